@@ -1,32 +1,10 @@
-QT       += core gui
+TEMPLATE = subdirs
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+SUBDIRS += \
+    app \
+    benchmarks \
+    tests
 
-CONFIG += c++17
-
-# You can make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-    coloritemdelegate.cpp \
-    main.cpp \
-    photoeditorwindow.cpp
-
-HEADERS += \
-    coloritemdelegate.h \
-    constants.h \
-    photoeditorwindow.h
-
-TRANSLATIONS += \
-    PhotoEditor_en_US.ts
-CONFIG += lrelease
-CONFIG += embed_translations
-
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
-
-RESOURCES += \
-    resources/photoeditor.qrc
+app.file = PhotoEditorApp.pro
+benchmarks.subdir = benchmarks
+tests.subdir = tests
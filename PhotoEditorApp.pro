@@ -0,0 +1,43 @@
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = PhotoEditor
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+include(PhotoEditorCore.pri)
+
+SOURCES += \
+    adjustmentsdialog.cpp \
+    coloritemdelegate.cpp \
+    filmstrip.cpp \
+    histogramwidget.cpp \
+    iconcache.cpp \
+    main.cpp \
+    photoeditorwindow.cpp \
+    resizedialog.cpp
+
+HEADERS += \
+    adjustmentsdialog.h \
+    coloritemdelegate.h \
+    filmstrip.h \
+    histogramwidget.h \
+    iconcache.h \
+    photoeditorwindow.h \
+    resizedialog.h
+
+TRANSLATIONS += \
+    PhotoEditor_en_US.ts
+CONFIG += lrelease
+CONFIG += embed_translations
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+RESOURCES += \
+    resources/photoeditor.qrc
@@ -0,0 +1,87 @@
+# Sources shared by the application, the benchmarks and the tests.
+
+QT += core gui widgets concurrent printsupport
+
+CONFIG += c++17 simd
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/annotation.cpp \
+    $$PWD/annotationscene.cpp \
+    $$PWD/batchprocessor.cpp \
+    $$PWD/colormanagement.cpp \
+    $$PWD/compositing.cpp \
+    $$PWD/edithistory.cpp \
+    $$PWD/exif.cpp \
+    $$PWD/filtergraph.cpp \
+    $$PWD/histogram.cpp \
+    $$PWD/imagepyramid.cpp \
+    $$PWD/photocanvas.cpp \
+    $$PWD/photoloader.cpp \
+    $$PWD/photomimedata.cpp \
+    $$PWD/photoprinter.cpp \
+    $$PWD/photosaver.cpp \
+    $$PWD/profiler.cpp \
+    $$PWD/projectfile.cpp \
+    $$PWD/recoveryjournal.cpp \
+    $$PWD/redaction.cpp \
+    $$PWD/resampler.cpp \
+    $$PWD/summedareatable.cpp \
+    $$PWD/thumbnailloader.cpp \
+    $$PWD/tiledimage.cpp \
+    $$PWD/tiledimagestore.cpp
+
+HEADERS += \
+    $$PWD/annotation.h \
+    $$PWD/annotationscene.h \
+    $$PWD/batchprocessor.h \
+    $$PWD/colormanagement.h \
+    $$PWD/compositing.h \
+    $$PWD/constants.h \
+    $$PWD/edithistory.h \
+    $$PWD/exif.h \
+    $$PWD/filtergraph.h \
+    $$PWD/histogram.h \
+    $$PWD/imagepyramid.h \
+    $$PWD/photocanvas.h \
+    $$PWD/photoloader.h \
+    $$PWD/photomimedata.h \
+    $$PWD/photoprinter.h \
+    $$PWD/photosaver.h \
+    $$PWD/profiler.h \
+    $$PWD/projectfile.h \
+    $$PWD/recoveryjournal.h \
+    $$PWD/redaction.h \
+    $$PWD/resampler.h \
+    $$PWD/summedareatable.h \
+    $$PWD/thumbnailloader.h \
+    $$PWD/tiledimage.h \
+    $$PWD/tiledimagestore.h
+
+# Huge JPEG photos are decoded and saved scanline by scanline with the libjpeg API, which libjpeg-turbo provides too,
+# when it is available, other photos too big for memory decode a clip rect per band.
+packagesExist(libjpeg) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libjpeg
+    DEFINES += HAVE_LIBJPEG
+    SOURCES += $$PWD/jpegbandreader.cpp \
+        $$PWD/jpegbandwriter.cpp
+    HEADERS += $$PWD/jpegbandreader.h \
+        $$PWD/jpegbandwriter.h
+}
+
+# Kernels built with their instruction set enabled, the CPU is checked at runtime before calling them.
+contains(QT_ARCH, x86_64)|contains(QT_ARCH, i386) {
+    SSE4_1_SOURCES += \
+        $$PWD/compositing_sse4.cpp \
+        $$PWD/histogram_sse4.cpp \
+        $$PWD/redaction_sse4.cpp \
+        $$PWD/resampler_sse4.cpp
+    AVX2_SOURCES += \
+        $$PWD/compositing_avx2.cpp \
+        $$PWD/histogram_avx2.cpp \
+        $$PWD/redaction_avx2.cpp \
+        $$PWD/resampler_avx2.cpp
+}
@@ -0,0 +1,120 @@
+#include "adjustmentsdialog.h"
+#include "constants.h"
+
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QPushButton>
+#include <QSlider>
+
+namespace {
+
+// The sliders move by hundredths of the factors and tenths of the radius.
+const qreal FACTOR_STEPS = 100.0;
+const qreal RADIUS_STEPS = 10.0;
+
+FilterGraph::Node findNode(const QVector<FilterGraph::Node>& nodes, FilterGraph::Node::Type type)
+{
+    for (const FilterGraph::Node& node : nodes) {
+        if (node.type == type)
+            return node;
+    }
+    FilterGraph::Node node;
+    node.type = type;
+    return node;
+}
+
+}
+
+AdjustmentsDialog::AdjustmentsDialog(const QVector<FilterGraph::Node>& adjustments, QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Adjustments"));
+
+    auto* layout = new QFormLayout(this);
+    m_blackPointSlider = addSlider(layout, tr("Black point:"), 0, 254);
+    m_whitePointSlider = addSlider(layout, tr("White point:"), 1, 255);
+    m_gammaSlider = addSlider(layout, tr("Gamma:"), 10, 300);
+    m_brightnessSlider = addSlider(layout, tr("Brightness:"), -100, 100);
+    m_contrastSlider = addSlider(layout, tr("Contrast:"), -100, 100);
+    m_saturationSlider = addSlider(layout, tr("Saturation:"), 0, 200);
+    m_sharpenAmountSlider = addSlider(layout, tr("Sharpen amount:"), 0, 300);
+    m_sharpenRadiusSlider = addSlider(layout, tr("Sharpen radius:"), 5, 100);
+    setAdjustments(adjustments);
+
+    auto* buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel | QDialogButtonBox::Reset, this);
+    layout->addRow(buttonBox);
+
+    // The black point stays below the white point.
+    connect(m_blackPointSlider, &QSlider::valueChanged, [&](int value) {
+        if (m_whitePointSlider->value() <= value)
+            m_whitePointSlider->setValue(value + 1);
+    });
+    connect(m_whitePointSlider, &QSlider::valueChanged, [&](int value) {
+        if (m_blackPointSlider->value() >= value)
+            m_blackPointSlider->setValue(value - 1);
+    });
+    connect(buttonBox->button(QDialogButtonBox::Reset), &QPushButton::clicked, [&]() {
+        setAdjustments(QVector<FilterGraph::Node>());
+        emit adjustmentsChanged(this->adjustments());
+    });
+    connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+QVector<FilterGraph::Node> AdjustmentsDialog::adjustments() const
+{
+    FilterGraph::Node levels;
+    levels.type = FilterGraph::Node::Levels;
+    levels.blackPoint = m_blackPointSlider->value();
+    levels.whitePoint = m_whitePointSlider->value();
+    levels.gamma = m_gammaSlider->value() / FACTOR_STEPS;
+
+    FilterGraph::Node brightnessContrast;
+    brightnessContrast.type = FilterGraph::Node::BrightnessContrast;
+    brightnessContrast.brightness = m_brightnessSlider->value() / FACTOR_STEPS;
+    brightnessContrast.contrast = m_contrastSlider->value() / FACTOR_STEPS;
+
+    FilterGraph::Node saturation;
+    saturation.type = FilterGraph::Node::Saturation;
+    saturation.saturation = m_saturationSlider->value() / FACTOR_STEPS;
+
+    FilterGraph::Node sharpen;
+    sharpen.type = FilterGraph::Node::Sharpen;
+    sharpen.amount = m_sharpenAmountSlider->value() / FACTOR_STEPS;
+    sharpen.radius = m_sharpenRadiusSlider->value() / RADIUS_STEPS;
+
+    return { levels, brightnessContrast, saturation, sharpen };
+}
+
+QSlider* AdjustmentsDialog::addSlider(QFormLayout* layout, const QString& label, int minimum, int maximum)
+{
+    auto* slider = new QSlider(Qt::Horizontal, this);
+    slider->setRange(minimum, maximum);
+    slider->setMinimumWidth(Constants::ADJUSTMENT_SLIDER_WIDTH_PX);
+    layout->addRow(label, slider);
+    connect(slider, &QSlider::valueChanged, [this]() {
+        emit adjustmentsChanged(adjustments());
+    });
+    return slider;
+}
+
+void AdjustmentsDialog::setAdjustments(const QVector<FilterGraph::Node>& adjustments)
+{
+    const FilterGraph::Node levels = findNode(adjustments, FilterGraph::Node::Levels),
+            brightnessContrast = findNode(adjustments, FilterGraph::Node::BrightnessContrast),
+            saturation = findNode(adjustments, FilterGraph::Node::Saturation),
+            sharpen = findNode(adjustments, FilterGraph::Node::Sharpen);
+    const QList<QSlider*> sliders = findChildren<QSlider*>();
+    for (QSlider* slider : sliders)
+        slider->blockSignals(true);
+    m_blackPointSlider->setValue(levels.blackPoint);
+    m_whitePointSlider->setValue(levels.whitePoint);
+    m_gammaSlider->setValue(qRound(levels.gamma * FACTOR_STEPS));
+    m_brightnessSlider->setValue(qRound(brightnessContrast.brightness * FACTOR_STEPS));
+    m_contrastSlider->setValue(qRound(brightnessContrast.contrast * FACTOR_STEPS));
+    m_saturationSlider->setValue(qRound(saturation.saturation * FACTOR_STEPS));
+    m_sharpenAmountSlider->setValue(qRound(sharpen.amount * FACTOR_STEPS));
+    m_sharpenRadiusSlider->setValue(qRound(sharpen.radius * RADIUS_STEPS));
+    for (QSlider* slider : sliders)
+        slider->blockSignals(false);
+}
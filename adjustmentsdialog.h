@@ -0,0 +1,41 @@
+#ifndef ADJUSTMENTSDIALOG_H
+#define ADJUSTMENTSDIALOG_H
+
+#include "filtergraph.h"
+
+#include <QDialog>
+
+class QFormLayout;
+class QSlider;
+
+// Edits the adjustments of the photo with a slider per parameter. The adjustments are emitted as the sliders
+// move, for the photo to preview them; the caller restores the previous ones if the dialog is canceled.
+class AdjustmentsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    AdjustmentsDialog(const QVector<FilterGraph::Node>& adjustments, QWidget* parent = nullptr);
+    ~AdjustmentsDialog() = default;
+
+    // One node of every type, in the order they apply. Nodes left as they are are dropped by the graph.
+    QVector<FilterGraph::Node> adjustments() const;
+
+signals:
+    void adjustmentsChanged(const QVector<FilterGraph::Node>& adjustments);
+
+private:
+    QSlider* addSlider(QFormLayout* layout, const QString& label, int minimum, int maximum);
+    void setAdjustments(const QVector<FilterGraph::Node>& adjustments);
+
+    QSlider* m_blackPointSlider { nullptr };
+    QSlider* m_whitePointSlider { nullptr };
+    QSlider* m_gammaSlider { nullptr };
+    QSlider* m_brightnessSlider { nullptr };
+    QSlider* m_contrastSlider { nullptr };
+    QSlider* m_saturationSlider { nullptr };
+    QSlider* m_sharpenAmountSlider { nullptr };
+    QSlider* m_sharpenRadiusSlider { nullptr };
+};
+
+#endif // ADJUSTMENTSDIALOG_H
@@ -0,0 +1,152 @@
+#include "annotation.h"
+
+#include <QPainter>
+#include <QPainterPathStroker>
+#include <QtMath>
+
+namespace {
+
+const qreal ARROW_HEAD_LENGTH_FACTOR = 4.0;
+const qreal ARROW_HEAD_ANGLE = M_PI / 6.0;
+const int STAR_POINT_COUNT = 5;
+const qreal STAR_INNER_RADIUS_FACTOR = 0.382;
+
+}
+
+Annotation::Annotation(Type type, const QColor& color, qreal penWidth)
+    : m_type(type)
+    , m_color(color)
+    , m_penWidth(penWidth)
+{}
+
+void Annotation::addPoint(const QPointF& point)
+{
+    m_points.append(point);
+    if (m_type != Pencil) {
+        updateBoundingRect();
+        return;
+    }
+
+    // A stroke only grows, extend the bounding rect by the new point instead of walking the whole stroke.
+    const qreal margin = m_penWidth / 2.0 + 1.0;
+    const QRectF pointRect = QRectF(point, QSizeF(0.0, 0.0)).adjusted(-margin, -margin, margin, margin);
+    m_boundingRect = m_points.size() == 1 ? pointRect : m_boundingRect.united(pointRect);
+}
+
+void Annotation::setEndPoint(const QPointF& point)
+{
+    if (m_points.size() < 2)
+        m_points.append(point);
+    else
+        m_points.last() = point;
+    updateBoundingRect();
+}
+
+QPainterPath Annotation::path() const
+{
+    QPainterPath path;
+    if (m_points.isEmpty())
+        return path;
+
+    const QPointF first = m_points.first(), last = m_points.last();
+    const QRectF rect = QRectF(first, last).normalized();
+    switch (m_type) {
+    case Pencil:
+        path.moveTo(first);
+        for (int i = 1; i < m_points.size(); ++i)
+            path.lineTo(m_points.at(i));
+        if (m_points.size() == 1)
+            path.lineTo(first);
+        break;
+    case Arrow: {
+        const qreal angle = qAtan2(last.y() - first.y(), last.x() - first.x()),
+                headLength = m_penWidth * ARROW_HEAD_LENGTH_FACTOR;
+        path.moveTo(first);
+        path.lineTo(last);
+        path.moveTo(last - QPointF(qCos(angle - ARROW_HEAD_ANGLE), qSin(angle - ARROW_HEAD_ANGLE)) * headLength);
+        path.lineTo(last);
+        path.lineTo(last - QPointF(qCos(angle + ARROW_HEAD_ANGLE), qSin(angle + ARROW_HEAD_ANGLE)) * headLength);
+        break;
+    }
+    case Box:
+    case Blur:
+    case Pixelate:
+        path.addRect(rect);
+        break;
+    case Ellipse:
+        path.addEllipse(rect);
+        break;
+    case Triangle:
+        path.moveTo(rect.bottomLeft());
+        path.lineTo(QPointF(rect.center().x(), rect.top()));
+        path.lineTo(rect.bottomRight());
+        path.closeSubpath();
+        break;
+    case Star:
+        for (int i = 0; i < 2 * STAR_POINT_COUNT; ++i) {
+            const qreal radiusFactor = i % 2 ? STAR_INNER_RADIUS_FACTOR : 1.0,
+                    angle = -M_PI / 2.0 + i * M_PI / STAR_POINT_COUNT;
+            const QPointF vertex(rect.center().x() + qCos(angle) * rect.width() / 2.0 * radiusFactor,
+                                 rect.center().y() + qSin(angle) * rect.height() / 2.0 * radiusFactor);
+            if (i == 0)
+                path.moveTo(vertex);
+            else
+                path.lineTo(vertex);
+        }
+        path.closeSubpath();
+        break;
+    default:
+        break;
+    }
+    return path;
+}
+
+bool Annotation::contains(const QPointF& point, qreal tolerance) const
+{
+    if (!m_boundingRect.adjusted(-tolerance, -tolerance, tolerance, tolerance).contains(point))
+        return false;
+
+    QPainterPathStroker stroker;
+    stroker.setWidth(m_penWidth + 2.0 * tolerance);
+    stroker.setCapStyle(Qt::RoundCap);
+    stroker.setJoinStyle(Qt::RoundJoin);
+    return stroker.createStroke(path()).contains(point);
+}
+
+void Annotation::paint(QPainter* painter, const QRectF& exposedRect) const
+{
+    painter->setPen(QPen(m_color, m_penWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    painter->setBrush(Qt::NoBrush);
+    if (m_type != Pencil || exposedRect.isNull() || m_points.size() < 2 || exposedRect.contains(m_boundingRect)) {
+        painter->drawPath(path());
+        return;
+    }
+
+    // Stroking a long stroke costs the same whatever the clip, while a repaint usually exposes a few segments.
+    // Only the runs of segments intersecting the exposed rect are drawn.
+    const qreal margin = m_penWidth / 2.0 + 1.0;
+    const QRectF rect = exposedRect.adjusted(-margin, -margin, margin, margin);
+    auto segmentVisible = [&](int index) {
+        const QPointF& a = m_points.at(index - 1);
+        const QPointF& b = m_points.at(index);
+        return qMax(a.x(), b.x()) >= rect.left() && qMin(a.x(), b.x()) <= rect.right()
+                && qMax(a.y(), b.y()) >= rect.top() && qMin(a.y(), b.y()) <= rect.bottom();
+    };
+
+    int runStart = -1;
+    for (int i = 1; i <= m_points.size(); ++i) {
+        const bool visible = i < m_points.size() && segmentVisible(i);
+        if (visible && runStart < 0) {
+            runStart = i - 1;
+        } else if (!visible && runStart >= 0) {
+            painter->drawPolyline(m_points.constData() + runStart, i - runStart);
+            runStart = -1;
+        }
+    }
+}
+
+void Annotation::updateBoundingRect()
+{
+    const qreal margin = m_penWidth / 2.0 + 1.0;
+    m_boundingRect = path().controlPointRect().adjusted(-margin, -margin, margin, margin);
+}
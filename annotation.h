@@ -0,0 +1,59 @@
+#ifndef ANNOTATION_H
+#define ANNOTATION_H
+
+#include <QColor>
+#include <QPainterPath>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+class QPainter;
+
+// Vector annotation drawn over the photo, in photo coordinates.
+class Annotation
+{
+public:
+    // The types follow the order of PhotoEditorWindow::DrawTools.
+    enum Type {
+        Invalid = -1,
+        Pencil = 0,
+        Arrow,
+        Box,
+        Ellipse,
+        Triangle,
+        Star,
+        // Rubber bands of the redaction tools, which edit the pixels of the photo instead of staying annotations.
+        Blur,
+        Pixelate
+    };
+
+    Annotation() = default;
+    Annotation(Type type, const QColor& color, qreal penWidth);
+
+    bool isNull() const { return m_type == Invalid; }
+    Type type() const { return m_type; }
+    QColor color() const { return m_color; }
+    qreal penWidth() const { return m_penWidth; }
+
+    // A pencil stroke goes through all the points, a shape is spanned by the first and the last one.
+    const QVector<QPointF>& points() const { return m_points; }
+    void addPoint(const QPointF& point);
+    void setEndPoint(const QPointF& point);
+
+    QPainterPath path() const;
+    QRectF boundingRect() const { return m_boundingRect; }
+    bool contains(const QPointF& point, qreal tolerance) const;
+    // Paints the annotation, a pencil stroke only paints its segments near the exposed rect if one is given.
+    void paint(QPainter* painter, const QRectF& exposedRect = QRectF()) const;
+
+private:
+    void updateBoundingRect();
+
+    Type m_type { Invalid };
+    QColor m_color;
+    qreal m_penWidth { 1.0 };
+    QVector<QPointF> m_points;
+    QRectF m_boundingRect;
+};
+
+#endif // ANNOTATION_H
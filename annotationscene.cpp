@@ -0,0 +1,168 @@
+#include "annotationscene.h"
+#include "compositing.h"
+
+#include <QPainter>
+#include <QSet>
+#include <QtMath>
+
+#include <algorithm>
+
+AnnotationScene::AnnotationScene(int cellSize)
+    : m_cellSize(qMax(1, cellSize))
+{}
+
+quint64 AnnotationScene::add(const Annotation& annotation)
+{
+    const quint64 id = m_nextId;
+    set(id, annotation);
+    return id;
+}
+
+void AnnotationScene::set(quint64 id, const Annotation& annotation)
+{
+    remove(id);
+    if (annotation.isNull())
+        return;
+
+    m_annotations.insert(id, annotation);
+    index(id, annotation.boundingRect());
+    m_nextId = qMax(m_nextId, id + 1);
+}
+
+void AnnotationScene::remove(quint64 id)
+{
+    const auto it = m_annotations.constFind(id);
+    if (it == m_annotations.constEnd())
+        return;
+
+    unindex(id, it->boundingRect());
+    m_annotations.erase(it);
+}
+
+void AnnotationScene::clear()
+{
+    m_annotations.clear();
+    m_cells.clear();
+}
+
+quint64 AnnotationScene::itemAt(const QPointF& point, qreal tolerance) const
+{
+    const QVector<quint64> ids = items(QRectF(point, QSizeF(0.0, 0.0)).adjusted(-tolerance, -tolerance, tolerance, tolerance));
+    for (auto it = ids.crbegin(); it != ids.crend(); ++it) {
+        if (m_annotations.value(*it).contains(point, tolerance))
+            return *it;
+    }
+    return 0;
+}
+
+QVector<quint64> AnnotationScene::ids() const
+{
+    QVector<quint64> ids = m_annotations.keys().toVector();
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+QRectF AnnotationScene::boundingRect() const
+{
+    QRectF rect;
+    for (const Annotation& annotation : m_annotations)
+        rect |= annotation.boundingRect();
+    return rect;
+}
+
+QVector<quint64> AnnotationScene::items(const QRectF& rect) const
+{
+    QVector<quint64> ids;
+    QSet<quint64> visitedIds;
+    const QRect range = cellRange(rect);
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column) {
+            const auto cell = m_cells.constFind(cellKey(column, row));
+            if (cell == m_cells.constEnd())
+                continue;
+
+            for (const quint64 id : *cell) {
+                if (visitedIds.contains(id))
+                    continue;
+                visitedIds.insert(id);
+                if (m_annotations.value(id).boundingRect().intersects(rect))
+                    ids.append(id);
+            }
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+void AnnotationScene::paint(QPainter* painter, const QRectF& rect) const
+{
+    const QVector<quint64> ids = items(rect);
+    for (const quint64 id : ids)
+        m_annotations.value(id).paint(painter, rect);
+}
+
+void AnnotationScene::composite(QImage& image, int opacity, const QPoint& origin, qreal scale) const
+{
+    if (isEmpty() || opacity <= 0)
+        return;
+    // The kernels blend premultiplied pixels, straight alpha ones would get wrong colors.
+    image = Compositing::toDestinationFormat(image);
+
+    // The layer is rendered band by band, so it never takes the memory of a whole photo.
+    const int bandHeight = Constants::PHOTO_TILE_SIZE_PX * 4;
+    for (int top = 0; top < image.height(); top += bandHeight) {
+        const QRect band(0, top, image.width(), qMin(bandHeight, image.height() - top));
+        const QRect scaledBand = band.translated(origin);
+        const QRectF photoBand(scaledBand.x() / scale, scaledBand.y() / scale, scaledBand.width() / scale, scaledBand.height() / scale);
+        const QVector<quint64> ids = items(photoBand);
+        if (ids.isEmpty())
+            continue;
+
+        QImage layer(band.size(), QImage::Format_ARGB32_Premultiplied);
+        layer.fill(Qt::transparent);
+        QPainter painter(&layer);
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        painter.translate(-scaledBand.topLeft());
+        painter.scale(scale, scale);
+        for (const quint64 id : ids)
+            m_annotations.value(id).paint(&painter, photoBand);
+        painter.end();
+        Compositing::sourceOver(image, layer, opacity, band.topLeft());
+    }
+}
+
+QRect AnnotationScene::cellRange(const QRectF& rect) const
+{
+    return QRect(QPoint(qFloor(rect.left() / m_cellSize), qFloor(rect.top() / m_cellSize)),
+                 QPoint(qFloor(rect.right() / m_cellSize), qFloor(rect.bottom() / m_cellSize)));
+}
+
+void AnnotationScene::index(quint64 id, const QRectF& rect)
+{
+    const QRect range = cellRange(rect);
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column)
+            m_cells[cellKey(column, row)].append(id);
+    }
+}
+
+void AnnotationScene::unindex(quint64 id, const QRectF& rect)
+{
+    const QRect range = cellRange(rect);
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column) {
+            const auto cell = m_cells.find(cellKey(column, row));
+            if (cell == m_cells.end())
+                continue;
+
+            cell->removeOne(id);
+            if (cell->isEmpty())
+                m_cells.erase(cell);
+        }
+    }
+}
+
+quint64 AnnotationScene::cellKey(int column, int row)
+{
+    return (quint64(quint32(row)) << 32) | quint64(quint32(column));
+}
@@ -0,0 +1,64 @@
+#ifndef ANNOTATIONSCENE_H
+#define ANNOTATIONSCENE_H
+
+#include "annotation.h"
+#include "constants.h"
+
+#include <QHash>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+// Retained scene of the annotations drawn over the photo. Annotations are kept as vector objects apart
+// from the photo pixels, so editing one never recomposites the photo. A uniform grid indexes them by
+// their bounding rects: hit-testing and painting only visit the annotations of the cells they touch,
+// whatever the number of annotations in the scene.
+// Ids are never reused and increase with the insertion order, which is also the paint order.
+class AnnotationScene
+{
+public:
+    explicit AnnotationScene(int cellSize = Constants::ANNOTATION_GRID_CELL_SIZE_PX);
+
+    bool isEmpty() const { return m_annotations.isEmpty(); }
+    int count() const { return m_annotations.size(); }
+    bool contains(quint64 id) const { return m_annotations.contains(id); }
+    // Returns a null annotation for an unknown id.
+    Annotation annotation(quint64 id) const { return m_annotations.value(id); }
+    quint64 nextId() const { return m_nextId; }
+    // Keeps add() from handing out the ids below the given one, like the ids of removed annotations still
+    // referred to by the undo history of a reopened project.
+    void reserveIds(quint64 nextId) { m_nextId = qMax(m_nextId, nextId); }
+
+    quint64 add(const Annotation& annotation);
+    // Inserts or replaces the annotation with the given id, a null annotation removes it.
+    void set(quint64 id, const Annotation& annotation);
+    void remove(quint64 id);
+    void clear();
+
+    // Returns the topmost annotation whose outline passes within the tolerance of the point, 0 if none.
+    quint64 itemAt(const QPointF& point, qreal tolerance) const;
+    // Returns all the annotations, in paint order.
+    QVector<quint64> ids() const;
+    // Returns the rect of all the annotations, in photo coordinates.
+    QRectF boundingRect() const;
+    // Returns the annotations intersecting the rect, in paint order.
+    QVector<quint64> items(const QRectF& rect) const;
+    void paint(QPainter* painter, const QRectF& rect) const;
+    // Blends the annotations as one layer over the image, opacity in [0, 255]. An image in another format than
+    // RGB32 or premultiplied ARGB32, like a straight alpha one, is converted to one of them first.
+    // The image covers the part of the photo scaled by the scale at the origin, in scaled coordinates.
+    void composite(QImage& image, int opacity = 255, const QPoint& origin = QPoint(), qreal scale = 1.0) const;
+
+private:
+    QRect cellRange(const QRectF& rect) const;
+    void index(quint64 id, const QRectF& rect);
+    void unindex(quint64 id, const QRectF& rect);
+    static quint64 cellKey(int column, int row);
+
+    int m_cellSize;
+    QHash<quint64, Annotation> m_annotations;
+    QHash<quint64, QVector<quint64>> m_cells;
+    quint64 m_nextId { 1 };
+};
+
+#endif // ANNOTATIONSCENE_H
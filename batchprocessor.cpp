@@ -0,0 +1,315 @@
+#include "batchprocessor.h"
+#include "annotationscene.h"
+#include "photoloader.h"
+#include "photoprinter.h"
+#include "profiler.h"
+#include "constants.h"
+
+#include <QAtomicInt>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QHash>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <cstring>
+
+namespace {
+
+const char* const BATCH_OPTION = "--batch";
+
+const QStringList TOOL_NAMES { "pencil", "arrow", "box", "ellipse", "triangle", "star" };
+
+// Identifies the file of the path whether it exists or not, through the canonical path of its directory.
+QString fileKey(const QString& path)
+{
+    const QFileInfo fileInfo(path);
+    const QString canonicalDirectory = QFileInfo(fileInfo.absolutePath()).canonicalFilePath();
+    const QString key = QDir::cleanPath((canonicalDirectory.isEmpty() ? fileInfo.absolutePath() : canonicalDirectory)
+                                        + '/' + fileInfo.fileName());
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+    return key.toLower();
+#else
+    return key;
+#endif
+}
+
+}
+
+BatchProcessor::BatchProcessor(const Script& script, const QString& outputDirectory)
+    : m_script(script)
+    , m_outputDirectory(outputDirectory)
+{}
+
+bool BatchProcessor::isBatchInvocation(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], BATCH_OPTION) == 0)
+            return true;
+    }
+    return false;
+}
+
+int BatchProcessor::exec(int argc, char* argv[])
+{
+    // Build servers have no display, nothing is shown anyway.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QObject::tr("Applies an operation script to photos without showing the editor."));
+    parser.addHelpOption();
+    parser.addOption({ "batch", QObject::tr("Runs in batch mode.") });
+    parser.addOption({ "script", QObject::tr("Operation script to apply."), QObject::tr("file") });
+    parser.addOption({ "output", QObject::tr("Directory of the processed photos."), QObject::tr("directory") });
+    parser.addOption({ "jobs", QObject::tr("Number of photos processed in parallel, the number of cores by default."), QObject::tr("count") });
+    parser.addOption({ "trace", QObject::tr("Writes a Chrome trace of the run to the file."), QObject::tr("file") });
+    parser.addPositionalArgument("inputs", QObject::tr("Photos or directories of photos to process."), QObject::tr("<file or directory>..."));
+    parser.process(application);
+
+    QTextStream errorStream(stderr);
+    if (!parser.isSet("script") || !parser.isSet("output") || parser.positionalArguments().isEmpty()) {
+        errorStream << parser.helpText();
+        return 2;
+    }
+
+    Script script;
+    QString errorString;
+    if (!parseScript(parser.value("script"), &script, &errorString)) {
+        errorStream << QObject::tr("Invalid script: %1").arg(errorString) << Qt::endl;
+        return 2;
+    }
+
+    const QString outputDirectory = parser.value("output");
+    if (!QDir().mkpath(outputDirectory)) {
+        errorStream << QObject::tr("Cannot create %1").arg(QDir::toNativeSeparators(outputDirectory)) << Qt::endl;
+        return 2;
+    }
+
+    const int jobCount = parser.isSet("jobs") ? parser.value("jobs").toInt() : QThread::idealThreadCount();
+    BatchProcessor processor(script, outputDirectory);
+    const int failedCount = processor.run(collectInputs(parser.positionalArguments()), jobCount);
+    if (parser.isSet("trace") && !Profiler::writeTrace(parser.value("trace"), &errorString)) {
+        errorStream << QObject::tr("Cannot write the trace: %1").arg(errorString) << Qt::endl;
+        return 1;
+    }
+    return failedCount == 0 ? 0 : 1;
+}
+
+bool BatchProcessor::parseScript(const QString& filePath, Script* script, QString* errorString)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    auto fail = [errorString](int lineNumber, const QString& message) {
+        if (errorString)
+            *errorString = QObject::tr("line %1: %2").arg(lineNumber).arg(message);
+        return false;
+    };
+
+    QTextStream stream(&file);
+    for (int lineNumber = 1; !stream.atEnd(); ++lineNumber) {
+        const QString line = stream.readLine().section('#', 0, 0).trimmed();
+        const QStringList words = line.split(QRegExp("\\s+"), Qt::SkipEmptyParts);
+        if (words.isEmpty())
+            continue;
+
+        const QString operation = words.first().toLower();
+        bool ok = words.size() == 2;
+        if (operation == "opacity") {
+            const int opacity = ok ? words.at(1).toInt(&ok) : 0;
+            if (!ok || opacity < 0 || opacity > Constants::SLIDER_MAX_VALUE)
+                return fail(lineNumber, QObject::tr("expected opacity <0-%1>").arg(Constants::SLIDER_MAX_VALUE));
+            script->opacity = qRound(opacity * 255.0 / Constants::SLIDER_MAX_VALUE);
+        } else if (operation == "format") {
+            const QByteArray format = ok ? words.at(1).toLatin1().toLower() : QByteArray();
+            if (format != "pdf" && !QImageWriter::supportedImageFormats().contains(format))
+                return fail(lineNumber, QObject::tr("expected format <suffix> of a supported format"));
+            script->format = format;
+        } else if (operation == "quality") {
+            const int quality = ok ? words.at(1).toInt(&ok) : 0;
+            if (!ok || quality < 0 || quality > 100)
+                return fail(lineNumber, QObject::tr("expected quality <0-100>"));
+            script->quality = quality;
+        } else if (TOOL_NAMES.contains(operation)) {
+            const auto type = static_cast<Annotation::Type>(TOOL_NAMES.indexOf(operation));
+            const int coordinateCount = words.size() - 3;
+            const QColor color(words.value(1));
+            const qreal penWidth = words.value(2).toDouble(&ok);
+            if (!color.isValid() || !ok || penWidth <= 0.0 || coordinateCount < 2 || coordinateCount % 2
+                    || (type != Annotation::Pencil && coordinateCount != 4))
+                return fail(lineNumber, QObject::tr("expected %1 <color> <pen width> <x> <y>...").arg(operation));
+
+            Annotation annotation(type, color, penWidth);
+            for (int i = 3; i < words.size(); i += 2) {
+                bool xOk = false, yOk = false;
+                const QPointF point(words.at(i).toDouble(&xOk), words.at(i + 1).toDouble(&yOk));
+                if (!xOk || !yOk)
+                    return fail(lineNumber, QObject::tr("invalid coordinates"));
+                annotation.addPoint(point);
+            }
+            script->annotations.append(annotation);
+        } else {
+            return fail(lineNumber, QObject::tr("unknown operation %1").arg(operation));
+        }
+    }
+    return true;
+}
+
+QStringList BatchProcessor::collectInputs(const QStringList& paths)
+{
+    QStringList nameFilters;
+    const QList<QByteArray> supportedFormats = QImageReader::supportedImageFormats();
+    for (const QByteArray& format : supportedFormats)
+        nameFilters.append(QStringLiteral("*.") + QString::fromLatin1(format));
+
+    QStringList filePaths;
+    for (const QString& path : paths) {
+        const QFileInfo fileInfo(path);
+        if (!fileInfo.isDir()) {
+            filePaths.append(path);
+            continue;
+        }
+        const QFileInfoList entries = QDir(path).entryInfoList(nameFilters, QDir::Files | QDir::Readable, QDir::Name);
+        for (const QFileInfo& entry : entries)
+            filePaths.append(entry.filePath());
+    }
+    return filePaths;
+}
+
+int BatchProcessor::run(const QStringList& filePaths, int jobCount)
+{
+    // The bands the conversion and compositing split a photo into go to the same pool, so they never
+    // oversubscribe the cores: with all the threads busy on photos, each photo runs its bands itself.
+    QThreadPool* threadPool = QThreadPool::globalInstance();
+    threadPool->setMaxThreadCount(qMax(1, jobCount));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Two files saved to the same output would be written to it at once, refuse them before any is processed.
+    QSet<QString> inputKeys;
+    for (const QString& filePath : filePaths)
+        inputKeys.insert(fileKey(filePath));
+    QHash<QString, QString> outputs;
+    QStringList acceptedPaths;
+    int refusedCount = 0;
+    for (const QString& filePath : filePaths) {
+        const QString path = outputPath(filePath);
+        const QString key = fileKey(path);
+        if (inputKeys.contains(key)) {
+            print(QObject::tr("%1: the output %2 would overwrite an input").arg(QDir::toNativeSeparators(filePath),
+                                                                                QDir::toNativeSeparators(path)), true);
+        } else if (outputs.contains(key)) {
+            print(QObject::tr("%1: the output %2 is already the output of %3").arg(QDir::toNativeSeparators(filePath),
+                                                                                   QDir::toNativeSeparators(path),
+                                                                                   QDir::toNativeSeparators(outputs.value(key))), true);
+        } else {
+            outputs.insert(key, filePath);
+            acceptedPaths.append(filePath);
+            continue;
+        }
+        ++refusedCount;
+    }
+
+    QAtomicInt failedCount(refusedCount);
+    for (const QString& filePath : qAsConst(acceptedPaths)) {
+        threadPool->start([this, filePath, &failedCount]() {
+            if (!process(filePath))
+                failedCount.fetchAndAddRelaxed(1);
+        });
+    }
+    threadPool->waitForDone();
+
+    print(QObject::tr("%1 photos processed in %2 ms with %3 jobs, %4 failed")
+          .arg(filePaths.size()).arg(timer.elapsed()).arg(threadPool->maxThreadCount()).arg(failedCount.loadRelaxed()));
+    return failedCount.loadRelaxed();
+}
+
+QByteArray BatchProcessor::outputFormat(const QFileInfo& fileInfo) const
+{
+    if (!m_script.format.isEmpty())
+        return m_script.format;
+    const QByteArray format = fileInfo.suffix().toLatin1().toLower();
+    return QImageWriter::supportedImageFormats().contains(format) ? format : QByteArray("png");
+}
+
+QString BatchProcessor::outputPath(const QString& filePath) const
+{
+    const QFileInfo fileInfo(filePath);
+    return QDir(m_outputDirectory).filePath(fileInfo.completeBaseName() + '.' + QString::fromLatin1(outputFormat(fileInfo)));
+}
+
+bool BatchProcessor::process(const QString& filePath)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QString errorString;
+    QImage photo = PhotoLoader::readPhoto(filePath, &errorString);
+    if (photo.isNull()) {
+        print(QObject::tr("%1: cannot load: %2").arg(QDir::toNativeSeparators(filePath), errorString), true);
+        return false;
+    }
+    const qint64 loadTime = timer.restart();
+
+    AnnotationScene scene;
+    for (const Annotation& annotation : qAsConst(m_script.annotations))
+        scene.add(annotation);
+
+    const QByteArray format = outputFormat(QFileInfo(filePath));
+    const QString savePath = outputPath(filePath);
+
+    // A PDF page is rendered in bands straight from the tiles and the scene, the photo is never flattened.
+    qint64 annotateTime = 0;
+    bool saved = false;
+    if (format == "pdf") {
+        PhotoSaver::Document document;
+        document.pyramid = ImagePyramid(photo);
+        document.annotations = scene;
+        document.annotationOpacity = m_script.opacity;
+        saved = PhotoPrinter::exportPdf(document, savePath, &errorString);
+    } else {
+        scene.composite(photo, m_script.opacity);
+        annotateTime = timer.restart();
+
+        QImageWriter writer(savePath, format);
+        writer.setQuality(m_script.quality);
+        saved = writer.write(photo);
+        if (!saved)
+            errorString = writer.errorString();
+    }
+    if (!saved) {
+        print(QObject::tr("%1: cannot save %2: %3").arg(QDir::toNativeSeparators(filePath), QDir::toNativeSeparators(savePath),
+                                                        errorString), true);
+        return false;
+    }
+    const qint64 saveTime = timer.elapsed();
+
+    print(QObject::tr("%1: load %2 ms, annotate %3 ms, save %4 ms, total %5 ms")
+          .arg(QDir::toNativeSeparators(filePath)).arg(loadTime).arg(annotateTime).arg(saveTime)
+          .arg(loadTime + annotateTime + saveTime));
+    return true;
+}
+
+void BatchProcessor::print(const QString& line, bool error)
+{
+    QMutexLocker locker(&m_outputMutex);
+    QTextStream stream(error ? stderr : stdout);
+    stream << line << Qt::endl;
+}
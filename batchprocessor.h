@@ -0,0 +1,59 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include "annotation.h"
+
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+
+class QFileInfo;
+
+// Headless mode running the load, color conversion, annotation and save pipeline of the editor on a batch
+// of photos, without any widget. Files are processed in parallel on the global thread pool, one file per
+// thread, and the per-file timings are printed on the standard output.
+//
+//   PhotoEditor --batch --script <file> --output <directory> [--jobs <count>] [--trace <file>] <file or directory>...
+//
+// The script has one operation per line, # starts a comment:
+//   pencil|arrow|box|ellipse|triangle|star <color> <pen width> <x> <y> <x> <y>...
+//   opacity <0-100>       opacity of the annotations
+//   format <suffix>       format of the outputs, the format of each input by default, pdf prints a page
+//   quality <0-100>       quality of the outputs for the lossy formats
+class BatchProcessor
+{
+public:
+    struct Script
+    {
+        QVector<Annotation> annotations;
+        int opacity { 255 };
+        QByteArray format;
+        int quality { -1 };
+    };
+
+    BatchProcessor(const Script& script, const QString& outputDirectory);
+
+    static bool isBatchInvocation(int argc, char* argv[]);
+    // Runs the batch mode with its own application object, returns the exit code.
+    static int exec(int argc, char* argv[]);
+
+    static bool parseScript(const QString& filePath, Script* script, QString* errorString = nullptr);
+    // Expands the directories into the readable image files they contain.
+    static QStringList collectInputs(const QStringList& paths);
+
+    // Returns the number of files which failed. A file whose output would replace an input file, or the output
+    // of an earlier file, like a.jpg and a.png saved as PNG, fails before anything is written.
+    int run(const QStringList& filePaths, int jobCount);
+
+private:
+    QByteArray outputFormat(const QFileInfo& fileInfo) const;
+    QString outputPath(const QString& filePath) const;
+    bool process(const QString& filePath);
+    void print(const QString& line, bool error = false);
+
+    Script m_script;
+    QString m_outputDirectory;
+    QMutex m_outputMutex;
+};
+
+#endif // BATCHPROCESSOR_H
@@ -0,0 +1,495 @@
+#include "annotation.h"
+#include "colormanagement.h"
+#include "compositing.h"
+#include "filtergraph.h"
+#include "histogram.h"
+#include "imagepyramid.h"
+#include "photocanvas.h"
+#include "photoloader.h"
+#include "redaction.h"
+#include "resampler.h"
+
+#include <QApplication>
+#include <QColorSpace>
+#include <QImageWriter>
+#include <QPainter>
+#include <QPixmap>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QtConcurrent>
+#include <QtTest>
+
+#include <cmath>
+#include <numeric>
+
+// Benchmarks of the hot paths of the editor on generated photos of 12, 50 and 100 MP.
+// PHOTOEDITOR_BENCHMARK_MEGAPIXELS restricts the sizes, e.g. "12,50". The results are printed as CSV
+// unless another output format is requested, see -help.
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void decode_data();
+    void decode();
+    void colorConversion_data();
+    void colorConversion();
+    void pixmapUpload_data();
+    void pixmapUpload();
+    void zoomedPainting_data();
+    void zoomedPainting();
+    void compositing_data();
+    void compositing();
+    void resampling_data();
+    void resampling();
+    void histogram_data();
+    void histogram();
+    void adjustments_data();
+    void adjustments();
+    void redaction_data();
+    void redaction();
+    void shapeRasterization_data();
+    void shapeRasterization();
+
+private:
+    void addSizeRows();
+    QImage photo(int megapixels);
+
+    QTemporaryDir m_fixtureDirectory;
+    QVector<int> m_megapixels;
+    QHash<int, QString> m_fixturePaths;
+    QHash<int, QImage> m_photos;
+};
+
+namespace {
+
+// Photos have a 4:3 aspect ratio.
+QSize photoSize(int megapixels)
+{
+    const int width = qRound(std::sqrt(megapixels * 1e6 * 4.0 / 3.0));
+    return QSize(width, width * 3 / 4);
+}
+
+// Smooth gradients with some noise, so the encoders work as hard as on real photos.
+QImage generatePhoto(const QSize& size)
+{
+    QImage image(size, QImage::Format_RGB32);
+    QRandomGenerator random(size.width());
+    for (int y = 0; y < image.height(); ++y) {
+        auto* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            const int noise = int(random.bounded(16u));
+            line[x] = qRgb((x * 255 / size.width() + noise) & 0xFF, (y * 255 / size.height() + noise) & 0xFF,
+                           ((x + y) * 255 / (size.width() + size.height()) + noise) & 0xFF);
+        }
+    }
+    return image;
+}
+
+// Annotation-like layer: mostly transparent, with opaque and antialiased strokes.
+QImage generateLayer(const QSize& size)
+{
+    QImage layer(size, QImage::Format_ARGB32_Premultiplied);
+    layer.fill(Qt::transparent);
+    QPainter painter(&layer);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setPen(QPen(QColor(229, 51, 42), size.width() / 200.0));
+    for (int i = 0; i < 50; ++i) {
+        const QRectF rect(size.width() * (i % 10) / 10.0, size.height() * (i / 10) / 5.0, size.width() / 12.0, size.height() / 6.0);
+        painter.drawEllipse(rect);
+    }
+    return layer;
+}
+
+}
+
+void Benchmarks::initTestCase()
+{
+    QVERIFY(m_fixtureDirectory.isValid());
+
+    const QByteArray megapixels = qgetenv("PHOTOEDITOR_BENCHMARK_MEGAPIXELS");
+    if (megapixels.isEmpty()) {
+        m_megapixels = { 12, 50, 100 };
+    } else {
+        for (const QByteArray& value : megapixels.split(','))
+            m_megapixels.append(value.trimmed().toInt());
+    }
+
+    for (const int size : qAsConst(m_megapixels)) {
+        const QString path = m_fixtureDirectory.filePath(QStringLiteral("photo-%1mp.jpg").arg(size));
+        QImageWriter writer(path, "jpg");
+        writer.setQuality(90);
+        QVERIFY2(writer.write(photo(size)), qPrintable(writer.errorString()));
+        m_fixturePaths.insert(size, path);
+    }
+}
+
+void Benchmarks::decode_data()
+{
+    addSizeRows();
+}
+
+void Benchmarks::decode()
+{
+    QFETCH(int, megapixels);
+    const QString path = m_fixturePaths.value(megapixels);
+    QBENCHMARK {
+        QVERIFY(!PhotoLoader::readPhoto(path).isNull());
+    }
+}
+
+void Benchmarks::colorConversion_data()
+{
+    addSizeRows();
+}
+
+void Benchmarks::colorConversion()
+{
+    QFETCH(int, megapixels);
+    QImage image = photo(megapixels).copy();
+    const QColorSpace adobeRgb(QColorSpace::AdobeRgb);
+    QBENCHMARK {
+        // Converting the same pixels again costs the same.
+        image.setColorSpace(adobeRgb);
+        ColorManagement::convertToSRgb(image);
+    }
+}
+
+void Benchmarks::pixmapUpload_data()
+{
+    addSizeRows();
+}
+
+void Benchmarks::pixmapUpload()
+{
+    QFETCH(int, megapixels);
+    const TiledImage tiles(photo(megapixels));
+    QBENCHMARK {
+        for (int row = 0; row < tiles.rows(); ++row) {
+            for (int column = 0; column < tiles.columns(); ++column)
+                QPixmap::fromImage(tiles.tile(column, row));
+        }
+    }
+}
+
+void Benchmarks::zoomedPainting_data()
+{
+    QTest::addColumn<int>("megapixels");
+    QTest::addColumn<qreal>("zoom");
+    for (const int megapixels : qAsConst(m_megapixels)) {
+        for (const qreal zoom : { 0.125, 0.5, 1.0, 4.0 })
+            QTest::addRow("%dmp-zoom%g", megapixels, zoom) << megapixels << zoom;
+    }
+}
+
+void Benchmarks::zoomedPainting()
+{
+    QFETCH(int, megapixels);
+    QFETCH(qreal, zoom);
+
+    // A full HD viewport in the middle of the photo.
+    PhotoCanvas canvas;
+    canvas.setPyramid(ImagePyramid(photo(megapixels)));
+    canvas.setZoom(zoom);
+    QPixmap viewport(1920, 1080);
+    const QRect viewportRect = QRect(QPoint(0, 0), viewport.size()).translated(canvas.width() / 2 - 960, canvas.height() / 2 - 540)
+            .intersected(canvas.rect());
+    QBENCHMARK {
+        canvas.render(&viewport, QPoint(), QRegion(viewportRect));
+    }
+}
+
+void Benchmarks::compositing_data()
+{
+    QTest::addColumn<int>("megapixels");
+    QTest::addColumn<int>("instructionSet");
+    const QVector<QPair<Compositing::InstructionSet, const char*>> instructionSets {
+        { Compositing::InstructionSet::Scalar, "scalar" },
+        { Compositing::InstructionSet::Sse41, "sse4.1" },
+        { Compositing::InstructionSet::Avx2, "avx2" }
+    };
+    for (const int megapixels : qAsConst(m_megapixels)) {
+        for (const auto& instructionSet : instructionSets) {
+            if (Compositing::isSupported(instructionSet.first))
+                QTest::addRow("%dmp-%s", megapixels, instructionSet.second) << megapixels << int(instructionSet.first);
+        }
+    }
+}
+
+void Benchmarks::compositing()
+{
+    QFETCH(int, megapixels);
+    QFETCH(int, instructionSet);
+
+    QImage destination = photo(megapixels).copy();
+    const QImage layer = generateLayer(destination.size());
+    const Compositing::SourceOverFunction sourceOver = Compositing::sourceOverFunction(Compositing::InstructionSet(instructionSet));
+    QBENCHMARK {
+        for (int y = 0; y < destination.height(); ++y)
+            sourceOver(reinterpret_cast<quint32*>(destination.scanLine(y)), reinterpret_cast<const quint32*>(layer.constScanLine(y)),
+                       destination.width(), 128);
+    }
+}
+
+void Benchmarks::resampling_data()
+{
+    QTest::addColumn<int>("megapixels");
+    QTest::addColumn<int>("filter");
+    QTest::addColumn<int>("instructionSet");
+    const QVector<QPair<Resampler::Filter, const char*>> filters {
+        { Resampler::Filter::Box, "box" },
+        { Resampler::Filter::Bilinear, "bilinear" },
+        { Resampler::Filter::Lanczos3, "lanczos3" }
+    };
+    const QVector<QPair<Compositing::InstructionSet, const char*>> instructionSets {
+        { Compositing::InstructionSet::Scalar, "scalar" },
+        { Compositing::InstructionSet::Sse41, "sse4.1" },
+        { Compositing::InstructionSet::Avx2, "avx2" }
+    };
+    for (const int megapixels : qAsConst(m_megapixels)) {
+        // The baseline, a filter of -1.
+        QTest::addRow("%dmp-qimage-scaled", megapixels) << megapixels << -1 << 0;
+        for (const auto& filter : filters) {
+            for (const auto& instructionSet : instructionSets) {
+                if (Compositing::isSupported(instructionSet.first)) {
+                    QTest::addRow("%dmp-%s-%s", megapixels, filter.second, instructionSet.second)
+                            << megapixels << int(filter.first) << int(instructionSet.first);
+                }
+            }
+        }
+    }
+}
+
+void Benchmarks::resampling()
+{
+    QFETCH(int, megapixels);
+    QFETCH(int, filter);
+    QFETCH(int, instructionSet);
+
+    // The photo fitted into a full HD screen; the throughput is the megapixels of the row over the time.
+    const QImage source = photo(megapixels);
+    const QSize size = source.size().scaled(1920, 1080, Qt::KeepAspectRatio);
+    QImage result;
+    if (filter < 0) {
+        QBENCHMARK {
+            result = source.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+    } else {
+        QBENCHMARK {
+            result = Resampler::resample(source, QRectF(QPointF(0.0, 0.0), QSizeF(source.size())), size,
+                                         Resampler::Filter(filter), Compositing::InstructionSet(instructionSet));
+        }
+    }
+    QCOMPARE(result.size(), size);
+}
+
+void Benchmarks::histogram_data()
+{
+    QTest::addColumn<int>("megapixels");
+    QTest::addColumn<bool>("incremental");
+    for (const int megapixels : qAsConst(m_megapixels)) {
+        QTest::addRow("%dmp-full", megapixels) << megapixels << false;
+        QTest::addRow("%dmp-tile-update", megapixels) << megapixels << true;
+    }
+}
+
+void Benchmarks::histogram()
+{
+    QFETCH(int, megapixels);
+    QFETCH(bool, incremental);
+
+    // A full count when a photo is opened, or the recount of the tile of an edit.
+    const TiledImage image(photo(megapixels));
+    Histogram histogram;
+    if (incremental) {
+        histogram.setImage(image);
+        const QRect tileRect = image.tileRect(image.columns() / 2, image.rows() / 2);
+        QBENCHMARK {
+            histogram.updateImage(image, tileRect);
+        }
+    } else {
+        QBENCHMARK {
+            histogram.setImage(image);
+        }
+    }
+    QCOMPARE(histogram.pixelCount(), qint64(image.width()) * image.height());
+}
+
+void Benchmarks::adjustments_data()
+{
+    QTest::addColumn<int>("megapixels");
+    QTest::addColumn<int>("changedNode");
+    for (const int megapixels : qAsConst(m_megapixels)) {
+        QTest::addRow("%dmp-first-node-changed", megapixels) << megapixels << 0;
+        QTest::addRow("%dmp-last-node-changed", megapixels) << megapixels << 3;
+    }
+}
+
+void Benchmarks::adjustments()
+{
+    QFETCH(int, megapixels);
+    QFETCH(int, changedNode);
+
+    // Every iteration changes a parameter and evaluates the tiles of a full HD view at 100%, like a slider drag.
+    // Changing the last node reuses the outputs of the nodes before it.
+    const ImagePyramid pyramid(photo(megapixels));
+    QVector<FilterGraph::Node> nodes(4);
+    nodes[0].type = FilterGraph::Node::Levels;
+    nodes[0].gamma = 1.2;
+    nodes[1].type = FilterGraph::Node::BrightnessContrast;
+    nodes[1].contrast = 0.2;
+    nodes[2].type = FilterGraph::Node::Saturation;
+    nodes[2].saturation = 1.3;
+    nodes[3].type = FilterGraph::Node::Sharpen;
+    nodes[3].amount = 1.0;
+    nodes[3].radius = 2.0;
+
+    FilterGraph graph(nodes);
+    QRect viewRect(QPoint(0, 0), QSize(1920, 1080));
+    viewRect.moveCenter(QRect(QPoint(0, 0), pyramid.size()).center());
+    const QRect range = pyramid.level(0).tileRange(viewRect);
+    QVector<int> tileIndices(range.width() * range.height());
+    std::iota(tileIndices.begin(), tileIndices.end(), 0);
+    auto evaluateView = [&]() {
+        const ImagePyramid adjustedPyramid = graph.apply(pyramid);
+        QtConcurrent::blockingMap(tileIndices, [&](int index) {
+            adjustedPyramid.level(0).tile(range.left() + index % range.width(), range.top() + index / range.width());
+        });
+    };
+    // The nodes before the changed one are evaluated once, before the measurement.
+    evaluateView();
+
+    int iteration = 0;
+    QBENCHMARK {
+        ++iteration;
+        if (changedNode == 0)
+            nodes[0].gamma = 1.2 + iteration * 1e-4;
+        else
+            nodes[3].amount = 1.0 + iteration * 1e-4;
+        graph.setNodes(nodes);
+        evaluateView();
+    }
+}
+
+void Benchmarks::redaction_data()
+{
+    QTest::addColumn<int>("megapixels");
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<int>("strength");
+    QTest::addColumn<int>("instructionSet");
+    const QVector<QPair<Compositing::InstructionSet, const char*>> instructionSets {
+        { Compositing::InstructionSet::Scalar, "scalar" },
+        { Compositing::InstructionSet::Sse41, "sse4.1" },
+        { Compositing::InstructionSet::Avx2, "avx2" }
+    };
+    for (const int megapixels : qAsConst(m_megapixels)) {
+        // The blur costs the same for every radius.
+        for (const int radius : { 4, 32, 256 }) {
+            for (const auto& instructionSet : instructionSets) {
+                if (Compositing::isSupported(instructionSet.first)) {
+                    QTest::addRow("%dmp-blur-r%d-%s", megapixels, radius, instructionSet.second)
+                            << megapixels << int(Redaction::Mode::Blur) << radius << int(instructionSet.first);
+                }
+            }
+        }
+        QTest::addRow("%dmp-pixelate", megapixels) << megapixels << int(Redaction::Mode::Pixelate) << 16
+                                                   << int(Compositing::InstructionSet::Scalar);
+    }
+}
+
+void Benchmarks::redaction()
+{
+    QFETCH(int, megapixels);
+    QFETCH(int, mode);
+    QFETCH(int, strength);
+    QFETCH(int, instructionSet);
+
+    // The whole photo as the region, the worst case of a redaction.
+    const QImage source = photo(megapixels);
+    QImage result;
+    QBENCHMARK {
+        result = Redaction::Mode(mode) == Redaction::Mode::Blur
+                ? Redaction::blurred(source, strength, Compositing::InstructionSet(instructionSet))
+                : Redaction::pixelated(source, strength);
+    }
+    QCOMPARE(result.size(), source.size());
+}
+
+void Benchmarks::shapeRasterization_data()
+{
+    QTest::addColumn<int>("megapixels");
+    QTest::addColumn<int>("type");
+    const QVector<QPair<Annotation::Type, const char*>> types {
+        { Annotation::Pencil, "pencil" },
+        { Annotation::Arrow, "arrow" },
+        { Annotation::Box, "box" },
+        { Annotation::Ellipse, "ellipse" },
+        { Annotation::Triangle, "triangle" },
+        { Annotation::Star, "star" }
+    };
+    for (const int megapixels : qAsConst(m_megapixels)) {
+        for (const auto& type : types)
+            QTest::addRow("%dmp-%s", megapixels, type.second) << megapixels << int(type.first);
+    }
+}
+
+void Benchmarks::shapeRasterization()
+{
+    QFETCH(int, megapixels);
+    QFETCH(int, type);
+
+    // A shape spanning the photo, or a pencil scribble across it.
+    QImage layer(photoSize(megapixels), QImage::Format_ARGB32_Premultiplied);
+    layer.fill(Qt::transparent);
+    Annotation annotation(Annotation::Type(type), QColor(229, 51, 42), layer.width() / 400.0);
+    if (annotation.type() == Annotation::Pencil) {
+        for (int i = 0; i <= 1000; ++i)
+            annotation.addPoint(QPointF(layer.width() * i / 1000.0, layer.height() * (0.5 + 0.4 * std::sin(i / 20.0))));
+    } else {
+        annotation.addPoint(QPointF(layer.width() * 0.05, layer.height() * 0.05));
+        annotation.addPoint(QPointF(layer.width() * 0.95, layer.height() * 0.95));
+    }
+
+    QBENCHMARK {
+        QPainter painter(&layer);
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        annotation.paint(&painter);
+    }
+}
+
+void Benchmarks::addSizeRows()
+{
+    QTest::addColumn<int>("megapixels");
+    for (const int megapixels : qAsConst(m_megapixels))
+        QTest::addRow("%dmp", megapixels) << megapixels;
+}
+
+QImage Benchmarks::photo(int megapixels)
+{
+    if (!m_photos.contains(megapixels))
+        m_photos.insert(megapixels, generatePhoto(photoSize(megapixels)));
+    return m_photos.value(megapixels);
+}
+
+int main(int argc, char* argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication application(argc, argv);
+
+    // Machine-readable results by default, to track them between releases.
+    QStringList arguments = application.arguments();
+    const QStringList outputOptions { "-o", "-txt", "-csv", "-xml", "-lightxml", "-junitxml", "-teamcity", "-tap" };
+    bool outputRequested = false;
+    for (const QString& argument : qAsConst(arguments))
+        outputRequested = outputRequested || outputOptions.contains(argument);
+    if (!outputRequested)
+        arguments.append("-csv");
+
+    Benchmarks benchmarks;
+    return QTest::qExec(&benchmarks, arguments);
+}
+
+#include "benchmarks.moc"
@@ -0,0 +1,11 @@
+QT += testlib
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = benchmarks
+
+include(../PhotoEditorCore.pri)
+
+SOURCES += \
+    benchmarks.cpp
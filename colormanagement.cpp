@@ -0,0 +1,90 @@
+#include "colormanagement.h"
+#include "profiler.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtConcurrent>
+#include <QVector>
+
+namespace {
+
+const int TRANSFORM_CACHE_SIZE = 8;
+// Rows converted per parallel task, big enough to amortize the scheduling.
+const int BAND_HEIGHT = 128;
+
+QMutex transformCacheMutex;
+QCache<QByteArray, QColorTransform> transformCache(TRANSFORM_CACHE_SIZE);
+
+// Color spaces without an ICC profile are keyed by their named primaries and transfer function,
+// custom ones without a profile are not cached.
+QByteArray cacheKey(const QColorSpace& colorSpace)
+{
+    const QByteArray iccProfile = colorSpace.iccProfile();
+    if (!iccProfile.isEmpty())
+        return iccProfile;
+
+    if (colorSpace.primaries() == QColorSpace::Primaries::Custom || colorSpace.transferFunction() == QColorSpace::TransferFunction::Custom)
+        return QByteArray();
+
+    return QByteArrayLiteral("named:") + QByteArray::number(int(colorSpace.primaries()))
+            + ':' + QByteArray::number(int(colorSpace.transferFunction()))
+            + ':' + QByteArray::number(colorSpace.gamma());
+}
+
+bool isBandConvertible(QImage::Format format)
+{
+    return format == QImage::Format_RGB32 || format == QImage::Format_ARGB32 || format == QImage::Format_ARGB32_Premultiplied;
+}
+
+}
+
+namespace ColorManagement {
+
+QColorTransform transformToSRgb(const QColorSpace& colorSpace)
+{
+    const QByteArray key = cacheKey(colorSpace);
+    if (key.isEmpty())
+        return colorSpace.transformationToColorSpace(QColorSpace::SRgb);
+
+    QMutexLocker locker(&transformCacheMutex);
+    if (const QColorTransform* transform = transformCache.object(key))
+        return *transform;
+
+    auto* transform = new QColorTransform(colorSpace.transformationToColorSpace(QColorSpace::SRgb));
+    const QColorTransform result = *transform;
+    transformCache.insert(key, transform);
+    return result;
+}
+
+void convertToSRgb(QImage& image)
+{
+    const QColorSpace colorSpace = image.colorSpace();
+    if (image.isNull() || !colorSpace.isValid() || colorSpace == QColorSpace(QColorSpace::SRgb))
+        return;
+
+    const Profiler::ScopedTimer timer("convert to sRGB", "convert");
+    const QColorTransform transform = transformToSRgb(colorSpace);
+    if (!isBandConvertible(image.format()) || image.height() < 2 * BAND_HEIGHT) {
+        image.applyColorTransform(transform);
+        image.setColorSpace(QColorSpace::SRgb);
+        return;
+    }
+
+    // The bands are views on the pixels of the image, detached once here, and converted in place.
+    uchar* const bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    QVector<int> bandTops;
+    for (int y = 0; y < image.height(); y += BAND_HEIGHT)
+        bandTops.append(y);
+
+    QtConcurrent::blockingMap(bandTops, [&](int bandTop) {
+        const Profiler::ScopedTimer bandTimer("convert band", "convert");
+        QImage band(bits + bandTop * bytesPerLine, image.width(), qMin(BAND_HEIGHT, image.height() - bandTop),
+                    bytesPerLine, image.format());
+        band.applyColorTransform(transform);
+    });
+    image.setColorSpace(QColorSpace::SRgb);
+}
+
+}
@@ -0,0 +1,21 @@
+#ifndef COLORMANAGEMENT_H
+#define COLORMANAGEMENT_H
+
+#include <QColorSpace>
+#include <QColorTransform>
+#include <QImage>
+
+// Color space conversion of the decoded photos.
+namespace ColorManagement {
+
+    // Returns the transform from the color space to sRGB. Building one computes the lookup tables of the
+    // transfer functions, so the transforms are cached by source profile.
+    QColorTransform transformToSRgb(const QColorSpace& colorSpace);
+
+    // Converts the image to sRGB in place. 32-bit images are converted band by band on all cores
+    // with the same transform as QImage::convertToColorSpace, so the result matches it within one level per channel.
+    void convertToSRgb(QImage& image);
+
+}
+
+#endif // COLORMANAGEMENT_H
@@ -0,0 +1,190 @@
+#include "compositing.h"
+
+#include <QtConcurrent>
+#include <QVector>
+
+#if defined(Q_PROCESSOR_X86) && defined(Q_CC_MSVC)
+#include <intrin.h>
+#elif defined(Q_PROCESSOR_X86)
+#include <cpuid.h>
+#endif
+
+namespace {
+
+// Rows blended per parallel task, big enough to amortize the scheduling.
+const int BAND_HEIGHT = 64;
+
+// x / 255 rounded to the nearest, exact for x in [0, 255 * 255].
+inline quint32 div255(quint32 x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+#ifdef Q_PROCESSOR_X86
+
+// The XGETBV bits tell whether the OS saves the YMM registers, AVX2 is useless without it.
+bool cpuSupports(Compositing::InstructionSet instructionSet)
+{
+#ifdef Q_CC_MSVC
+    int info[4];
+    __cpuid(info, 1);
+    const unsigned int ecx1 = unsigned(info[2]);
+    __cpuidex(info, 7, 0);
+    const unsigned int ebx7 = unsigned(info[1]);
+    const bool osSavesYmm = (ecx1 & (1u << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+#else
+    unsigned int eax = 0, ebx = 0, ecx1 = 0, edx = 0, ebx7 = 0;
+    __get_cpuid(1, &eax, &ebx, &ecx1, &edx);
+    if (__get_cpuid_max(0, nullptr) >= 7) {
+        unsigned int ecx = 0;
+        __cpuid_count(7, 0, eax, ebx7, ecx, edx);
+    }
+    bool osSavesYmm = false;
+    if (ecx1 & (1u << 27)) {
+        unsigned int xcr0Low = 0, xcr0High = 0;
+        __asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+        osSavesYmm = (xcr0Low & 0x6) == 0x6;
+    }
+#endif
+
+    switch (instructionSet) {
+    case Compositing::InstructionSet::Scalar:
+        return true;
+    case Compositing::InstructionSet::Sse41:
+        return ecx1 & (1u << 19);
+    case Compositing::InstructionSet::Avx2:
+        return osSavesYmm && (ecx1 & (1u << 28)) && (ebx7 & (1u << 5));
+    }
+    return false;
+}
+
+#else
+
+bool cpuSupports(Compositing::InstructionSet instructionSet)
+{
+    return instructionSet == Compositing::InstructionSet::Scalar;
+}
+
+#endif
+
+}
+
+namespace Compositing {
+
+InstructionSet bestInstructionSet()
+{
+    static const InstructionSet best = isSupported(InstructionSet::Avx2) ? InstructionSet::Avx2
+                                     : isSupported(InstructionSet::Sse41) ? InstructionSet::Sse41
+                                     : InstructionSet::Scalar;
+    return best;
+}
+
+bool isSupported(InstructionSet instructionSet)
+{
+    switch (instructionSet) {
+    case InstructionSet::Scalar:
+        return true;
+    case InstructionSet::Sse41:
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+        return cpuSupports(instructionSet);
+#else
+        return false;
+#endif
+    case InstructionSet::Avx2:
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+        return cpuSupports(instructionSet);
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+SourceOverFunction sourceOverFunction(InstructionSet instructionSet)
+{
+    if (!isSupported(instructionSet))
+        return sourceOverScalar;
+
+    switch (instructionSet) {
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    case InstructionSet::Sse41:
+        return sourceOverSse41;
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    case InstructionSet::Avx2:
+        return sourceOverAvx2;
+#endif
+    default:
+        return sourceOverScalar;
+    }
+}
+
+bool isDestinationFormat(QImage::Format format)
+{
+    return format == QImage::Format_RGB32 || format == QImage::Format_ARGB32_Premultiplied;
+}
+
+QImage toDestinationFormat(const QImage& image)
+{
+    if (image.isNull() || isDestinationFormat(image.format()))
+        return image;
+    return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+}
+
+void sourceOver(quint32* destination, const quint32* source, int count, int opacity)
+{
+    static const SourceOverFunction function = sourceOverFunction(bestInstructionSet());
+    function(destination, source, count, opacity);
+}
+
+void sourceOver(QImage& destination, const QImage& source, int opacity, const QPoint& offset)
+{
+    Q_ASSERT(source.format() == QImage::Format_ARGB32_Premultiplied);
+    Q_ASSERT(isDestinationFormat(destination.format()));
+
+    const QRect rect = QRect(offset, source.size()) & destination.rect();
+    if (rect.isEmpty() || opacity <= 0)
+        return;
+
+    // Detach once here, not concurrently from the bands.
+    uchar* const destinationBits = destination.bits();
+    const qsizetype destinationBytesPerLine = destination.bytesPerLine();
+    opacity = qMin(opacity, 255);
+
+    QVector<int> bandTops;
+    for (int y = rect.top(); y <= rect.bottom(); y += BAND_HEIGHT)
+        bandTops.append(y);
+
+    const SourceOverFunction function = sourceOverFunction(bestInstructionSet());
+    QtConcurrent::blockingMap(bandTops, [&](int bandTop) {
+        const int bandBottom = qMin(bandTop + BAND_HEIGHT - 1, rect.bottom());
+        for (int y = bandTop; y <= bandBottom; ++y) {
+            auto* target = reinterpret_cast<quint32*>(destinationBits + y * destinationBytesPerLine) + rect.left();
+            const auto* line = reinterpret_cast<const quint32*>(source.constScanLine(y - offset.y())) + rect.left() - offset.x();
+            function(target, line, rect.width(), opacity);
+        }
+    });
+}
+
+void sourceOverScalar(quint32* destination, const quint32* source, int count, int opacity)
+{
+    for (int i = 0; i < count; ++i) {
+        quint32 pixel = source[i];
+        if (opacity != 255) {
+            pixel = div255((pixel & 0xFF) * quint32(opacity))
+                    | div255(((pixel >> 8) & 0xFF) * quint32(opacity)) << 8
+                    | div255(((pixel >> 16) & 0xFF) * quint32(opacity)) << 16
+                    | div255((pixel >> 24) * quint32(opacity)) << 24;
+        }
+
+        const quint32 inverseAlpha = 255 - (pixel >> 24),
+                target = destination[i];
+        destination[i] = ((pixel & 0xFF) + div255((target & 0xFF) * inverseAlpha))
+                | (((pixel >> 8) & 0xFF) + div255(((target >> 8) & 0xFF) * inverseAlpha)) << 8
+                | (((pixel >> 16) & 0xFF) + div255(((target >> 16) & 0xFF) * inverseAlpha)) << 16
+                | ((pixel >> 24) + div255((target >> 24) * inverseAlpha)) << 24;
+    }
+}
+
+}
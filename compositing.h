@@ -0,0 +1,48 @@
+#ifndef COMPOSITING_H
+#define COMPOSITING_H
+
+#include <QImage>
+
+// Blending of premultiplied ARGB32 pixels. Every kernel computes the same exact result:
+//   source' = source * opacity / 255
+//   destination = source' + destination * (255 - alpha(source')) / 255
+// with each division rounded to the nearest, so the SIMD kernels are bit-exact with the scalar one.
+// The widest kernel supported by the CPU is selected at runtime.
+namespace Compositing {
+
+    enum class InstructionSet {
+        Scalar,
+        Sse41,
+        Avx2
+    };
+
+    // Blends count source pixels over the destination ones, opacity in [0, 255].
+    using SourceOverFunction = void (*)(quint32* destination, const quint32* source, int count, int opacity);
+
+    InstructionSet bestInstructionSet();
+    bool isSupported(InstructionSet instructionSet);
+    // Returns the kernel of the instruction set, the scalar one if the CPU does not support it.
+    SourceOverFunction sourceOverFunction(InstructionSet instructionSet);
+
+    // The kernels blend onto RGB32 and premultiplied ARGB32 only. Photos are converted to one of them as they are
+    // decoded, straight alpha ARGB32 ones included, which have 32 bits per pixel too.
+    bool isDestinationFormat(QImage::Format format);
+    // Returns the image in RGB32, or in premultiplied ARGB32 if it has alpha, unless it is in one of them already.
+    QImage toDestinationFormat(const QImage& image);
+
+    void sourceOver(quint32* destination, const quint32* source, int count, int opacity = 255);
+    // Blends a premultiplied ARGB32 source over an RGB32 or premultiplied ARGB32 destination at the offset,
+    // row bands run on all cores.
+    void sourceOver(QImage& destination, const QImage& source, int opacity = 255, const QPoint& offset = QPoint());
+
+    void sourceOverScalar(quint32* destination, const quint32* source, int count, int opacity);
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    void sourceOverSse41(quint32* destination, const quint32* source, int count, int opacity);
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    void sourceOverAvx2(quint32* destination, const quint32* source, int count, int opacity);
+#endif
+
+}
+
+#endif // COMPOSITING_H
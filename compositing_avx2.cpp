@@ -0,0 +1,60 @@
+#include "compositing.h"
+
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+
+#include <immintrin.h>
+
+namespace {
+
+// x / 255 rounded to the nearest in each 16-bit lane, exact for x in [0, 255 * 255].
+inline __m256i div255(__m256i x)
+{
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+// Blends four pixels widened to 16-bit lanes.
+inline __m256i blend(__m256i source, __m256i destination, __m256i opacity, bool scaled)
+{
+    if (scaled)
+        source = div255(_mm256_mullo_epi16(source, opacity));
+    const __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m256i inverseAlpha = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+    return _mm256_add_epi16(source, div255(_mm256_mullo_epi16(destination, inverseAlpha)));
+}
+
+}
+
+namespace Compositing {
+
+void sourceOverAvx2(quint32* destination, const quint32* source, int count, int opacity)
+{
+    const __m256i zero = _mm256_setzero_si256(),
+            opacityLanes = _mm256_set1_epi16(short(opacity)),
+            alphaMask = _mm256_set1_epi32(int(0xFF000000));
+    const bool scaled = opacity != 255;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i sourcePixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        auto* target = reinterpret_cast<__m256i*>(destination + i);
+        // Transparent and opaque sources are the bulk of an annotation layer, they need no arithmetic.
+        if (_mm256_testz_si256(sourcePixels, sourcePixels))
+            continue;
+        if (!scaled && _mm256_testc_si256(sourcePixels, alphaMask)) {
+            _mm256_storeu_si256(target, sourcePixels);
+            continue;
+        }
+
+        // Unpacking and packing both work within 128-bit lanes, so the pixel order is preserved.
+        const __m256i destinationPixels = _mm256_loadu_si256(target);
+        const __m256i low = blend(_mm256_unpacklo_epi8(sourcePixels, zero), _mm256_unpacklo_epi8(destinationPixels, zero), opacityLanes, scaled);
+        const __m256i high = blend(_mm256_unpackhi_epi8(sourcePixels, zero), _mm256_unpackhi_epi8(destinationPixels, zero), opacityLanes, scaled);
+        _mm256_storeu_si256(target, _mm256_packus_epi16(low, high));
+    }
+    sourceOverScalar(destination + i, source + i, count - i, opacity);
+}
+
+}
+
+#endif // QT_COMPILER_SUPPORTS_AVX2
@@ -75,6 +75,17 @@ namespace Constants {
     inline const int DRAW_TOOLS_PANEL_MARGIN_SIDE_PX { 24 };
     inline const int DRAW_TOOLS_PANEL_MARGIN_TOP_PX { 16 };
 
+    // --------------------------------------------------------------------------
+    // Histogram panel
+
+    inline const int HISTOGRAM_HEIGHT_PX { 120 };
+    inline const QString HISTOGRAM_BACKGROUND_COLOR { QStringLiteral("#141415") };
+    // Colors of the curves, translucent so the overlapping ones show through.
+    inline const QString HISTOGRAM_RED_COLOR { QStringLiteral("#B0E5332A") };
+    inline const QString HISTOGRAM_GREEN_COLOR { QStringLiteral("#B068AB25") };
+    inline const QString HISTOGRAM_BLUE_COLOR { QStringLiteral("#B02A6BE5") };
+    inline const QString HISTOGRAM_LUMA_COLOR { QStringLiteral("#80C8C8C8") };
+
     // --------------------------------------------------------------------------
     // Draw Tools Settings bar
 
@@ -111,10 +122,97 @@ namespace Constants {
     inline const int PHOTO_ZONE_MARGIN_PX { 50 };
     inline const QString PHOTO_ZONE_COLOR { QStringLiteral("#141415") };
 
+    // Edge of the square tiles the photo is split into for painting and caching.
+    inline const int PHOTO_TILE_SIZE_PX { 256 };
+    // Budget of the tile pixmap cache of the photo canvas.
+    inline const int PHOTO_TILE_CACHE_SIZE_KB { 256 * 1024 };
+    // Budget of the tiles resampled to the current zoom.
+    inline const int PHOTO_SCALED_TILE_CACHE_SIZE_KB { 128 * 1024 };
+    // Bound of the width and the height a photo can be resized to.
+    inline const int RESIZE_MAX_SIZE_PX { 32768 };
+    inline const int ADJUSTMENT_SLIDER_WIDTH_PX { 240 };
+    inline const double PHOTO_ZOOM_MIN { 1.0 / 64.0 };
+    inline const double PHOTO_ZOOM_MAX { 16.0 };
+    inline const double PHOTO_ZOOM_STEP { 1.25 };
+    // Bound of the reduced preview shown while the full resolution photo is being decoded.
+    inline const int PHOTO_PREVIEW_SIZE_PX { 2048 };
+    // Photos bigger than this are decoded band by band into an out-of-core tile store.
+    inline const int OUT_OF_CORE_THRESHOLD_MB { 1024 };
+    // Pyramid levels up to this size of an out-of-core photo are kept in memory.
+    inline const int OUT_OF_CORE_MEMORY_LEVEL_MB { 256 };
+    // Quality of the out-of-core photos saved as JPEG band by band, the default of QImageWriter.
+    inline const int OUT_OF_CORE_JPEG_QUALITY { 75 };
+    // Suffix of the native project files.
+    inline const QString PROJECT_FILE_SUFFIX { QStringLiteral("pe") };
+    // Budget of the decompressed tiles of each pyramid level of an open project.
+    inline const int PROJECT_TILE_CACHE_SIZE_KB { 64 * 1024 };
+    // Budget of the tiles the adjustments were evaluated for, the outputs of every adjustment node.
+    inline const int FILTER_TILE_CACHE_SIZE_KB { 256 * 1024 };
+    // Budget of the decoded photos kept for going back to them or prefetched for going forward.
+    inline const int PHOTO_CACHE_SIZE_MB { 1024 };
+    // Photos of the folder prefetched on each side of the current one, on as many threads.
+    inline const int PHOTO_PREFETCH_NEIGHBORS { 1 };
+    inline const int PHOTO_PREFETCH_THREAD_COUNT { 2 };
+    // Bound of the thumbnails made and cached on disk.
+    inline const int THUMBNAIL_SIZE_PX { 160 };
+    inline const int THUMBNAIL_THREAD_COUNT { 4 };
+    inline const int FILMSTRIP_THUMBNAIL_SIZE_PX { 80 };
+    // Thumbnails are made for this many widths of the filmstrip on each side of the visible part.
+    inline const int FILMSTRIP_PREFETCH_PAGES { 2 };
+    // Memory the undo history may hold before compressing and spilling edited tiles.
+    inline const int HISTORY_MEMORY_BUDGET_MB { 512 };
+    // The edits made within this interval are written to the recovery journal and synced to disk together.
+    inline const int RECOVERY_JOURNAL_SYNC_INTERVAL_MS { 200 };
+    // Rows of the bands a page is printed in, at the resolution of the pyramid level printed.
+    inline const int PRINT_BAND_HEIGHT_PX { 256 };
+    // Edge of the square cells of the annotation spatial index, in photo pixels.
+    inline const int ANNOTATION_GRID_CELL_SIZE_PX { 256 };
+    inline const int ANNOTATION_PEN_WIDTH_PX { 4 };
+    inline const int ANNOTATION_HIT_TOLERANCE_PX { 4 };
+    // Pointer moves shorter than this, in screen pixels, are dropped from strokes.
+    inline const double ANNOTATION_MIN_POINT_DISTANCE_PX { 1.0 };
+    // Weight of a new pointer position in the exponential smoothing of strokes.
+    inline const double ANNOTATION_SMOOTHING_FACTOR { 0.5 };
+    inline const QString ANNOTATION_DEFAULT_COLOR { QStringLiteral("#E5332A") };
+    inline const QString ANNOTATION_SELECTION_COLOR { QStringLiteral("#68AB25") };
+    // Blur radius and pixelate cell size of the redaction tools, in screen pixels at the zoom the region is drawn at.
+    inline const int REDACTION_BLUR_RADIUS_PX { 8 };
+    inline const int REDACTION_PIXELATE_CELL_SIZE_PX { 12 };
+    // Edge of the square of photo pixels the pipette averages by default, 1 samples a single pixel.
+    inline const int PIPETTE_DEFAULT_SAMPLE_SIZE_PX { 1 };
+    // Budget of the summed-area tables of the tiles the pipette sampled.
+    inline const int PIPETTE_TABLE_CACHE_SIZE_KB { 64 * 1024 };
+    // The loupe magnifies at least this many photo pixels around the pointer, more for larger samples.
+    inline const int PIPETTE_LOUPE_PIXELS { 15 };
+    inline const int PIPETTE_LOUPE_SIZE_PX { 120 };
+    inline const int PIPETTE_LOUPE_SWATCH_HEIGHT_PX { 24 };
+    // Distance of the loupe from the pointer.
+    inline const int PIPETTE_LOUPE_OFFSET_PX { 24 };
+    // Photos are counted at the finest pyramid level held in memory, or out of core at the finest one under this size.
+    inline const int HISTOGRAM_OUT_OF_CORE_MAX_MEGAPIXELS { 16 };
+    // Adjusted photos are counted through the adjustments at the finest pyramid level under this size, again as they change.
+    inline const int HISTOGRAM_ADJUSTED_MAX_MEGAPIXELS { 2 };
+    // The histogram is counted again once the sliders changing it were left still for this long.
+    inline const int HISTOGRAM_RECOUNT_DELAY_MS { 100 };
+
+    // --------------------------------------------------------------------------
+    // Profiling
+
+    // Capacity of the ring buffer of trace events, the oldest events are dropped first.
+    inline const int PROFILER_TRACE_EVENT_COUNT { 64 * 1024 };
+    // Period the frame counters are averaged over.
+    inline const int PROFILER_COUNTERS_WINDOW_MS { 1000 };
+
     // --------------------------------------------------------------------------
     // Header toolbar
 
     inline const int FOOTER_TOOL_BAR_HEIGHT_PX { 40 };
+    inline const int PROGRESS_BAR_WIDTH_PX { 200 };
+    inline const int PROGRESS_BAR_HEIGHT_PX { 6 };
+    inline const int PROGRESS_BAR_BORDER_RADIUS_PX { 2 };
+    inline const QString PROGRESS_BAR_COLOR { QStringLiteral("#585A5E") };
+    inline const QString PROGRESS_BAR_CHUNK_COLOR { QStringLiteral("#68AB25") };
+    inline const int PERF_HUD_REFRESH_INTERVAL_MS { 500 };
 
 }
 
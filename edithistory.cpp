@@ -0,0 +1,463 @@
+#include "edithistory.h"
+
+#include <QDir>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QTemporaryFile>
+
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+const int TILE_COMPRESSION_LEVEL = 1;
+
+// Returns a null image if the data is not the compressed pixels of an image of the size and format.
+QImage decompress(const QByteArray& compressed, const QSize& size, QImage::Format format)
+{
+    const QByteArray pixels = qUncompress(compressed);
+    QImage image(size, format);
+    if (image.isNull())
+        return QImage();
+    const int lineBytes = size.width() * image.depth() / 8;
+    if (pixels.size() != lineBytes * size.height())
+        return QImage();
+    for (int y = 0; y < size.height(); ++y)
+        std::memcpy(image.scanLine(y), pixels.constData() + y * lineBytes, size_t(lineBytes));
+    return image;
+}
+
+QByteArray compressPixels(const QImage& image)
+{
+    const int lineBytes = image.width() * image.depth() / 8;
+    QByteArray pixels;
+    pixels.reserve(lineBytes * image.height());
+    for (int y = 0; y < image.height(); ++y)
+        pixels.append(reinterpret_cast<const char*>(image.constScanLine(y)), lineBytes);
+    return qCompress(pixels, TILE_COMPRESSION_LEVEL);
+}
+
+qint64 tileUsage(const QImage& image, const QByteArray& compressed)
+{
+    return (image.isNull() ? 0 : image.sizeInBytes()) + compressed.size();
+}
+
+}
+
+// Saves read the spilled tiles of their snapshot of the history, and give the blocks back once done with them,
+// on their own thread.
+class EditHistory::SpillFile : public EditHistory::TileFile
+{
+public:
+    SpillFile()
+        : m_file(QDir::tempPath() + QStringLiteral("/PhotoEditor-XXXXXX.history"))
+    {}
+
+    // Writes the data into the first free range large enough for it, or at the end. Returns its offset, or -1.
+    qint64 write(const QByteArray& data)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_file.isOpen() && !m_file.open())
+            return -1;
+
+        qint64 offset = m_size;
+        for (auto range = m_freeRanges.begin(); range != m_freeRanges.end(); ++range) {
+            if (range.value() < data.size())
+                continue;
+            offset = range.key();
+            const qint64 rest = range.value() - data.size();
+            m_freeRanges.erase(range);
+            if (rest > 0)
+                m_freeRanges.insert(offset + data.size(), rest);
+            break;
+        }
+        if (!m_file.seek(offset) || m_file.write(data) != data.size()) {
+            if (offset < m_size)
+                releaseRange(offset, data.size());
+            return -1;
+        }
+        m_size = qMax(m_size, offset + data.size());
+        return offset;
+    }
+
+    QByteArray read(qint64 offset, int size) override
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_file.seek(offset))
+            return QByteArray();
+        const QByteArray data = m_file.read(size);
+        return data.size() == size ? data : QByteArray();
+    }
+
+    void release(qint64 offset, qint64 size)
+    {
+        QMutexLocker locker(&m_mutex);
+        releaseRange(offset, size);
+    }
+
+    QString errorString() const override
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_file.errorString();
+    }
+
+private:
+    // Frees the range, merged with the free neighbour ranges. A free range at the end is cut off the file.
+    void releaseRange(qint64 offset, qint64 size)
+    {
+        auto next = m_freeRanges.lowerBound(offset);
+        if (next != m_freeRanges.end() && offset + size == next.key()) {
+            size += next.value();
+            next = m_freeRanges.erase(next);
+        }
+        if (next != m_freeRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous.key() + previous.value() == offset) {
+                offset = previous.key();
+                size += previous.value();
+                m_freeRanges.erase(previous);
+            }
+        }
+
+        if (offset + size == m_size) {
+            m_size = offset;
+            m_file.resize(m_size);
+        } else {
+            m_freeRanges.insert(offset, size);
+        }
+    }
+
+    mutable QMutex m_mutex;
+    QTemporaryFile m_file;
+    qint64 m_size { 0 };
+    // Offsets and sizes of the free ranges.
+    QMap<qint64, qint64> m_freeRanges;
+};
+
+struct EditHistory::SpillBlock : EditHistory::TileBlock
+{
+    SpillBlock(const QSharedPointer<SpillFile>& spillFile, qint64 blockOffset, int blockSize)
+        : TileBlock { spillFile, blockOffset, blockSize }
+    {}
+    ~SpillBlock() { static_cast<SpillFile*>(file.data())->release(offset, size); }
+};
+
+QByteArray EditHistory::StoredTile::compressedPixels() const
+{
+    if (!compressed.isEmpty())
+        return compressed;
+    if (block)
+        return block->read();
+    return compressPixels(image);
+}
+
+EditHistory::EditHistory(QObject* parent)
+    : QObject(parent)
+{}
+
+void EditHistory::setMemoryBudget(qint64 bytes)
+{
+    m_memoryBudget = bytes;
+    enforceMemoryBudget();
+}
+
+QString EditHistory::undoText() const
+{
+    return canUndo() ? m_entries.at(m_index - 1).text : QString();
+}
+
+QString EditHistory::redoText() const
+{
+    return canRedo() ? m_entries.at(m_index).text : QString();
+}
+
+void EditHistory::push(const QString& text, const Change& before, const Change& after)
+{
+    truncate(m_index);
+    append(text, before, after);
+    m_index = m_entries.size();
+
+    enforceMemoryBudget();
+    emit changed();
+}
+
+bool EditHistory::undo(Change* change, QString* errorString)
+{
+    if (!canUndo())
+        return false;
+
+    const Entry& entry = m_entries.at(m_index - 1);
+    QVector<Tile> tiles;
+    if (!restore(entry.before, &tiles, errorString))
+        return false;
+
+    --m_index;
+    *change = { tiles, entry.annotationsBefore };
+    m_imageEntries.insert(m_index);
+    enforceMemoryBudget();
+    emit changed();
+    return true;
+}
+
+bool EditHistory::redo(Change* change, QString* errorString)
+{
+    if (!canRedo())
+        return false;
+
+    const Entry& entry = m_entries.at(m_index);
+    QVector<Tile> tiles;
+    if (!restore(entry.after, &tiles, errorString))
+        return false;
+
+    *change = { tiles, entry.annotationsAfter };
+    m_imageEntries.insert(m_index);
+    ++m_index;
+    enforceMemoryBudget();
+    emit changed();
+    return true;
+}
+
+void EditHistory::clear()
+{
+    m_entries.clear();
+    m_index = 0;
+    m_memoryUsage = 0;
+    m_imageEntries.clear();
+    m_compressedEntries.clear();
+    m_spillFile.reset();
+    emit changed();
+}
+
+QVector<EditHistory::Record> EditHistory::records() const
+{
+    auto copyTiles = [](const QVector<StoredTilePointer>& tiles) {
+        QVector<StoredTile> copiedTiles;
+        copiedTiles.reserve(tiles.size());
+        for (const StoredTilePointer& tile : tiles)
+            copiedTiles.append(*tile);
+        return copiedTiles;
+    };
+
+    QVector<Record> records;
+    records.reserve(m_entries.size());
+    for (const Entry& entry : m_entries) {
+        records.append({ entry.text, copyTiles(entry.before), copyTiles(entry.after),
+                         entry.annotationsBefore, entry.annotationsAfter });
+    }
+    return records;
+}
+
+void EditHistory::setRecords(const QVector<Record>& records, int index)
+{
+    m_entries.clear();
+    m_memoryUsage = 0;
+    m_imageEntries.clear();
+    m_compressedEntries.clear();
+    m_spillFile.reset();
+
+    auto storeTiles = [this](const QVector<StoredTile>& tiles) {
+        QVector<StoredTilePointer> storedTiles;
+        storedTiles.reserve(tiles.size());
+        for (const StoredTile& tile : tiles) {
+            storedTiles.append(StoredTilePointer::create(tile));
+            m_memoryUsage += tileUsage(tile.image, tile.compressed);
+        }
+        return storedTiles;
+    };
+    for (const Record& record : records) {
+        Entry entry;
+        entry.text = record.text;
+        entry.before = storeTiles(record.tilesBefore);
+        entry.after = storeTiles(record.tilesAfter);
+        entry.annotationsBefore = record.annotationsBefore;
+        entry.annotationsAfter = record.annotationsAfter;
+        m_imageEntries.insert(m_entries.size());
+        m_compressedEntries.insert(m_entries.size());
+        m_entries.append(entry);
+    }
+    m_index = qBound(0, index, m_entries.size());
+
+    enforceMemoryBudget();
+    emit changed();
+}
+
+void EditHistory::append(const QString& text, const Change& before, const Change& after)
+{
+    // The state before this edit is usually the state after the previous one.
+    const QVector<StoredTilePointer> shareable = m_entries.isEmpty() ? QVector<StoredTilePointer>() : m_entries.last().after;
+    Entry entry;
+    entry.text = text;
+    for (const Tile& tile : before.tiles)
+        entry.before.append(store(tile, shareable));
+    for (const Tile& tile : after.tiles)
+        entry.after.append(store(tile, QVector<StoredTilePointer>()));
+    entry.annotationsBefore = before.annotations;
+    entry.annotationsAfter = after.annotations;
+    m_imageEntries.insert(m_entries.size());
+    m_entries.append(entry);
+}
+
+void EditHistory::truncate(int index)
+{
+    if (index >= m_entries.size())
+        return;
+
+    // The state before the first edit dropped is the state after the last one kept, their tiles are shared.
+    QSet<const StoredTile*> keptTiles, droppedTiles;
+    if (index > 0) {
+        for (const StoredTilePointer& tile : qAsConst(m_entries.at(index - 1).after))
+            keptTiles.insert(tile.data());
+    }
+    for (int entryIndex = index; entryIndex < m_entries.size(); ++entryIndex) {
+        const Entry& entry = m_entries.at(entryIndex);
+        for (const auto* tiles : { &entry.before, &entry.after }) {
+            for (const StoredTilePointer& tile : *tiles) {
+                if (keptTiles.contains(tile.data()) || droppedTiles.contains(tile.data()))
+                    continue;
+                droppedTiles.insert(tile.data());
+                m_memoryUsage -= tileUsage(tile->image, tile->compressed);
+            }
+        }
+        m_imageEntries.erase(entryIndex);
+        m_compressedEntries.erase(entryIndex);
+    }
+    // The spilled tiles give their ranges back to the scratch file as they are destroyed.
+    m_entries.resize(index);
+}
+
+EditHistory::StoredTilePointer EditHistory::store(const Tile& tile, const QVector<StoredTilePointer>& shareable)
+{
+    if (!tile.image.isNull()) {
+        for (const StoredTilePointer& storedTile : shareable) {
+            if (storedTile->column == tile.column && storedTile->row == tile.row
+                    && !storedTile->image.isNull() && storedTile->image.cacheKey() == tile.image.cacheKey())
+                return storedTile;
+        }
+    }
+
+    auto storedTile = StoredTilePointer::create();
+    storedTile->column = tile.column;
+    storedTile->row = tile.row;
+    storedTile->image = tile.image;
+    storedTile->size = tile.image.size();
+    storedTile->format = tile.image.format();
+    m_memoryUsage += tileUsage(storedTile->image, storedTile->compressed);
+    return storedTile;
+}
+
+bool EditHistory::restore(const QVector<StoredTilePointer>& tiles, QVector<Tile>* restoredTiles, QString* errorString)
+{
+    restoredTiles->clear();
+    restoredTiles->reserve(tiles.size());
+    for (const StoredTilePointer& tile : tiles) {
+        QImage image;
+        if (!tile->isOriginal()) {
+            image = load(*tile, errorString);
+            if (image.isNull())
+                return false;
+        }
+        restoredTiles->append({ tile->column, tile->row, image });
+    }
+    return true;
+}
+
+QImage EditHistory::load(StoredTile& tile, QString* errorString)
+{
+    if (!tile.image.isNull())
+        return tile.image;
+
+    const QByteArray compressed = tile.compressedPixels();
+    if (compressed.isEmpty()) {
+        if (errorString)
+            *errorString = tr("Cannot read the undo history back: %1").arg(tile.block ? tile.block->file->errorString() : QString());
+        return QImage();
+    }
+    const QImage image = decompress(compressed, tile.size, tile.format);
+    if (image.isNull()) {
+        if (errorString)
+            *errorString = tr("The undo history is damaged");
+        return QImage();
+    }
+
+    // The block is kept, the image is dropped rather than compressed again if the budget is exceeded.
+    m_memoryUsage += tileUsage(image, QByteArray()) - tileUsage(QImage(), tile.compressed);
+    tile.image = image;
+    tile.compressed.clear();
+    return image;
+}
+
+void EditHistory::compress(StoredTile& tile)
+{
+    const QByteArray compressed = tile.block ? QByteArray() : compressPixels(tile.image);
+    m_memoryUsage += tileUsage(QImage(), compressed) - tileUsage(tile.image, tile.compressed);
+    tile.compressed = compressed;
+    tile.image = QImage();
+}
+
+bool EditHistory::spill(StoredTile& tile)
+{
+    if (!m_spillFile)
+        m_spillFile = QSharedPointer<SpillFile>::create();
+
+    const qint64 offset = m_spillFile->write(tile.compressed);
+    if (offset < 0)
+        return false;
+
+    tile.block = QSharedPointer<TileBlock>(new SpillBlock(m_spillFile, offset, tile.compressed.size()));
+    m_memoryUsage -= tileUsage(QImage(), tile.compressed);
+    tile.compressed.clear();
+    return true;
+}
+
+int EditHistory::distance(int entryIndex) const
+{
+    return entryIndex < m_index ? m_index - 1 - entryIndex : entryIndex - m_index;
+}
+
+int EditHistory::farthestEntry(const std::set<int>& entryIndices) const
+{
+    if (entryIndices.empty())
+        return -1;
+
+    // The distance grows away from the current state on both sides, the farthest edit is the first or the last.
+    const int first = *entryIndices.begin(), last = *entryIndices.rbegin();
+    return distance(first) >= distance(last) ? first : last;
+}
+
+void EditHistory::enforceMemoryBudget()
+{
+    // Edits farthest from the current state are the least likely to be restored soon.
+    // Everything possible is compressed first, spilled to disk only if that is not enough.
+    while (m_memoryUsage > m_memoryBudget) {
+        const int entryIndex = farthestEntry(m_imageEntries);
+        if (entryIndex < 0)
+            break;
+
+        m_imageEntries.erase(entryIndex);
+        Entry& entry = m_entries[entryIndex];
+        for (const auto* tiles : { &entry.before, &entry.after }) {
+            for (const StoredTilePointer& tile : *tiles) {
+                if (!tile->image.isNull())
+                    compress(*tile);
+            }
+        }
+        m_compressedEntries.insert(entryIndex);
+    }
+
+    while (m_memoryUsage > m_memoryBudget) {
+        const int entryIndex = farthestEntry(m_compressedEntries);
+        if (entryIndex < 0)
+            break;
+
+        m_compressedEntries.erase(entryIndex);
+        Entry& entry = m_entries[entryIndex];
+        for (const auto* tiles : { &entry.before, &entry.after }) {
+            for (const StoredTilePointer& tile : *tiles) {
+                if (!tile->compressed.isEmpty())
+                    spill(*tile);
+            }
+        }
+    }
+}
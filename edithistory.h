@@ -0,0 +1,175 @@
+#ifndef EDITHISTORY_H
+#define EDITHISTORY_H
+
+#include "annotation.h"
+#include "constants.h"
+
+#include <QObject>
+#include <QImage>
+#include <QVector>
+#include <QSharedPointer>
+
+#include <set>
+
+// Undo/redo history of the photo edits. An edit only records the tiles and annotations it touched, tile images
+// are shared with the photo and between the neighbour edits, and the original tiles are never stored at all.
+// Once the history exceeds its memory budget, the tiles of the edits farthest from the current state
+// are compressed, then spilled to a scratch file; the tiles of a history opened from a project stay in the project
+// file until restored. The memory held is counted as the tiles change hands and the
+// edits holding tiles in memory are kept ordered, so enforcing the budget does not go through the whole history.
+class EditHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    // State of a photo tile, a null image stands for the original tile.
+    struct Tile
+    {
+        int column { 0 };
+        int row { 0 };
+        QImage image;
+    };
+
+    // State of an annotation of the scene, a null annotation stands for an absent one.
+    struct AnnotationState
+    {
+        quint64 id { 0 };
+        Annotation annotation;
+    };
+
+    // State of everything an edit touched.
+    struct Change
+    {
+        QVector<Tile> tiles;
+        QVector<AnnotationState> annotations;
+
+        bool isEmpty() const { return tiles.isEmpty() && annotations.isEmpty(); }
+    };
+
+    // File the compressed pixels of tiles are read back from: the scratch file of the spilled tiles, or the project
+    // the history was opened from. Saves read it on their own thread while the history goes on with it.
+    class TileFile
+    {
+    public:
+        virtual ~TileFile() = default;
+        // Returns an empty array if the range cannot be read whole.
+        virtual QByteArray read(qint64 offset, int size) = 0;
+        virtual QString errorString() const = 0;
+    };
+
+    // Range of a tile file holding the compressed pixels of a tile.
+    struct TileBlock
+    {
+        QSharedPointer<TileFile> file;
+        qint64 offset { 0 };
+        int size { 0 };
+
+        QByteArray read() const { return file->read(offset, size); }
+    };
+
+    // Tile of an edit as the history stores it: the image, or its pixels compressed in memory or in a tile file.
+    // A null size stands for the original tile. Copies share the pixels and the blocks, and stay as they are
+    // while the history compresses and spills its own tiles.
+    struct StoredTile
+    {
+        int column { 0 };
+        int row { 0 };
+        QImage image;
+        QSize size;
+        QImage::Format format { QImage::Format_Invalid };
+        QByteArray compressed;
+        QSharedPointer<TileBlock> block;
+
+        bool isOriginal() const { return size.isEmpty(); }
+        // Returns the compressed pixels, compressing the image if they are only held as an image.
+        // Returns an empty array if they cannot be read back from the tile file.
+        QByteArray compressedPixels() const;
+    };
+
+    // An edit with the tiles and annotations it replaced and the ones it made, for saving the history along
+    // with the photo.
+    struct Record
+    {
+        QString text;
+        QVector<StoredTile> tilesBefore;
+        QVector<StoredTile> tilesAfter;
+        QVector<AnnotationState> annotationsBefore;
+        QVector<AnnotationState> annotationsAfter;
+    };
+
+    EditHistory(QObject* parent = nullptr);
+    ~EditHistory() = default;
+
+    qint64 memoryBudget() const { return m_memoryBudget; }
+    void setMemoryBudget(qint64 bytes);
+    // Returns the bytes of the tile images and compressed tiles held in memory by the history, the images shared
+    // with the photo included.
+    qint64 memoryUsage() const { return m_memoryUsage; }
+
+    bool canUndo() const { return m_index > 0; }
+    bool canRedo() const { return m_index < m_entries.size(); }
+    QString undoText() const;
+    QString redoText() const;
+
+    // Records an edit which replaced the before states by the after states.
+    void push(const QString& text, const Change& before, const Change& after);
+    // Set the states to restore on the photo. A tile which cannot be read back from the scratch file fails
+    // the undo or redo, the current state stays as it is.
+    bool undo(Change* change, QString* errorString = nullptr);
+    bool redo(Change* change, QString* errorString = nullptr);
+    void clear();
+
+    // Returns the edits oldest first, the current state being the one after the first index() of them.
+    // Only the stored tiles are copied, not their pixels, so the records are a snapshot cheap to take.
+    QVector<Record> records() const;
+    int index() const { return m_index; }
+    // Replaces the history with the edits, the current state being the one after the first index of them.
+    // The tiles are kept as they are stored, the ones in a tile file are only read once restored.
+    void setRecords(const QVector<Record>& records, int index);
+
+signals:
+    void changed();
+
+private:
+    // Scratch file of the spilled tiles, the ranges of the tiles dropped from the history are written over again.
+    class SpillFile;
+    // Block of the scratch file holding a spilled tile, given back to the file with the last tile referring to it.
+    struct SpillBlock;
+
+    using StoredTilePointer = QSharedPointer<StoredTile>;
+
+    struct Entry
+    {
+        QString text;
+        QVector<StoredTilePointer> before;
+        QVector<StoredTilePointer> after;
+        QVector<AnnotationState> annotationsBefore;
+        QVector<AnnotationState> annotationsAfter;
+    };
+
+    void append(const QString& text, const Change& before, const Change& after);
+    // Drops the edits from the index on, with the memory of the tiles no other edit refers to.
+    void truncate(int index);
+    StoredTilePointer store(const Tile& tile, const QVector<StoredTilePointer>& shareable);
+    bool restore(const QVector<StoredTilePointer>& tiles, QVector<Tile>* restoredTiles, QString* errorString);
+    QImage load(StoredTile& tile, QString* errorString);
+    void compress(StoredTile& tile);
+    bool spill(StoredTile& tile);
+    // Number of undos or redos from the current state to the state the edit restores.
+    int distance(int entryIndex) const;
+    // Returns the edit of the set farthest from the current state, -1 if the set is empty.
+    int farthestEntry(const std::set<int>& entryIndices) const;
+    void enforceMemoryBudget();
+
+    QVector<Entry> m_entries;
+    int m_index { 0 };
+    qint64 m_memoryBudget { qint64(Constants::HISTORY_MEMORY_BUDGET_MB) * 1024 * 1024 };
+    qint64 m_memoryUsage { 0 };
+    // Edits which may hold tile images, and edits which may hold compressed tiles in memory.
+    std::set<int> m_imageEntries;
+    std::set<int> m_compressedEntries;
+    // Created on the first spill.
+    QSharedPointer<SpillFile> m_spillFile;
+};
+
+#endif // EDITHISTORY_H
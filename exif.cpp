@@ -0,0 +1,164 @@
+#include "exif.h"
+
+#include <QIODevice>
+#include <QTransform>
+
+namespace {
+
+const uchar JPEG_MARKER_PREFIX = 0xFF;
+const uchar JPEG_MARKER_APP1 = 0xE1;
+const uchar JPEG_MARKER_SOS = 0xDA;
+const uchar JPEG_MARKER_EOI = 0xD9;
+
+const quint16 TIFF_TAG_ORIENTATION = 0x0112;
+const quint16 TIFF_TAG_JPEG_OFFSET = 0x0201;
+const quint16 TIFF_TAG_JPEG_LENGTH = 0x0202;
+const int TIFF_IFD_ENTRY_SIZE = 12;
+
+// Bounds-checked reader of the TIFF structure inside the EXIF block.
+class TiffReader
+{
+public:
+    explicit TiffReader(const QByteArray& data)
+        : m_data(data)
+    {
+        m_valid = data.size() >= 8 && (data.startsWith("II") || data.startsWith("MM"));
+        m_littleEndian = data.startsWith("II");
+        m_valid = m_valid && u16(2) == 42;
+    }
+
+    bool isValid() const { return m_valid; }
+
+    bool contains(qint64 offset, qint64 size) const
+    {
+        return offset >= 0 && size >= 0 && offset + size <= m_data.size();
+    }
+
+    quint16 u16(int offset) const
+    {
+        if (!contains(offset, 2))
+            return 0;
+        const auto* bytes = reinterpret_cast<const uchar*>(m_data.constData()) + offset;
+        return m_littleEndian ? quint16(bytes[0] | (bytes[1] << 8)) : quint16((bytes[0] << 8) | bytes[1]);
+    }
+
+    quint32 u32(int offset) const
+    {
+        if (!contains(offset, 4))
+            return 0;
+        return m_littleEndian ? (quint32(u16(offset)) | (quint32(u16(offset + 2)) << 16))
+                              : ((quint32(u16(offset)) << 16) | quint32(u16(offset + 2)));
+    }
+
+    // Returns the value of a SHORT or LONG tag of the IFD at the offset.
+    quint32 tag(quint32 ifdOffset, quint16 tag, quint32 defaultValue = 0) const
+    {
+        const int entryCount = u16(int(ifdOffset));
+        for (int i = 0; i < entryCount; ++i) {
+            const int entryOffset = int(ifdOffset) + 2 + i * TIFF_IFD_ENTRY_SIZE;
+            if (!contains(entryOffset, TIFF_IFD_ENTRY_SIZE))
+                break;
+            if (u16(entryOffset) == tag)
+                return u16(entryOffset + 2) == 3 ? u16(entryOffset + 8) : u32(entryOffset + 8);
+        }
+        return defaultValue;
+    }
+
+    quint32 nextIfd(quint32 ifdOffset) const
+    {
+        const int entryCount = u16(int(ifdOffset));
+        return u32(int(ifdOffset) + 2 + entryCount * TIFF_IFD_ENTRY_SIZE);
+    }
+
+    QByteArray mid(quint32 offset, quint32 size) const
+    {
+        return contains(offset, size) ? m_data.mid(int(offset), int(size)) : QByteArray();
+    }
+
+private:
+    const QByteArray& m_data;
+    bool m_littleEndian { true };
+    bool m_valid { false };
+};
+
+QImage thumbnailFromTiff(const QByteArray& tiff)
+{
+    const TiffReader reader(tiff);
+    if (!reader.isValid())
+        return QImage();
+
+    const quint32 ifd0 = reader.u32(4);
+    if (!reader.contains(ifd0, 2))
+        return QImage();
+    const int orientation = int(reader.tag(ifd0, TIFF_TAG_ORIENTATION, 1));
+
+    // The thumbnail is described by the second IFD.
+    const quint32 ifd1 = reader.nextIfd(ifd0);
+    if (ifd1 == 0 || !reader.contains(ifd1, 2))
+        return QImage();
+    const quint32 offset = reader.tag(ifd1, TIFF_TAG_JPEG_OFFSET),
+            length = reader.tag(ifd1, TIFF_TAG_JPEG_LENGTH);
+    const QByteArray jpeg = reader.mid(offset, length);
+    if (jpeg.isEmpty())
+        return QImage();
+
+    return Exif::applyOrientation(QImage::fromData(jpeg, "JPEG"), orientation);
+}
+
+}
+
+namespace Exif {
+
+QImage readThumbnail(QIODevice* device)
+{
+    if (!device || !device->seek(0) || device->read(2) != QByteArray("\xFF\xD8", 2))
+        return QImage();
+
+    // Walk the JPEG segments up to the image data looking for the APP1 EXIF segment.
+    qint64 position = 2;
+    while (device->seek(position)) {
+        const QByteArray marker = device->read(4);
+        if (marker.size() < 4 || uchar(marker[0]) != JPEG_MARKER_PREFIX)
+            break;
+
+        const uchar type = uchar(marker[1]);
+        if (type == JPEG_MARKER_SOS || type == JPEG_MARKER_EOI)
+            break;
+
+        const int length = (uchar(marker[2]) << 8) | uchar(marker[3]);
+        if (length < 2)
+            break;
+
+        if (type == JPEG_MARKER_APP1) {
+            const QByteArray segment = device->read(length - 2);
+            if (segment.startsWith(QByteArray("Exif\0\0", 6)))
+                return thumbnailFromTiff(segment.mid(6));
+        }
+        position += 2 + length;
+    }
+    return QImage();
+}
+
+QImage applyOrientation(const QImage& image, int orientation)
+{
+    switch (orientation) {
+    case 2:
+        return image.mirrored(true, false);
+    case 3:
+        return image.mirrored(true, true);
+    case 4:
+        return image.mirrored(false, true);
+    case 5:
+        return image.mirrored(true, false).transformed(QTransform().rotate(270));
+    case 6:
+        return image.transformed(QTransform().rotate(90));
+    case 7:
+        return image.mirrored(true, false).transformed(QTransform().rotate(90));
+    case 8:
+        return image.transformed(QTransform().rotate(270));
+    default:
+        return image;
+    }
+}
+
+}
@@ -0,0 +1,19 @@
+#ifndef EXIF_H
+#define EXIF_H
+
+#include <QImage>
+
+class QIODevice;
+
+namespace Exif {
+
+    // Returns the thumbnail embedded into the EXIF block of a JPEG file, rotated according to the EXIF orientation.
+    // Returns a null image for other formats or if there is no thumbnail. The device position is not preserved.
+    QImage readThumbnail(QIODevice* device);
+
+    // Applies the EXIF orientation (1..8) to the image.
+    QImage applyOrientation(const QImage& image, int orientation);
+
+}
+
+#endif // EXIF_H
@@ -0,0 +1,174 @@
+#include "filmstrip.h"
+#include "photoloader.h"
+#include "thumbnailloader.h"
+#include "constants.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QPixmap>
+#include <QResizeEvent>
+#include <QScrollBar>
+
+namespace {
+
+const int FilePathRole = Qt::UserRole;
+// Set once the thumbnail of the item was delivered or failed, so it is not requested again.
+const int ThumbnailDoneRole = Qt::UserRole + 1;
+
+}
+
+Filmstrip::Filmstrip(QWidget* parent)
+    : QListWidget(parent)
+    , m_thumbnailLoader(new ThumbnailLoader(this))
+{
+    setViewMode(QListView::IconMode);
+    setFlow(QListView::LeftToRight);
+    setWrapping(false);
+    setMovement(QListView::Static);
+    setUniformItemSizes(true);
+    setSelectionMode(QAbstractItemView::SingleSelection);
+    setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    m_listingThreadPool.setMaxThreadCount(1);
+    setThumbnailSize(Constants::FILMSTRIP_THUMBNAIL_SIZE_PX);
+
+    connect(horizontalScrollBar(), &QScrollBar::valueChanged, this, &Filmstrip::requestVisibleThumbnails);
+    connect(m_thumbnailLoader, &ThumbnailLoader::thumbnailReady, this, &Filmstrip::setThumbnail);
+    auto activatePhoto = [&](QListWidgetItem* photoItem) {
+        const QString filePath = photoItem->data(FilePathRole).toString();
+        if (filePath != m_currentPhoto)
+            emit photoActivated(filePath);
+    };
+    connect(this, &QListWidget::itemClicked, activatePhoto);
+    connect(this, &QListWidget::itemActivated, activatePhoto);
+}
+
+Filmstrip::~Filmstrip()
+{
+    m_listingThreadPool.waitForDone();
+}
+
+void Filmstrip::setThumbnailSize(int size)
+{
+    setIconSize(QSize(size, size));
+    const int spacing = size / 8;
+    setGridSize(QSize(size + spacing * 2, size + fontMetrics().height() + spacing * 2));
+    setFixedHeight(gridSize().height() + horizontalScrollBar()->sizeHint().height() + frameWidth() * 2);
+
+    // Items without their thumbnail yet keep the size of the ones with it.
+    const qreal pixelRatio = devicePixelRatioF();
+    QPixmap placeholder(iconSize() * pixelRatio);
+    placeholder.setDevicePixelRatio(pixelRatio);
+    placeholder.fill(Qt::transparent);
+    m_placeholderIcon = QIcon(placeholder);
+}
+
+void Filmstrip::setCurrentPhoto(const QString& filePath)
+{
+    const QFileInfo fileInfo(filePath);
+    m_currentPhoto = fileInfo.absoluteFilePath();
+    const QString folderPath = fileInfo.absolutePath();
+    // A photo missing from the listed folder was added since, the folder is listed again.
+    if (folderPath == m_folderPath && m_rows.contains(m_currentPhoto)) {
+        m_listingFolderPath.clear();
+        selectCurrentPhoto();
+    } else if (folderPath != m_listingFolderPath) {
+        listFolder(folderPath);
+    }
+}
+
+void Filmstrip::resizeEvent(QResizeEvent* event)
+{
+    QListWidget::resizeEvent(event);
+    requestVisibleThumbnails();
+}
+
+void Filmstrip::listFolder(const QString& folderPath)
+{
+    m_listingFolderPath = folderPath;
+    m_listingThreadPool.start([this, folderPath]() {
+        const QStringList photos = PhotoLoader::listPhotos(folderPath);
+        QMetaObject::invokeMethod(this, [this, folderPath, photos]() {
+            // The listing of a folder left meanwhile is dropped.
+            if (folderPath == m_listingFolderPath)
+                setPhotos(folderPath, photos);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void Filmstrip::setPhotos(const QString& folderPath, const QStringList& photos)
+{
+    m_listingFolderPath.clear();
+    m_folderPath = folderPath;
+    m_photos = photos;
+    m_rows.clear();
+    clear();
+    for (int row = 0; row < photos.size(); ++row) {
+        const QString& filePath = photos.at(row);
+        auto* photoItem = new QListWidgetItem(m_placeholderIcon, QFileInfo(filePath).fileName());
+        photoItem->setData(FilePathRole, filePath);
+        photoItem->setToolTip(QDir::toNativeSeparators(filePath));
+        addItem(photoItem);
+        m_rows.insert(filePath, row);
+    }
+
+    selectCurrentPhoto();
+    requestVisibleThumbnails();
+}
+
+void Filmstrip::selectCurrentPhoto()
+{
+    const auto row = m_rows.constFind(m_currentPhoto);
+    if (row == m_rows.constEnd())
+        return;
+
+    setCurrentRow(*row);
+    scrollToItem(item(*row), QAbstractItemView::PositionAtCenter);
+}
+
+void Filmstrip::requestVisibleThumbnails()
+{
+    if (count() == 0)
+        return;
+
+    // The items are laid out in a single row of grid cells, the visible ones follow from the scroll position.
+    const int cellWidth = qMax(1, gridSize().width());
+    const int firstVisible = qBound(0, horizontalScrollBar()->value() / cellWidth, count() - 1);
+    const int visibleCount = viewport()->width() / cellWidth + 2;
+    const int lastVisible = qMin(count() - 1, firstVisible + visibleCount - 1);
+
+    QStringList filePaths;
+    auto appendRow = [&](int row) {
+        const QListWidgetItem* photoItem = item(row);
+        if (!photoItem->data(ThumbnailDoneRole).toBool())
+            filePaths.append(photoItem->data(FilePathRole).toString());
+    };
+    for (int row = firstVisible; row <= lastVisible; ++row)
+        appendRow(row);
+    // Then the pages around the visible ones, nearest first.
+    for (int distance = 1; distance <= visibleCount * Constants::FILMSTRIP_PREFETCH_PAGES; ++distance) {
+        if (lastVisible + distance < count())
+            appendRow(lastVisible + distance);
+        if (firstVisible - distance >= 0)
+            appendRow(firstVisible - distance);
+    }
+    m_thumbnailLoader->request(filePaths);
+}
+
+void Filmstrip::setThumbnail(const QString& filePath, const QImage& thumbnail)
+{
+    const auto row = m_rows.constFind(filePath);
+    if (row == m_rows.constEnd())
+        return;
+
+    QListWidgetItem* photoItem = item(*row);
+    photoItem->setData(ThumbnailDoneRole, true);
+    if (thumbnail.isNull())
+        return;
+
+    // Scaled to the icon size once, instead of on every paint of the item.
+    const qreal pixelRatio = devicePixelRatioF();
+    QPixmap pixmap = QPixmap::fromImage(thumbnail.scaled(iconSize() * pixelRatio, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+    pixmap.setDevicePixelRatio(pixelRatio);
+    photoItem->setIcon(QIcon(pixmap));
+}
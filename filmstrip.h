@@ -0,0 +1,53 @@
+#ifndef FILMSTRIP_H
+#define FILMSTRIP_H
+
+#include <QHash>
+#include <QIcon>
+#include <QListWidget>
+#include <QThreadPool>
+
+class ThumbnailLoader;
+
+// Strip of the thumbnails of the photos of a folder. The folder is listed on a worker thread, and thumbnails
+// are only requested for the items in view and a few pages around them, the ones in view first. A folder of
+// thousands of photos opens at once, and only the part of it scrolled through is ever read.
+class Filmstrip : public QListWidget
+{
+    Q_OBJECT
+
+public:
+    Filmstrip(QWidget* parent = nullptr);
+    ~Filmstrip();
+
+    // Sets the size of the thumbnails and the height of the strip.
+    void setThumbnailSize(int size);
+    // Selects the photo, listing its folder first if it is not the one shown.
+    void setCurrentPhoto(const QString& filePath);
+    // The listed folder and its photos, in name order.
+    QString folderPath() const { return m_folderPath; }
+    QStringList photos() const { return m_photos; }
+
+signals:
+    void photoActivated(const QString& filePath);
+
+protected:
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    void listFolder(const QString& folderPath);
+    void setPhotos(const QString& folderPath, const QStringList& photos);
+    void selectCurrentPhoto();
+    void requestVisibleThumbnails();
+    void setThumbnail(const QString& filePath, const QImage& thumbnail);
+
+    ThumbnailLoader* m_thumbnailLoader { nullptr };
+    QThreadPool m_listingThreadPool;
+    QString m_folderPath;
+    QString m_listingFolderPath;
+    QStringList m_photos;
+    QHash<QString, int> m_rows;
+    QString m_currentPhoto;
+    QIcon m_placeholderIcon;
+};
+
+#endif // FILMSTRIP_H
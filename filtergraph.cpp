@@ -0,0 +1,415 @@
+#include "filtergraph.h"
+#include "tiledimagestore.h"
+#include "constants.h"
+
+#include <QCache>
+#include <QDataStream>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtMath>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// The key of a memoized tile packs the digest of its node with its level, row and column.
+const int KEY_POSITION_BITS = 14;
+const int KEY_LEVEL_SHIFT = 2 * KEY_POSITION_BITS;
+const quint64 KEY_POSITION_MASK = (quint64(1) << KEY_POSITION_BITS) - 1;
+
+quint64 tileKey(uint digest, int level, int column, int row)
+{
+    return quint64(digest) << 32 | quint64(level & 0xF) << KEY_LEVEL_SHIFT
+            | (quint64(row) & KEY_POSITION_MASK) << KEY_POSITION_BITS | (quint64(column) & KEY_POSITION_MASK);
+}
+
+uint nodeDigest(const FilterGraph::Node& node, uint seed)
+{
+    seed = qHash(int(node.type), seed);
+    seed = qHash(node.blackPoint, seed);
+    seed = qHash(node.whitePoint, seed);
+    seed = qHash(node.gamma, seed);
+    seed = qHash(node.brightness, seed);
+    seed = qHash(node.contrast, seed);
+    seed = qHash(node.saturation, seed);
+    seed = qHash(node.amount, seed);
+    return qHash(node.radius, seed);
+}
+
+// The radius of a sharpen node on a level, 0 when too small to make a difference there.
+int sharpenRadius(const FilterGraph::Node& node, int level)
+{
+    return qRound(node.radius / (1 << level));
+}
+
+// The same mapping of every color channel, for the nodes which are one.
+QVector<uchar> lookupTable(const FilterGraph::Node& node)
+{
+    QVector<uchar> table;
+    if (node.type != FilterGraph::Node::Levels && node.type != FilterGraph::Node::BrightnessContrast)
+        return table;
+
+    table.resize(256);
+    const int range = qMax(1, node.whitePoint - node.blackPoint);
+    // Contrast stretches the values away from the middle gray, up to 100 times.
+    const qreal contrastFactor = node.contrast >= 0.0 ? 1.0 / (1.0 - 0.99 * node.contrast) : 1.0 + node.contrast;
+    for (int value = 0; value < 256; ++value) {
+        qreal mapped = value / 255.0;
+        if (node.type == FilterGraph::Node::Levels)
+            mapped = std::pow(qBound(0.0, qreal(value - node.blackPoint) / range, 1.0), 1.0 / qMax(0.01, node.gamma));
+        else
+            mapped = (mapped - 0.5) * contrastFactor + 0.5 + node.brightness * 0.5;
+        table[value] = uchar(qBound(0, qRound(mapped * 255.0), 255));
+    }
+    return table;
+}
+
+void applyLookupTable(QImage& image, const uchar* table)
+{
+    uchar* const bits = image.bits();
+    for (int y = 0; y < image.height(); ++y) {
+        quint32* line = reinterpret_cast<quint32*>(bits + y * image.bytesPerLine());
+        for (int x = 0; x < image.width(); ++x) {
+            const quint32 pixel = line[x];
+            line[x] = (pixel & 0xFF000000) | quint32(table[(pixel >> 16) & 0xFF]) << 16
+                    | quint32(table[(pixel >> 8) & 0xFF]) << 8 | table[pixel & 0xFF];
+        }
+    }
+}
+
+// Moves the colors toward or away from their luma, Rec. 709 weights like the histogram.
+void saturate(QImage& image, qreal saturation)
+{
+    const int factor = qRound(saturation * 256.0);
+    uchar* const bits = image.bits();
+    for (int y = 0; y < image.height(); ++y) {
+        quint32* line = reinterpret_cast<quint32*>(bits + y * image.bytesPerLine());
+        for (int x = 0; x < image.width(); ++x) {
+            const quint32 pixel = line[x];
+            const int red = (pixel >> 16) & 0xFF, green = (pixel >> 8) & 0xFF, blue = pixel & 0xFF;
+            const int luma = (54 * red + 183 * green + 19 * blue + 128) >> 8;
+            auto channel = [luma, factor](int value) {
+                return quint32(qBound(0, luma + (((value - luma) * factor + 128) >> 8), 255));
+            };
+            line[x] = (pixel & 0xFF000000) | channel(red) << 16 | channel(green) << 8 | channel(blue);
+        }
+    }
+}
+
+// Averages the colors of the pixels within the radius along a line, the pixels out of the line left out.
+void boxAverage(const quint32* source, qsizetype sourceStride, quint32* destination, qsizetype destinationStride,
+                int count, int radius)
+{
+    quint32 blue = 0, green = 0, red = 0;
+    quint32 pixelCount = 0;
+    auto add = [&](quint32 pixel) {
+        blue += pixel & 0xFF;
+        green += (pixel >> 8) & 0xFF;
+        red += (pixel >> 16) & 0xFF;
+        ++pixelCount;
+    };
+    auto remove = [&](quint32 pixel) {
+        blue -= pixel & 0xFF;
+        green -= (pixel >> 8) & 0xFF;
+        red -= (pixel >> 16) & 0xFF;
+        --pixelCount;
+    };
+
+    for (int i = 0; i <= qMin(radius, count - 1); ++i)
+        add(source[i * sourceStride]);
+    for (int i = 0; i < count; ++i) {
+        const quint32 half = pixelCount / 2;
+        destination[i * destinationStride] = (red + half) / pixelCount << 16 | (green + half) / pixelCount << 8
+                | (blue + half) / pixelCount;
+        if (i + radius + 1 < count)
+            add(source[(i + radius + 1) * sourceStride]);
+        if (i - radius >= 0)
+            remove(source[(i - radius) * sourceStride]);
+    }
+}
+
+// Unsharp mask of the part of the image inside the rect, against a separable box blur of the radius.
+// The image holds the pixels around the rect the blur reads.
+QImage sharpened(const QImage& image, const QRect& rect, int radius, qreal amount)
+{
+    const int width = image.width(), height = image.height();
+    QVector<quint32> horizontal(width * height);
+    for (int y = 0; y < height; ++y) {
+        boxAverage(reinterpret_cast<const quint32*>(image.constScanLine(y)), 1, horizontal.data() + y * width, 1,
+                   width, radius);
+    }
+    QVector<quint32> blurred(rect.width() * height);
+    for (int x = rect.left(); x <= rect.right(); ++x)
+        boxAverage(horizontal.constData() + x, width, blurred.data() + x - rect.left(), rect.width(), height, radius);
+
+    const int factor = qRound(amount * 256.0);
+    auto channel = [factor](quint32 value, quint32 blur) {
+        const int difference = int(value & 0xFF) - int(blur & 0xFF);
+        return quint32(qBound(0, int(value & 0xFF) + ((difference * factor + 128) >> 8), 255));
+    };
+    QImage tile(rect.size(), image.format());
+    for (int y = 0; y < rect.height(); ++y) {
+        const quint32* source = reinterpret_cast<const quint32*>(image.constScanLine(rect.top() + y)) + rect.left();
+        const quint32* blur = blurred.constData() + (rect.top() + y) * rect.width();
+        quint32* destination = reinterpret_cast<quint32*>(tile.scanLine(y));
+        for (int x = 0; x < rect.width(); ++x) {
+            const quint32 pixel = source[x];
+            destination[x] = (pixel & 0xFF000000) | channel(pixel >> 16, blur[x] >> 16) << 16
+                    | channel(pixel >> 8, blur[x] >> 8) << 8 | channel(pixel, blur[x]);
+        }
+    }
+    return tile;
+}
+
+// Adjustments work on the colors, not on the colors premultiplied by the alpha.
+QImage straight(const QImage& image)
+{
+    return image.format() == QImage::Format_ARGB32_Premultiplied ? image.convertToFormat(QImage::Format_ARGB32) : image;
+}
+
+}
+
+// Memoized outputs of the nodes, shared by the levels of the pyramids the graph made and evaluated from all threads.
+class FilterGraph::TileCache
+{
+public:
+    TileCache()
+    {
+        tiles.setMaxCost(Constants::FILTER_TILE_CACHE_SIZE_KB);
+    }
+
+    QMutex mutex;
+    QCache<quint64, QImage> tiles;
+    int tileSize { Constants::PHOTO_TILE_SIZE_PX };
+};
+
+// A pyramid level through the graph, evaluating the tiles asked for from the tiles of the source level.
+class FilterGraph::TileStore : public TiledImageStore
+{
+public:
+    TileStore(const TiledImage& source, int level, const QVector<Node>& nodes, const QVector<uint>& digests,
+              const QSharedPointer<TileCache>& cache)
+        : TiledImageStore(source.size(), source.format(), source.tileSize())
+        , m_source(source)
+        , m_level(level)
+        , m_nodes(nodes)
+        , m_digests(digests)
+        , m_cache(cache)
+    {
+        for (const Node& node : nodes)
+            m_lookupTables.append(lookupTable(node));
+    }
+
+    QImage tile(int column, int row) const override
+    {
+        return evaluate(m_nodes.size() - 1, column, row);
+    }
+
+private:
+    // Returns the output of the node for the tile, the tile of the source level for node -1.
+    QImage evaluate(int node, int column, int row) const
+    {
+        if (node < 0)
+            return m_source.tile(column, row);
+
+        const Node& filter = m_nodes.at(node);
+        const int radius = filter.type == Node::Sharpen ? sharpenRadius(filter, m_level) : 0;
+        if (filter.type == Node::Sharpen && radius == 0)
+            return evaluate(node - 1, column, row);
+
+        const QRect rect = tileRect(column, row);
+        if (rect.isEmpty())
+            return QImage();
+
+        const quint64 key = tileKey(m_digests.at(node), m_level, column, row);
+        {
+            QMutexLocker locker(&m_cache->mutex);
+            if (const QImage* tile = m_cache->tiles.object(key))
+                return *tile;
+        }
+
+        // Evaluated outside of the lock, so the tiles evaluate in parallel. Two threads asking for the same tile
+        // at once both evaluate it, the same way.
+        QImage tile;
+        if (filter.type == Node::Sharpen) {
+            const QRect inputRect = rect.adjusted(-radius, -radius, radius, radius).intersected(QRect(QPoint(0, 0), size()));
+            tile = sharpened(straight(input(node - 1, inputRect)), rect.translated(-inputRect.topLeft()), radius,
+                             filter.amount);
+        } else {
+            tile = straight(evaluate(node - 1, column, row));
+            if (filter.type == Node::Saturation)
+                saturate(tile, filter.saturation);
+            else
+                applyLookupTable(tile, m_lookupTables.at(node).constData());
+        }
+        if (tile.format() != format())
+            tile = tile.convertToFormat(format());
+
+        QMutexLocker locker(&m_cache->mutex);
+        m_cache->tiles.insert(key, new QImage(tile), int(qMax<qint64>(1, tile.sizeInBytes() / 1024)));
+        return tile;
+    }
+
+    // Assembles the output of the node inside the rect from its tiles.
+    QImage input(int node, const QRect& rect) const
+    {
+        if (node < 0)
+            return m_source.copy(rect);
+
+        QImage image(rect.size(), format());
+        const int firstColumn = rect.left() / tileSize(), lastColumn = rect.right() / tileSize(),
+                firstRow = rect.top() / tileSize(), lastRow = rect.bottom() / tileSize();
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                const QImage tile = evaluate(node, column, row);
+                const QRect tileRect = this->tileRect(column, row);
+                const QRect part = tileRect.intersected(rect);
+                const size_t lineBytes = size_t(part.width()) * 4;
+                for (int y = part.top(); y <= part.bottom(); ++y) {
+                    std::memcpy(image.scanLine(y - rect.top()) + (part.left() - rect.left()) * 4,
+                                tile.constScanLine(y - tileRect.top()) + (part.left() - tileRect.left()) * 4, lineBytes);
+                }
+            }
+        }
+        return image;
+    }
+
+    TiledImage m_source;
+    int m_level;
+    QVector<Node> m_nodes;
+    QVector<uint> m_digests;
+    QVector<QVector<uchar>> m_lookupTables;
+    QSharedPointer<TileCache> m_cache;
+};
+
+bool FilterGraph::Node::isIdentity() const
+{
+    switch (type) {
+    case Levels:
+        return blackPoint == 0 && whitePoint == 255 && qFuzzyCompare(gamma, 1.0);
+    case BrightnessContrast:
+        return qFuzzyIsNull(brightness) && qFuzzyIsNull(contrast);
+    case Saturation:
+        return qFuzzyCompare(saturation, 1.0);
+    case Sharpen:
+        return qFuzzyIsNull(amount) || radius < 0.5;
+    }
+    return true;
+}
+
+FilterGraph::FilterGraph()
+    : m_cache(new TileCache)
+{}
+
+FilterGraph::FilterGraph(const QVector<Node>& nodes)
+    : FilterGraph()
+{
+    setNodes(nodes);
+}
+
+void FilterGraph::setNodes(const QVector<Node>& nodes)
+{
+    m_nodes.clear();
+    m_digests.clear();
+    uint digest = 0;
+    for (const Node& node : nodes) {
+        if (node.isIdentity())
+            continue;
+        digest = nodeDigest(node, digest);
+        m_nodes.append(node);
+        m_digests.append(digest);
+    }
+}
+
+int FilterGraph::margin() const
+{
+    int margin = 0;
+    for (const Node& node : m_nodes) {
+        if (node.type == Node::Sharpen)
+            margin += qCeil(node.radius);
+    }
+    return margin;
+}
+
+ImagePyramid FilterGraph::apply(const ImagePyramid& pyramid) const
+{
+    if (m_nodes.isEmpty() || pyramid.isNull())
+        return pyramid;
+
+    {
+        QMutexLocker locker(&m_cache->mutex);
+        m_cache->tileSize = pyramid.level(0).tileSize();
+    }
+    QVector<TiledImage> levels;
+    for (int level = 0; level < pyramid.levelCount(); ++level) {
+        levels.append(TiledImage(QSharedPointer<TiledImageStore>(
+                new TileStore(pyramid.level(level), level, m_nodes, m_digests, m_cache))));
+    }
+    return ImagePyramid(levels);
+}
+
+void FilterGraph::invalidate(const QRect& dirtyRect)
+{
+    if (dirtyRect.isEmpty())
+        return;
+
+    const int margin = this->margin();
+    const QRect rect = dirtyRect.adjusted(-margin, -margin, margin, margin);
+    QMutexLocker locker(&m_cache->mutex);
+    const QList<quint64> keys = m_cache->tiles.keys();
+    for (const quint64 key : keys) {
+        const int level = int(key >> KEY_LEVEL_SHIFT) & 0xF,
+                row = int((key >> KEY_POSITION_BITS) & KEY_POSITION_MASK),
+                column = int(key & KEY_POSITION_MASK);
+        // A pixel of a level averages photo pixels up to one pixel of the level apart.
+        const QRect levelRect(QPoint((rect.left() >> level) - 1, (rect.top() >> level) - 1),
+                              QPoint((rect.right() >> level) + 1, (rect.bottom() >> level) + 1));
+        const int tileSize = m_cache->tileSize;
+        if (levelRect.intersects(QRect(column * tileSize, row * tileSize, tileSize, tileSize)))
+            m_cache->tiles.remove(key);
+    }
+}
+
+void FilterGraph::invalidate()
+{
+    QMutexLocker locker(&m_cache->mutex);
+    m_cache->tiles.clear();
+}
+
+void FilterGraph::writeNodes(QDataStream& stream, const QVector<Node>& nodes)
+{
+    stream << qint32(nodes.size());
+    for (const Node& node : nodes) {
+        stream << qint32(node.type) << qint32(node.blackPoint) << qint32(node.whitePoint) << double(node.gamma)
+               << double(node.brightness) << double(node.contrast) << double(node.saturation)
+               << double(node.amount) << double(node.radius);
+    }
+}
+
+QVector<FilterGraph::Node> FilterGraph::readNodes(QDataStream& stream)
+{
+    qint32 count = 0;
+    stream >> count;
+    QVector<Node> nodes;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 type = Node::Levels, blackPoint = 0, whitePoint = 255;
+        double gamma = 1.0, brightness = 0.0, contrast = 0.0, saturation = 1.0, amount = 0.0, radius = 1.0;
+        stream >> type >> blackPoint >> whitePoint >> gamma >> brightness >> contrast >> saturation >> amount >> radius;
+        if (stream.status() != QDataStream::Ok || type < Node::Levels || type > Node::Sharpen)
+            break;
+
+        Node node;
+        node.type = Node::Type(type);
+        node.blackPoint = blackPoint;
+        node.whitePoint = whitePoint;
+        node.gamma = gamma;
+        node.brightness = brightness;
+        node.contrast = contrast;
+        node.saturation = saturation;
+        node.amount = amount;
+        node.radius = radius;
+        nodes.append(node);
+    }
+    return nodes;
+}
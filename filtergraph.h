@@ -0,0 +1,79 @@
+#ifndef FILTERGRAPH_H
+#define FILTERGRAPH_H
+
+#include "imagepyramid.h"
+
+#include <QSharedPointer>
+#include <QVector>
+
+class QDataStream;
+
+// Non-destructive adjustments of the photo, a chain of nodes each taking the output of the previous one, the first
+// one the photo with its edits. Applying the graph to a pyramid makes a pyramid the tiles of which are evaluated
+// lazily, when they are painted, printed or saved, so only the tiles asked for are ever computed. The output of
+// every node is memoized per tile, keyed by the parameters of the node and of the nodes before it: changing a
+// parameter recomputes that node and the following ones for the tiles asked for next, reusing the outputs of the
+// nodes before it. Point adjustments map a tile to the same tile through lookup tables, sharpening reads a margin
+// of the neighbour tiles of its input. Tiles evaluate on whichever thread asks for them, in parallel.
+class FilterGraph
+{
+public:
+    struct Node
+    {
+        enum Type {
+            Levels,
+            BrightnessContrast,
+            Saturation,
+            Sharpen
+        };
+
+        Type type { Levels };
+        // Input levels mapped to black and white, and the gamma of the midtones.
+        int blackPoint { 0 };
+        int whitePoint { 255 };
+        qreal gamma { 1.0 };
+        // In [-1, 1].
+        qreal brightness { 0.0 };
+        qreal contrast { 0.0 };
+        // 0 is grayscale, 1 leaves the colors as they are.
+        qreal saturation { 1.0 };
+        // Unsharp mask, the amount the difference with the blurred photo is added by, the radius in photo pixels.
+        qreal amount { 0.0 };
+        qreal radius { 1.0 };
+
+        // Returns true if the node leaves the pixels as they are.
+        bool isIdentity() const;
+    };
+
+    FilterGraph();
+    explicit FilterGraph(const QVector<Node>& nodes);
+
+    bool isEmpty() const { return m_nodes.isEmpty(); }
+    QVector<Node> nodes() const { return m_nodes; }
+    // Identity nodes are dropped. The memoized outputs of the nodes kept in front stay valid.
+    void setNodes(const QVector<Node>& nodes);
+    // Photo pixels around a pixel the graph reads to compute it.
+    int margin() const;
+
+    // Returns the pyramid through the graph, the pyramid itself if the graph is empty. The levels of the pyramid
+    // returned share the memoized tiles of the graph, copies of the graph included.
+    ImagePyramid apply(const ImagePyramid& pyramid) const;
+    // Drops the memoized tiles depending on the photo pixels inside the rect, after they were edited.
+    void invalidate(const QRect& dirtyRect);
+    // Drops all the memoized tiles, after the photo was replaced.
+    void invalidate();
+
+    static void writeNodes(QDataStream& stream, const QVector<Node>& nodes);
+    static QVector<Node> readNodes(QDataStream& stream);
+
+private:
+    class TileCache;
+    class TileStore;
+
+    QVector<Node> m_nodes;
+    // Digest of the parameters of every node and of the nodes before it.
+    QVector<uint> m_digests;
+    QSharedPointer<TileCache> m_cache;
+};
+
+#endif // FILTERGRAPH_H
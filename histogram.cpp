@@ -0,0 +1,178 @@
+#include "histogram.h"
+#include "profiler.h"
+
+#include <QtConcurrent>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+const int TILE_COUNTS = Histogram::ChannelCount * Histogram::BIN_COUNT;
+
+// Rec. 709 weights in 8-bit fixed point, they sum to 256 so white stays 255.
+const int LUMA_RED_WEIGHT = 54;
+const int LUMA_GREEN_WEIGHT = 183;
+const int LUMA_BLUE_WEIGHT = 19;
+
+}
+
+void Histogram::setImage(const TiledImage& image, const AnnotationScene* scene, int opacity, qreal scale)
+{
+    m_image = image;
+    m_scene = scene;
+    m_opacity = opacity;
+    m_scale = scale;
+    m_tileCounts.fill(0, image.columns() * image.rows() * TILE_COUNTS);
+    m_totals.fill(0, TILE_COUNTS);
+    if (image.isNull())
+        return;
+
+    QVector<int> tileIndices(image.columns() * image.rows());
+    std::iota(tileIndices.begin(), tileIndices.end(), 0);
+    countTiles(tileIndices);
+}
+
+void Histogram::updateImage(const TiledImage& image, const QRect& dirtyRect)
+{
+    m_image = image;
+    const QRect rect = dirtyRect.intersected(QRect(QPoint(0, 0), m_image.size()));
+    if (rect.isEmpty())
+        return;
+
+    QVector<int> tileIndices;
+    const QRect range = m_image.tileRange(rect);
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column)
+            tileIndices.append(row * m_image.columns() + column);
+    }
+    countTiles(tileIndices);
+}
+
+void Histogram::setAnnotationOpacity(int opacity, const QRect& dirtyRect)
+{
+    if (opacity == m_opacity)
+        return;
+
+    m_opacity = opacity;
+    updateImage(m_image, dirtyRect);
+}
+
+void Histogram::clear()
+{
+    setImage(TiledImage());
+}
+
+quint64 Histogram::maxCount(Channel channel) const
+{
+    if (m_totals.isEmpty())
+        return 0;
+    return *std::max_element(counts(channel), counts(channel) + BIN_COUNT);
+}
+
+void Histogram::countTiles(const QVector<int>& tileIndices)
+{
+    const Profiler::ScopedTimer timer("count histogram", "histogram");
+    QVector<quint32> newCounts(tileIndices.size() * TILE_COUNTS);
+    quint32* const newCountsData = newCounts.data();
+    QVector<int> positions(tileIndices.size());
+    std::iota(positions.begin(), positions.end(), 0);
+    QtConcurrent::blockingMap(positions, [&](int position) {
+        countTile(tileIndices.at(position), newCountsData + position * TILE_COUNTS);
+    });
+
+    // The previous counts of the tiles are swapped for the new ones, each channel reduced on its own.
+    quint64* const totals = m_totals.data();
+    quint32* const tileCounts = m_tileCounts.data();
+    QVector<int> channels(ChannelCount);
+    std::iota(channels.begin(), channels.end(), 0);
+    QtConcurrent::blockingMap(channels, [&](int channel) {
+        for (int position = 0; position < tileIndices.size(); ++position) {
+            quint32* previous = tileCounts + tileIndices.at(position) * TILE_COUNTS + channel * BIN_COUNT;
+            const quint32* current = newCountsData + position * TILE_COUNTS + channel * BIN_COUNT;
+            quint64* total = totals + channel * BIN_COUNT;
+            for (int bin = 0; bin < BIN_COUNT; ++bin) {
+                total[bin] += current[bin];
+                total[bin] -= previous[bin];
+                previous[bin] = current[bin];
+            }
+        }
+    });
+}
+
+void Histogram::countTile(int tileIndex, quint32* counts) const
+{
+    const int column = tileIndex % m_image.columns(),
+            row = tileIndex / m_image.columns();
+    const QRect tileRect = m_image.tileRect(column, row);
+    QImage tile = m_image.tile(column, row);
+    const QRectF photoRect(tileRect.x() / m_scale, tileRect.y() / m_scale, tileRect.width() / m_scale, tileRect.height() / m_scale);
+    if (m_scene && m_opacity > 0 && !m_scene->items(photoRect).isEmpty()) {
+        // Compositing detaches the tile from the pixels of the photo.
+        tile = tile.convertToFormat(tile.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+        m_scene->composite(tile, m_opacity, tileRect.topLeft(), m_scale);
+    } else if (tile.format() != QImage::Format_RGB32 && tile.format() != QImage::Format_ARGB32_Premultiplied) {
+        tile = tile.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    // Even and odd pixels are counted into separate histograms, so the increments of neighbour pixels
+    // of the same value do not wait for each other.
+    static const LumaFunction luma = lumaFunction(Compositing::bestInstructionSet());
+    QVarLengthArray<quint32, 2 * TILE_COUNTS> interleaved(2 * TILE_COUNTS);
+    std::fill(interleaved.begin(), interleaved.end(), 0u);
+    quint32* const even = interleaved.data();
+    quint32* const odd = even + TILE_COUNTS;
+    QVarLengthArray<uchar, Constants::PHOTO_TILE_SIZE_PX> lumaLine(tile.width());
+    for (int y = 0; y < tile.height(); ++y) {
+        const auto* line = reinterpret_cast<const quint32*>(tile.constScanLine(y));
+        luma(lumaLine.data(), line, tile.width());
+        int x = 0;
+        for (; x + 2 <= tile.width(); x += 2) {
+            ++even[Red * BIN_COUNT + ((line[x] >> 16) & 0xFF)];
+            ++even[Green * BIN_COUNT + ((line[x] >> 8) & 0xFF)];
+            ++even[Blue * BIN_COUNT + (line[x] & 0xFF)];
+            ++even[Luma * BIN_COUNT + lumaLine[x]];
+            ++odd[Red * BIN_COUNT + ((line[x + 1] >> 16) & 0xFF)];
+            ++odd[Green * BIN_COUNT + ((line[x + 1] >> 8) & 0xFF)];
+            ++odd[Blue * BIN_COUNT + (line[x + 1] & 0xFF)];
+            ++odd[Luma * BIN_COUNT + lumaLine[x + 1]];
+        }
+        if (x < tile.width()) {
+            ++even[Red * BIN_COUNT + ((line[x] >> 16) & 0xFF)];
+            ++even[Green * BIN_COUNT + ((line[x] >> 8) & 0xFF)];
+            ++even[Blue * BIN_COUNT + (line[x] & 0xFF)];
+            ++even[Luma * BIN_COUNT + lumaLine[x]];
+        }
+    }
+    for (int i = 0; i < TILE_COUNTS; ++i)
+        counts[i] = even[i] + odd[i];
+}
+
+Histogram::LumaFunction Histogram::lumaFunction(Compositing::InstructionSet instructionSet)
+{
+    if (!Compositing::isSupported(instructionSet))
+        return lumaScalar;
+
+    switch (instructionSet) {
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    case Compositing::InstructionSet::Sse41:
+        return lumaSse41;
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    case Compositing::InstructionSet::Avx2:
+        return lumaAvx2;
+#endif
+    default:
+        return lumaScalar;
+    }
+}
+
+void Histogram::lumaScalar(uchar* luma, const quint32* pixels, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const quint32 pixel = pixels[i];
+        luma[i] = uchar((LUMA_RED_WEIGHT * ((pixel >> 16) & 0xFF) + LUMA_GREEN_WEIGHT * ((pixel >> 8) & 0xFF)
+                         + LUMA_BLUE_WEIGHT * (pixel & 0xFF) + 128) >> 8);
+    }
+}
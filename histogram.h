@@ -0,0 +1,69 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "annotationscene.h"
+#include "compositing.h"
+#include "tiledimage.h"
+
+#include <QVector>
+
+// Red, green, blue and luma histogram of a tiled 32-bit image with the annotations composited over it.
+// Every tile is counted on its own, in parallel, and keeps its counts, which add up to the totals; an edit
+// only recounts the tiles of its dirty rect, subtracting their previous counts and adding the new ones,
+// so updating after a stroke costs the tiles under the stroke whatever the size of the photo.
+// Luma is computed with the Rec. 709 weights in fixed point; the SIMD kernels are bit-exact with the scalar
+// one and the widest one supported by the CPU is selected at runtime. Premultiplied pixels are counted as they are.
+class Histogram
+{
+public:
+    enum Channel {
+        Red,
+        Green,
+        Blue,
+        Luma,
+        ChannelCount
+    };
+    static const int BIN_COUNT = 256;
+
+    // Writes the luma of count pixels, one byte each.
+    using LumaFunction = void (*)(uchar* luma, const quint32* pixels, int count);
+
+    bool isNull() const { return m_image.isNull(); }
+    qint64 pixelCount() const { return qint64(m_image.width()) * m_image.height(); }
+
+    // The scene must outlive the histogram, or be set again before the next update. The image is the photo
+    // scaled by the scale, like a level of its pyramid, the annotations are composited at the same scale.
+    void setImage(const TiledImage& image, const AnnotationScene* scene = nullptr, int opacity = 255, qreal scale = 1.0);
+    // Takes an edited version of the current image, or of its annotations, and recounts the tiles of the dirty rect.
+    void updateImage(const TiledImage& image, const QRect& dirtyRect);
+    void setAnnotationOpacity(int opacity, const QRect& dirtyRect);
+    void clear();
+
+    // Returns the BIN_COUNT totals of the channel.
+    const quint64* counts(Channel channel) const { return m_totals.constData() + channel * BIN_COUNT; }
+    quint64 maxCount(Channel channel) const;
+
+    static LumaFunction lumaFunction(Compositing::InstructionSet instructionSet);
+    static void lumaScalar(uchar* luma, const quint32* pixels, int count);
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    static void lumaSse41(uchar* luma, const quint32* pixels, int count);
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    static void lumaAvx2(uchar* luma, const quint32* pixels, int count);
+#endif
+
+private:
+    // Counts the tiles in parallel and replaces their contributions to the totals.
+    void countTiles(const QVector<int>& tileIndices);
+    void countTile(int tileIndex, quint32* counts) const;
+
+    TiledImage m_image;
+    const AnnotationScene* m_scene { nullptr };
+    int m_opacity { 255 };
+    qreal m_scale { 1.0 };
+    // ChannelCount * BIN_COUNT counts per tile, in the order of the tiles.
+    QVector<quint32> m_tileCounts;
+    QVector<quint64> m_totals;
+};
+
+#endif // HISTOGRAM_H
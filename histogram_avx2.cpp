@@ -0,0 +1,32 @@
+#include "histogram.h"
+
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+
+#include <immintrin.h>
+
+#include <cstring>
+
+void Histogram::lumaAvx2(uchar* luma, const quint32* pixels, int count)
+{
+    // Blue, green, red and alpha weights of two pixels widened to 16-bit lanes, in both 128-bit lanes.
+    const __m256i weights = _mm256_setr_epi16(19, 183, 54, 0, 19, 183, 54, 0, 19, 183, 54, 0, 19, 183, 54, 0),
+            zero = _mm256_setzero_si256(),
+            rounding = _mm256_set1_epi32(128);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i pixelData = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i));
+        // Unpacking and the horizontal add work within 128-bit lanes, each lane ends with its four pixels in order.
+        const __m256i low = _mm256_madd_epi16(_mm256_unpacklo_epi8(pixelData, zero), weights),
+                high = _mm256_madd_epi16(_mm256_unpackhi_epi8(pixelData, zero), weights);
+        const __m256i sums = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(low, high), rounding), 8);
+        const __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(sums, zero), zero);
+        const int first = _mm_cvtsi128_si32(_mm256_castsi256_si128(bytes)),
+                second = _mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1));
+        memcpy(luma + i, &first, sizeof(first));
+        memcpy(luma + i + 4, &second, sizeof(second));
+    }
+    lumaScalar(luma + i, pixels + i, count - i);
+}
+
+#endif // QT_COMPILER_SUPPORTS_AVX2
@@ -0,0 +1,30 @@
+#include "histogram.h"
+
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+
+#include <smmintrin.h>
+
+#include <cstring>
+
+void Histogram::lumaSse41(uchar* luma, const quint32* pixels, int count)
+{
+    // Blue, green, red and alpha weights of two pixels widened to 16-bit lanes.
+    const __m128i weights = _mm_setr_epi16(19, 183, 54, 0, 19, 183, 54, 0),
+            zero = _mm_setzero_si128(),
+            rounding = _mm_set1_epi32(128);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i pixelData = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+        // Each multiply-add gives two partial sums per pixel, the horizontal add finishes them in pixel order.
+        const __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(pixelData, zero), weights),
+                high = _mm_madd_epi16(_mm_unpackhi_epi8(pixelData, zero), weights);
+        const __m128i sums = _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(low, high), rounding), 8);
+        const __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(sums, zero), zero);
+        const int packed = _mm_cvtsi128_si32(bytes);
+        memcpy(luma + i, &packed, sizeof(packed));
+    }
+    lumaScalar(luma + i, pixels + i, count - i);
+}
+
+#endif // QT_COMPILER_SUPPORTS_SSE4_1
@@ -0,0 +1,59 @@
+#include "histogramwidget.h"
+#include "constants.h"
+
+#include <QPainter>
+#include <QPainterPath>
+
+HistogramWidget::HistogramWidget(QWidget* parent)
+    : QWidget(parent)
+{}
+
+void HistogramWidget::setHistogram(const Histogram& histogram)
+{
+    m_counts.clear();
+    if (!histogram.isNull()) {
+        for (int channel = 0; channel < Histogram::ChannelCount; ++channel) {
+            const quint64* counts = histogram.counts(Histogram::Channel(channel));
+            m_counts.append(QVector<quint64>(counts, counts + Histogram::BIN_COUNT));
+            m_maxCounts[channel] = histogram.maxCount(Histogram::Channel(channel));
+        }
+    }
+    update();
+}
+
+void HistogramWidget::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event)
+
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(Constants::HISTOGRAM_BACKGROUND_COLOR));
+    if (m_counts.isEmpty())
+        return;
+
+    // Luma is drawn first, the colors add up over it where they overlap.
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    const QColor colors[Histogram::ChannelCount] {
+        QColor(Constants::HISTOGRAM_RED_COLOR),
+        QColor(Constants::HISTOGRAM_GREEN_COLOR),
+        QColor(Constants::HISTOGRAM_BLUE_COLOR),
+        QColor(Constants::HISTOGRAM_LUMA_COLOR)
+    };
+    const qreal binWidth = qreal(width()) / Histogram::BIN_COUNT;
+    for (const int channel : { Histogram::Luma, Histogram::Red, Histogram::Green, Histogram::Blue }) {
+        if (m_maxCounts[channel] == 0)
+            continue;
+
+        const quint64* counts = m_counts.constData() + channel * Histogram::BIN_COUNT;
+        QPainterPath path(QPointF(0.0, height()));
+        for (int bin = 0; bin < Histogram::BIN_COUNT; ++bin) {
+            const qreal top = height() - qreal(counts[bin]) / m_maxCounts[channel] * height();
+            path.lineTo(bin * binWidth, top);
+            path.lineTo((bin + 1) * binWidth, top);
+        }
+        path.lineTo(width(), height());
+        path.closeSubpath();
+
+        painter.setCompositionMode(channel == Histogram::Luma ? QPainter::CompositionMode_SourceOver : QPainter::CompositionMode_Plus);
+        painter.fillPath(path, colors[channel]);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef HISTOGRAMWIDGET_H
+#define HISTOGRAMWIDGET_H
+
+#include "histogram.h"
+
+#include <QWidget>
+
+// Plots the red, green, blue and luma curves of a histogram, each scaled to its highest bin.
+class HistogramWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    HistogramWidget(QWidget* parent = nullptr);
+    ~HistogramWidget() = default;
+
+    // Copies the totals of the histogram, the widget does not keep a reference to it.
+    void setHistogram(const Histogram& histogram);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    QVector<quint64> m_counts;
+    quint64 m_maxCounts[Histogram::ChannelCount] {};
+};
+
+#endif // HISTOGRAMWIDGET_H
@@ -0,0 +1,76 @@
+#include "iconcache.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtMath>
+
+namespace {
+
+const QString& cacheDirectory()
+{
+    static const QString directory = []() {
+        const QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/icons");
+        QDir().mkpath(path);
+        return path;
+    }();
+    return directory;
+}
+
+QImage render(const QByteArray& svg, const QSize& pixelSize)
+{
+    QBuffer buffer;
+    buffer.setData(svg);
+    QImageReader reader(&buffer, "svg");
+    if (pixelSize.isValid())
+        reader.setScaledSize(pixelSize);
+    return reader.read();
+}
+
+bool writeRaster(const QImage& image, const QString& filePath)
+{
+    QSaveFile file(filePath);
+    return !image.isNull() && file.open(QIODevice::WriteOnly) && image.save(&file, "png") && file.commit();
+}
+
+}
+
+namespace IconCache {
+
+QString rasterPath(const QString& resourcePath, const QSize& size, qreal devicePixelRatio)
+{
+    QFile resource(resourcePath);
+    if (!resource.open(QIODevice::ReadOnly))
+        return resourcePath;
+    const QByteArray svg = resource.readAll();
+
+    const QString hash = QString::fromLatin1(QCryptographicHash::hash(svg, QCryptographicHash::Md5).toHex().left(16));
+    const QString sizeName = size.isValid() ? QStringLiteral("%1x%2").arg(size.width()).arg(size.height()) : QStringLiteral("svg");
+    const QString basePath = QStringLiteral("%1/%2-%3-%4").arg(cacheDirectory(), QFileInfo(resourcePath).fileName(), sizeName, hash);
+    const QString filePath = basePath + QStringLiteral(".png");
+    const int pixelRatio = qMax(1, qCeil(devicePixelRatio));
+    const QString highDpiFilePath = QStringLiteral("%1@%2x.png").arg(basePath).arg(pixelRatio);
+
+    if (!QFileInfo::exists(filePath)) {
+        const QImage raster = render(svg, size);
+        if (!writeRaster(raster, filePath))
+            return resourcePath;
+    }
+    if (pixelRatio > 1 && !QFileInfo::exists(highDpiFilePath)) {
+        const QSize logicalSize = size.isValid() ? size : QImageReader(filePath).size();
+        writeRaster(render(svg, logicalSize * pixelRatio), highDpiFilePath);
+    }
+    return filePath;
+}
+
+QIcon icon(const QString& resourcePath, const QSize& size, qreal devicePixelRatio)
+{
+    return QIcon(rasterPath(resourcePath, size, devicePixelRatio));
+}
+
+}
@@ -0,0 +1,22 @@
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <QIcon>
+#include <QSize>
+#include <QString>
+
+// Rasters of the SVG icons of the resources, cached on disk per size and device pixel ratio. Rendering an SVG
+// parses it and runs the vector rasterizer, loading the PNG rendered by a previous run costs a fraction of it.
+// The rasters are named after a hash of the SVG, so an updated icon is never served from a stale raster.
+namespace IconCache {
+
+    // Returns the path of a PNG raster of the SVG resource at the logical size, the size of the SVG if the size
+    // is invalid, rendering it on the first use. The raster for the device pixel ratio is written next to it
+    // with the @Nx suffix QIcon and the stylesheets look for. Returns the resource path if it cannot be written.
+    QString rasterPath(const QString& resourcePath, const QSize& size = QSize(), qreal devicePixelRatio = 1.0);
+
+    QIcon icon(const QString& resourcePath, const QSize& size, qreal devicePixelRatio = 1.0);
+
+}
+
+#endif // ICONCACHE_H
@@ -0,0 +1,164 @@
+#include "imagepyramid.h"
+#include "compositing.h"
+#include "tiledimagestore.h"
+
+#include <QObject>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Rounded average of four 32-bit pixels, two channels at a time in 16-bit lanes.
+inline quint32 average4(quint32 a, quint32 b, quint32 c, quint32 d)
+{
+    const quint32 evenChannels = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF) + 0x00020002;
+    const quint32 oddChannels = ((a >> 8) & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF) + ((c >> 8) & 0x00FF00FF) + ((d >> 8) & 0x00FF00FF) + 0x00020002;
+    return ((evenChannels >> 2) & 0x00FF00FF) | (((oddChannels >> 2) & 0x00FF00FF) << 8);
+}
+
+}
+
+ImagePyramid::ImagePyramid(const QImage& image)
+{
+    if (image.isNull())
+        return;
+
+    QImage level = Compositing::toDestinationFormat(image);
+
+    m_levels.append(TiledImage(level));
+    while (level.width() > Constants::PHOTO_TILE_SIZE_PX || level.height() > Constants::PHOTO_TILE_SIZE_PX) {
+        level = halved(level);
+        m_levels.append(TiledImage(level));
+    }
+}
+
+ImagePyramid::ImagePyramid(const QVector<TiledImage>& levels)
+    : m_levels(levels)
+{}
+
+void ImagePyramid::setTile(int column, int row, const QImage& tile)
+{
+    if (isNull())
+        return;
+
+    m_levels[0].setTile(column, row, tile);
+    for (int level = 1; level < m_levels.size(); ++level) {
+        const TiledImage& finerLevel = m_levels.at(level - 1);
+        const int finerColumn = column & ~1, finerRow = row & ~1;
+        column /= 2;
+        row /= 2;
+
+        // A tile covers 2x2 tiles of the finer level, it is original if all of them are.
+        bool modified = false;
+        for (int y = finerRow; y < qMin(finerRow + 2, finerLevel.rows()); ++y) {
+            for (int x = finerColumn; x < qMin(finerColumn + 2, finerLevel.columns()); ++x)
+                modified = modified || finerLevel.isTileModified(x, y);
+        }
+        if (!modified) {
+            m_levels[level].setTile(column, row, QImage());
+            continue;
+        }
+
+        const QRect rect = m_levels.at(level).tileRect(column, row);
+        m_levels[level].setTile(column, row, halved(finerLevel.copy(QRect(rect.x() * 2, rect.y() * 2, rect.width() * 2, rect.height() * 2))));
+    }
+}
+
+void ImagePyramid::resetTiles()
+{
+    for (auto& level : m_levels)
+        level.resetTiles();
+}
+
+qint64 ImagePyramid::memoryUsage() const
+{
+    qint64 usage = 0;
+    for (const TiledImage& level : m_levels)
+        usage += level.memoryUsage();
+    return usage;
+}
+
+int ImagePyramid::levelForScale(qreal scale) const
+{
+    if (isNull() || scale >= 1.0)
+        return 0;
+
+    const int level = int(std::floor(std::log2(1.0 / scale)));
+    return qBound(0, level, levelCount() - 1);
+}
+
+QImage ImagePyramid::halved(const QImage& image)
+{
+    Q_ASSERT(image.depth() == 32);
+
+    const int width = (image.width() + 1) / 2,
+            height = (image.height() + 1) / 2,
+            lastX = image.width() - 1,
+            lastY = image.height() - 1;
+    QImage result(width, height, image.format());
+
+    for (int y = 0; y < height; ++y) {
+        const auto* line0 = reinterpret_cast<const quint32*>(image.constScanLine(2 * y));
+        const auto* line1 = reinterpret_cast<const quint32*>(image.constScanLine(qMin(2 * y + 1, lastY)));
+        auto* target = reinterpret_cast<quint32*>(result.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const int x0 = 2 * x, x1 = qMin(x0 + 1, lastX);
+            target[x] = average4(line0[x0], line0[x1], line1[x0], line1[x1]);
+        }
+    }
+    return result;
+}
+
+TiledPyramidBuilder::TiledPyramidBuilder(const QSize& size)
+    : m_size(size)
+    , m_memoryLevelSize(size)
+{
+    while (qint64(m_memoryLevelSize.width()) * m_memoryLevelSize.height() * 4 > qint64(Constants::OUT_OF_CORE_MEMORY_LEVEL_MB) * 1024 * 1024) {
+        m_memoryLevelSize = QSize((m_memoryLevelSize.width() + 1) / 2, (m_memoryLevelSize.height() + 1) / 2);
+        ++m_memoryLevel;
+    }
+}
+
+bool TiledPyramidBuilder::addBand(QImage band, QPoint position, QString* errorString)
+{
+    if (m_memoryLevelImage.isNull()) {
+        QSize levelSize = m_size;
+        for (int level = 0; level < m_memoryLevel; ++level) {
+            auto store = QSharedPointer<TiledImageStore>::create(levelSize, band.format());
+            if (!store->open(errorString))
+                return false;
+            m_stores.append(store);
+            levelSize = QSize((levelSize.width() + 1) / 2, (levelSize.height() + 1) / 2);
+        }
+        m_memoryLevelImage = QImage(m_memoryLevelSize, band.format());
+        if (m_memoryLevelImage.isNull()) {
+            if (errorString)
+                *errorString = QObject::tr("Not enough memory");
+            return false;
+        }
+    }
+
+    for (int level = 0; level < m_memoryLevel; ++level) {
+        m_stores[level]->write(band, position);
+        band = ImagePyramid::halved(band);
+        position = QPoint(position.x() / 2, position.y() / 2);
+    }
+    const QRect rect = QRect(position, band.size()).intersected(m_memoryLevelImage.rect());
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        std::memcpy(m_memoryLevelImage.scanLine(y) + rect.left() * 4,
+                    band.constScanLine(y - position.y()) + (rect.left() - position.x()) * 4, size_t(rect.width()) * 4);
+    }
+    return true;
+}
+
+ImagePyramid TiledPyramidBuilder::pyramid() const
+{
+    QVector<TiledImage> levels;
+    for (const auto& store : m_stores)
+        levels.append(TiledImage(store));
+    const ImagePyramid memoryPyramid(m_memoryLevelImage);
+    for (int level = 0; level < memoryPyramid.levelCount(); ++level)
+        levels.append(memoryPyramid.level(level));
+    return ImagePyramid(levels);
+}
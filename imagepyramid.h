@@ -0,0 +1,60 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include "tiledimage.h"
+
+#include <QVector>
+
+// Mipmap pyramid of a photo. Level 0 is the photo itself, every next level halves the previous one,
+// down to the level which fits into a single tile.
+class ImagePyramid
+{
+public:
+    ImagePyramid() = default;
+    explicit ImagePyramid(const QImage& image);
+    explicit ImagePyramid(const QVector<TiledImage>& levels);
+
+    bool isNull() const { return m_levels.isEmpty(); }
+    QSize size() const { return isNull() ? QSize() : m_levels.first().size(); }
+    int levelCount() const { return m_levels.size(); }
+    const TiledImage& level(int level) const { return m_levels.at(level); }
+
+    // Replaces a tile of the photo and rebuilds the tiles covering the same area on the coarser levels,
+    // a null image restores the original tile.
+    void setTile(int column, int row, const QImage& tile);
+    void resetTiles();
+    qint64 memoryUsage() const;
+
+    // Returns the coarsest level which still has at least one pixel per device pixel at the given scale.
+    int levelForScale(qreal scale) const;
+
+    // Averages every 2x2 block of a 32-bit image.
+    static QImage halved(const QImage& image);
+
+private:
+    QVector<TiledImage> m_levels;
+};
+
+// Assembles the pyramid of a photo too big for memory from bands of it. The levels bigger than the memory budget
+// go to out-of-core stores, each band is written into them and halved down into the first level which fits into
+// memory, the coarser levels are made from that one.
+class TiledPyramidBuilder
+{
+public:
+    explicit TiledPyramidBuilder(const QSize& size);
+
+    // Bands are halved down to the memory level, so they have to land on rows and columns divisible by this.
+    int bandAlignment() const { return 1 << m_memoryLevel; }
+    // The first band decides the pixel format of all the levels.
+    bool addBand(QImage band, QPoint position, QString* errorString = nullptr);
+    ImagePyramid pyramid() const;
+
+private:
+    QSize m_size;
+    int m_memoryLevel { 0 };
+    QSize m_memoryLevelSize;
+    QVector<QSharedPointer<TiledImageStore>> m_stores;
+    QImage m_memoryLevelImage;
+};
+
+#endif // IMAGEPYRAMID_H
@@ -0,0 +1,204 @@
+#include "jpegbandreader.h"
+
+#include <QFile>
+#include <QObject>
+#include <QSysInfo>
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+namespace {
+
+const int SOURCE_BUFFER_SIZE = 64 * 1024;
+
+// Reports the libjpeg errors by jumping back to the decoder call which failed, instead of exiting.
+struct ErrorManager
+{
+    jpeg_error_mgr manager;
+    std::jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+// Feeds libjpeg from a QFile, so the paths are not limited to the local 8-bit encoding.
+struct SourceManager
+{
+    jpeg_source_mgr manager;
+    QFile* file;
+    JOCTET buffer[SOURCE_BUFFER_SIZE];
+};
+
+void exitOnError(j_common_ptr info)
+{
+    auto* error = reinterpret_cast<ErrorManager*>(info->err);
+    info->err->format_message(info, error->message);
+    std::longjmp(error->jump, 1);
+}
+
+void ignoreMessage(j_common_ptr)
+{}
+
+void initSource(j_decompress_ptr)
+{}
+
+boolean fillInputBuffer(j_decompress_ptr info)
+{
+    auto* source = reinterpret_cast<SourceManager*>(info->src);
+    const qint64 size = source->file->read(reinterpret_cast<char*>(source->buffer), SOURCE_BUFFER_SIZE);
+    // A truncated photo is an error, the missing lines would silently end up gray.
+    if (size <= 0)
+        ERREXIT(info, JERR_INPUT_EOF);
+
+    source->manager.next_input_byte = source->buffer;
+    source->manager.bytes_in_buffer = size_t(size);
+    return TRUE;
+}
+
+void skipInputData(j_decompress_ptr info, long count)
+{
+    auto* source = reinterpret_cast<SourceManager*>(info->src);
+    if (count <= 0)
+        return;
+
+    if (size_t(count) <= source->manager.bytes_in_buffer) {
+        source->manager.next_input_byte += count;
+        source->manager.bytes_in_buffer -= size_t(count);
+        return;
+    }
+    const qint64 skipped = count - qint64(source->manager.bytes_in_buffer);
+    source->manager.bytes_in_buffer = 0;
+    if (!source->file->seek(source->file->pos() + skipped))
+        ERREXIT(info, JERR_INPUT_EOF);
+}
+
+void termSource(j_decompress_ptr)
+{}
+
+}
+
+struct JpegBandReader::Decoder
+{
+    jpeg_decompress_struct info;
+    ErrorManager error;
+    SourceManager source;
+    QFile file;
+    bool created { false };
+    QByteArray iccProfile;
+
+    // The calls into libjpeg are kept in functions without objects to destroy, the error jump skips their frames.
+    bool start();
+    bool readScanlines(QImage& band);
+};
+
+bool JpegBandReader::Decoder::start()
+{
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = exitOnError;
+    error.manager.output_message = ignoreMessage;
+    error.message[0] = '\0';
+    if (setjmp(error.jump))
+        return false;
+
+    jpeg_create_decompress(&info);
+    created = true;
+    source.file = &file;
+    source.manager.init_source = initSource;
+    source.manager.fill_input_buffer = fillInputBuffer;
+    source.manager.skip_input_data = skipInputData;
+    source.manager.resync_to_restart = jpeg_resync_to_restart;
+    source.manager.term_source = termSource;
+    source.manager.next_input_byte = nullptr;
+    source.manager.bytes_in_buffer = 0;
+    info.src = &source.manager;
+
+    jpeg_save_markers(&info, JPEG_APP0 + 2, 0xFFFF);
+    jpeg_read_header(&info, TRUE);
+    if (info.jpeg_color_space == JCS_CMYK || info.jpeg_color_space == JCS_YCCK)
+        ERREXIT(&info, JERR_CONVERSION_NOTIMPL);
+
+    JOCTET* profile = nullptr;
+    unsigned int profileSize = 0;
+    if (jpeg_read_icc_profile(&info, &profile, &profileSize)) {
+        iccProfile = QByteArray(reinterpret_cast<const char*>(profile), int(profileSize));
+        std::free(profile);
+    }
+
+    // Decoded straight into the memory layout of Format_RGB32.
+    info.out_color_space = QSysInfo::ByteOrder == QSysInfo::LittleEndian ? JCS_EXT_BGRX : JCS_EXT_XRGB;
+    jpeg_start_decompress(&info);
+    return true;
+}
+
+bool JpegBandReader::Decoder::readScanlines(QImage& band)
+{
+    if (setjmp(error.jump))
+        return false;
+
+    for (int y = 0; y < band.height();) {
+        JSAMPROW line = band.scanLine(y);
+        const JDIMENSION readLines = jpeg_read_scanlines(&info, &line, 1);
+        if (readLines == 0)
+            ERREXIT(&info, JERR_INPUT_EOF);
+        y += int(readLines);
+    }
+    return true;
+}
+
+JpegBandReader::JpegBandReader(const QString& filePath)
+    : m_decoder(new Decoder)
+{
+    m_decoder->file.setFileName(filePath);
+}
+
+JpegBandReader::~JpegBandReader()
+{
+    if (m_decoder->created)
+        jpeg_destroy_decompress(&m_decoder->info);
+}
+
+bool JpegBandReader::open(QString* errorString)
+{
+    if (!m_decoder->file.open(QIODevice::ReadOnly)) {
+        if (errorString)
+            *errorString = m_decoder->file.errorString();
+        return false;
+    }
+    if (!m_decoder->start()) {
+        if (errorString)
+            *errorString = QString::fromLocal8Bit(m_decoder->error.message);
+        return false;
+    }
+
+    m_size = QSize(int(m_decoder->info.output_width), int(m_decoder->info.output_height));
+    if (!m_decoder->iccProfile.isEmpty())
+        m_colorSpace = QColorSpace::fromIccProfile(m_decoder->iccProfile);
+    return true;
+}
+
+QImage JpegBandReader::readBand(int height, QString* errorString)
+{
+    if (m_size.isEmpty())
+        return QImage();
+
+    const int lines = qMin(height, int(m_decoder->info.output_height - m_decoder->info.output_scanline));
+    if (lines <= 0)
+        return QImage();
+
+    QImage band(m_size.width(), lines, QImage::Format_RGB32);
+    if (band.isNull()) {
+        if (errorString)
+            *errorString = QObject::tr("Not enough memory");
+        return QImage();
+    }
+    if (!m_decoder->readScanlines(band)) {
+        if (errorString)
+            *errorString = QString::fromLocal8Bit(m_decoder->error.message);
+        return QImage();
+    }
+    if (m_colorSpace.isValid())
+        band.setColorSpace(m_colorSpace);
+    return band;
+}
@@ -0,0 +1,36 @@
+#ifndef JPEGBANDREADER_H
+#define JPEGBANDREADER_H
+
+#include <QColorSpace>
+#include <QImage>
+#include <QScopedPointer>
+
+// Decodes a JPEG photo with libjpeg from the top down, a band of scanlines at a time. Each scanline is decoded
+// once, so reading a photo too big for memory takes a time linear in its size, unlike decoding a clip rect per band.
+// The bands are in the stored orientation, the EXIF orientation is left to the caller.
+class JpegBandReader
+{
+    Q_DISABLE_COPY(JpegBandReader)
+
+public:
+    JpegBandReader(const QString& filePath);
+    ~JpegBandReader();
+
+    // Reads the header and starts the decode, fails for the files which are not JPEG or not decodable to RGB.
+    bool open(QString* errorString = nullptr);
+    QSize size() const { return m_size; }
+    // Color space of the embedded ICC profile, invalid if there is none.
+    QColorSpace colorSpace() const { return m_colorSpace; }
+    // Decodes the next lines into a Format_RGB32 image, shorter than the height at the bottom of the photo.
+    // Returns a null image on error or once all the lines are decoded.
+    QImage readBand(int height, QString* errorString = nullptr);
+
+private:
+    struct Decoder;
+
+    QScopedPointer<Decoder> m_decoder;
+    QSize m_size;
+    QColorSpace m_colorSpace;
+};
+
+#endif // JPEGBANDREADER_H
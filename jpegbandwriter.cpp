@@ -0,0 +1,176 @@
+#include "jpegbandwriter.h"
+
+#include <QIODevice>
+#include <QSysInfo>
+
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+namespace {
+
+const int DESTINATION_BUFFER_SIZE = 64 * 1024;
+
+// Reports the libjpeg errors by jumping back to the encoder call which failed, instead of exiting.
+struct ErrorManager
+{
+    jpeg_error_mgr manager;
+    std::jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+// Writes the encoded photo to a QIODevice, a QSaveFile keeps the save atomic.
+struct DestinationManager
+{
+    jpeg_destination_mgr manager;
+    QIODevice* device;
+    JOCTET buffer[DESTINATION_BUFFER_SIZE];
+};
+
+void exitOnError(j_common_ptr info)
+{
+    auto* error = reinterpret_cast<ErrorManager*>(info->err);
+    info->err->format_message(info, error->message);
+    std::longjmp(error->jump, 1);
+}
+
+void ignoreMessage(j_common_ptr)
+{}
+
+void initDestination(j_compress_ptr info)
+{
+    auto* destination = reinterpret_cast<DestinationManager*>(info->dest);
+    destination->manager.next_output_byte = destination->buffer;
+    destination->manager.free_in_buffer = DESTINATION_BUFFER_SIZE;
+}
+
+boolean emptyOutputBuffer(j_compress_ptr info)
+{
+    // The whole buffer is written, whatever the free size says.
+    auto* destination = reinterpret_cast<DestinationManager*>(info->dest);
+    if (destination->device->write(reinterpret_cast<const char*>(destination->buffer), DESTINATION_BUFFER_SIZE) != DESTINATION_BUFFER_SIZE)
+        ERREXIT(info, JERR_FILE_WRITE);
+
+    destination->manager.next_output_byte = destination->buffer;
+    destination->manager.free_in_buffer = DESTINATION_BUFFER_SIZE;
+    return TRUE;
+}
+
+void termDestination(j_compress_ptr info)
+{
+    auto* destination = reinterpret_cast<DestinationManager*>(info->dest);
+    const qint64 size = DESTINATION_BUFFER_SIZE - qint64(destination->manager.free_in_buffer);
+    if (size > 0 && destination->device->write(reinterpret_cast<const char*>(destination->buffer), size) != size)
+        ERREXIT(info, JERR_FILE_WRITE);
+}
+
+}
+
+struct JpegBandWriter::Encoder
+{
+    jpeg_compress_struct info;
+    ErrorManager error;
+    DestinationManager destination;
+    bool created { false };
+
+    // The calls into libjpeg are kept in functions without objects to destroy, the error jump skips their frames.
+    bool start(int width, int height, int quality);
+    bool writeScanlines(const QImage& band);
+    bool finish();
+};
+
+bool JpegBandWriter::Encoder::start(int width, int height, int quality)
+{
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = exitOnError;
+    error.manager.output_message = ignoreMessage;
+    error.message[0] = '\0';
+    if (setjmp(error.jump))
+        return false;
+
+    jpeg_create_compress(&info);
+    created = true;
+    destination.manager.init_destination = initDestination;
+    destination.manager.empty_output_buffer = emptyOutputBuffer;
+    destination.manager.term_destination = termDestination;
+    info.dest = &destination.manager;
+
+    // Encoded straight from the memory layout of Format_RGB32.
+    info.image_width = JDIMENSION(width);
+    info.image_height = JDIMENSION(height);
+    info.input_components = 4;
+    info.in_color_space = QSysInfo::ByteOrder == QSysInfo::LittleEndian ? JCS_EXT_BGRX : JCS_EXT_XRGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    jpeg_start_compress(&info, TRUE);
+    return true;
+}
+
+bool JpegBandWriter::Encoder::writeScanlines(const QImage& band)
+{
+    if (setjmp(error.jump))
+        return false;
+
+    for (int y = 0; y < band.height(); ++y) {
+        JSAMPROW line = const_cast<uchar*>(band.constScanLine(y));
+        if (jpeg_write_scanlines(&info, &line, 1) != 1)
+            ERREXIT(&info, JERR_FILE_WRITE);
+    }
+    return true;
+}
+
+bool JpegBandWriter::Encoder::finish()
+{
+    if (setjmp(error.jump))
+        return false;
+
+    jpeg_finish_compress(&info);
+    return true;
+}
+
+JpegBandWriter::JpegBandWriter(QIODevice* device)
+    : m_encoder(new Encoder)
+{
+    m_encoder->destination.device = device;
+}
+
+JpegBandWriter::~JpegBandWriter()
+{
+    if (m_encoder->created)
+        jpeg_destroy_compress(&m_encoder->info);
+}
+
+bool JpegBandWriter::open(const QSize& size, int quality, QString* errorString)
+{
+    if (!m_encoder->start(size.width(), size.height(), qBound(0, quality, 100))) {
+        if (errorString)
+            *errorString = QString::fromLocal8Bit(m_encoder->error.message);
+        return false;
+    }
+    return true;
+}
+
+bool JpegBandWriter::writeBand(const QImage& band, QString* errorString)
+{
+    // Premultiplied pixels already are over black, their alpha is dropped as it is.
+    const QImage lines = band.format() == QImage::Format_RGB32 || band.format() == QImage::Format_ARGB32_Premultiplied
+            ? band : band.convertToFormat(QImage::Format_RGB32);
+    if (!m_encoder->writeScanlines(lines)) {
+        if (errorString)
+            *errorString = QString::fromLocal8Bit(m_encoder->error.message);
+        return false;
+    }
+    return true;
+}
+
+bool JpegBandWriter::finish(QString* errorString)
+{
+    if (!m_encoder->finish()) {
+        if (errorString)
+            *errorString = QString::fromLocal8Bit(m_encoder->error.message);
+        return false;
+    }
+    return true;
+}
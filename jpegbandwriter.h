@@ -0,0 +1,33 @@
+#ifndef JPEGBANDWRITER_H
+#define JPEGBANDWRITER_H
+
+#include <QImage>
+#include <QScopedPointer>
+
+class QIODevice;
+
+// Encodes a JPEG photo with libjpeg from the top down, a band of scanlines at a time, so a photo too big for memory
+// is saved without ever being flattened whole.
+class JpegBandWriter
+{
+    Q_DISABLE_COPY(JpegBandWriter)
+
+public:
+    // The device must stay open until the writer is finished.
+    JpegBandWriter(QIODevice* device);
+    ~JpegBandWriter();
+
+    // Writes the header of a photo of the size, the quality in [0, 100].
+    bool open(const QSize& size, int quality, QString* errorString = nullptr);
+    // Encodes the 32-bit band as the lines below the ones written so far. The alpha channel is dropped.
+    bool writeBand(const QImage& band, QString* errorString = nullptr);
+    // Writes the end of the photo once all its lines are written.
+    bool finish(QString* errorString = nullptr);
+
+private:
+    struct Encoder;
+
+    QScopedPointer<Encoder> m_encoder;
+};
+
+#endif // JPEGBANDWRITER_H
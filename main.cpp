@@ -1,13 +1,83 @@
 #include "photoeditorwindow.h"
+#include "batchprocessor.h"
+#include "profiler.h"
+#include "recoveryjournal.h"
 #include "constants.h"
 
 #include <QApplication>
 #include <QLocale>
+#include <QTextStream>
+#include <QTimer>
 #include <QTranslator>
 
+#include <cstring>
+
+namespace {
+
+const char* const PROFILE_STARTUP_OPTION = "--profile-startup";
+
+// Waits for the first frame of the window, then for the event loop to get idle, which is when the window
+// starts handling input. Prints the startup phases measured so far and quits.
+class StartupProfiler : public QObject
+{
+public:
+    bool eventFilter(QObject* watched, QEvent* event) override
+    {
+        if (event->type() == QEvent::Paint && !m_painted) {
+            m_painted = true;
+            QTimer::singleShot(0, this, [this]() {
+                report();
+            });
+        }
+        return QObject::eventFilter(watched, event);
+    }
+
+private:
+    void report()
+    {
+        const qint64 interactiveNs = Profiler::now();
+        const QVector<Profiler::Span> spans = Profiler::spans("startup");
+        QTextStream stream(stdout);
+        for (const Profiler::Span& span : spans) {
+            // Phases nested into others are indented under them.
+            int depth = 0;
+            for (const Profiler::Span& other : spans) {
+                depth += &other != &span && other.startNs <= span.startNs
+                        && other.startNs + other.durationNs >= span.startNs + span.durationNs;
+            }
+            stream << QString("%1%2 %3 ms").arg(QString(depth * 2, ' ')).arg(QString::fromLatin1(span.name), -32 + depth * 2)
+                      .arg(span.durationNs / 1e6, 8, 'f', 1) << Qt::endl;
+        }
+        stream << QString("%1 %2 ms").arg(QStringLiteral("time to interactive"), -32).arg(interactiveNs / 1e6, 8, 'f', 1) << Qt::endl;
+        QCoreApplication::quit();
+    }
+
+    bool m_painted { false };
+};
+
+bool isStartupProfileInvocation(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], PROFILE_STARTUP_OPTION) == 0)
+            return true;
+    }
+    return false;
+}
+
+}
+
 int main(int argc, char *argv[])
 {
+    if (BatchProcessor::isBatchInvocation(argc, argv))
+        return BatchProcessor::exec(argc, argv);
+
+    // The startup phases are measured from here, --profile-startup prints them once the window is interactive.
+    Profiler::now();
+    const bool profileStartup = isStartupProfileInvocation(argc, argv);
+
+    Profiler::ScopedTimer applicationTimer("create application", "startup");
     QApplication a(argc, argv);
+    applicationTimer.finish();
 
     // Software change pixel font size, some controls font size doesn't change automatically on high DPI.
     QFont font = a.font();
@@ -15,6 +85,7 @@ int main(int argc, char *argv[])
     font.setPixelSize(qRound(Constants::APP_FONT_SIZE_PX * fontMetrics.fontDpi() / Constants::LOGICAL_DPI_REF_VALUE));
     a.setFont(font);
 
+    Profiler::ScopedTimer translatorTimer("load translations", "startup");
     QTranslator translator;
     const QStringList uiLanguages = QLocale::system().uiLanguages();
     for (const QString &locale : uiLanguages) {
@@ -24,7 +95,28 @@ int main(int argc, char *argv[])
             break;
         }
     }
+    translatorTimer.finish();
+
+    StartupProfiler startupProfiler;
+    if (profileStartup)
+        a.installEventFilter(&startupProfiler);
+
+    Profiler::ScopedTimer windowTimer("create window", "startup");
     PhotoEditorWindow w;
+    windowTimer.finish();
+    Profiler::ScopedTimer showTimer("show window", "startup");
     w.show();
+    showTimer.finish();
+
+    // The most recent journal left by a session which crashed is offered for recovery once the window shows,
+    // the older ones are offered by the next starts.
+    if (!profileStartup) {
+        const QStringList journals = RecoveryJournal::orphanedJournals();
+        if (!journals.isEmpty()) {
+            QTimer::singleShot(0, &w, [&w, journalPath = journals.first()]() {
+                w.recoverSession(journalPath);
+            });
+        }
+    }
     return a.exec();
 }
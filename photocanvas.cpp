@@ -0,0 +1,803 @@
+#include "photocanvas.h"
+#include "profiler.h"
+#include "resampler.h"
+#include "constants.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QTabletEvent>
+#include <QKeyEvent>
+#include <QLineF>
+#include <QLoggingCategory>
+#include <QScrollArea>
+#include <QScrollBar>
+#include <QtConcurrent>
+#include <QtMath>
+
+#include <numeric>
+
+Q_LOGGING_CATEGORY(lcInput, "photoeditor.input")
+
+namespace {
+
+// Filter of the tiles resampled to the device pixels of the canvas.
+const Resampler::Filter SCALED_TILE_FILTER = Resampler::Filter::Lanczos3;
+
+}
+
+PhotoCanvas::PhotoCanvas(QWidget* parent)
+    : QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    m_inputClock.start();
+    setFocusPolicy(Qt::ClickFocus);
+    m_tileCache.setMaxCost(Constants::PHOTO_TILE_CACHE_SIZE_KB);
+    m_scaledTileCache.setMaxCost(Constants::PHOTO_SCALED_TILE_CACHE_SIZE_KB);
+}
+
+void PhotoCanvas::setPhoto(const QImage& photo)
+{
+    setPyramid(ImagePyramid(photo));
+}
+
+void PhotoCanvas::setPyramid(const ImagePyramid& pyramid)
+{
+    // Cached pixmaps may share the pixels of the previous pyramid, drop them first.
+    m_tileCache.clear();
+    m_scaledTileCache.clear();
+    m_pyramid = pyramid;
+    m_photoSize = pyramid.size();
+    m_preview = false;
+    m_summedAreaTable.setImage(pyramid.isNull() ? TiledImage() : pyramid.level(0));
+    hideLoupe();
+    resize(sizeHint());
+    update();
+}
+
+void PhotoCanvas::updatePyramid(const ImagePyramid& pyramid, const QRect& dirtyRect)
+{
+    m_pyramid = pyramid;
+    m_summedAreaTable.updateImage(m_pyramid.level(0), dirtyRect);
+    for (int level = 0; level < m_pyramid.levelCount(); ++level) {
+        const QRect levelRect(QPoint(dirtyRect.left() >> level, dirtyRect.top() >> level),
+                              QPoint(dirtyRect.right() >> level, dirtyRect.bottom() >> level));
+        const QRect range = m_pyramid.level(level).tileRange(levelRect);
+        // The resampled tiles reach into their neighbours by the margin of the filter.
+        const int margin = scaledTileMargin(level);
+        const QRect scaledRange = m_pyramid.level(level).tileRange(levelRect.adjusted(-margin, -margin, margin, margin));
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            for (int column = range.left(); column <= range.right(); ++column)
+                m_tileCache.remove(tileKey(level, column, row));
+        }
+        for (int row = scaledRange.top(); row <= scaledRange.bottom(); ++row) {
+            for (int column = scaledRange.left(); column <= scaledRange.right(); ++column)
+                m_scaledTileCache.remove(tileKey(level, column, row));
+        }
+    }
+
+    update(mapFromPhoto(dirtyRect));
+}
+
+void PhotoCanvas::setPreview(const QImage& preview, const QSize& photoSize)
+{
+    m_tileCache.clear();
+    m_scaledTileCache.clear();
+    m_pyramid = ImagePyramid(preview);
+    m_photoSize = photoSize;
+    m_preview = true;
+    m_selectedAnnotation = 0;
+    m_summedAreaTable.setImage(m_pyramid.isNull() ? TiledImage() : m_pyramid.level(0));
+    hideLoupe();
+    resize(sizeHint());
+    update();
+}
+
+void PhotoCanvas::setAnnotationScene(const AnnotationScene* scene)
+{
+    m_annotationScene = scene;
+    m_selectedAnnotation = 0;
+    update();
+}
+
+void PhotoCanvas::updateAnnotations(const QRectF& dirtyRect)
+{
+    if (m_selectedAnnotation && !(m_annotationScene && m_annotationScene->contains(m_selectedAnnotation)))
+        m_selectedAnnotation = 0;
+    update(mapFromPhoto(dirtyRect));
+}
+
+void PhotoCanvas::setAnnotationOpacity(int opacity)
+{
+    opacity = qBound(0, opacity, 255);
+    if (opacity == m_annotationOpacity)
+        return;
+
+    m_annotationOpacity = opacity;
+    if (m_annotationScene && !m_annotationScene->isEmpty())
+        update();
+}
+
+void PhotoCanvas::setSelectedAnnotation(quint64 id)
+{
+    if (id == m_selectedAnnotation || !m_annotationScene)
+        return;
+
+    for (const quint64 changedId : { m_selectedAnnotation, id }) {
+        if (changedId)
+            update(mapFromPhoto(m_annotationScene->annotation(changedId).boundingRect()));
+    }
+    m_selectedAnnotation = id;
+}
+
+void PhotoCanvas::setPipetteActive(bool active)
+{
+    if (active == m_pipetteActive)
+        return;
+
+    // Hovering only samples while the pipette is active, drawing has no use for moves without a button.
+    m_pipetteActive = active;
+    setMouseTracking(active);
+    if (active) {
+        setCursor(Qt::CrossCursor);
+        // Takes the focus, so Escape reaches the canvas.
+        setFocus();
+    } else {
+        unsetCursor();
+        hideLoupe();
+    }
+}
+
+void PhotoCanvas::setPipetteSampleSize(int size)
+{
+    m_pipetteSampleSize = qMax(1, size);
+}
+
+void PhotoCanvas::setZoom(qreal zoom, const QPoint& anchor)
+{
+    zoom = qBound(Constants::PHOTO_ZOOM_MIN, zoom, Constants::PHOTO_ZOOM_MAX);
+    if (qFuzzyCompare(zoom, m_zoom))
+        return;
+
+    // Keep the anchor point under the same viewport position, the viewport center by default.
+    QScrollArea* area = scrollArea();
+    QPoint canvasAnchor = anchor, viewportAnchor;
+    if (area) {
+        if (canvasAnchor.isNull())
+            canvasAnchor = mapFrom(area->viewport(), area->viewport()->rect().center());
+        viewportAnchor = mapTo(area->viewport(), canvasAnchor);
+    }
+
+    const qreal ratio = zoom / m_zoom;
+    m_zoom = zoom;
+    resize(sizeHint());
+
+    if (area) {
+        area->horizontalScrollBar()->setValue(qRound(canvasAnchor.x() * ratio) - viewportAnchor.x());
+        area->verticalScrollBar()->setValue(qRound(canvasAnchor.y() * ratio) - viewportAnchor.y());
+    }
+    update();
+    emit zoomChanged(m_zoom);
+}
+
+void PhotoCanvas::zoomIn()
+{
+    setZoom(m_zoom * Constants::PHOTO_ZOOM_STEP);
+}
+
+void PhotoCanvas::zoomOut()
+{
+    setZoom(m_zoom / Constants::PHOTO_ZOOM_STEP);
+}
+
+void PhotoCanvas::zoomToFit()
+{
+    if (m_pyramid.isNull())
+        return;
+
+    qreal zoom = 1.0;
+    if (QScrollArea* area = scrollArea()) {
+        const QSize viewportSize = area->viewport()->size();
+        zoom = qMin(zoom, qMin(qreal(viewportSize.width()) / m_photoSize.width(), qreal(viewportSize.height()) / m_photoSize.height()));
+    }
+    m_zoom = qBound(Constants::PHOTO_ZOOM_MIN, zoom, Constants::PHOTO_ZOOM_MAX);
+    resize(sizeHint());
+    update();
+    emit zoomChanged(m_zoom);
+}
+
+QSize PhotoCanvas::sizeHint() const
+{
+    if (m_pyramid.isNull())
+        return QSize();
+
+    return QSize(qMax(1, qRound(m_photoSize.width() * m_zoom)), qMax(1, qRound(m_photoSize.height() * m_zoom)));
+}
+
+void PhotoCanvas::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(this);
+    const QRect exposedRect = event->rect();
+    painter.fillRect(exposedRect, QColor(Constants::PHOTO_ZONE_COLOR));
+    if (m_pyramid.isNull())
+        return;
+
+    Profiler::ScopedTimer paintTimer("paint", "paint");
+
+    // A preview pyramid is smaller than the photo, pick the level by the actual scale of its base.
+    const int levelIndex = m_pyramid.levelForScale(qreal(width()) / m_pyramid.size().width());
+    const TiledImage& level = m_pyramid.level(levelIndex);
+    const qreal scaleX = qreal(width()) / level.width(),
+            scaleY = qreal(height()) / level.height();
+
+    const QRect levelRect = QRectF(exposedRect.x() / scaleX, exposedRect.y() / scaleY,
+                                   exposedRect.width() / scaleX, exposedRect.height() / scaleY).toAlignedRect();
+    const QRect range = level.tileRange(levelRect);
+    if (scaleX < 1.0) {
+        // Shrunk tiles are resampled to the device pixels they cover, drawn as they are.
+        paintScaledTiles(painter, levelIndex, range);
+    } else {
+        fetchTiles(levelIndex, range);
+        for (int row = range.top(); row <= range.bottom(); ++row) {
+            for (int column = range.left(); column <= range.right(); ++column) {
+                // Snap tile edges to device pixels, so the neighbour tiles meet without seams.
+                const QRect tileRect = level.tileRect(column, row);
+                const int left = qFloor(tileRect.left() * scaleX),
+                        top = qFloor(tileRect.top() * scaleY),
+                        right = qFloor((tileRect.right() + 1) * scaleX),
+                        bottom = qFloor((tileRect.bottom() + 1) * scaleY);
+                painter.drawPixmap(QRect(left, top, right - left, bottom - top), tilePixmap(levelIndex, column, row));
+            }
+        }
+    }
+
+    if (!m_drawnAnnotation.isNull() && (m_drawnAnnotation.type() == Annotation::Blur || m_drawnAnnotation.type() == Annotation::Pixelate))
+        paintRedactionPreview(painter, levelIndex, levelRect);
+
+    // Annotations are in photo coordinates, only the ones indexed in the exposed cells are visited.
+    const QRectF exposedPhotoRect(mapToPhoto(exposedRect.topLeft()), mapToPhoto(exposedRect.bottomRight() + QPoint(1, 1)));
+    const qreal annotationOpacity = m_annotationOpacity / 255.0;
+    if (m_annotationScene && m_annotationOpacity > 0 && m_annotationOpacity < 255) {
+        // The opacity applies to the annotations as one layer, overlapping annotations do not show through each other.
+        const qreal pixelRatio = devicePixelRatioF();
+        QImage layer(exposedRect.size() * pixelRatio, QImage::Format_ARGB32_Premultiplied);
+        layer.setDevicePixelRatio(pixelRatio);
+        layer.fill(Qt::transparent);
+        QPainter layerPainter(&layer);
+        layerPainter.setRenderHint(QPainter::Antialiasing, true);
+        layerPainter.translate(-exposedRect.topLeft());
+        layerPainter.scale(scale(), scale());
+        m_annotationScene->paint(&layerPainter, exposedPhotoRect);
+        layerPainter.end();
+        painter.setOpacity(annotationOpacity);
+        painter.drawImage(exposedRect.topLeft(), layer);
+        painter.setOpacity(1.0);
+    }
+
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.scale(scale(), scale());
+    if (m_annotationScene) {
+        if (m_annotationOpacity == 255)
+            m_annotationScene->paint(&painter, exposedPhotoRect);
+        const Annotation selection = m_annotationScene->annotation(m_selectedAnnotation);
+        if (!selection.isNull()) {
+            QPen selectionPen(QColor(Constants::ANNOTATION_SELECTION_COLOR), 1.0, Qt::DashLine);
+            selectionPen.setCosmetic(true);
+            painter.setPen(selectionPen);
+            painter.setBrush(Qt::NoBrush);
+            painter.drawRect(selection.boundingRect());
+        }
+    }
+    if (!m_drawnAnnotation.isNull()) {
+        flushPendingPoints();
+        if (m_drawnAnnotation.type() == Annotation::Blur || m_drawnAnnotation.type() == Annotation::Pixelate) {
+            // The rubber band of a redaction only outlines the preview, it is not an annotation.
+            QPen outlinePen(QColor(Constants::ANNOTATION_SELECTION_COLOR), 1.0, Qt::DashLine);
+            outlinePen.setCosmetic(true);
+            painter.setPen(outlinePen);
+            painter.setBrush(Qt::NoBrush);
+            painter.drawPath(m_drawnAnnotation.path());
+        } else {
+            painter.setOpacity(annotationOpacity);
+            m_drawnAnnotation.paint(&painter, exposedPhotoRect);
+        }
+    }
+    if (!m_loupeRect.isNull() && m_loupeRect.intersects(exposedRect)) {
+        painter.resetTransform();
+        painter.setOpacity(1.0);
+        paintLoupe(painter);
+    }
+
+    // Latency is measured from the delivery of the first input event not painted yet to the end of the paint,
+    // the compositor adds its own frame on top of it.
+    if (m_pendingSinceNs >= 0) {
+        const qint64 latencyNs = m_inputClock.nsecsElapsed() - m_pendingSinceNs;
+        m_latencySumNs += latencyNs;
+        m_latencyMaxNs = qMax(m_latencyMaxNs, latencyNs);
+        ++m_latencySamples;
+        m_pendingSinceNs = -1;
+    }
+
+    // The scroll area moves the canvas to pan, a zoom resizes it.
+    const bool panning = geometry().size() == m_lastPaintGeometry.size() && geometry().topLeft() != m_lastPaintGeometry.topLeft();
+    m_lastPaintGeometry = geometry();
+    Profiler::recordFrame(paintTimer.finish(), panning);
+}
+
+void PhotoCanvas::wheelEvent(QWheelEvent* event)
+{
+    if (!(event->modifiers() & Qt::ControlModifier) || m_pyramid.isNull()) {
+        event->ignore();
+        return;
+    }
+
+    const qreal steps = event->angleDelta().y() / 120.0;
+    setZoom(m_zoom * qPow(Constants::PHOTO_ZOOM_STEP, steps), event->position().toPoint());
+    event->accept();
+}
+
+void PhotoCanvas::mousePressEvent(QMouseEvent* event)
+{
+    if (m_pipetteActive && !m_pyramid.isNull()) {
+        if (event->button() == Qt::LeftButton) {
+            samplePipette(event->localPos());
+            if (m_pipetteColor.isValid())
+                emit colorPicked(m_pipetteColor);
+        }
+        return;
+    }
+    if (event->button() != Qt::LeftButton || !beginStroke(event->localPos(), event->modifiers()))
+        QWidget::mousePressEvent(event);
+}
+
+void PhotoCanvas::mouseMoveEvent(QMouseEvent* event)
+{
+    if (m_pipetteActive && !m_pyramid.isNull())
+        samplePipette(event->localPos());
+    else if (m_drawnAnnotation.isNull())
+        QWidget::mouseMoveEvent(event);
+    else
+        continueStroke(event->localPos());
+}
+
+void PhotoCanvas::mouseReleaseEvent(QMouseEvent* event)
+{
+    if (event->button() != Qt::LeftButton || m_drawnAnnotation.isNull())
+        QWidget::mouseReleaseEvent(event);
+    else
+        endStroke();
+}
+
+void PhotoCanvas::tabletEvent(QTabletEvent* event)
+{
+    // Accepted tablet events are not synthesized into mouse events, so the pen is handled at its full rate.
+    // The pipette has no use for that rate, it samples from the synthesized mouse events.
+    if (m_pipetteActive) {
+        event->ignore();
+        return;
+    }
+    switch (event->type()) {
+    case QEvent::TabletPress:
+        if (event->button() == Qt::LeftButton && beginStroke(event->posF(), event->modifiers())) {
+            event->accept();
+            return;
+        }
+        break;
+    case QEvent::TabletMove:
+        if (!m_drawnAnnotation.isNull()) {
+            continueStroke(event->posF());
+            event->accept();
+            return;
+        }
+        break;
+    case QEvent::TabletRelease:
+        if (event->button() == Qt::LeftButton && !m_drawnAnnotation.isNull()) {
+            endStroke();
+            event->accept();
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+    event->ignore();
+}
+
+void PhotoCanvas::keyPressEvent(QKeyEvent* event)
+{
+    if (event->key() == Qt::Key_Escape && m_pipetteActive) {
+        emit pipetteCanceled();
+        return;
+    }
+    if ((event->key() == Qt::Key_Delete || event->key() == Qt::Key_Backspace) && m_selectedAnnotation) {
+        emit annotationDeleteRequested(m_selectedAnnotation);
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
+
+void PhotoCanvas::leaveEvent(QEvent* event)
+{
+    hideLoupe();
+    QWidget::leaveEvent(event);
+}
+
+bool PhotoCanvas::beginStroke(const QPointF& position, Qt::KeyboardModifiers modifiers)
+{
+    if (m_pyramid.isNull() || m_preview || !m_annotationScene)
+        return false;
+
+    // Ctrl+click selects the annotation under the cursor instead of drawing a new one.
+    const QPointF point = mapToPhoto(position);
+    if (modifiers & Qt::ControlModifier) {
+        setSelectedAnnotation(m_annotationScene->itemAt(point, Constants::ANNOTATION_HIT_TOLERANCE_PX / scale()));
+        return true;
+    }
+
+    // The pen width is given in screen pixels at the zoom the annotation is drawn at.
+    setSelectedAnnotation(0);
+    m_drawnAnnotation = Annotation(m_drawTool, m_drawColor, Constants::ANNOTATION_PEN_WIDTH_PX / scale());
+    m_drawnAnnotation.addPoint(point);
+    m_smoothedPoint = m_lastInputPoint = point;
+    m_pendingPoints.clear();
+    m_latencySamples = 0;
+    m_latencySumNs = m_latencyMaxNs = 0;
+    m_pendingSinceNs = -1;
+    update(mapFromPhoto(m_drawnAnnotation.boundingRect()));
+    return true;
+}
+
+void PhotoCanvas::continueStroke(const QPointF& position)
+{
+    const QPointF point = mapToPhoto(position);
+    if (QLineF(m_lastInputPoint, point).length() * scale() < Constants::ANNOTATION_MIN_POINT_DISTANCE_PX)
+        return;
+
+    m_lastInputPoint = point;
+    if (m_pendingSinceNs < 0)
+        m_pendingSinceNs = m_inputClock.nsecsElapsed();
+
+    if (m_drawnAnnotation.type() == Annotation::Pencil) {
+        // Points are only queued here and smoothed once per frame in paintEvent, however many events arrive
+        // meanwhile. The smoothed points stay within the convex hull of the last smoothed point and the queued
+        // ones, which may reach out of the rects between consecutive points, so their whole bounds are repainted.
+        if (m_pendingPoints.isEmpty())
+            m_pendingBounds = QRectF(m_smoothedPoint, m_smoothedPoint);
+        m_pendingPoints.append(point);
+        m_pendingBounds.setCoords(qMin(m_pendingBounds.left(), point.x()), qMin(m_pendingBounds.top(), point.y()),
+                                  qMax(m_pendingBounds.right(), point.x()), qMax(m_pendingBounds.bottom(), point.y()));
+        const qreal margin = m_drawnAnnotation.penWidth();
+        update(mapFromPhoto(m_pendingBounds.adjusted(-margin, -margin, margin, margin)));
+    } else {
+        // A shape only depends on its end point, the previous and the new rubber band are repainted.
+        const QRectF previousRect = m_drawnAnnotation.boundingRect();
+        m_drawnAnnotation.setEndPoint(point);
+        update(mapFromPhoto(previousRect | m_drawnAnnotation.boundingRect()));
+    }
+}
+
+void PhotoCanvas::endStroke()
+{
+    flushPendingPoints();
+    // The smoothed stroke lags behind the pointer, finish it where the pointer was released.
+    if (m_drawnAnnotation.type() == Annotation::Pencil && m_drawnAnnotation.points().last() != m_lastInputPoint)
+        m_drawnAnnotation.addPoint(m_lastInputPoint);
+
+    const Annotation annotation = m_drawnAnnotation;
+    const int strength = redactionStrength();
+    m_drawnAnnotation = Annotation();
+    m_redactionPreview = QImage();
+    m_redactionPreviewLevel = -1;
+    m_pendingSinceNs = -1;
+    update(mapFromPhoto(annotation.boundingRect()));
+
+    if (m_latencySamples > 0) {
+        qCDebug(lcInput, "Stroke input latency: %.2f ms average, %.2f ms max over %d frames",
+                m_latencySumNs / 1e6 / m_latencySamples, m_latencyMaxNs / 1e6, m_latencySamples);
+        emit inputLatencyMeasured(m_latencySumNs / 1e6 / m_latencySamples, m_latencyMaxNs / 1e6);
+    }
+
+    if (annotation.type() == Annotation::Blur || annotation.type() == Annotation::Pixelate) {
+        const QRect rect = QRectF(annotation.points().first(), annotation.points().last()).normalized().toAlignedRect()
+                .intersected(QRect(QPoint(0, 0), m_photoSize));
+        if (annotation.points().size() > 1 && !rect.isEmpty())
+            emit redactionDrawn(annotation.type() == Annotation::Blur ? Redaction::Mode::Blur : Redaction::Mode::Pixelate, rect, strength);
+        return;
+    }
+
+    // A click without a drag only makes a pencil dot, a shape needs two points.
+    if (annotation.type() == Annotation::Pencil || annotation.points().size() > 1)
+        emit annotationDrawn(annotation);
+}
+
+void PhotoCanvas::flushPendingPoints()
+{
+    for (const QPointF& point : qAsConst(m_pendingPoints)) {
+        m_smoothedPoint += (point - m_smoothedPoint) * Constants::ANNOTATION_SMOOTHING_FACTOR;
+        m_drawnAnnotation.addPoint(m_smoothedPoint);
+    }
+    m_pendingPoints.clear();
+}
+
+int PhotoCanvas::redactionStrength() const
+{
+    const int strength = m_drawnAnnotation.type() == Annotation::Blur ? Constants::REDACTION_BLUR_RADIUS_PX
+                                                                      : Constants::REDACTION_PIXELATE_CELL_SIZE_PX;
+    return qMax(1, qRound(strength / scale()));
+}
+
+void PhotoCanvas::paintRedactionPreview(QPainter& painter, int levelIndex, const QRect& exposedLevelRect)
+{
+    const TiledImage& level = m_pyramid.level(levelIndex);
+    const qreal levelScale = qreal(level.width()) / m_photoSize.width();
+    const QRectF photoRect = QRectF(m_drawnAnnotation.points().first(), m_drawnAnnotation.points().last()).normalized();
+    const QRect levelRect = QRectF(photoRect.topLeft() * levelScale, photoRect.bottomRight() * levelScale).toAlignedRect()
+            .intersected(QRect(QPoint(0, 0), level.size()));
+    const QRect exposedRegionRect = levelRect.intersected(exposedLevelRect);
+    if (exposedRegionRect.isEmpty())
+        return;
+
+    // Only the part in view is redacted, with the pixels around it the blur reaches, or the whole cells it cuts,
+    // kept on the grid of the region. The painting is clipped to the exposed rect, what is around it is not shown.
+    const Redaction::Mode mode = m_drawnAnnotation.type() == Annotation::Blur ? Redaction::Mode::Blur : Redaction::Mode::Pixelate;
+    const int strength = qMax(1, qRound(redactionStrength() * levelScale));
+    QRect redactedRect;
+    if (mode == Redaction::Mode::Blur) {
+        const int reach = Redaction::BLUR_PASSES * qMin(strength, Redaction::MAX_RADIUS);
+        redactedRect = exposedRegionRect.adjusted(-reach, -reach, reach, reach).intersected(levelRect);
+    } else {
+        const QRect cells = exposedRegionRect.translated(-levelRect.topLeft());
+        redactedRect = QRect(QPoint(cells.left() / strength * strength, cells.top() / strength * strength),
+                             QPoint((cells.right() / strength + 1) * strength - 1, (cells.bottom() / strength + 1) * strength - 1))
+                .translated(levelRect.topLeft()).intersected(levelRect);
+    }
+
+    // A repaint of the same part of the same rubber band reuses the previous preview.
+    if (redactedRect != m_redactionPreviewRect || levelRect != m_redactionPreviewRegionRect
+            || levelIndex != m_redactionPreviewLevel) {
+        const Profiler::ScopedTimer timer("redaction preview", "paint");
+        m_redactionPreview = Redaction::redacted(level.copy(redactedRect), mode, strength);
+        m_redactionPreviewRect = redactedRect;
+        m_redactionPreviewRegionRect = levelRect;
+        m_redactionPreviewLevel = levelIndex;
+    }
+
+    const qreal scaleX = qreal(width()) / level.width(),
+            scaleY = qreal(height()) / level.height();
+    painter.drawImage(QRectF(redactedRect.x() * scaleX, redactedRect.y() * scaleY,
+                             redactedRect.width() * scaleX, redactedRect.height() * scaleY),
+                      m_redactionPreview);
+}
+
+void PhotoCanvas::samplePipette(const QPointF& position)
+{
+    // A preview is smaller than the photo it stands for, the sample square shrinks along.
+    const TiledImage& base = m_pyramid.level(0);
+    const qreal baseScale = qreal(base.width()) / m_photoSize.width();
+    const QPointF point = mapToPhoto(position) * baseScale;
+    const QPoint center(qMin(int(point.x()), base.width() - 1), qMin(int(point.y()), base.height() - 1));
+    // Odd sizes keep the square centered on the pixel under the pointer.
+    const int sampleSize = qMax(1, qRound(m_pipetteSampleSize * baseScale)) | 1;
+    m_pipetteColor = m_summedAreaTable.average(QRect(center - QPoint(sampleSize / 2, sampleSize / 2), QSize(sampleSize, sampleSize)));
+
+    // The patch is copied once per move, painting the loupe only scales it. Parts outside the photo show the zone.
+    const int patchSize = qMax(Constants::PIPETTE_LOUPE_PIXELS, sampleSize + 4) | 1;
+    const QRect patchRect(center - QPoint(patchSize / 2, patchSize / 2), QSize(patchSize, patchSize));
+    m_loupePatch = QImage(patchRect.size(), QImage::Format_RGB32);
+    m_loupePatch.fill(QColor(Constants::PHOTO_ZONE_COLOR));
+    QPainter patchPainter(&m_loupePatch);
+    patchPainter.drawImage(patchRect.intersected(QRect(QPoint(0, 0), base.size())).topLeft() - patchRect.topLeft(), base.copy(patchRect));
+    patchPainter.end();
+    m_loupeSampleSize = sampleSize;
+
+    // The loupe follows the pointer on its bottom right, flipped to stay inside the visible part of the canvas.
+    const QRect visibleRect = visibleRegion().boundingRect();
+    const QSize loupeSize(Constants::PIPETTE_LOUPE_SIZE_PX, Constants::PIPETTE_LOUPE_SIZE_PX + Constants::PIPETTE_LOUPE_SWATCH_HEIGHT_PX);
+    const QPoint pointer = position.toPoint();
+    QRect loupeRect(pointer + QPoint(Constants::PIPETTE_LOUPE_OFFSET_PX, Constants::PIPETTE_LOUPE_OFFSET_PX), loupeSize);
+    if (loupeRect.right() > visibleRect.right())
+        loupeRect.moveRight(pointer.x() - Constants::PIPETTE_LOUPE_OFFSET_PX);
+    if (loupeRect.bottom() > visibleRect.bottom())
+        loupeRect.moveBottom(pointer.y() - Constants::PIPETTE_LOUPE_OFFSET_PX);
+
+    update(m_loupeRect | loupeRect);
+    m_loupeRect = loupeRect;
+}
+
+void PhotoCanvas::hideLoupe()
+{
+    if (m_loupeRect.isNull())
+        return;
+
+    update(m_loupeRect);
+    m_loupeRect = QRect();
+}
+
+void PhotoCanvas::paintLoupe(QPainter& painter) const
+{
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    const QRect magnifiedRect(m_loupeRect.topLeft(), QSize(m_loupeRect.width(), m_loupeRect.width()));
+    painter.drawImage(magnifiedRect, m_loupePatch);
+
+    // Outline of the sample square, dark and light so it shows over any pixels.
+    const qreal pixelSize = qreal(magnifiedRect.width()) / m_loupePatch.width();
+    QRectF sampleRect(0.0, 0.0, m_loupeSampleSize * pixelSize, m_loupeSampleSize * pixelSize);
+    sampleRect.moveCenter(QRectF(magnifiedRect).center());
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(Qt::black);
+    painter.drawRect(sampleRect.adjusted(-1.0, -1.0, 1.0, 1.0));
+    painter.setPen(Qt::white);
+    painter.drawRect(sampleRect);
+
+    const QRect swatchRect(magnifiedRect.left(), magnifiedRect.bottom() + 1, m_loupeRect.width(), Constants::PIPETTE_LOUPE_SWATCH_HEIGHT_PX);
+    if (m_pipetteColor.isValid()) {
+        painter.fillRect(swatchRect, m_pipetteColor);
+        painter.setPen(qGray(m_pipetteColor.rgb()) < 128 ? Qt::white : Qt::black);
+        painter.drawText(swatchRect, Qt::AlignCenter, m_pipetteColor.name().toUpper());
+    }
+    painter.setPen(QColor(Constants::DELIMITER_LINE_COLOR));
+    painter.drawRect(m_loupeRect.adjusted(0, 0, -1, -1));
+}
+
+qreal PhotoCanvas::scale() const
+{
+    return m_photoSize.isEmpty() ? 1.0 : qreal(width()) / m_photoSize.width();
+}
+
+QPointF PhotoCanvas::mapToPhoto(const QPointF& point) const
+{
+    const qreal photoScale = scale();
+    return QPointF(qBound(0.0, point.x() / photoScale, qreal(m_photoSize.width())),
+                   qBound(0.0, point.y() / photoScale, qreal(m_photoSize.height())));
+}
+
+QRect PhotoCanvas::mapFromPhoto(const QRectF& rect) const
+{
+    const qreal photoScale = scale();
+    return QRectF(rect.x() * photoScale, rect.y() * photoScale, rect.width() * photoScale, rect.height() * photoScale)
+            .toAlignedRect().adjusted(-1, -1, 1, 1);
+}
+
+QScrollArea* PhotoCanvas::scrollArea() const
+{
+    for (QWidget* widget = parentWidget(); widget; widget = widget->parentWidget()) {
+        if (auto area = qobject_cast<QScrollArea*>(widget))
+            return area;
+    }
+    return nullptr;
+}
+
+QPixmap PhotoCanvas::tilePixmap(int level, int column, int row)
+{
+    const quint64 key = tileKey(level, column, row);
+    const QPixmap* cachedPixmap = m_tileCache.object(key);
+    Profiler::recordTileCacheLookup(cachedPixmap != nullptr);
+    if (cachedPixmap)
+        return *cachedPixmap;
+
+    const Profiler::ScopedTimer timer("upload tile", "paint");
+    auto* pixmap = new QPixmap(QPixmap::fromImage(m_pyramid.level(level).tile(column, row)));
+    const QPixmap result = *pixmap;
+    m_tileCache.insert(key, pixmap, qMax(1, pixmap->width() * pixmap->height() * 4 / 1024));
+    return result;
+}
+
+void PhotoCanvas::fetchTiles(int levelIndex, const QRect& range)
+{
+    QVector<QPoint> missingTiles;
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column) {
+            if (!m_tileCache.contains(tileKey(levelIndex, column, row)))
+                missingTiles.append(QPoint(column, row));
+        }
+    }
+    if (missingTiles.size() < 2)
+        return;
+
+    // Tiles decompressed from a project or evaluated through the adjustments take a while, they are made on all cores.
+    const Profiler::ScopedTimer timer("fetch tiles", "paint");
+    const TiledImage& level = m_pyramid.level(levelIndex);
+    QVector<QImage> tiles(missingTiles.size());
+    QImage* const tile = tiles.data();
+    QVector<int> tileIndices(missingTiles.size());
+    std::iota(tileIndices.begin(), tileIndices.end(), 0);
+    QtConcurrent::blockingMap(tileIndices, [&](int index) {
+        tile[index] = level.tile(missingTiles.at(index).x(), missingTiles.at(index).y());
+    });
+    for (int i = 0; i < missingTiles.size(); ++i) {
+        auto* pixmap = new QPixmap(QPixmap::fromImage(tiles.at(i)));
+        m_tileCache.insert(tileKey(levelIndex, missingTiles.at(i).x(), missingTiles.at(i).y()), pixmap,
+                           qMax(1, pixmap->width() * pixmap->height() * 4 / 1024));
+    }
+}
+
+void PhotoCanvas::paintScaledTiles(QPainter& painter, int levelIndex, const QRect& range)
+{
+    // The resampled tiles are only valid for the device size of the canvas they were made for.
+    const qreal pixelRatio = devicePixelRatioF();
+    const QSize deviceSize = size() * pixelRatio;
+    if (deviceSize != m_scaledTilesDeviceSize) {
+        m_scaledTileCache.clear();
+        m_scaledTilesDeviceSize = deviceSize;
+    }
+
+    const TiledImage& level = m_pyramid.level(levelIndex);
+    const qreal scaleX = qreal(deviceSize.width()) / level.width(),
+            scaleY = qreal(deviceSize.height()) / level.height();
+    // Tile edges are snapped to device pixels, so the neighbour tiles meet without seams.
+    auto deviceRect = [&](int column, int row) {
+        const QRect tileRect = level.tileRect(column, row);
+        const int left = qFloor(tileRect.left() * scaleX),
+                top = qFloor(tileRect.top() * scaleY),
+                right = qFloor((tileRect.right() + 1) * scaleX),
+                bottom = qFloor((tileRect.bottom() + 1) * scaleY);
+        return QRect(left, top, right - left, bottom - top);
+    };
+
+    QVector<QPoint> missingTiles;
+    QHash<quint64, QPixmap> madeTiles;
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column) {
+            const bool cached = m_scaledTileCache.contains(tileKey(levelIndex, column, row));
+            Profiler::recordTileCacheLookup(cached);
+            if (!cached && !deviceRect(column, row).isEmpty())
+                missingTiles.append(QPoint(column, row));
+        }
+    }
+
+    if (!missingTiles.isEmpty()) {
+        const Profiler::ScopedTimer timer("resample tiles", "paint");
+        // The filter reaches into the neighbour tiles, their pixels around the tile are resampled along.
+        const int margin = scaledTileMargin(levelIndex);
+        QVector<QImage> scaledTiles(missingTiles.size());
+        QImage* const scaledTile = scaledTiles.data();
+        QVector<int> tileIndices(missingTiles.size());
+        std::iota(tileIndices.begin(), tileIndices.end(), 0);
+        QtConcurrent::blockingMap(tileIndices, [&](int index) {
+            const QPoint tile = missingTiles.at(index);
+            const QRect rect = deviceRect(tile.x(), tile.y());
+            const QRect sourceRect = level.tileRect(tile.x(), tile.y())
+                    .adjusted(-margin, -margin, margin, margin)
+                    .intersected(QRect(QPoint(0, 0), level.size()));
+            const QRectF scaledRect(rect.left() / scaleX - sourceRect.left(), rect.top() / scaleY - sourceRect.top(),
+                                    rect.width() / scaleX, rect.height() / scaleY);
+            scaledTile[index] = Resampler::resample(level.copy(sourceRect), scaledRect, rect.size(), SCALED_TILE_FILTER);
+        });
+        for (int i = 0; i < missingTiles.size(); ++i) {
+            auto* pixmap = new QPixmap(QPixmap::fromImage(scaledTiles.at(i)));
+            pixmap->setDevicePixelRatio(pixelRatio);
+            const quint64 key = tileKey(levelIndex, missingTiles.at(i).x(), missingTiles.at(i).y());
+            // Keeps the tiles of this paint even if the cache has to drop some of them.
+            madeTiles.insert(key, *pixmap);
+            m_scaledTileCache.insert(key, pixmap, qMax(1, pixmap->width() * pixmap->height() * 4 / 1024));
+        }
+    }
+
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column) {
+            const quint64 key = tileKey(levelIndex, column, row);
+            const QPixmap* pixmap = m_scaledTileCache.object(key);
+            const QPixmap tile = pixmap ? *pixmap : madeTiles.value(key);
+            const QRect rect = deviceRect(column, row);
+            if (!tile.isNull())
+                painter.drawPixmap(QPointF(rect.left() / pixelRatio, rect.top() / pixelRatio), tile);
+        }
+    }
+}
+
+int PhotoCanvas::scaledTileMargin(int levelIndex) const
+{
+    const TiledImage& level = m_pyramid.level(levelIndex);
+    const qreal scale = qMin(qreal(m_scaledTilesDeviceSize.width()) / level.width(),
+                             qreal(m_scaledTilesDeviceSize.height()) / level.height());
+    // Without tiles resampled yet there is nothing to reach. The tile edges are snapped to device pixels, the tiles
+    // cover up to a device pixel more.
+    return scale > 0.0 ? Resampler::reach(SCALED_TILE_FILTER, scale) + qCeil(1.0 / scale) : 0;
+}
+
+quint64 PhotoCanvas::tileKey(int level, int column, int row)
+{
+    return (quint64(level) << 48) | (quint64(row) << 24) | quint64(column);
+}
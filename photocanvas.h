@@ -0,0 +1,164 @@
+#ifndef PHOTOCANVAS_H
+#define PHOTOCANVAS_H
+
+#include "annotationscene.h"
+#include "imagepyramid.h"
+#include "redaction.h"
+#include "summedareatable.h"
+
+#include <QWidget>
+#include <QCache>
+#include <QPixmap>
+#include <QElapsedTimer>
+
+class QScrollArea;
+
+// Paints the photo from the tiles of its mipmap pyramid. Only the tiles intersecting the exposed region
+// are painted, taken from the pyramid level nearest to the zoom, so the cost of a repaint depends on
+// the viewport size rather than on the photo size.
+// Between two levels, the tiles of the finer one are resampled with a Lanczos filter to the device pixels they
+// cover, on all cores, and cached until the zoom changes; magnified tiles are stretched by the painter.
+// The annotations of the scene are painted over the tiles. Drawn annotations are handed over through
+// annotationDrawn and only enter the scene once the owner of the scene applied them.
+// The redaction tools draw a rubber band instead, previewed redacted at the painted pyramid level while it is
+// dragged, and hand the rect over through redactionDrawn for the owner to edit the pixels of the photo.
+// Stroke input is coalesced per frame: pointer events only queue points and schedule the repaint of the rect
+// the stroke may grow into, the queued points are smoothed and added once per paint.
+// While the pipette is active, the pointer samples the photo instead of drawing: the average of the sample
+// square under it comes from a summed-area table, and a loupe next to it magnifies the pixels around it.
+class PhotoCanvas : public QWidget
+{
+    Q_OBJECT
+
+public:
+    PhotoCanvas(QWidget* parent = nullptr);
+    ~PhotoCanvas() = default;
+
+    void setPhoto(const QImage& photo);
+    void setPyramid(const ImagePyramid& pyramid);
+    // Takes an edited version of the current pyramid, only the area of the dirty rect is repainted.
+    void updatePyramid(const ImagePyramid& pyramid, const QRect& dirtyRect);
+    // Shows a reduced preview stretched to the size of the photo it stands for, until the photo itself is set.
+    // Nothing can be drawn over a preview, the edits would be lost when the photo replaces it.
+    void setPreview(const QImage& preview, const QSize& photoSize);
+    bool isPreview() const { return m_preview; }
+    QSize photoSize() const { return m_photoSize; }
+    const ImagePyramid& pyramid() const { return m_pyramid; }
+    qint64 tileCacheMemoryUsage() const { return (qint64(m_tileCache.totalCost()) + m_scaledTileCache.totalCost()) * 1024; }
+
+    qreal zoom() const { return m_zoom; }
+    void setZoom(qreal zoom, const QPoint& anchor = QPoint());
+    void zoomIn();
+    void zoomOut();
+    void zoomToFit();
+
+    // The scene is owned by the caller and must outlive the canvas.
+    void setAnnotationScene(const AnnotationScene* scene);
+    // Repaints the area of the scene which changed, in photo coordinates.
+    void updateAnnotations(const QRectF& dirtyRect);
+    void setDrawTool(Annotation::Type type) { m_drawTool = type; }
+    void setDrawColor(const QColor& color) { m_drawColor = color; }
+    // Opacity of the annotations as a whole, in [0, 255].
+    int annotationOpacity() const { return m_annotationOpacity; }
+    void setAnnotationOpacity(int opacity);
+    quint64 selectedAnnotation() const { return m_selectedAnnotation; }
+    void setSelectedAnnotation(quint64 id);
+
+    bool isPipetteActive() const { return m_pipetteActive; }
+    void setPipetteActive(bool active);
+    // Edge of the square of photo pixels the pipette averages.
+    void setPipetteSampleSize(int size);
+
+    QSize sizeHint() const override;
+
+signals:
+    void zoomChanged(qreal zoom);
+    void annotationDrawn(const Annotation& annotation);
+    // The rect in photo pixels, the strength is the blur radius or the pixelate cell size in photo pixels.
+    void redactionDrawn(Redaction::Mode mode, const QRect& rect, int strength);
+    void annotationDeleteRequested(quint64 id);
+    void colorPicked(const QColor& color);
+    void pipetteCanceled();
+    // Average and worst time from an input event to the end of the paint showing it, over the last stroke.
+    void inputLatencyMeasured(qreal averageMs, qreal maxMs);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void tabletEvent(QTabletEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+    void leaveEvent(QEvent* event) override;
+
+private:
+    bool beginStroke(const QPointF& position, Qt::KeyboardModifiers modifiers);
+    void continueStroke(const QPointF& position);
+    void endStroke();
+    void flushPendingPoints();
+    // Strength of the redaction of the drawn annotation in photo pixels, for the zoom it is drawn at.
+    int redactionStrength() const;
+    // Redacts the part of the drawn region in the exposed rect, in the pixels of the level.
+    void paintRedactionPreview(QPainter& painter, int levelIndex, const QRect& exposedLevelRect);
+    void samplePipette(const QPointF& position);
+    void hideLoupe();
+    void paintLoupe(QPainter& painter) const;
+    qreal scale() const;
+    QPointF mapToPhoto(const QPointF& point) const;
+    QRect mapFromPhoto(const QRectF& rect) const;
+    QScrollArea* scrollArea() const;
+    QPixmap tilePixmap(int level, int column, int row);
+    // Caches the pixmaps of the tiles of the range not cached yet, their pixels fetched in parallel.
+    void fetchTiles(int levelIndex, const QRect& range);
+    void paintScaledTiles(QPainter& painter, int levelIndex, const QRect& range);
+    // Pixels of the neighbour tiles resampled along with a tile of the level, the reach of the filter at the
+    // scale of the device size the tiles are resampled for.
+    int scaledTileMargin(int levelIndex) const;
+    static quint64 tileKey(int level, int column, int row);
+
+    ImagePyramid m_pyramid;
+    QSize m_photoSize;
+    bool m_preview { false };
+    QCache<quint64, QPixmap> m_tileCache;
+    // Tiles shrunk to the device pixels of the canvas, for the device size they were resampled for.
+    QCache<quint64, QPixmap> m_scaledTileCache;
+    QSize m_scaledTilesDeviceSize;
+    qreal m_zoom { 1.0 };
+    QRect m_lastPaintGeometry;
+
+    const AnnotationScene* m_annotationScene { nullptr };
+    Annotation m_drawnAnnotation;
+    Annotation::Type m_drawTool { Annotation::Pencil };
+    QColor m_drawColor { Constants::ANNOTATION_DEFAULT_COLOR };
+    int m_annotationOpacity { 255 };
+    quint64 m_selectedAnnotation { 0 };
+    // Part of the region of the drawn redaction in view, redacted at the pyramid level and in the pixels of that level
+    // it was made for, with the region it is part of.
+    QImage m_redactionPreview;
+    QRect m_redactionPreviewRect;
+    QRect m_redactionPreviewRegionRect;
+    int m_redactionPreviewLevel { -1 };
+
+    QVector<QPointF> m_pendingPoints;
+    // Bounds of the last smoothed point and the queued points, in photo coordinates.
+    QRectF m_pendingBounds;
+    QPointF m_smoothedPoint;
+    QPointF m_lastInputPoint;
+    QElapsedTimer m_inputClock;
+    qint64 m_pendingSinceNs { -1 };
+    qint64 m_latencySumNs { 0 };
+    qint64 m_latencyMaxNs { 0 };
+    int m_latencySamples { 0 };
+
+    bool m_pipetteActive { false };
+    int m_pipetteSampleSize { Constants::PIPETTE_DEFAULT_SAMPLE_SIZE_PX };
+    SummedAreaTable m_summedAreaTable;
+    QColor m_pipetteColor;
+    // Pixels magnified by the loupe and the size of the sample square among them, in pixels of the pyramid base.
+    QImage m_loupePatch;
+    int m_loupeSampleSize { 1 };
+    QRect m_loupeRect;
+};
+
+#endif // PHOTOCANVAS_H
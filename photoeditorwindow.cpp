@@ -1,5 +1,16 @@
 #include "photoeditorwindow.h"
+#include "adjustmentsdialog.h"
 #include "coloritemdelegate.h"
+#include "filmstrip.h"
+#include "histogramwidget.h"
+#include "iconcache.h"
+#include "photocanvas.h"
+#include "photoloader.h"
+#include "photoprinter.h"
+#include "photosaver.h"
+#include "profiler.h"
+#include "projectfile.h"
+#include "resizedialog.h"
 #include "constants.h"
 
 #include <QHBoxLayout>
@@ -10,16 +21,36 @@
 #include <QRegExp>
 #include <QPainter>
 #include <QImageReader>
+#include <QImageWriter>
+#include <QClipboard>
+#include <QPrinter>
+#include <QPrintDialog>
 #include <QMessageBox>
 #include <QGuiApplication>
 #include <QDir>
-#include <QColorSpace>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QStandardPaths>
 #include <QScreen>
 #include <QStatusBar>
 #include <QSignalBlocker>
 #include <QGridLayout>
+#include <QHash>
+#include <QPair>
+#include <QtMath>
+
+namespace {
+
+// Returns the selectors joined into a selector list, each one followed by the same pseudo-states or subcontrols.
+QString selectorList(const QStringList& selectors, const QString& suffix = QString())
+{
+    QStringList list;
+    for (const QString& selector : selectors)
+        list.append(selector + suffix);
+    return list.join(", ");
+}
+
+}
 
 PhotoEditorWindow::PhotoEditorWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -49,6 +80,10 @@ void PhotoEditorWindow::openFile()
         mimeTypeFilters.append(mimeTypeName);
     mimeTypeFilters.sort();
     fileDialog.setMimeTypeFilters(mimeTypeFilters);
+    // Projects have no MIME type, their filter is added by name.
+    QStringList nameFilters = fileDialog.nameFilters();
+    nameFilters.prepend(tr("Photo Editor projects (*.%1)").arg(Constants::PROJECT_FILE_SUFFIX));
+    fileDialog.setNameFilters(nameFilters);
     fileDialog.selectMimeTypeFilter("image/jpeg");
 
     auto retValue = fileDialog.exec();
@@ -58,26 +93,688 @@ void PhotoEditorWindow::openFile()
     }
 }
 
+void PhotoEditorWindow::saveFile()
+{
+    if (m_filePath.isEmpty())
+        saveFileAs();
+    else
+        savePhoto(m_filePath);
+}
+
+void PhotoEditorWindow::saveFileAs()
+{
+    if (m_pyramid.isNull())
+        return;
+
+    QFileDialog fileDialog(this, tr("Save File As"));
+    fileDialog.setAcceptMode(QFileDialog::AcceptSave);
+    if (!m_filePath.isEmpty())
+        fileDialog.selectFile(m_filePath);
+
+    QStringList mimeTypeFilters;
+    const QByteArrayList supportedMimeTypes = QImageWriter::supportedMimeTypes();
+    for (const QByteArray &mimeTypeName : supportedMimeTypes)
+        mimeTypeFilters.append(mimeTypeName);
+    mimeTypeFilters.sort();
+    fileDialog.setMimeTypeFilters(mimeTypeFilters);
+    const QString projectFilter = tr("Photo Editor project (*.%1)").arg(Constants::PROJECT_FILE_SUFFIX);
+    QStringList nameFilters = fileDialog.nameFilters();
+    nameFilters.prepend(projectFilter);
+    fileDialog.setNameFilters(nameFilters);
+    if (ProjectFile::isProject(m_filePath)) {
+        fileDialog.selectNameFilter(projectFilter);
+        fileDialog.setDefaultSuffix(Constants::PROJECT_FILE_SUFFIX);
+    } else {
+        fileDialog.selectMimeTypeFilter("image/png");
+        fileDialog.setDefaultSuffix("png");
+    }
+    connect(&fileDialog, &QFileDialog::filterSelected, [&](const QString& filter) {
+        if (filter == projectFilter)
+            fileDialog.setDefaultSuffix(Constants::PROJECT_FILE_SUFFIX);
+    });
+
+    if (fileDialog.exec() == QDialog::Accepted) {
+        m_saveAsFilePath = fileDialog.selectedFiles().first();
+        savePhoto(m_saveAsFilePath);
+    }
+}
+
+void PhotoEditorWindow::savePhoto(const QString& filePath)
+{
+    if (m_pyramid.isNull())
+        return;
+
+    // The snapshot shares the pixels and the annotations, editing goes on while it is encoded.
+    PhotoSaver::Document document = documentSnapshot();
+    // Projects keep the undo history, editing goes on where it was left when they are reopened.
+    if (ProjectFile::isProject(filePath)) {
+        document.history = m_editHistory->records();
+        document.historyIndex = m_editHistory->index();
+    }
+    m_photoSaver->save(document, filePath);
+}
+
+PhotoSaver::Document PhotoEditorWindow::documentSnapshot() const
+{
+    PhotoSaver::Document document;
+    document.pyramid = m_pyramid;
+    document.annotations = m_annotations;
+    document.annotationOpacity = m_photoCanvas->annotationOpacity();
+    document.adjustments = m_filterGraph.nodes();
+    return document;
+}
+
+void PhotoEditorWindow::copy()
+{
+    if (m_pyramid.isNull())
+        return;
+
+    // Nothing is flattened nor encoded until a consumer asks for the data.
+    if (m_clipboardContent.isNull()) {
+        m_clipboardContent = QSharedPointer<PhotoMimeData::Content>::create();
+        m_clipboardContent->document = documentSnapshot();
+    }
+    QGuiApplication::clipboard()->setMimeData(new PhotoMimeData(m_clipboardContent));
+}
+
+void PhotoEditorWindow::print()
+{
+    if (m_pyramid.isNull())
+        return;
+
+    QPrinter printer(QPrinter::HighResolution);
+    const QSize photoSize = m_pyramid.size();
+    printer.setPageOrientation(photoSize.width() > photoSize.height() ? QPageLayout::Landscape : QPageLayout::Portrait);
+    QPrintDialog printDialog(&printer, this);
+    if (printDialog.exec() != QDialog::Accepted)
+        return;
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QString errorString;
+    const bool printed = PhotoPrinter::print(&printer, documentSnapshot(), &errorString);
+    QApplication::restoreOverrideCursor();
+    if (!printed) {
+        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                                 tr("Cannot print: %1").arg(errorString));
+    }
+}
+
+void PhotoEditorWindow::exportTrace()
+{
+    QFileDialog fileDialog(this, tr("Export Performance Trace"));
+    fileDialog.setAcceptMode(QFileDialog::AcceptSave);
+    fileDialog.setNameFilter(tr("Chrome trace (*.json)"));
+    fileDialog.setDefaultSuffix("json");
+    fileDialog.selectFile("photoeditor-trace.json");
+    if (fileDialog.exec() != QDialog::Accepted)
+        return;
+
+    QString errorString;
+    const QString filePath = fileDialog.selectedFiles().first();
+    if (!Profiler::writeTrace(filePath, &errorString)) {
+        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                                 tr("Cannot save %1: %2").arg(QDir::toNativeSeparators(filePath), errorString));
+    }
+}
+
 bool PhotoEditorWindow::loadPhoto(const QString& filePath)
 {
-    QImageReader photoReader(filePath);
-    photoReader.setAutoTransform(true);
-    const QImage newPhoto = photoReader.read();
-    if (newPhoto.isNull()) {
+    if (!QFileInfo(filePath).isReadable()) {
         QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
-                                 tr("Cannot load %1: %2").arg(QDir::toNativeSeparators(filePath), photoReader.errorString()));
+                                 tr("Cannot load %1: %2").arg(QDir::toNativeSeparators(filePath), tr("File is not readable")));
         return false;
     }
 
-    m_photo = newPhoto;
-    if (m_photo.colorSpace().isValid())
-        m_photo.convertToColorSpace(QColorSpace::SRgb);
-    m_photoLabel->setPixmap(QPixmap::fromImage(m_photo));
-    m_photoScrollArea->setVisible(true);
-    m_photoLabel->adjustSize();
+    // Decoding runs on the loader thread, a load in flight is canceled. Absolute paths key the decoded photo cache.
+    m_previewFilePath.clear();
+    m_browsedFilePath = QFileInfo(filePath).absoluteFilePath();
+    m_filmstrip->setCurrentPhoto(m_browsedFilePath);
+    m_filmstrip->setVisible(true);
+    m_nextPhotoAction->setEnabled(true);
+    m_previousPhotoAction->setEnabled(true);
+    m_photoLoader->load(m_browsedFilePath);
     return true;
 }
 
+void PhotoEditorWindow::openNextPhoto()
+{
+    openNeighborPhoto(1);
+}
+
+void PhotoEditorWindow::openPreviousPhoto()
+{
+    openNeighborPhoto(-1);
+}
+
+void PhotoEditorWindow::openNeighborPhoto(int step)
+{
+    if (m_browsedFilePath.isEmpty())
+        return;
+
+    // Steps from the last photo asked for, not the last one loaded, so stepping does not wait for the loads.
+    const QStringList photos = folderPhotos(m_browsedFilePath);
+    if (photos.isEmpty())
+        return;
+    const int index = photos.indexOf(m_browsedFilePath);
+    const int neighborIndex = index < 0 ? 0 : qBound(0, index + step, photos.size() - 1);
+    if (neighborIndex != index)
+        loadPhoto(photos.at(neighborIndex));
+}
+
+QStringList PhotoEditorWindow::folderPhotos(const QString& filePath) const
+{
+    // The filmstrip lists the folder in the background, the folder is only listed here until it is done.
+    const QString folderPath = QFileInfo(filePath).absolutePath();
+    if (m_filmstrip->folderPath() == folderPath)
+        return m_filmstrip->photos();
+    return PhotoLoader::listPhotos(folderPath);
+}
+
+void PhotoEditorWindow::prefetchNeighborPhotos(const QString& filePath)
+{
+    const QStringList photos = folderPhotos(filePath);
+    const int index = photos.indexOf(filePath);
+    QStringList neighbors;
+    for (int distance = 1; index >= 0 && distance <= Constants::PHOTO_PREFETCH_NEIGHBORS; ++distance) {
+        if (index + distance < photos.size())
+            neighbors.append(photos.at(index + distance));
+        if (index - distance >= 0)
+            neighbors.append(photos.at(index - distance));
+    }
+    m_photoLoader->prefetch(neighbors);
+}
+
+void PhotoEditorWindow::onPhotoPreviewReady(const QString& filePath, const QImage& preview, const QSize& photoSize)
+{
+    // The first preview of a photo sets the zoom, the next stages keep the one the user may have changed meanwhile.
+    const bool firstPreview = m_previewFilePath != filePath;
+    m_previewFilePath = filePath;
+    m_photoCanvas->setPreview(preview, photoSize);
+    m_photoScrollArea->setVisible(true);
+    if (firstPreview)
+        m_photoCanvas->zoomToFit();
+    updateHistoryActions();
+}
+
+void PhotoEditorWindow::onPhotoLoaded(const QString& filePath, const QImage& photo, const ImagePyramid& pyramid)
+{
+    showPhoto(filePath, photo, pyramid);
+    resetHistogram();
+    beginJournal(filePath);
+}
+
+void PhotoEditorWindow::onProjectLoaded(const QString& filePath, const PhotoSaver::Document& document)
+{
+    // Projects have no photo image, their pixels are decompressed from the mapped file as the pyramid is painted.
+    showPhoto(filePath, QImage(), document.pyramid);
+    m_annotations = document.annotations;
+    m_photoCanvas->setAnnotationScene(&m_annotations);
+    m_opacitySlider->setValue(qRound(document.annotationOpacity * Constants::SLIDER_MAX_VALUE / 255.0));
+    m_editHistory->setRecords(document.history, document.historyIndex);
+    setAdjustments(document.adjustments);
+    beginJournal(filePath);
+}
+
+void PhotoEditorWindow::showPhoto(const QString& filePath, const QImage& photo, const ImagePyramid& pyramid)
+{
+    const bool previewShown = m_previewFilePath == filePath && m_photoCanvas->photoSize() == pyramid.size();
+    m_previewFilePath.clear();
+
+    m_photo = photo;
+    m_pyramid = pyramid;
+    m_filePath = filePath;
+    m_saveAsFilePath.clear();
+    m_clipboardContent.reset();
+    m_annotations.clear();
+    m_editHistory->clear();
+    m_filterGraph.setNodes(QVector<FilterGraph::Node>());
+    m_filterGraph.invalidate();
+    // Counted again by the caller once the annotations of the document are set.
+    m_histogram.clear();
+    m_photoCanvas->setAnnotationScene(&m_annotations);
+    m_photoCanvas->setPyramid(m_pyramid);
+    m_photoScrollArea->setVisible(true);
+    if (!previewShown)
+        m_photoCanvas->zoomToFit();
+
+    m_progressBarAction->setVisible(false);
+    m_statusLabel->setText(QDir::toNativeSeparators(filePath));
+
+    // The neighbors are decoded while the photo is looked at, stepping to them takes them from the cache.
+    prefetchNeighborPhotos(filePath);
+}
+
+void PhotoEditorWindow::beginJournal(const QString& filePath)
+{
+    m_recoveryJournal->begin(filePath);
+    // Opening another photo meanwhile gives up the recovery.
+    const RecoveryJournal::Session session = m_recoverySession;
+    m_recoverySession = RecoveryJournal::Session();
+    if (session.sourcePath != filePath)
+        return;
+
+    // Replaying journals the operations again, the recovered session is protected as well.
+    for (const RecoveryJournal::Operation& operation : session.operations) {
+        switch (operation.type) {
+        case RecoveryJournal::Edit:
+            applyEdit(operation.text, operation.change);
+            break;
+        case RecoveryJournal::Undo:
+            undo();
+            break;
+        case RecoveryJournal::Redo:
+            redo();
+            break;
+        case RecoveryJournal::Reset:
+            resetEdits();
+            break;
+        case RecoveryJournal::Resize:
+            resizePhoto(operation.size, Resampler::Filter(operation.filter));
+            break;
+        case RecoveryJournal::Adjust:
+            m_recoveryJournal->recordAdjustments(operation.adjustments);
+            setAdjustments(operation.adjustments);
+            break;
+        case RecoveryJournal::Begin:
+            break;
+        }
+    }
+}
+
+void PhotoEditorWindow::onPhotoLoadFailed(const QString& filePath, const QString& errorString)
+{
+    m_recoverySession = RecoveryJournal::Session();
+    m_progressBarAction->setVisible(false);
+    m_statusLabel->clear();
+    QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                             tr("Cannot load %1: %2").arg(QDir::toNativeSeparators(filePath), errorString));
+}
+
+void PhotoEditorWindow::undo()
+{
+    if (!isEditable() || !m_editHistory->canUndo())
+        return;
+
+    // A tile lost from the scratch file of the history leaves the photo as it is.
+    EditHistory::Change change;
+    QString errorString;
+    const QString text = m_editHistory->undoText();
+    if (!m_editHistory->undo(&change, &errorString)) {
+        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                                 tr("Cannot undo %1: %2").arg(text, errorString));
+        return;
+    }
+    m_recoveryJournal->recordUndo();
+    applyChange(change);
+}
+
+void PhotoEditorWindow::redo()
+{
+    if (!isEditable() || !m_editHistory->canRedo())
+        return;
+
+    EditHistory::Change change;
+    QString errorString;
+    const QString text = m_editHistory->redoText();
+    if (!m_editHistory->redo(&change, &errorString)) {
+        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                                 tr("Cannot redo %1: %2").arg(text, errorString));
+        return;
+    }
+    m_recoveryJournal->recordRedo();
+    applyChange(change);
+}
+
+void PhotoEditorWindow::resetEdits()
+{
+    if (!isEditable())
+        return;
+
+    // The original tiles are never modified, dropping the edited ones restores them. The adjustments are dropped along.
+    m_recoveryJournal->recordReset();
+    m_editHistory->clear();
+    m_annotations.clear();
+    m_pyramid.resetTiles();
+    m_filterGraph.setNodes(QVector<FilterGraph::Node>());
+    m_filterGraph.invalidate();
+    m_clipboardContent.reset();
+    m_photoCanvas->setAnnotationScene(&m_annotations);
+    m_photoCanvas->setPyramid(m_pyramid);
+    resetHistogram();
+}
+
+void PhotoEditorWindow::resizeImage()
+{
+    if (!isEditable())
+        return;
+
+    ResizeDialog resizeDialog(m_pyramid.size(), this);
+    if (resizeDialog.exec() != QDialog::Accepted || resizeDialog.imageSize() == m_pyramid.size())
+        return;
+    // The resize cannot be undone, it starts the history over.
+    if ((m_editHistory->canUndo() || m_editHistory->canRedo())
+            && QMessageBox::question(this, QGuiApplication::applicationDisplayName(),
+                                     tr("Resizing the photo clears the undo history. Resize it anyway?"))
+                    != QMessageBox::Yes)
+        return;
+
+    resizePhoto(resizeDialog.imageSize(), resizeDialog.filter());
+}
+
+void PhotoEditorWindow::adjustImage()
+{
+    if (!isEditable())
+        return;
+
+    // Only the tiles in view are evaluated as the sliders move, the previous adjustments come back on cancel.
+    const QVector<FilterGraph::Node> previousAdjustments = m_filterGraph.nodes();
+    AdjustmentsDialog adjustmentsDialog(previousAdjustments, this);
+    connect(&adjustmentsDialog, &AdjustmentsDialog::adjustmentsChanged, this, &PhotoEditorWindow::setAdjustments);
+    if (adjustmentsDialog.exec() != QDialog::Accepted) {
+        setAdjustments(previousAdjustments);
+        return;
+    }
+
+    m_recoveryJournal->recordAdjustments(adjustmentsDialog.adjustments());
+    setAdjustments(adjustmentsDialog.adjustments());
+}
+
+void PhotoEditorWindow::resizePhoto(const QSize& size, Resampler::Filter filter)
+{
+    const Profiler::ScopedTimer timer("resize photo", "edit");
+    const QSize photoSize = m_pyramid.size();
+    const qreal scaleX = qreal(size.width()) / photoSize.width(),
+            scaleY = qreal(size.height()) / photoSize.height();
+
+    // Shrinking starts from the coarsest level still finer than the result, the edited tiles are part of it.
+    // An out-of-core level, or a result too big for memory, is resampled band by band from the tiles into
+    // out-of-core stores, like a photo too big for memory is decoded.
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const TiledImage& level = m_pyramid.level(m_pyramid.levelForScale(qMax(scaleX, scaleY)));
+    const bool outOfCore = level.isOutOfCore()
+            || qint64(size.width()) * size.height() * 4 > qint64(Constants::OUT_OF_CORE_THRESHOLD_MB) * 1024 * 1024;
+    QImage photo;
+    ImagePyramid pyramid;
+    QString errorString = tr("Not enough memory");
+    if (outOfCore) {
+        TiledPyramidBuilder builder(size);
+        const int bandHeight = qMax(Constants::PHOTO_TILE_SIZE_PX * 4, builder.bandAlignment());
+        const bool resampled = Resampler::resample(level, size, filter, bandHeight, [&](const QImage& band, int y) {
+            return builder.addBand(band, QPoint(0, y), &errorString);
+        });
+        if (resampled)
+            pyramid = builder.pyramid();
+    } else {
+        photo = Resampler::resample(level.copy(QRect(QPoint(0, 0), level.size())), size, filter);
+        if (!photo.isNull())
+            pyramid = ImagePyramid(photo);
+    }
+    QApplication::restoreOverrideCursor();
+    if (pyramid.isNull()) {
+        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                                 tr("Cannot resize to %1 x %2: %3").arg(size.width()).arg(size.height()).arg(errorString));
+        return;
+    }
+
+    // Annotations stay vectors, their points and pens are scaled along.
+    AnnotationScene annotations;
+    const QVector<quint64> ids = m_annotations.ids();
+    for (const quint64 id : ids) {
+        const Annotation annotation = m_annotations.annotation(id);
+        Annotation scaledAnnotation(annotation.type(), annotation.color(), annotation.penWidth() * (scaleX + scaleY) / 2.0);
+        for (const QPointF& point : annotation.points())
+            scaledAnnotation.addPoint(QPointF(point.x() * scaleX, point.y() * scaleY));
+        annotations.set(id, scaledAnnotation);
+    }
+    annotations.reserveIds(ids.isEmpty() ? 0 : ids.last() + 1);
+
+    // The history refers to the tiles of the previous size, the resize starts it over.
+    m_recoveryJournal->recordResize(size, int(filter));
+    m_photo = photo;
+    m_pyramid = pyramid;
+    m_filterGraph.invalidate();
+    m_annotations = annotations;
+    m_clipboardContent.reset();
+    m_editHistory->clear();
+    m_photoCanvas->setAnnotationScene(&m_annotations);
+    m_photoCanvas->setPyramid(m_filterGraph.apply(m_pyramid));
+    m_photoCanvas->zoomToFit();
+    resetHistogram();
+}
+
+void PhotoEditorWindow::setAdjustments(const QVector<FilterGraph::Node>& adjustments)
+{
+    // The tiles memoized for the nodes in front of the first one changed are reused.
+    m_filterGraph.setNodes(adjustments);
+    m_clipboardContent.reset();
+    m_photoCanvas->setPyramid(m_filterGraph.apply(m_pyramid));
+    // The adjusted level is evaluated whole to be counted, only once the sliders stop.
+    m_histogramResetTimer->start();
+}
+
+void PhotoEditorWindow::redact(Redaction::Mode mode, const QRect& rect, int strength)
+{
+    if (!isEditable() || rect.isEmpty())
+        return;
+
+    // The pixels under the adjustments are redacted, the adjustments apply over them like over any other edit.
+    const Profiler::ScopedTimer timer("redact", "edit");
+    const TiledImage& photoTiles = m_pyramid.level(0);
+    const QImage region = Redaction::redacted(photoTiles.copy(rect), mode, strength);
+    if (region.isNull())
+        return;
+
+    EditHistory::Change change;
+    const QRect range = photoTiles.tileRange(rect);
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column) {
+            QImage tile = photoTiles.tile(column, row);
+            QPainter painter(&tile);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.drawImage(rect.topLeft() - photoTiles.tileRect(column, row).topLeft(), region);
+            painter.end();
+            change.tiles.append({ column, row, tile });
+        }
+    }
+    applyEdit(mode == Redaction::Mode::Blur ? tr("Blur") : tr("Pixelate"), change);
+}
+
+void PhotoEditorWindow::recoverSession(const QString& journalPath)
+{
+    RecoveryJournal::Session session;
+    const bool readable = RecoveryJournal::read(journalPath, &session);
+    // The journal is consumed either way, recovered edits are journaled again by this session.
+    RecoveryJournal::remove(journalPath);
+    if (!readable || session.operations.isEmpty())
+        return;
+
+    const QString fileName = QDir::toNativeSeparators(session.sourcePath);
+    if (!session.isSourceUnchanged()) {
+        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                                 tr("The unsaved edits of %1 cannot be recovered, the file was changed since.").arg(fileName));
+        return;
+    }
+    if (QMessageBox::question(this, QGuiApplication::applicationDisplayName(),
+                              tr("The last session ended unexpectedly. Recover the unsaved edits of %1?").arg(fileName))
+            != QMessageBox::Yes)
+        return;
+
+    m_recoverySession = session;
+    loadPhoto(session.sourcePath);
+}
+
+bool PhotoEditorWindow::isEditable() const
+{
+    return !m_pyramid.isNull() && !m_photoCanvas->isPreview();
+}
+
+void PhotoEditorWindow::applyEdit(const QString& text, const EditHistory::Change& change)
+{
+    if (!isEditable())
+        return;
+
+    EditHistory::Change previousChange;
+    previousChange.tiles.reserve(change.tiles.size());
+    const TiledImage& photoTiles = m_pyramid.level(0);
+    for (const auto& tile : change.tiles) {
+        const bool modified = photoTiles.isTileModified(tile.column, tile.row);
+        previousChange.tiles.append({ tile.column, tile.row, modified ? photoTiles.tile(tile.column, tile.row) : QImage() });
+    }
+    previousChange.annotations.reserve(change.annotations.size());
+    for (const auto& state : change.annotations)
+        previousChange.annotations.append({ state.id, m_annotations.annotation(state.id) });
+
+    m_editHistory->push(text, previousChange, change);
+    m_recoveryJournal->recordEdit(text, change);
+    applyChange(change);
+}
+
+void PhotoEditorWindow::applyChange(const EditHistory::Change& change)
+{
+    if (change.isEmpty() || m_pyramid.isNull())
+        return;
+
+    m_clipboardContent.reset();
+    QRect dirtyRect;
+    for (const auto& tile : change.tiles) {
+        m_pyramid.setTile(tile.column, tile.row, tile.image);
+        dirtyRect |= m_pyramid.level(0).tileRect(tile.column, tile.row);
+    }
+    if (!dirtyRect.isEmpty()) {
+        // The adjustments reach into the neighbour pixels by their margin, the edit spreads as far through them.
+        m_filterGraph.invalidate(dirtyRect);
+        const int margin = m_filterGraph.margin();
+        dirtyRect = dirtyRect.adjusted(-margin, -margin, margin, margin).intersected(QRect(QPoint(0, 0), m_pyramid.size()));
+        m_photoCanvas->updatePyramid(m_filterGraph.apply(m_pyramid), dirtyRect);
+    }
+
+    // Both the previous and the new outline of an annotation need repainting.
+    QRectF annotationsDirtyRect;
+    for (const auto& state : change.annotations) {
+        annotationsDirtyRect |= m_annotations.annotation(state.id).boundingRect();
+        annotationsDirtyRect |= state.annotation.boundingRect();
+        m_annotations.set(state.id, state.annotation);
+    }
+    if (!annotationsDirtyRect.isEmpty())
+        m_photoCanvas->updateAnnotations(annotationsDirtyRect);
+
+    // Antialiasing may touch the pixels just outside the bounding rects.
+    if (!annotationsDirtyRect.isEmpty())
+        dirtyRect |= annotationsDirtyRect.toAlignedRect().adjusted(-1, -1, 1, 1);
+    updateHistogram(dirtyRect);
+}
+
+void PhotoEditorWindow::resetHistogram()
+{
+    m_histogramResetTimer->stop();
+    if (m_pyramid.isNull()) {
+        m_histogram.clear();
+        m_histogramWidget->setHistogram(m_histogram);
+        return;
+    }
+
+    // Out-of-core levels would be paged in whole and adjusted levels evaluated whole, those are only counted
+    // once they are small enough.
+    const ImagePyramid pyramid = m_filterGraph.apply(m_pyramid);
+    const qint64 maxPixels = qint64(m_filterGraph.isEmpty() ? Constants::HISTOGRAM_OUT_OF_CORE_MAX_MEGAPIXELS
+                                                            : Constants::HISTOGRAM_ADJUSTED_MAX_MEGAPIXELS) * 1000000;
+    m_histogramLevel = 0;
+    while (m_histogramLevel + 1 < pyramid.levelCount() && pyramid.level(m_histogramLevel).isOutOfCore()
+           && qint64(pyramid.level(m_histogramLevel).width()) * pyramid.level(m_histogramLevel).height() > maxPixels)
+        ++m_histogramLevel;
+    m_histogram.setImage(pyramid.level(m_histogramLevel), &m_annotations, m_photoCanvas->annotationOpacity(),
+                         1.0 / (1 << m_histogramLevel));
+    m_histogramWidget->setHistogram(m_histogram);
+}
+
+void PhotoEditorWindow::updateHistogram(const QRect& dirtyRect)
+{
+    if (m_histogram.isNull() || dirtyRect.isEmpty())
+        return;
+
+    const QRect levelRect(QPoint(dirtyRect.left() >> m_histogramLevel, dirtyRect.top() >> m_histogramLevel),
+                          QPoint(dirtyRect.right() >> m_histogramLevel, dirtyRect.bottom() >> m_histogramLevel));
+    m_histogram.updateImage(m_filterGraph.apply(m_pyramid).level(m_histogramLevel), levelRect);
+    m_histogramWidget->setHistogram(m_histogram);
+}
+
+void PhotoEditorWindow::updateHistogramOpacity()
+{
+    if (m_histogram.isNull())
+        return;
+
+    // Only the tiles under annotations change with their opacity.
+    const qreal scale = 1.0 / (1 << m_histogramLevel);
+    const QRectF rect = m_annotations.boundingRect();
+    const QRect levelRect = rect.isEmpty() ? QRect()
+            : QRectF(rect.topLeft() * scale, rect.size() * scale).toAlignedRect().adjusted(-1, -1, 1, 1);
+    m_histogram.setAnnotationOpacity(m_photoCanvas->annotationOpacity(), levelRect);
+    m_histogramWidget->setHistogram(m_histogram);
+}
+
+void PhotoEditorWindow::updateHistoryActions()
+{
+    const bool canUndo = isEditable() && m_editHistory->canUndo(),
+            canRedo = isEditable() && m_editHistory->canRedo();
+    m_undoAction->setEnabled(canUndo);
+    m_redoAction->setEnabled(canRedo);
+    m_undoButton->setEnabled(canUndo);
+    m_redoButton->setEnabled(canRedo);
+    m_undoButton->setToolTip(m_editHistory->canUndo() ? tr("Undo %1").arg(m_editHistory->undoText()) : tr("Undo"));
+    m_redoButton->setToolTip(m_editHistory->canRedo() ? tr("Redo %1").arg(m_editHistory->redoText()) : tr("Redo"));
+}
+
+QColorDialog* PhotoEditorWindow::colorDialog()
+{
+    // Built on the first use, most sessions never open it.
+    if (m_colorDialog)
+        return m_colorDialog;
+
+    m_colorDialog = new QColorDialog(this);
+    auto colorDialogPalette = m_defaultSystemPalette;
+    colorDialogPalette.setColor(QPalette::WindowText, Qt::black);
+    colorDialogPalette.setColor(QPalette::Text, Qt::black);
+    m_colorDialog->setPalette(colorDialogPalette);
+    connect(m_colorDialog, &QColorDialog::colorSelected, this, &PhotoEditorWindow::addDrawColor);
+    return m_colorDialog;
+}
+
+void PhotoEditorWindow::addDrawColor(const QColor& color)
+{
+    const int iconSize = m_colorCombobox->style()->pixelMetric(QStyle::PM_LargeIconSize);
+    QPixmap pixmap(iconSize, iconSize);
+    pixmap.fill(QColor(255, 0, 0, 0));
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    QBrush brush(color);
+    painter.setBrush(brush);
+    painter.drawEllipse(pixmap.rect());
+    QIcon icon(pixmap);
+    if (m_colorCombobox->count() >= m_colorCombobox->maxCount())
+        m_colorCombobox->removeItem(0);
+    const int itemsCount = m_colorCombobox->count();
+    m_colorCombobox->addItem(icon, "", color);
+    m_colorCombobox->setCurrentIndex(itemsCount);
+}
+
+void PhotoEditorWindow::updatePerformanceHud()
+{
+    const Profiler::Counters counters = Profiler::takeCounters();
+    auto formatMs = [](qint64 ns) {
+        return ns < 0 ? QStringLiteral("-") : QString::number(ns / 1e6, 'f', 1);
+    };
+
+    // The photo tiles, the edited tiles kept by the history and the uploaded pixmaps. The tiles of the current
+    // state are held by both the photo and the history.
+    const qint64 imageMemory = m_pyramid.memoryUsage() + m_editHistory->memoryUsage() + m_photoCanvas->tileCacheMemoryUsage();
+    m_performanceHudLabel->setText(tr("Decode %1 ms | Paint %2 ms | Pan %3 fps | Tile cache %4 | Images %5 MB")
+                                   .arg(formatMs(counters.decodeNs), formatMs(counters.paintNs))
+                                   .arg(counters.panningFps > 0.0 ? QString::number(qRound(counters.panningFps)) : QStringLiteral("-"))
+                                   .arg(counters.tileCacheHitRate < 0.0 ? QStringLiteral("-")
+                                                                        : QStringLiteral("%1%").arg(qRound(counters.tileCacheHitRate * 100)))
+                                   .arg(imageMemory / (1024 * 1024)));
+}
+
 void PhotoEditorWindow::init()
 {
     QFont appFont = font();
@@ -92,9 +789,16 @@ void PhotoEditorWindow::init()
     palette.setColor(QPalette::Text, Qt::white);
     QApplication::setPalette(palette);
 
+    // Set before the widgets exist, so each one is polished once.
+    Profiler::ScopedTimer styleSheetTimer("stylesheet", "startup");
+    qApp->setStyleSheet(applicationStyleSheet());
+    styleSheetTimer.finish();
+
+    Profiler::ScopedTimer widgetsTimer("create widgets", "startup");
     createWidgets();
     createLayout();
     createConnections();
+    widgetsTimer.finish();
 
     setCentralWidget(m_centralWidget);
 
@@ -103,7 +807,7 @@ void PhotoEditorWindow::init()
     setWindowFlags(windowFlags() | Qt::FramelessWindowHint);
     setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding);
     statusBar()->setSizeGripEnabled(true);
-    statusBar()->setStyleSheet(QString("QStatusBar { background-color: %1; }").arg(Constants::APP_BACKGROUND_COLOR));
+    statusBar()->setObjectName("statusBar");
 
     // Set minimum size for the Scanner Main Window.
     const QSize preferredMinimumSize = QSize(qRound(1366 * m_scaleFactor), qRound(844 * m_scaleFactor));
@@ -123,12 +827,12 @@ void PhotoEditorWindow::init()
 }
 void PhotoEditorWindow::createWidgets()
 {
-    const int delimiterLineThickness = qRound(Constants::DELIMITER_LINE_THICKNESS_PX * m_scaleFactor);
-    const QString toolBarStyleSheet = QString("QToolBar { background-color: %1; border-top: %2px solid %3; border-bottom: %2px solid %3; }")
-            .arg(Constants::TOOL_BAR_COLOR).arg(delimiterLineThickness).arg(Constants::DELIMITER_LINE_COLOR),
-            titleToolBarStyleSheet = QString("QToolBar { background-color: %1; }").arg(Constants::TOOL_BAR_COLOR);
-
-    const QString sToolButtonStyleSheet = toolButtonStyleSheet();
+    // Widgets are styled by the application stylesheet through their object names. Icons are loaded from
+    // rasters cached at the size the toolbars request, not rendered from the SVG resources.
+    const qreal pixelRatio = devicePixelRatioF();
+    auto cachedIcon = [pixelRatio](const QString& resourcePath, const QSize& size) {
+        return IconCache::icon(resourcePath, size, pixelRatio);
+    };
 
     // --------------------------------------------------------------------------
     // Title toolbar
@@ -136,42 +840,37 @@ void PhotoEditorWindow::createWidgets()
     m_titleToolBar = new QToolBar(m_centralWidget);
     m_titleToolBar->setMovable(false);
     m_titleToolBar->setFixedHeight(qRound(Constants::TITLE_BAR_HEIGHT_PX * m_scaleFactor));
-    m_titleToolBar->setStyleSheet(titleToolBarStyleSheet);
-
-    const QString sTitleIconToolButtonStyleSheet = titleIconToolButtonStyleSheet(),
-            sTitleToolButtonStyleSheet = titleToolButtonStyleSheet(),
-            sSystemToolButtonStyleSheet = systemToolButtonStyleSheet(),
-            sCloseSystemToolButtonStyleSheet = closeSystemToolButtonStyleSheet(),
-            sTitleLabelStyleSheet = "QLabel { color: white; }";
+    m_titleToolBar->setObjectName("titleToolBar");
+    const QSize titleIconSize = m_titleToolBar->iconSize();
 
     m_titleIconButton = new QToolButton(m_titleToolBar);
-    m_titleIconButton->setIcon(QIcon(":/resources/svg/pe"));
-    m_titleIconButton->setStyleSheet(sTitleIconToolButtonStyleSheet);
+    m_titleIconButton->setIcon(cachedIcon(":/resources/svg/pe", titleIconSize));
+    m_titleIconButton->setObjectName("titleIconButton");
 
     m_titleLabel = new QLabel(tr("Photo Editor 1.0"), m_titleToolBar);
-    m_titleLabel->setStyleSheet(sTitleLabelStyleSheet);
+    m_titleLabel->setObjectName("titleLabel");
 
     m_settingsButton = new QToolButton(m_titleToolBar);
-    m_settingsButton->setIcon(QIcon(":/resources/svg/settings"));
-    m_settingsButton->setStyleSheet(sTitleToolButtonStyleSheet);
+    m_settingsButton->setIcon(cachedIcon(":/resources/svg/settings", titleIconSize));
+    m_settingsButton->setObjectName("settingsButton");
 
     m_helpButton = new QToolButton(m_titleToolBar);
-    m_helpButton->setIcon(QIcon(":/resources/svg/help"));
-    m_helpButton->setStyleSheet(sTitleToolButtonStyleSheet);
+    m_helpButton->setIcon(cachedIcon(":/resources/svg/help", titleIconSize));
+    m_helpButton->setObjectName("helpButton");
 
     m_minimizeButton = new QToolButton(m_titleToolBar);
-    m_minimizeButton->setIcon(QIcon(":/resources/svg/minimize"));
-    m_minimizeButton->setStyleSheet(sSystemToolButtonStyleSheet);
+    m_minimizeButton->setIcon(cachedIcon(":/resources/svg/minimize", titleIconSize));
+    m_minimizeButton->setObjectName("minimizeButton");
     m_minimizeButton->setToolTip(tr("Minimize"));
 
     m_maximizeButton = new QToolButton(m_titleToolBar);
-    m_maximizeButton->setIcon(QIcon(":/resources/svg/maximize"));
-    m_maximizeButton->setStyleSheet(sSystemToolButtonStyleSheet);
+    m_maximizeButton->setIcon(cachedIcon(":/resources/svg/maximize", titleIconSize));
+    m_maximizeButton->setObjectName("maximizeButton");
     m_maximizeButton->setToolTip(tr("Maximize"));
 
     m_closeButton = new QToolButton(m_titleToolBar);
-    m_closeButton->setIcon(QIcon(":/resources/svg/close"));
-    m_closeButton->setStyleSheet(sCloseSystemToolButtonStyleSheet);
+    m_closeButton->setIcon(cachedIcon(":/resources/svg/close", titleIconSize));
+    m_closeButton->setObjectName("closeButton");
     m_closeButton->setToolTip(tr("Close"));
 
     QWidget* titleSpacer = new QWidget(m_titleToolBar);
@@ -187,7 +886,7 @@ void PhotoEditorWindow::createWidgets()
     m_titleToolBar->addWidget(m_closeButton);
 
     m_centralWidget = new QWidget(this);
-    m_centralWidget->setStyleSheet(QString("QWidget { background-color: %1; }").arg(Constants::APP_BACKGROUND_COLOR));
+    m_centralWidget->setObjectName("centralWidget");
 
     // --------------------------------------------------------------------------
     // Header toolbar
@@ -195,54 +894,75 @@ void PhotoEditorWindow::createWidgets()
     m_headerToolBar = new QToolBar(m_centralWidget);
     m_headerToolBar->setMovable(false);
     m_headerToolBar->setFixedHeight(qRound(Constants::HEADER_TOOL_BAR_HEIGHT_PX * m_scaleFactor));
-    m_headerToolBar->setStyleSheet(toolBarStyleSheet);
+    m_headerToolBar->setObjectName("headerToolBar");
     const int headerToolbarSideMargin = qRound(Constants::HEADER_TOOL_BAR_SIDE_MARGIN_PX * m_scaleFactor);
     m_headerToolBar->setContentsMargins(headerToolbarSideMargin, 0, headerToolbarSideMargin, 0);
 
     m_openFileAction = new QAction(tr("Open file"), m_headerToolBar);
     m_openFileAction->setShortcuts(QKeySequence::Open);
+    m_nextPhotoAction = new QAction(tr("Next photo in folder"), m_headerToolBar);
+    m_nextPhotoAction->setShortcut(Qt::Key_PageDown);
+    m_nextPhotoAction->setEnabled(false);
+    m_previousPhotoAction = new QAction(tr("Previous photo in folder"), m_headerToolBar);
+    m_previousPhotoAction->setShortcut(Qt::Key_PageUp);
+    m_previousPhotoAction->setEnabled(false);
     m_saveFileAction = new QAction(tr("Save"), m_headerToolBar);
     m_saveFileAction->setShortcuts(QKeySequence::Save);
     m_saveAsFileAction = new QAction(tr("Save as..."), m_headerToolBar);
     m_saveAsFileAction->setShortcuts(QKeySequence::SaveAs);
+    m_resizeImageAction = new QAction(tr("Resize image..."), m_headerToolBar);
+    m_adjustImageAction = new QAction(tr("Adjustments..."), m_headerToolBar);
     m_printAction = new QAction(tr("Print"), m_headerToolBar);
     m_printAction->setShortcuts(QKeySequence::Print);
+    m_exportTraceAction = new QAction(tr("Export performance trace..."), m_headerToolBar);
 
-    const QString sFileMenuStyleSheet = fileMenuStyleSheet();
     m_fileMenu = new QMenu(tr("File"), m_headerToolBar);
     m_fileMenu->addAction(m_openFileAction);
+    m_fileMenu->addAction(m_nextPhotoAction);
+    m_fileMenu->addAction(m_previousPhotoAction);
     m_fileMenu->addSeparator();
     m_fileMenu->addAction(m_saveFileAction);
     m_fileMenu->addAction(m_saveAsFileAction);
     m_fileMenu->addSeparator();
+    m_fileMenu->addAction(m_resizeImageAction);
+    m_fileMenu->addAction(m_adjustImageAction);
+    m_fileMenu->addSeparator();
     m_fileMenu->addAction(m_printAction);
-    m_fileMenu->setStyleSheet(sFileMenuStyleSheet);
+    m_fileMenu->addSeparator();
+    m_fileMenu->addAction(m_exportTraceAction);
+    m_fileMenu->setObjectName("fileMenu");
     m_fileMenu->setFixedWidth(qRound(Constants::FILE_MENU_WIDTH_PX * m_scaleFactor));
 
-    const QString sFileMenuToolButtonStyleSheet = fileMenuToolButtonStyleSheet();
     auto fileMenuToolButtonFont = font();
     m_fileMenuToolButton = new QToolButton(m_headerToolBar);
     m_fileMenuToolButton->setFont(fileMenuToolButtonFont);
     m_fileMenuToolButton->setText(tr("File"));
     m_fileMenuToolButton->setMenu(m_fileMenu);
     m_fileMenuToolButton->setPopupMode(QToolButton::MenuButtonPopup);
-    m_fileMenuToolButton->setStyleSheet(sFileMenuToolButtonStyleSheet);
+    m_fileMenuToolButton->setObjectName("fileMenuToolButton");
 
     m_undoButton = new QToolButton(m_headerToolBar);
-    m_undoButton->setIcon(QIcon(":/resources/svg/undo"));
-    m_undoButton->setStyleSheet(sToolButtonStyleSheet);
+    m_undoButton->setIcon(cachedIcon(":/resources/svg/undo", m_headerToolBar->iconSize()));
+    m_undoButton->setObjectName("undoButton");
 
     m_redoButton = new QToolButton(m_headerToolBar);
-    m_redoButton->setIcon(QIcon(":/resources/svg/redo"));
-    m_redoButton->setStyleSheet(sToolButtonStyleSheet);
+    m_redoButton->setIcon(cachedIcon(":/resources/svg/redo", m_headerToolBar->iconSize()));
+    m_redoButton->setObjectName("redoButton");
 
     m_resetButton = new QToolButton(m_headerToolBar);
-    m_resetButton->setIcon(QIcon(":/resources/svg/reset"));
-    m_resetButton->setStyleSheet(sToolButtonStyleSheet);
+    m_resetButton->setIcon(cachedIcon(":/resources/svg/reset", m_headerToolBar->iconSize()));
+    m_resetButton->setObjectName("resetButton");
+    m_resetButton->setToolTip(tr("Reset"));
+
+    m_undoAction = new QAction(tr("Undo"), this);
+    m_undoAction->setShortcuts(QKeySequence::Undo);
+    addAction(m_undoAction);
+    m_redoAction = new QAction(tr("Redo"), this);
+    m_redoAction->setShortcuts(QKeySequence::Redo);
+    addAction(m_redoAction);
 
     m_copyButton = new QPushButton(tr("Copy"), m_headerToolBar);
-    m_copyButton->setStyleSheet(pushButtonStyleSheet(":/resources/svg/copy-rest", ":/resources/svg/copy-hover",
-                                                     ":/resources/svg/copy-pressed", ":/resources/svg/copy-disabled"));
+    m_copyButton->setObjectName("copyButton");
 
     QWidget* headerSpacer = new QWidget(m_headerToolBar);
     headerSpacer->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
@@ -256,16 +976,11 @@ void PhotoEditorWindow::createWidgets()
     // --------------------------------------------------------------------------
     // Draw Tools toolbar
 
-    QString drawToolsPanelStyleSheet = QString("QToolBar { background-color: %1; }").arg(Constants::TOOL_BAR_COLOR),
-            drawToolsSidePanelStyleSheet = QString("QToolBar { background-color: %1; }").arg(Constants::TOOL_BAR_COLOR);
-
     m_drawToolsSidePanel = new QWidget(this);
-    m_drawToolsSidePanel->setStyleSheet(drawToolsSidePanelStyleSheet);
     m_drawToolsSidePanel->setFixedWidth(qRound(Constants::DRAW_TOOLS_SIDE_PANEL_WIDTH_PX * m_scaleFactor));
 
     m_drawToolsPanel = new QWidget(this);
     m_drawToolsPanel->setFixedHeight(qRound(Constants::DRAW_TOOLS_PANEL_HEIGHT_PX * m_scaleFactor));
-    m_drawToolsPanel->setStyleSheet(drawToolsPanelStyleSheet);
 
     m_drawToolsLabel = new QLabel(tr("Draw Tools"), m_drawToolsPanel);
     auto drawToolsLabelFont = font();
@@ -277,31 +992,42 @@ void PhotoEditorWindow::createWidgets()
     m_drawToolsButtonGroup->setExclusive(true);
 
     m_drawToolsBar = new QToolBar(m_drawToolsPanel);
+    m_drawToolsBar->setObjectName("drawToolsBar");
 
     m_pencilDrawToolButton = new QToolButton();
     m_pencilDrawToolButton->setCheckable(true);
     m_pencilDrawToolButton->setChecked(true);
-    m_pencilDrawToolButton->setStyleSheet(checkableDrawToolButtonStyleSheet(":/resources/svg/pencil", ":/resources/svg/pencil-checked"));
+    m_pencilDrawToolButton->setObjectName("pencilDrawToolButton");
 
     m_arrowDrawToolButton = new QToolButton();
     m_arrowDrawToolButton->setCheckable(true);
-    m_arrowDrawToolButton->setStyleSheet(checkableDrawToolButtonStyleSheet(":/resources/svg/arrow", ":/resources/svg/arrow-checked"));
+    m_arrowDrawToolButton->setObjectName("arrowDrawToolButton");
 
     m_boxDrawToolButton = new QToolButton();
     m_boxDrawToolButton->setCheckable(true);
-    m_boxDrawToolButton->setStyleSheet(checkableDrawToolButtonStyleSheet(":/resources/svg/box", ":/resources/svg/box-checked"));
+    m_boxDrawToolButton->setObjectName("boxDrawToolButton");
 
     m_ellipseDrawToolButton = new QToolButton();
     m_ellipseDrawToolButton->setCheckable(true);
-    m_ellipseDrawToolButton->setStyleSheet(checkableDrawToolButtonStyleSheet(":/resources/svg/ellipse", ":/resources/svg/ellipse-checked"));
+    m_ellipseDrawToolButton->setObjectName("ellipseDrawToolButton");
 
     m_triangleDrawToolButton = new QToolButton();
     m_triangleDrawToolButton->setCheckable(true);
-    m_triangleDrawToolButton->setStyleSheet(checkableDrawToolButtonStyleSheet(":/resources/svg/triangle", ":/resources/svg/triangle-checked"));
+    m_triangleDrawToolButton->setObjectName("triangleDrawToolButton");
 
     m_starDrawToolButton = new QToolButton(m_drawToolsPanel);
     m_starDrawToolButton->setCheckable(true);
-    m_starDrawToolButton->setStyleSheet(checkableDrawToolButtonStyleSheet(":/resources/svg/star", ":/resources/svg/star-checked"));
+    m_starDrawToolButton->setObjectName("starDrawToolButton");
+
+    m_blurDrawToolButton = new QToolButton(m_drawToolsPanel);
+    m_blurDrawToolButton->setCheckable(true);
+    m_blurDrawToolButton->setObjectName("blurDrawToolButton");
+    m_blurDrawToolButton->setToolTip(tr("Blur"));
+
+    m_pixelateDrawToolButton = new QToolButton(m_drawToolsPanel);
+    m_pixelateDrawToolButton->setCheckable(true);
+    m_pixelateDrawToolButton->setObjectName("pixelateDrawToolButton");
+    m_pixelateDrawToolButton->setToolTip(tr("Pixelate"));
 
     m_drawToolsButtonGroup->addButton(m_pencilDrawToolButton, PencilDrawTool);
     m_drawToolsButtonGroup->addButton(m_arrowDrawToolButton, ArrowDrawTool);
@@ -309,6 +1035,8 @@ void PhotoEditorWindow::createWidgets()
     m_drawToolsButtonGroup->addButton(m_ellipseDrawToolButton, EllipseDrawTool);
     m_drawToolsButtonGroup->addButton(m_triangleDrawToolButton, TriangleDrawTool);
     m_drawToolsButtonGroup->addButton(m_starDrawToolButton, StarDrawTool);
+    m_drawToolsButtonGroup->addButton(m_blurDrawToolButton, BlurDrawTool);
+    m_drawToolsButtonGroup->addButton(m_pixelateDrawToolButton, PixelateDrawTool);
 
     auto drawToolsBarSpacerRight = new QWidget(m_drawToolsBar);
     drawToolsBarSpacerRight->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
@@ -319,16 +1047,13 @@ void PhotoEditorWindow::createWidgets()
     m_drawToolsBar->addWidget(m_ellipseDrawToolButton);
     m_drawToolsBar->addWidget(m_triangleDrawToolButton);
     m_drawToolsBar->addWidget(m_starDrawToolButton);
+    m_drawToolsBar->addWidget(m_blurDrawToolButton);
+    m_drawToolsBar->addWidget(m_pixelateDrawToolButton);
     m_drawToolsBar->addWidget(drawToolsBarSpacerRight);
 
     // --------------------------------------------------------------------------
     // Draw Tools Settings toolbar
 
-    const QString sOpacityLineEditStyleSheet = opacityLineEditStyleSheet(),
-            sOpacitySliderStyleSheet = opacitySliderStyleSheet(),
-            sRoundToolButtonStyleSheet = roundToolButtonStyleSheet(),
-            sRoundComboboxStyleSheet = roundComboboxStyleSheet();
-
     m_drawToolsSettingsPanel = new QWidget(m_centralWidget);
 
     m_opacityLabel = new QLabel(tr("Opacity image"), m_drawToolsSettingsPanel);
@@ -336,11 +1061,11 @@ void PhotoEditorWindow::createWidgets()
     m_opacitySlider = new QSlider(Qt::Horizontal, m_drawToolsSettingsPanel);
     m_opacitySlider->setRange(0, Constants::SLIDER_MAX_VALUE);
     m_opacitySlider->setValue(Constants::SLIDER_MAX_VALUE);
-    m_opacitySlider->setStyleSheet(sOpacitySliderStyleSheet);
+    m_opacitySlider->setObjectName("opacitySlider");
 
     m_opacityLineEdit = new QLineEdit(m_drawToolsSettingsPanel);
     m_opacityLineEdit->setFixedWidth(qRound(Constants::OPACITY_LINE_EDIT_WIDTH_PX * m_scaleFactor));
-    m_opacityLineEdit->setStyleSheet(sOpacityLineEditStyleSheet);
+    m_opacityLineEdit->setObjectName("opacityLineEdit");
     QRegExp rx("^([1-9][0-9]{0,1}|100)$");
     auto* opacityVaidator = new QRegExpValidator(rx, m_opacityLineEdit);
     m_opacityLineEdit->setValidator(opacityVaidator);
@@ -349,52 +1074,114 @@ void PhotoEditorWindow::createWidgets()
     m_outlineColorLabel = new QLabel(tr("Outline color"), m_drawToolsSettingsPanel);
 
     m_pipetteToolButton = new QToolButton(m_drawToolsSettingsPanel);
-    m_pipetteToolButton->setIcon(QIcon(":/resources/svg/pipette"));
-    m_pipetteToolButton->setStyleSheet(sRoundToolButtonStyleSheet);
+    m_pipetteToolButton->setObjectName("pipetteToolButton");
     const int roundToolButtonIconSize = qRound(Constants::ROUND_TOOL_BUTTON_ICON_SIZE_PX * m_scaleFactor);
     m_pipetteToolButton->setIconSize(QSize(roundToolButtonIconSize, roundToolButtonIconSize));
-
-    m_colorDialog = new QColorDialog(this);
-    auto colorDialogPalette = m_defaultSystemPalette;
-    colorDialogPalette.setColor(QPalette::WindowText, Qt::black);
-    colorDialogPalette.setColor(QPalette::Text, Qt::black);
-    m_colorDialog->setPalette(colorDialogPalette);
+    m_pipetteToolButton->setIcon(cachedIcon(":/resources/svg/pipette", m_pipetteToolButton->iconSize()));
+    m_pipetteToolButton->setCheckable(true);
+    m_pipetteToolButton->setToolTip(tr("Pick a color from the photo, hold for the sample size"));
+
+    // Clicking the pipette toggles it, holding it opens the menu.
+    m_pipetteMenu = new QMenu(m_pipetteToolButton);
+    m_pipetteMenu->setObjectName("pipetteMenu");
+    m_pipetteSampleSizeGroup = new QActionGroup(m_pipetteMenu);
+    for (const int sampleSize : { 1, 3, 11, 51 }) {
+        QAction* sampleSizeAction = m_pipetteMenu->addAction(sampleSize == 1 ? tr("Point sample")
+                                                                             : tr("%1 by %1 average").arg(sampleSize));
+        sampleSizeAction->setCheckable(true);
+        sampleSizeAction->setChecked(sampleSize == Constants::PIPETTE_DEFAULT_SAMPLE_SIZE_PX);
+        sampleSizeAction->setData(sampleSize);
+        m_pipetteSampleSizeGroup->addAction(sampleSizeAction);
+    }
+    m_pipetteMenu->addSeparator();
+    m_chooseColorAction = m_pipetteMenu->addAction(tr("Choose Color..."));
+    m_pipetteToolButton->setMenu(m_pipetteMenu);
+    m_pipetteToolButton->setPopupMode(QToolButton::DelayedPopup);
 
     m_colorCombobox = new QComboBox(m_drawToolsSettingsPanel);
-    m_colorCombobox->setStyleSheet(sRoundComboboxStyleSheet);
+    m_colorCombobox->setObjectName("colorCombobox");
     m_colorCombobox->setItemDelegate(new ColorItemDelegate);
     const int roundComboBoxIconSize = qRound(Constants::ROUND_COMBO_BOX_ICON_SIZE_PX * m_scaleFactor);
     m_colorCombobox->setIconSize(QSize(roundComboBoxIconSize, roundComboBoxIconSize));
     m_colorCombobox->setMaxCount(10);
 
     // --------------------------------------------------------------------------
-    // Photo zone
+    // Histogram panel
+
+    m_histogramPanel = new QWidget(m_centralWidget);
+    m_histogramLabel = new QLabel(tr("Histogram"), m_histogramPanel);
+    m_histogramWidget = new HistogramWidget(m_histogramPanel);
+    // Dragging the opacity slider recounts the histogram once, where it stops.
+    m_histogramOpacityTimer = new QTimer(this);
+    m_histogramOpacityTimer->setSingleShot(true);
+    m_histogramOpacityTimer->setInterval(Constants::HISTOGRAM_RECOUNT_DELAY_MS);
+    m_histogramResetTimer = new QTimer(this);
+    m_histogramResetTimer->setSingleShot(true);
+    m_histogramResetTimer->setInterval(Constants::HISTOGRAM_RECOUNT_DELAY_MS);
+    m_histogramWidget->setFixedHeight(qRound(Constants::HISTOGRAM_HEIGHT_PX * m_scaleFactor));
 
-    const QString sPhotoScrollAreaStyleSheet = photoScrollAreaStyleSheet(),
-            sPhotoLabelStyleSheet = QString("QLabel { background-color: %1; }").arg(Constants::PHOTO_ZONE_COLOR);
+    // --------------------------------------------------------------------------
+    // Photo zone
 
-    m_photoLabel = new QLabel(m_centralWidget);
-    m_photoLabel->setBackgroundRole(QPalette::Base);
-    m_photoLabel->setScaledContents(true);
-    m_photoLabel->setStyleSheet(sPhotoLabelStyleSheet);
-    m_photoLabel->setAlignment(Qt::AlignCenter);
+    m_photoCanvas = new PhotoCanvas(m_centralWidget);
 
     m_photoScrollArea = new QScrollArea(m_centralWidget);
-    m_photoScrollArea->setStyleSheet(sPhotoScrollAreaStyleSheet);
-    m_photoScrollArea->setWidget(m_photoLabel);
+    m_photoScrollArea->setObjectName("photoScrollArea");
+    m_photoScrollArea->setWidget(m_photoCanvas);
     m_photoScrollArea->setAlignment(Qt::AlignCenter);
     m_photoScrollArea->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding);
 
+    m_filmstrip = new Filmstrip(m_centralWidget);
+    m_filmstrip->setObjectName("filmstrip");
+    m_filmstrip->setThumbnailSize(qRound(Constants::FILMSTRIP_THUMBNAIL_SIZE_PX * m_scaleFactor));
+    m_filmstrip->setVisible(false);
+
     // --------------------------------------------------------------------------
     // Footer toolbar
 
-    const QString footerToolBarStyleSheet = QString("QToolBar { background-color: %1; border-top: %2px solid %3; }")
-            .arg(Constants::TOOL_BAR_COLOR).arg(delimiterLineThickness).arg(Constants::DELIMITER_LINE_COLOR);
-
     m_footerToolBar = new QToolBar(m_centralWidget);
     m_footerToolBar->setMovable(false);
     m_footerToolBar->setFixedHeight(qRound(Constants::FOOTER_TOOL_BAR_HEIGHT_PX * m_scaleFactor));
-    m_footerToolBar->setStyleSheet(footerToolBarStyleSheet);
+    m_footerToolBar->setObjectName("footerToolBar");
+    const int footerToolbarSideMargin = qRound(Constants::HEADER_TOOL_BAR_SIDE_MARGIN_PX * m_scaleFactor);
+    m_footerToolBar->setContentsMargins(footerToolbarSideMargin, 0, footerToolbarSideMargin, 0);
+
+    m_statusLabel = new QLabel(m_footerToolBar);
+
+    m_progressBar = new QProgressBar(m_footerToolBar);
+    m_progressBar->setRange(0, 100);
+    m_progressBar->setTextVisible(false);
+    m_progressBar->setFixedSize(qRound(Constants::PROGRESS_BAR_WIDTH_PX * m_scaleFactor), qRound(Constants::PROGRESS_BAR_HEIGHT_PX * m_scaleFactor));
+    m_progressBar->setObjectName("progressBar");
+
+    m_performanceHudLabel = new QLabel(m_footerToolBar);
+
+    m_performanceHudAction = new QAction(tr("Performance"), this);
+    m_performanceHudAction->setCheckable(true);
+    m_performanceHudAction->setShortcut(Qt::Key_F12);
+    m_performanceHudAction->setToolTip(tr("Show the performance counters (F12)"));
+    addAction(m_performanceHudAction);
+    m_performanceHudButton = new QToolButton(m_footerToolBar);
+    m_performanceHudButton->setDefaultAction(m_performanceHudAction);
+    m_performanceHudButton->setObjectName("performanceHudButton");
+    m_performanceHudTimer = new QTimer(this);
+    m_performanceHudTimer->setInterval(Constants::PERF_HUD_REFRESH_INTERVAL_MS);
+
+    QWidget* footerSpacer = new QWidget(m_footerToolBar);
+    footerSpacer->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    m_footerToolBar->addWidget(m_statusLabel);
+    m_footerToolBar->addWidget(footerSpacer);
+    m_performanceHudLabelAction = m_footerToolBar->addWidget(m_performanceHudLabel);
+    m_performanceHudLabelAction->setVisible(false);
+    m_progressBarAction = m_footerToolBar->addWidget(m_progressBar);
+    m_progressBarAction->setVisible(false);
+    m_footerToolBar->addWidget(m_performanceHudButton);
+
+    m_photoLoader = new PhotoLoader(this);
+    m_photoSaver = new PhotoSaver(this);
+    m_editHistory = new EditHistory(this);
+    m_recoveryJournal = new RecoveryJournal(this);
+    updateHistoryActions();
 }
 
 void PhotoEditorWindow::createLayout()
@@ -405,7 +1192,7 @@ void PhotoEditorWindow::createLayout()
         auto horizontalLine = new QFrame(parent);
         horizontalLine->setFrameStyle(QFrame::HLine | QFrame::Plain);
         horizontalLine->setLineWidth(qRound(Constants::DELIMITER_LINE_THICKNESS_PX * m_scaleFactor));
-        horizontalLine->setStyleSheet(QString("QFrame { color: %1; } ").arg(Constants::DELIMITER_LINE_COLOR));
+        horizontalLine->setObjectName("delimiterLine");
         return horizontalLine;
     };
 
@@ -413,7 +1200,7 @@ void PhotoEditorWindow::createLayout()
         auto horizontalLine = new QFrame(parent);
         horizontalLine->setFrameStyle(QFrame::VLine | QFrame::Plain);
         horizontalLine->setLineWidth(qRound(Constants::DELIMITER_LINE_THICKNESS_PX * m_scaleFactor));
-        horizontalLine->setStyleSheet(QString("QFrame { color: %1; } ").arg(Constants::DELIMITER_LINE_COLOR));
+        horizontalLine->setObjectName("delimiterLine");
         return horizontalLine;
     };
 
@@ -445,20 +1232,34 @@ void PhotoEditorWindow::createLayout()
 
     m_drawToolsSettingsPanel->setLayout(drawToolsSettingsVBoxLayout);
 
+    auto histogramVBoxLayout = new QVBoxLayout;
+    histogramVBoxLayout->addWidget(m_histogramLabel);
+    histogramVBoxLayout->addWidget(m_histogramWidget);
+    histogramVBoxLayout->setContentsMargins(0, 0, 0, 0);
+    m_histogramPanel->setLayout(histogramVBoxLayout);
+
     auto horizontalLineDrawTools = createHorizontalLine(m_drawToolsSidePanel);
     auto horizontalLineDrawToolsSettings = createHorizontalLine(m_drawToolsSidePanel);
+    auto horizontalLineHistogram = createHorizontalLine(m_drawToolsSidePanel);
     auto drawToolsPanelVBoxLayout = new QVBoxLayout;
     drawToolsPanelVBoxLayout->addWidget(m_drawToolsPanel);
     drawToolsPanelVBoxLayout->addWidget(horizontalLineDrawTools);
     drawToolsPanelVBoxLayout->addWidget(m_drawToolsSettingsPanel);
     drawToolsPanelVBoxLayout->addWidget(horizontalLineDrawToolsSettings);
+    drawToolsPanelVBoxLayout->addWidget(m_histogramPanel);
+    drawToolsPanelVBoxLayout->addWidget(horizontalLineHistogram);
     drawToolsPanelVBoxLayout->addStretch(1);
     drawToolsSettingsVBoxLayout->setContentsMargins(0, 0, 0, 0);
     m_drawToolsSidePanel->setLayout(drawToolsPanelVBoxLayout);
 
     auto mainAreaVerticalLine = createVerticallLine(this);
+    auto photoZoneVBoxLayout = new QVBoxLayout;
+    photoZoneVBoxLayout->addWidget(m_photoScrollArea);
+    photoZoneVBoxLayout->addWidget(m_filmstrip);
+    photoZoneVBoxLayout->setSpacing(0);
+
     auto mainAreaHBoxLayout = new QHBoxLayout;
-    mainAreaHBoxLayout->addWidget(m_photoScrollArea);
+    mainAreaHBoxLayout->addLayout(photoZoneVBoxLayout);
     mainAreaHBoxLayout->addWidget(mainAreaVerticalLine);
     mainAreaHBoxLayout->addWidget(m_drawToolsSidePanel);
 
@@ -479,11 +1280,11 @@ void PhotoEditorWindow::createConnections()
     });
     connect(m_maximizeButton, &QToolButton::clicked, [&]() {
         if (isMaximized()) {
-            m_maximizeButton->setIcon(QIcon(":/resources/svg/maximize"));
+            m_maximizeButton->setIcon(IconCache::icon(":/resources/svg/maximize", m_titleToolBar->iconSize(), devicePixelRatioF()));
             m_maximizeButton->setToolTip(tr("Maximize"));
             showNormal();
         } else {
-            m_maximizeButton->setIcon(QIcon(":/resources/svg/restore-down"));
+            m_maximizeButton->setIcon(IconCache::icon(":/resources/svg/restore-down", m_titleToolBar->iconSize(), devicePixelRatioF()));
             m_maximizeButton->setToolTip(tr("Restore Down"));
             showMaximized();
         }
@@ -494,120 +1295,300 @@ void PhotoEditorWindow::createConnections()
     connect(m_drawToolsButtonGroup, QOverload<QAbstractButton *, bool>::of(&QButtonGroup::buttonToggled),
         [=](QAbstractButton *button, bool checked){
         button->setChecked(checked);
+        if (checked)
+            m_photoCanvas->setDrawTool(static_cast<Annotation::Type>(m_drawToolsButtonGroup->id(button)));
     });
     connect(m_opacitySlider, &QSlider::valueChanged, [&](int value) {
         QSignalBlocker blocker(m_opacityLineEdit);
         m_opacityLineEdit->setText(QString::number(value));
+        m_photoCanvas->setAnnotationOpacity(qRound(value * 255.0 / Constants::SLIDER_MAX_VALUE));
+        m_clipboardContent.reset();
+        m_histogramOpacityTimer->start();
     });
     connect(m_opacityLineEdit, &QLineEdit::textChanged, [&](const QString& value) {
         QSignalBlocker blocker(m_opacitySlider);
         m_opacitySlider->setValue(value.toInt());
+        m_photoCanvas->setAnnotationOpacity(qRound(m_opacitySlider->value() * 255.0 / Constants::SLIDER_MAX_VALUE));
+        m_clipboardContent.reset();
+        m_histogramOpacityTimer->start();
+    });
+    connect(m_pipetteToolButton, &QToolButton::toggled, [&](bool checked) {
+        // Without a photo there is nothing to sample, the color dialog opens instead.
+        if (checked && m_pyramid.isNull()) {
+            QSignalBlocker blocker(m_pipetteToolButton);
+            m_pipetteToolButton->setChecked(false);
+            colorDialog()->show();
+            return;
+        }
+        m_photoCanvas->setPipetteActive(checked);
+    });
+    connect(m_pipetteSampleSizeGroup, &QActionGroup::triggered, [&](QAction* action) {
+        m_photoCanvas->setPipetteSampleSize(action->data().toInt());
+    });
+    connect(m_chooseColorAction, &QAction::triggered, [&]() {
+        colorDialog()->show();
     });
-    connect(m_pipetteToolButton, &QToolButton::clicked, [&]() {
-        m_colorDialog->show();
+    connect(m_photoCanvas, &PhotoCanvas::colorPicked, [&](const QColor& color) {
+        addDrawColor(color);
+        m_pipetteToolButton->setChecked(false);
     });
-    connect(m_colorDialog, &QColorDialog::colorSelected, [&](const QColor& color) {
-        const int iconSize = m_colorCombobox->style()->pixelMetric(QStyle::PM_LargeIconSize);
-        QPixmap pixmap(iconSize, iconSize);
-        pixmap.fill(QColor(255, 0, 0, 0));
-        QPainter painter(&pixmap);
-        painter.setRenderHint(QPainter::Antialiasing, true);
-        QBrush brush(color);
-        painter.setBrush(brush);
-        painter.drawEllipse(pixmap.rect());
-        QIcon icon(pixmap);
-        const int itemsCount = m_colorCombobox->count();
-        m_colorCombobox->addItem(icon, "");
-        m_colorCombobox->setCurrentIndex(itemsCount);
+    connect(m_photoCanvas, &PhotoCanvas::pipetteCanceled, [&]() {
+        m_pipetteToolButton->setChecked(false);
+    });
+    connect(m_colorCombobox, QOverload<int>::of(&QComboBox::currentIndexChanged), [&](int index) {
+        const QVariant color = m_colorCombobox->itemData(index);
+        if (color.isValid())
+            m_photoCanvas->setDrawColor(color.value<QColor>());
+    });
+    connect(m_photoCanvas, &PhotoCanvas::annotationDrawn, [&](const Annotation& annotation) {
+        EditHistory::Change change;
+        change.annotations.append({ m_annotations.nextId(), annotation });
+        applyEdit(tr("Draw"), change);
+    });
+    connect(m_photoCanvas, &PhotoCanvas::redactionDrawn, this, &PhotoEditorWindow::redact);
+    connect(m_photoCanvas, &PhotoCanvas::annotationDeleteRequested, [&](quint64 id) {
+        EditHistory::Change change;
+        change.annotations.append({ id, Annotation() });
+        applyEdit(tr("Delete"), change);
     });
     connect(m_openFileAction, &QAction::triggered, this, &PhotoEditorWindow::openFile);
+    connect(m_nextPhotoAction, &QAction::triggered, this, &PhotoEditorWindow::openNextPhoto);
+    connect(m_previousPhotoAction, &QAction::triggered, this, &PhotoEditorWindow::openPreviousPhoto);
+    connect(m_filmstrip, &Filmstrip::photoActivated, this, &PhotoEditorWindow::loadPhoto);
+    connect(m_saveFileAction, &QAction::triggered, this, &PhotoEditorWindow::saveFile);
+    connect(m_saveAsFileAction, &QAction::triggered, this, &PhotoEditorWindow::saveFileAs);
+    connect(m_copyButton, &QPushButton::clicked, this, &PhotoEditorWindow::copy);
+    connect(m_resizeImageAction, &QAction::triggered, this, &PhotoEditorWindow::resizeImage);
+    connect(m_adjustImageAction, &QAction::triggered, this, &PhotoEditorWindow::adjustImage);
+    connect(m_printAction, &QAction::triggered, this, &PhotoEditorWindow::print);
+    connect(m_exportTraceAction, &QAction::triggered, this, &PhotoEditorWindow::exportTrace);
+    connect(m_performanceHudAction, &QAction::toggled, [&](bool checked) {
+        m_performanceHudLabelAction->setVisible(checked);
+        if (checked) {
+            updatePerformanceHud();
+            m_performanceHudTimer->start();
+        } else {
+            m_performanceHudTimer->stop();
+        }
+    });
+    connect(m_performanceHudTimer, &QTimer::timeout, this, &PhotoEditorWindow::updatePerformanceHud);
+    connect(m_histogramOpacityTimer, &QTimer::timeout, this, &PhotoEditorWindow::updateHistogramOpacity);
+    connect(m_histogramResetTimer, &QTimer::timeout, this, &PhotoEditorWindow::resetHistogram);
+    connect(m_undoAction, &QAction::triggered, this, &PhotoEditorWindow::undo);
+    connect(m_redoAction, &QAction::triggered, this, &PhotoEditorWindow::redo);
+    connect(m_undoButton, &QToolButton::clicked, this, &PhotoEditorWindow::undo);
+    connect(m_redoButton, &QToolButton::clicked, this, &PhotoEditorWindow::redo);
+    connect(m_resetButton, &QToolButton::clicked, this, &PhotoEditorWindow::resetEdits);
+    connect(m_editHistory, &EditHistory::changed, this, &PhotoEditorWindow::updateHistoryActions);
+    connect(m_photoLoader, &PhotoLoader::started, [&](const QString& filePath) {
+        m_statusLabel->setText(tr("Loading %1...").arg(QFileInfo(filePath).fileName()));
+        m_progressBar->setRange(0, 100);
+        m_progressBar->setValue(0);
+        m_progressBarAction->setVisible(true);
+    });
+    connect(m_photoLoader, &PhotoLoader::progressChanged, m_progressBar, &QProgressBar::setValue);
+    connect(m_photoLoader, &PhotoLoader::previewReady, this, &PhotoEditorWindow::onPhotoPreviewReady);
+    connect(m_photoLoader, &PhotoLoader::loaded, this, &PhotoEditorWindow::onPhotoLoaded);
+    connect(m_photoLoader, &PhotoLoader::projectLoaded, this, &PhotoEditorWindow::onProjectLoaded);
+    connect(m_photoLoader, &PhotoLoader::failed, this, &PhotoEditorWindow::onPhotoLoadFailed);
+    connect(m_photoLoader, &PhotoLoader::canceled, [&]() {
+        m_progressBarAction->setVisible(false);
+        m_statusLabel->clear();
+    });
+    connect(m_photoSaver, &PhotoSaver::started, [&](const QString& filePath) {
+        m_statusLabel->setText(tr("Saving %1...").arg(QFileInfo(filePath).fileName()));
+        m_progressBarAction->setVisible(true);
+    });
+    connect(m_photoSaver, &PhotoSaver::progressChanged, [&](int percent) {
+        // An empty range makes the progress bar busy.
+        m_progressBar->setRange(0, percent < 0 ? 0 : 100);
+        m_progressBar->setValue(qMax(0, percent));
+    });
+    connect(m_photoSaver, &PhotoSaver::saved, [&](const QString& filePath) {
+        // A photo opened meanwhile cleared the path it was saved as.
+        if (filePath == m_saveAsFilePath) {
+            m_filePath = filePath;
+            m_saveAsFilePath.clear();
+        }
+        if (m_photoSaver->isSaving())
+            return;
+        m_progressBarAction->setVisible(false);
+        m_statusLabel->setText(QDir::toNativeSeparators(filePath));
+    });
+    connect(m_photoSaver, &PhotoSaver::failed, [&](const QString& filePath, const QString& errorString) {
+        if (!m_photoSaver->isSaving())
+            m_progressBarAction->setVisible(false);
+        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                                 tr("Cannot save %1: %2").arg(QDir::toNativeSeparators(filePath), errorString));
+    });
 }
 
-QString PhotoEditorWindow::fileMenuToolButtonStyleSheet()
+QString PhotoEditorWindow::applicationStyleSheet()
 {
-    QString fileMenuToolButtonStyleSheet = QString("QToolButton { color: %1; }").arg(Constants::FILE_TOOL_BUTTON_COLOR);
-    fileMenuToolButtonStyleSheet.append(QString("QToolButton::menu-indicator { image: url(:/resources/svg/down-arrow); }"));
+    // Qt parses one stylesheet for the whole application instead of one per widget. It depends on the scale
+    // factor and, through the icon rasters rendered for it, on the rounded up device pixel ratio, so it is
+    // built once per pair of them.
+    static QHash<QPair<int, int>, QString> styleSheets;
+    const QPair<int, int> styleSheetKey(qRound(m_scaleFactor * 100), qMax(1, qCeil(devicePixelRatioF())));
+    const auto cachedStyleSheet = styleSheets.constFind(styleSheetKey);
+    if (cachedStyleSheet != styleSheets.constEnd())
+        return *cachedStyleSheet;
+
+    const int delimiterLineThickness = qRound(Constants::DELIMITER_LINE_THICKNESS_PX * m_scaleFactor);
+    const int toolBarIconSize = style()->pixelMetric(QStyle::PM_ToolBarIconSize),
+            buttonIconSize = style()->pixelMetric(QStyle::PM_ButtonIconSize);
+    auto iconUrl = [this](const QString& resourcePath, int size) {
+        return IconCache::rasterPath(resourcePath, QSize(size, size), devicePixelRatioF());
+    };
+
+    // The rules of the central widget descendants have an id selector, so they take precedence over the background.
+    QString styleSheet = QString("#centralWidget, #centralWidget * { background-color: %1; }").arg(Constants::APP_BACKGROUND_COLOR);
+    styleSheet.append(QString("QStatusBar#statusBar { background-color: %1; }").arg(Constants::APP_BACKGROUND_COLOR));
+    styleSheet.append(QString("QFrame#delimiterLine { color: %1; }").arg(Constants::DELIMITER_LINE_COLOR));
+
+    // Title toolbar
+    styleSheet.append(QString("QToolBar#titleToolBar { background-color: %1; }").arg(Constants::TOOL_BAR_COLOR));
+    styleSheet.append(titleIconToolButtonStyleSheet({ "QToolButton#titleIconButton" }));
+    styleSheet.append("QLabel#titleLabel { color: white; }");
+    styleSheet.append(titleToolButtonStyleSheet({ "QToolButton#settingsButton", "QToolButton#helpButton" }));
+    styleSheet.append(systemToolButtonStyleSheet({ "QToolButton#minimizeButton", "QToolButton#maximizeButton" }));
+    styleSheet.append(closeSystemToolButtonStyleSheet({ "QToolButton#closeButton" }));
+
+    // Header toolbar
+    styleSheet.append(QString("QToolBar#headerToolBar { background-color: %1; border-top: %2px solid %3; border-bottom: %2px solid %3; }")
+                      .arg(Constants::TOOL_BAR_COLOR).arg(delimiterLineThickness).arg(Constants::DELIMITER_LINE_COLOR));
+    styleSheet.append(fileMenuToolButtonStyleSheet({ "QToolButton#fileMenuToolButton" }));
+    styleSheet.append(fileMenuStyleSheet({ "QMenu#fileMenu" }));
+    styleSheet.append(toolButtonStyleSheet({ "QToolButton#undoButton", "QToolButton#redoButton", "QToolButton#resetButton" }));
+    styleSheet.append(pushButtonStyleSheet({ "QPushButton#copyButton" },
+                                           iconUrl(":/resources/svg/copy-rest", buttonIconSize),
+                                           iconUrl(":/resources/svg/copy-hover", buttonIconSize),
+                                           iconUrl(":/resources/svg/copy-pressed", buttonIconSize),
+                                           iconUrl(":/resources/svg/copy-disabled", buttonIconSize)));
+
+    // Draw Tools bar
+    styleSheet.append(QString("QToolBar#drawToolsBar { background-color: %1; }").arg(Constants::TOOL_BAR_COLOR));
+    for (const QString& drawTool : { "pencil", "arrow", "box", "ellipse", "triangle", "star", "blur", "pixelate" }) {
+        styleSheet.append(checkableDrawToolButtonStyleSheet({ QString("QToolButton#%1DrawToolButton").arg(drawTool) },
+                                                            iconUrl(":/resources/svg/" + drawTool, toolBarIconSize),
+                                                            iconUrl(":/resources/svg/" + drawTool + "-checked", toolBarIconSize)));
+    }
+
+    // Draw Tools Settings bar
+    styleSheet.append(opacityLineEditStyleSheet({ "QLineEdit#opacityLineEdit" }));
+    styleSheet.append(opacitySliderStyleSheet({ "QSlider#opacitySlider" }));
+    styleSheet.append(roundToolButtonStyleSheet({ "QToolButton#pipetteToolButton" }));
+    styleSheet.append(QString("QToolButton#pipetteToolButton:checked { background-color: %1; border-color: %1; }")
+                      .arg(Constants::TOOL_BUTTON_PRESSED_COLOR));
+    styleSheet.append("QToolButton#pipetteToolButton::menu-indicator { image: none; }");
+    styleSheet.append(fileMenuStyleSheet({ "QMenu#pipetteMenu" }));
+    styleSheet.append(roundComboboxStyleSheet({ "QComboBox#colorCombobox" }));
+
+    // Photo zone
+    styleSheet.append(photoScrollAreaStyleSheet({ "QScrollArea#photoScrollArea" }));
+    styleSheet.append(QString("QListWidget#filmstrip { background-color: %1; color: %2; border: none; border-top: %3px solid %4; }")
+                      .arg(Constants::TOOL_BAR_COLOR, Constants::FILE_TOOL_BUTTON_COLOR).arg(delimiterLineThickness).arg(Constants::DELIMITER_LINE_COLOR));
+    styleSheet.append(QString("QListWidget#filmstrip::item:selected { background-color: %1; color: %2; border-radius: %3px; }")
+                      .arg(Constants::DRAW_TOOL_BUTTON_PRESSED_COLOR, Constants::FILE_TOOL_BUTTON_COLOR)
+                      .arg(qRound(Constants::TOOL_BUTTON_BORDER_RADIUS_PX * m_scaleFactor)));
+
+    // Footer toolbar
+    styleSheet.append(QString("QToolBar#footerToolBar { background-color: %1; border-top: %2px solid %3; }")
+                      .arg(Constants::TOOL_BAR_COLOR).arg(delimiterLineThickness).arg(Constants::DELIMITER_LINE_COLOR));
+    styleSheet.append(progressBarStyleSheet({ "QProgressBar#progressBar" }));
+    styleSheet.append(QString("QToolButton#performanceHudButton { color: %1; }").arg(Constants::FILE_TOOL_BUTTON_COLOR));
+
+    styleSheets.insert(styleSheetKey, styleSheet);
+    return styleSheet;
+}
+
+QString PhotoEditorWindow::fileMenuToolButtonStyleSheet(const QStringList& selectors)
+{
+    QString fileMenuToolButtonStyleSheet = QString("%1 { color: %2; }").arg(selectorList(selectors), Constants::FILE_TOOL_BUTTON_COLOR);
+    fileMenuToolButtonStyleSheet.append(QString("%1 { image: url(\"%2\"); }")
+                                        .arg(selectorList(selectors, "::menu-indicator"),
+                                             IconCache::rasterPath(":/resources/svg/down-arrow", QSize(), devicePixelRatioF())));
     return fileMenuToolButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::fileMenuStyleSheet()
+QString PhotoEditorWindow::fileMenuStyleSheet(const QStringList& selectors)
 {
     const int fileMenuSeparatorHeight = qRound(Constants::FILE_MENU_SEPARATOR_HEIGHT_PX * m_scaleFactor),
             fileMenuItemPadding = qRound(Constants::FILE_MENU_ITEM_PADDING_PX * m_scaleFactor);
 
-    QString fileMenuStyleSheet = QString("QMenu { background-color: %1; color: %2; }")
-            .arg(Constants::FILE_TOOL_BUTTON_COLOR, Constants::FILE_MENU_COLOR);
-    fileMenuStyleSheet.append(QString("QMenu::item { padding: %1px; }").arg(fileMenuItemPadding));
-    fileMenuStyleSheet.append(QString("QMenu::item:selected { background-color: lightgrey; }"));
-    fileMenuStyleSheet.append(QString("QMenu::separator { height: %1px; background: %1; }")
-                              .arg(fileMenuSeparatorHeight).arg(Constants::FILE_MENU_SEPARATOR_COLOR));
+    QString fileMenuStyleSheet = QString("%1 { background-color: %2; color: %3; }")
+            .arg(selectorList(selectors), Constants::FILE_TOOL_BUTTON_COLOR, Constants::FILE_MENU_COLOR);
+    fileMenuStyleSheet.append(QString("%1 { padding: %2px; }").arg(selectorList(selectors, "::item")).arg(fileMenuItemPadding));
+    fileMenuStyleSheet.append(QString("%1 { background-color: lightgrey; }").arg(selectorList(selectors, "::item:selected")));
+    fileMenuStyleSheet.append(QString("%1 { height: %2px; background: %3; }")
+                              .arg(selectorList(selectors, "::separator")).arg(fileMenuSeparatorHeight).arg(Constants::FILE_MENU_SEPARATOR_COLOR));
     return fileMenuStyleSheet;
 }
 
-QString PhotoEditorWindow::titleIconToolButtonStyleSheet()
+QString PhotoEditorWindow::titleIconToolButtonStyleSheet(const QStringList& selectors)
 {
     const int toolButtonSize = qRound(Constants::TITLE_TOOL_BUTTON_SIZE_PX * m_scaleFactor),
             toolButtonMarginX = qRound(Constants::TITLE_TOOL_BUTTON_MARGIN_X_PX * m_scaleFactor);
 
-    QString toolButtonStyleSheet = QString("QToolButton { width: %1px; height: %1px; background-color: transparent; margin: 0 %2px; border: none; }")
-            .arg(toolButtonSize).arg(toolButtonMarginX);
+    QString toolButtonStyleSheet = QString("%1 { width: %2px; height: %2px; background-color: transparent; margin: 0 %3px; border: none; }")
+            .arg(selectorList(selectors)).arg(toolButtonSize).arg(toolButtonMarginX);
     return toolButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::titleToolButtonStyleSheet()
+QString PhotoEditorWindow::titleToolButtonStyleSheet(const QStringList& selectors)
 {
     const int toolButtonSize = qRound(Constants::TITLE_TOOL_BUTTON_SIZE_PX * m_scaleFactor),
             toolButtonMarginX = qRound(Constants::TITLE_TOOL_BUTTON_MARGIN_X_PX * m_scaleFactor);
 
-    QString toolButtonStyleSheet = QString("QToolButton { width: %1px; height: %1px; background-color: %2; margin: 0 %3px; border: 1px solid %2; border-radius: 0px; }")
-            .arg(toolButtonSize).arg(Constants::TOOL_BAR_COLOR).arg(toolButtonMarginX);
-    toolButtonStyleSheet.append(QString("QToolButton:hover { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_HOVER_COLOR));
-    toolButtonStyleSheet.append(QString("QToolButton:pressed { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_PRESSED_COLOR));
-    toolButtonStyleSheet.append(QString("QToolButton:disabled { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_DISABLED_COLOR));
+    QString toolButtonStyleSheet = QString("%1 { width: %2px; height: %2px; background-color: %3; margin: 0 %4px; border: 1px solid %3; border-radius: 0px; }")
+            .arg(selectorList(selectors)).arg(toolButtonSize).arg(Constants::TOOL_BAR_COLOR).arg(toolButtonMarginX);
+    toolButtonStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":hover"), Constants::TOOL_BUTTON_HOVER_COLOR));
+    toolButtonStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":pressed"), Constants::TOOL_BUTTON_PRESSED_COLOR));
+    toolButtonStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":disabled"), Constants::TOOL_BUTTON_DISABLED_COLOR));
     return toolButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::systemToolButtonStyleSheet()
+QString PhotoEditorWindow::systemToolButtonStyleSheet(const QStringList& selectors)
 {
     const int toolButtonPadding = qRound(Constants::TITLE_TOOL_BUTTON_PADDING_PX * m_scaleFactor);
 
-    QString systemToolButtonStyleSheet = titleToolButtonStyleSheet();
-    systemToolButtonStyleSheet.append(QString("QToolButton { padding-top: %1px; padding-bottom: %1px; }").arg(toolButtonPadding));
+    QString systemToolButtonStyleSheet = titleToolButtonStyleSheet(selectors);
+    systemToolButtonStyleSheet.append(QString("%1 { padding-top: %2px; padding-bottom: %2px; }").arg(selectorList(selectors)).arg(toolButtonPadding));
     return systemToolButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::closeSystemToolButtonStyleSheet()
+QString PhotoEditorWindow::closeSystemToolButtonStyleSheet(const QStringList& selectors)
 {
-    QString closeSystemToolButtonStyleSheet = systemToolButtonStyleSheet();
-    closeSystemToolButtonStyleSheet.append(QString("QToolButton:hover { background-color: %1; border-color: %1; }")
-                                           .arg(Constants::CLOSE_SYSTEM_BUTTON_HOVER_COLOR));
-    closeSystemToolButtonStyleSheet.append(QString("QToolButton:pressed { background-color: %1; border-color: %1; }")
-                                           .arg(Constants::CLOSE_SYSTEM_BUTTON_PRESSED_COLOR));
+    QString closeSystemToolButtonStyleSheet = systemToolButtonStyleSheet(selectors);
+    closeSystemToolButtonStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                           .arg(selectorList(selectors, ":hover"), Constants::CLOSE_SYSTEM_BUTTON_HOVER_COLOR));
+    closeSystemToolButtonStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                           .arg(selectorList(selectors, ":pressed"), Constants::CLOSE_SYSTEM_BUTTON_PRESSED_COLOR));
     return closeSystemToolButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::toolButtonStyleSheet()
+QString PhotoEditorWindow::toolButtonStyleSheet(const QStringList& selectors)
 {
     const int toolButtonSize = qRound(Constants::TOOL_BUTTON_SIZE_PX * m_scaleFactor),
             toolButtonMarginX = qRound(Constants::TOOL_BUTTON_MARGIN_X_PX * m_scaleFactor),
             toolButtonBorderRadius = qRound(Constants::TOOL_BUTTON_BORDER_RADIUS_PX * m_scaleFactor);
 
-    QString toolButtonStyleSheet = QString("QToolButton { width: %1px; height: %1px; background-color: %2; margin: 0 %3px; border: 1px solid %2; border-radius: %4px; }")
-            .arg(toolButtonSize).arg(Constants::TOOL_BUTTON_REST_COLOR).arg(toolButtonMarginX).arg(toolButtonBorderRadius);
-    toolButtonStyleSheet.append(QString("QToolButton:hover { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_HOVER_COLOR));
-    toolButtonStyleSheet.append(QString("QToolButton:pressed { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_PRESSED_COLOR));
-    toolButtonStyleSheet.append(QString("QToolButton:disabled { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_DISABLED_COLOR));
+    QString toolButtonStyleSheet = QString("%1 { width: %2px; height: %2px; background-color: %3; margin: 0 %4px; border: 1px solid %3; border-radius: %5px; }")
+            .arg(selectorList(selectors)).arg(toolButtonSize).arg(Constants::TOOL_BUTTON_REST_COLOR).arg(toolButtonMarginX).arg(toolButtonBorderRadius);
+    toolButtonStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":hover"), Constants::TOOL_BUTTON_HOVER_COLOR));
+    toolButtonStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":pressed"), Constants::TOOL_BUTTON_PRESSED_COLOR));
+    toolButtonStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":disabled"), Constants::TOOL_BUTTON_DISABLED_COLOR));
     return toolButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::pushButtonStyleSheet(const QString& normalIconUrl, const QString& hoverIconUrl,
-                                                const QString& pressedIconUrl, const QString& disabledIconUrl)
+QString PhotoEditorWindow::pushButtonStyleSheet(const QStringList& selectors, const QString& normalIconPath, const QString& hoverIconPath,
+                                                const QString& pressedIconPath, const QString& disabledIconPath)
 {
     const int pushButtonHeight = qRound(Constants::PUSH_BUTTON_HEIGHT_PX * m_scaleFactor),
             pushButtonWidth = qRound(Constants::PUSH_BUTTON_WIDTH_PX * m_scaleFactor),
@@ -615,44 +1596,46 @@ QString PhotoEditorWindow::pushButtonStyleSheet(const QString& normalIconUrl, co
             pushButtonBorder = qRound(Constants::PUSH_BUTTON_BORDER_PX * m_scaleFactor),
             pushButtonBorderRadius = qRound(Constants::PUSH_BUTTON_BORDER_RADIUS_PX * m_scaleFactor);
 
-    QString pushButtonStyleSheet = QString("QPushButton { qproperty-icon: url(%1); width: %2px; height: %3px; background-color: transparent; color: %4; margin: 0 %5px; border: %6px solid %4; border-radius: %7px; }")
-            .arg(normalIconUrl).arg(pushButtonWidth).arg(pushButtonHeight).arg(Constants::PUSH_BUTTON_REST_COLOR)
+    QString pushButtonStyleSheet = QString("%1 { qproperty-icon: url(\"%2\"); width: %3px; height: %4px; background-color: transparent; color: %5; margin: 0 %6px; border: %7px solid %5; border-radius: %8px; }")
+            .arg(selectorList(selectors), normalIconPath).arg(pushButtonWidth).arg(pushButtonHeight).arg(Constants::PUSH_BUTTON_REST_COLOR)
             .arg(pushButtonMarginX).arg(pushButtonBorder).arg(pushButtonBorderRadius);
-    pushButtonStyleSheet.append(QString("QPushButton:hover { qproperty-icon: url(%1); border-color: %2; color: %2; }")
-                                .arg(hoverIconUrl, Constants::PUSH_BUTTON_HOVER_COLOR));
-    pushButtonStyleSheet.append(QString("QPushButton:pressed { qproperty-icon: url(%1); border-color: %2; color: %2; }")
-                                .arg(pressedIconUrl, Constants::PUSH_BUTTON_PRESSED_COLOR));
-    pushButtonStyleSheet.append(QString("QPushButton:disabled { qproperty-icon: url(%1); border-color: %2; color: %2; opacity: %3; }")
-                                .arg(disabledIconUrl, Constants::PUSH_BUTTON_DISABLED_COLOR).arg(Constants::PUSH_BUTTON_DISABLED_OPACITY));
+    pushButtonStyleSheet.append(QString("%1 { qproperty-icon: url(\"%2\"); border-color: %3; color: %3; }")
+                                .arg(selectorList(selectors, ":hover"), hoverIconPath, Constants::PUSH_BUTTON_HOVER_COLOR));
+    pushButtonStyleSheet.append(QString("%1 { qproperty-icon: url(\"%2\"); border-color: %3; color: %3; }")
+                                .arg(selectorList(selectors, ":pressed"), pressedIconPath, Constants::PUSH_BUTTON_PRESSED_COLOR));
+    pushButtonStyleSheet.append(QString("%1 { qproperty-icon: url(\"%2\"); border-color: %3; color: %3; opacity: %4; }")
+                                .arg(selectorList(selectors, ":disabled"), disabledIconPath, Constants::PUSH_BUTTON_DISABLED_COLOR)
+                                .arg(Constants::PUSH_BUTTON_DISABLED_OPACITY));
     return pushButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::checkableDrawToolButtonStyleSheet(const QString& normalIconUrl, const QString& pressedIconUrl)
+QString PhotoEditorWindow::checkableDrawToolButtonStyleSheet(const QStringList& selectors, const QString& normalIconPath,
+                                                             const QString& pressedIconPath)
 {
     const int toolButtonSize = qRound(Constants::TOOL_BUTTON_SIZE_PX * m_scaleFactor),
             toolButtonMarginX = qRound(Constants::TOOL_BUTTON_MARGIN_X_PX * m_scaleFactor),
             toolButtonBorderRadius = qRound(Constants::TOOL_BUTTON_BORDER_RADIUS_PX * m_scaleFactor);
 
-    QString checkableDrawToolButtonStyleSheet = QString("QToolButton { qproperty-icon: url(%1); width: %2px; height: %2px; background-color: %3; margin: 0 %4px; border: 1px solid %3; border-radius: %5px; }")
-            .arg(normalIconUrl).arg(toolButtonSize).arg(Constants::TOOL_BUTTON_REST_COLOR).arg(toolButtonMarginX).arg(toolButtonBorderRadius);
-    checkableDrawToolButtonStyleSheet.append(QString("QToolButton:checked { qproperty-icon: url(%1); background-color: %2; border-color: %2; }")
-                                             .arg(pressedIconUrl, Constants::DRAW_TOOL_BUTTON_PRESSED_COLOR));
-    checkableDrawToolButtonStyleSheet.append(QString("QToolButton:hover { qproperty-icon: url(%1); background-color: %2; border-color: %2; }")
-                                             .arg(pressedIconUrl, Constants::DRAW_TOOL_BUTTON_PRESSED_COLOR));
+    QString checkableDrawToolButtonStyleSheet = QString("%1 { qproperty-icon: url(\"%2\"); width: %3px; height: %3px; background-color: %4; margin: 0 %5px; border: 1px solid %4; border-radius: %6px; }")
+            .arg(selectorList(selectors), normalIconPath).arg(toolButtonSize).arg(Constants::TOOL_BUTTON_REST_COLOR).arg(toolButtonMarginX).arg(toolButtonBorderRadius);
+    checkableDrawToolButtonStyleSheet.append(QString("%1 { qproperty-icon: url(\"%2\"); background-color: %3; border-color: %3; }")
+                                             .arg(selectorList(selectors, ":checked"), pressedIconPath, Constants::DRAW_TOOL_BUTTON_PRESSED_COLOR));
+    checkableDrawToolButtonStyleSheet.append(QString("%1 { qproperty-icon: url(\"%2\"); background-color: %3; border-color: %3; }")
+                                             .arg(selectorList(selectors, ":hover"), pressedIconPath, Constants::DRAW_TOOL_BUTTON_PRESSED_COLOR));
     return checkableDrawToolButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::opacityLineEditStyleSheet()
+QString PhotoEditorWindow::opacityLineEditStyleSheet(const QStringList& selectors)
 {
     const int opacityLineEditBorder = qRound(Constants::OPACITY_LINE_EDIT_BORDER_PX * m_scaleFactor),
             opacityLineEditBorderRadius = qRound(Constants::OPACITY_LINE_EDIT_BORDER_RADIUS_PX * m_scaleFactor);
 
-    QString opacityLineEditStyleSheet = QString("QLineEdit { border: %1px solid %2; border-radius: %3; }")
-            .arg(opacityLineEditBorder).arg(Constants::OPACITY_LINE_EDIT_BORDER_COLOR).arg(opacityLineEditBorderRadius);
+    QString opacityLineEditStyleSheet = QString("%1 { border: %2px solid %3; border-radius: %4; }")
+            .arg(selectorList(selectors)).arg(opacityLineEditBorder).arg(Constants::OPACITY_LINE_EDIT_BORDER_COLOR).arg(opacityLineEditBorderRadius);
     return opacityLineEditStyleSheet;
 }
 
-QString PhotoEditorWindow::opacitySliderStyleSheet()
+QString PhotoEditorWindow::opacitySliderStyleSheet(const QStringList& selectors)
 {
     const int opacitySliderGrooveHeight = qRound(Constants::OPACITY_SLIDER_GROOVE_HEIGHT_PX * m_scaleFactor),
             opacitySliderGrooveBorderRadius = qRound(Constants::OPACITY_SLIDER_GROOVE_BORDER_RADIUS_PX * m_scaleFactor),
@@ -662,25 +1645,27 @@ QString PhotoEditorWindow::opacitySliderStyleSheet()
             opacitySliderHandleBorder = qRound(Constants::OPACITY_SLIDER_HANDLE_BORDER_PX * m_scaleFactor),
             opacitySliderHandleMargin = -qRound(opacitySliderHandleBorderRadius * 0.5);
 
-    QString opacitySliderStyleSheet = QString("QSlider::groove:horizontal { background-color: %1; height: %2px; border-radius: %3px; }")
-            .arg(Constants::OPACITY_SLIDER_GROOVE_COLOR).arg(opacitySliderGrooveHeight).arg(opacitySliderGrooveBorderRadius);
-    opacitySliderStyleSheet.append(QString("QSlider::handle:horizontal { background-color: %1; border: %2px solid %1; width: %3px; height: %4px; line-height: %4px; margin-top: %5px; margin-bottom: %5px; border-radius: %6px; }")
-            .arg(Constants::OPACITY_SLIDER_HANDLE_COLOR).arg(opacitySliderHandleBorder).arg(opacitySliderHandleWidth).arg(opacitySliderHandleHeight)
-            .arg(opacitySliderHandleMargin).arg(opacitySliderHandleBorderRadius));
-    opacitySliderStyleSheet.append(QString("QSlider::handle:horizontal:hover { border-radius: %1px; }").arg(opacitySliderHandleBorderRadius));
+    QString opacitySliderStyleSheet = QString("%1 { background-color: %2; height: %3px; border-radius: %4px; }")
+            .arg(selectorList(selectors, "::groove:horizontal"), Constants::OPACITY_SLIDER_GROOVE_COLOR)
+            .arg(opacitySliderGrooveHeight).arg(opacitySliderGrooveBorderRadius);
+    opacitySliderStyleSheet.append(QString("%1 { background-color: %2; border: %3px solid %2; width: %4px; height: %5px; line-height: %5px; margin-top: %6px; margin-bottom: %6px; border-radius: %7px; }")
+            .arg(selectorList(selectors, "::handle:horizontal"), Constants::OPACITY_SLIDER_HANDLE_COLOR).arg(opacitySliderHandleBorder)
+            .arg(opacitySliderHandleWidth).arg(opacitySliderHandleHeight).arg(opacitySliderHandleMargin).arg(opacitySliderHandleBorderRadius));
+    opacitySliderStyleSheet.append(QString("%1 { border-radius: %2px; }")
+            .arg(selectorList(selectors, "::handle:horizontal:hover")).arg(opacitySliderHandleBorderRadius));
     return opacitySliderStyleSheet;
 }
 
-QString PhotoEditorWindow::roundToolButtonStyleSheet()
+QString PhotoEditorWindow::roundToolButtonStyleSheet(const QStringList& selectors)
 {
     const int roundToolButtonBorderRadius = qRound(Constants::ROUND_TOOL_BUTTON_BORDER_RADIUS_PX * m_scaleFactor);
 
-    QString roundToolButtonStyleSheet = toolButtonStyleSheet();
-    roundToolButtonStyleSheet.append(QString("QToolButton { border-radius: %1px;}").arg(roundToolButtonBorderRadius));
+    QString roundToolButtonStyleSheet = toolButtonStyleSheet(selectors);
+    roundToolButtonStyleSheet.append(QString("%1 { border-radius: %2px;}").arg(selectorList(selectors)).arg(roundToolButtonBorderRadius));
     return roundToolButtonStyleSheet;
 }
 
-QString PhotoEditorWindow::roundComboboxStyleSheet()
+QString PhotoEditorWindow::roundComboboxStyleSheet(const QStringList& selectors)
 {
     const int roundComboboxWidth = qRound(Constants::ROUND_COMBO_BOX_WIDTH_PX * m_scaleFactor),
             roundComboboxHeight = qRound(Constants::ROUND_COMBO_BOX_HEIGHT_PX * m_scaleFactor),
@@ -689,26 +1674,39 @@ QString PhotoEditorWindow::roundComboboxStyleSheet()
             roundComboboxDownArrowHeight = qRound(Constants::ROUND_COMBO_BOX_DOWN_ARROW_HEIGHT_PX * m_scaleFactor),
             roundComboboxDownArrowLeftShift = qRound(Constants::ROUND_COMBO_BOX_DOWN_ARROW_LEFT_SHIFT_PX * m_scaleFactor);
 
-    QString roundComboboxStyleSheet = QString("QComboBox { width: %1px; height: %2px; background-color: %3; border: 1px solid %3; border-radius: %4px; }")
-            .arg(roundComboboxWidth).arg(roundComboboxHeight).arg(Constants::TOOL_BUTTON_REST_COLOR).arg(roundComboboxBorderRadius);
-    roundComboboxStyleSheet.append(QString("QComboBox:hover { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_HOVER_COLOR));
-    roundComboboxStyleSheet.append(QString("QComboBox:pressed { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_PRESSED_COLOR));
-    roundComboboxStyleSheet.append(QString("QComboBox:disabled { background-color: %1; border-color: %1; }")
-                                .arg(Constants::TOOL_BUTTON_DISABLED_COLOR));
-    roundComboboxStyleSheet.append(QString("QComboBox:down-arrow { image: url(%1); width: %2px; height: %3px; left: %4px; }")
-                                .arg(":/resources/svg/down-arrow").arg(roundComboboxDownArrowWidth)
-                                .arg(roundComboboxDownArrowHeight).arg(roundComboboxDownArrowLeftShift));
-    roundComboboxStyleSheet.append("QComboBox::drop-down:!editable { background: transparent; border: none; }");
+    QString roundComboboxStyleSheet = QString("%1 { width: %2px; height: %3px; background-color: %4; border: 1px solid %4; border-radius: %5px; }")
+            .arg(selectorList(selectors)).arg(roundComboboxWidth).arg(roundComboboxHeight).arg(Constants::TOOL_BUTTON_REST_COLOR).arg(roundComboboxBorderRadius);
+    roundComboboxStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":hover"), Constants::TOOL_BUTTON_HOVER_COLOR));
+    roundComboboxStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":pressed"), Constants::TOOL_BUTTON_PRESSED_COLOR));
+    roundComboboxStyleSheet.append(QString("%1 { background-color: %2; border-color: %2; }")
+                                .arg(selectorList(selectors, ":disabled"), Constants::TOOL_BUTTON_DISABLED_COLOR));
+    roundComboboxStyleSheet.append(QString("%1 { image: url(\"%2\"); width: %3px; height: %4px; left: %5px; }")
+                                .arg(selectorList(selectors, ":down-arrow"),
+                                     IconCache::rasterPath(":/resources/svg/down-arrow", QSize(roundComboboxDownArrowWidth, roundComboboxDownArrowHeight),
+                                                           devicePixelRatioF()))
+                                .arg(roundComboboxDownArrowWidth).arg(roundComboboxDownArrowHeight).arg(roundComboboxDownArrowLeftShift));
+    roundComboboxStyleSheet.append(QString("%1 { background: transparent; border: none; }").arg(selectorList(selectors, "::drop-down:!editable")));
     return roundComboboxStyleSheet;
 }
 
- QString PhotoEditorWindow::photoScrollAreaStyleSheet()
- {
-     const int photoScrollAreaMargin = qRound(Constants::PHOTO_ZONE_MARGIN_PX * m_scaleFactor);
+QString PhotoEditorWindow::photoScrollAreaStyleSheet(const QStringList& selectors)
+{
+    const int photoScrollAreaMargin = qRound(Constants::PHOTO_ZONE_MARGIN_PX * m_scaleFactor);
+
+    QString photoScrollAreaStyleSheet = QString("%1 { background-color: %2; margin: %3; border: 1px solid %2; }")
+            .arg(selectorList(selectors), Constants::PHOTO_ZONE_COLOR).arg(photoScrollAreaMargin);
+    return photoScrollAreaStyleSheet;
+}
 
-     QString photoScrollAreaStyleSheet = QString("QScrollArea { background-color: %1; margin: %2; border: 1px solid %1; }")
-             .arg(Constants::PHOTO_ZONE_COLOR).arg(photoScrollAreaMargin);
-     return photoScrollAreaStyleSheet;
- }
+QString PhotoEditorWindow::progressBarStyleSheet(const QStringList& selectors)
+{
+    const int progressBarBorderRadius = qRound(Constants::PROGRESS_BAR_BORDER_RADIUS_PX * m_scaleFactor);
+
+    QString progressBarStyleSheet = QString("%1 { background-color: %2; border: none; border-radius: %3px; }")
+            .arg(selectorList(selectors), Constants::PROGRESS_BAR_COLOR).arg(progressBarBorderRadius);
+    progressBarStyleSheet.append(QString("%1 { background-color: %2; border-radius: %3px; }")
+                                 .arg(selectorList(selectors, "::chunk"), Constants::PROGRESS_BAR_CHUNK_COLOR).arg(progressBarBorderRadius));
+    return progressBarStyleSheet;
+}
@@ -1,10 +1,21 @@
 #ifndef PHOTOEDITORWINDOW_H
 #define PHOTOEDITORWINDOW_H
 
+#include "annotationscene.h"
+#include "edithistory.h"
+#include "filtergraph.h"
+#include "histogram.h"
+#include "imagepyramid.h"
+#include "photomimedata.h"
+#include "recoveryjournal.h"
+#include "redaction.h"
+#include "resampler.h"
+
 #include <QMainWindow>
 #include <QMenu>
 #include <QMenuBar>
 #include <QAction>
+#include <QActionGroup>
 #include <QToolBar>
 #include <QToolButton>
 #include <QPushButton>
@@ -17,6 +28,14 @@
 #include <QScrollArea>
 #include <QImage>
 #include <QVBoxLayout>
+#include <QProgressBar>
+#include <QTimer>
+
+class Filmstrip;
+class HistogramWidget;
+class PhotoCanvas;
+class PhotoLoader;
+class PhotoSaver;
 
 class PhotoEditorWindow : public QMainWindow
 {
@@ -29,7 +48,9 @@ public:
         BoxDrawTool,
         EllipseDrawTool,
         TriangleDrawTool,
-        StarDrawTool
+        StarDrawTool,
+        BlurDrawTool,
+        PixelateDrawTool
     };
 
     PhotoEditorWindow(QWidget *parent = nullptr);
@@ -37,6 +58,22 @@ public:
 
 public slots:
     void openFile();
+    void openNextPhoto();
+    void openPreviousPhoto();
+    void saveFile();
+    void saveFileAs();
+    void copy();
+    void print();
+    void exportTrace();
+    void undo();
+    void redo();
+    void resetEdits();
+    // Asks for a new size and resamples the photo to it, the edits are kept and the history is cleared.
+    void resizeImage();
+    // Edits the adjustments of the photo, previewed as the sliders move.
+    void adjustImage();
+    // Offers to recover the edits journaled by a session which crashed, the journal is removed.
+    void recoverSession(const QString& journalPath);
 
 private slots:
     bool loadPhoto(const QString& filePath);
@@ -47,24 +84,66 @@ private:
     void createLayout();
     void createConnections();
 
-    QString fileMenuToolButtonStyleSheet();
-    QString fileMenuStyleSheet();
-    QString titleIconToolButtonStyleSheet();
-    QString titleToolButtonStyleSheet();
-    QString systemToolButtonStyleSheet();
-    QString closeSystemToolButtonStyleSheet();
-    QString toolButtonStyleSheet();
-    QString pushButtonStyleSheet(const QString& normalIconUrl,
-                                 const QString& hoverIconUrl = QString(),
-                                 const QString& pressedIconUrl = QString(),
-                                 const QString& disabledIconUrl = QString());
-    QString checkableDrawToolButtonStyleSheet(const QString& normalIconUrl,
-                                              const QString& pressedIconUrl = QString());
-    QString opacityLineEditStyleSheet();
-    QString opacitySliderStyleSheet();
-    QString roundToolButtonStyleSheet();
-    QString roundComboboxStyleSheet();
-    QString photoScrollAreaStyleSheet();
+    // Opens the photo the number of steps away in the folder of the current one, in name order.
+    void openNeighborPhoto(int step);
+    // Returns the absolute paths of the photos of the folder of the file, in name order.
+    QStringList folderPhotos(const QString& filePath) const;
+    void prefetchNeighborPhotos(const QString& filePath);
+    void onPhotoPreviewReady(const QString& filePath, const QImage& preview, const QSize& photoSize);
+    void onPhotoLoaded(const QString& filePath, const QImage& photo, const ImagePyramid& pyramid);
+    void onProjectLoaded(const QString& filePath, const PhotoSaver::Document& document);
+    void showPhoto(const QString& filePath, const QImage& photo, const ImagePyramid& pyramid);
+    // Starts journaling the edits of the photo, replaying the ones of the session being recovered first.
+    void beginJournal(const QString& filePath);
+    void onPhotoLoadFailed(const QString& filePath, const QString& errorString);
+    void savePhoto(const QString& filePath);
+    PhotoSaver::Document documentSnapshot() const;
+    void resizePhoto(const QSize& size, Resampler::Filter filter);
+    void setAdjustments(const QVector<FilterGraph::Node>& adjustments);
+    // Blurs or pixelates the rect of the photo, as an edit of the tiles it covers.
+    void redact(Redaction::Mode mode, const QRect& rect, int strength);
+
+    // A photo is only edited once its full decode replaced the preview, the edits would not carry over to it.
+    bool isEditable() const;
+    // Replaces tiles and annotations of the photo and records the edit in the undo history.
+    void applyEdit(const QString& text, const EditHistory::Change& change);
+    void applyChange(const EditHistory::Change& change);
+    void updateHistoryActions();
+    // Counts the histogram of the photo and its annotations over, at the level of the pyramid it is counted at.
+    void resetHistogram();
+    // Recounts the tiles of the histogram under the dirty rect, in photo coordinates.
+    void updateHistogram(const QRect& dirtyRect);
+    // Recounts the tiles of the histogram under the annotations, with the opacity they are shown at.
+    void updateHistogramOpacity();
+    void updatePerformanceHud();
+
+    QColorDialog* colorDialog();
+    // Adds the color to the outline colors and selects it, the oldest one makes room when the list is full.
+    void addDrawColor(const QColor& color);
+
+    // Stylesheet of the whole application, its rules select the widgets by object name.
+    QString applicationStyleSheet();
+    QString fileMenuToolButtonStyleSheet(const QStringList& selectors);
+    QString fileMenuStyleSheet(const QStringList& selectors);
+    QString titleIconToolButtonStyleSheet(const QStringList& selectors);
+    QString titleToolButtonStyleSheet(const QStringList& selectors);
+    QString systemToolButtonStyleSheet(const QStringList& selectors);
+    QString closeSystemToolButtonStyleSheet(const QStringList& selectors);
+    QString toolButtonStyleSheet(const QStringList& selectors);
+    QString pushButtonStyleSheet(const QStringList& selectors,
+                                 const QString& normalIconPath,
+                                 const QString& hoverIconPath = QString(),
+                                 const QString& pressedIconPath = QString(),
+                                 const QString& disabledIconPath = QString());
+    QString checkableDrawToolButtonStyleSheet(const QStringList& selectors,
+                                              const QString& normalIconPath,
+                                              const QString& pressedIconPath = QString());
+    QString opacityLineEditStyleSheet(const QStringList& selectors);
+    QString opacitySliderStyleSheet(const QStringList& selectors);
+    QString roundToolButtonStyleSheet(const QStringList& selectors);
+    QString roundComboboxStyleSheet(const QStringList& selectors);
+    QString photoScrollAreaStyleSheet(const QStringList& selectors);
+    QString progressBarStyleSheet(const QStringList& selectors);
 
     // --------------------------------------------------------------------------
     // Title toolbar
@@ -85,12 +164,19 @@ private:
     QToolButton* m_fileMenuToolButton { nullptr };
     QMenu* m_fileMenu { nullptr };
     QAction* m_openFileAction { nullptr };
+    QAction* m_nextPhotoAction { nullptr };
+    QAction* m_previousPhotoAction { nullptr };
     QAction* m_saveFileAction { nullptr };
     QAction* m_saveAsFileAction { nullptr };
+    QAction* m_resizeImageAction { nullptr };
+    QAction* m_adjustImageAction { nullptr };
     QAction* m_printAction { nullptr };
+    QAction* m_exportTraceAction { nullptr };
     QToolButton* m_undoButton { nullptr };
     QToolButton* m_redoButton { nullptr };
     QToolButton* m_resetButton { nullptr };
+    QAction* m_undoAction { nullptr };
+    QAction* m_redoAction { nullptr };
     QPushButton* m_copyButton { nullptr };
 
     // --------------------------------------------------------------------------
@@ -107,6 +193,8 @@ private:
     QToolButton* m_ellipseDrawToolButton { nullptr };
     QToolButton* m_triangleDrawToolButton { nullptr };
     QToolButton* m_starDrawToolButton { nullptr };
+    QToolButton* m_blurDrawToolButton { nullptr };
+    QToolButton* m_pixelateDrawToolButton { nullptr };
 
     // --------------------------------------------------------------------------
     // Draw Tools Settings bar
@@ -117,21 +205,63 @@ private:
     QLineEdit* m_opacityLineEdit { nullptr };
     QLabel* m_outlineColorLabel { nullptr };
     QToolButton* m_pipetteToolButton { nullptr };
+    QMenu* m_pipetteMenu { nullptr };
+    QActionGroup* m_pipetteSampleSizeGroup { nullptr };
+    QAction* m_chooseColorAction { nullptr };
+    // Created on the first use.
     QColorDialog* m_colorDialog { nullptr };
     QComboBox* m_colorCombobox { nullptr };
     QPalette m_defaultSystemPalette;
 
+    // --------------------------------------------------------------------------
+    // Histogram panel
+
+    QWidget* m_histogramPanel { nullptr };
+    QLabel* m_histogramLabel { nullptr };
+    HistogramWidget* m_histogramWidget { nullptr };
+    Histogram m_histogram;
+    int m_histogramLevel { 0 };
+    QTimer* m_histogramOpacityTimer { nullptr };
+    QTimer* m_histogramResetTimer { nullptr };
+
     // --------------------------------------------------------------------------
     // Photo zone
 
     QImage m_photo;
-    QLabel *m_photoLabel { nullptr };
+    // The photo with its edits, the canvas shows it through the adjustments.
+    ImagePyramid m_pyramid;
+    FilterGraph m_filterGraph;
+    AnnotationScene m_annotations;
+    EditHistory* m_editHistory { nullptr };
+    PhotoLoader* m_photoLoader { nullptr };
+    PhotoSaver* m_photoSaver { nullptr };
+    RecoveryJournal* m_recoveryJournal { nullptr };
+    // Replayed once its photo is loaded.
+    RecoveryJournal::Session m_recoverySession;
+    QString m_filePath;
+    // Path the photo is being saved as, it becomes the file path once saved.
+    QString m_saveAsFilePath;
+    // Absolute path of the last photo asked for, the folder navigation steps from it.
+    QString m_browsedFilePath;
+    // Flattened photo put on the clipboard, reused by the next copies until the document changes.
+    QSharedPointer<PhotoMimeData::Content> m_clipboardContent;
+    PhotoCanvas* m_photoCanvas { nullptr };
+    QString m_previewFilePath;
     QScrollArea *m_photoScrollArea { nullptr };
+    Filmstrip* m_filmstrip { nullptr };
 
     // --------------------------------------------------------------------------
     // Footer toolbar
 
     QToolBar* m_footerToolBar { nullptr };
+    QLabel* m_statusLabel { nullptr };
+    QProgressBar* m_progressBar { nullptr };
+    QAction* m_progressBarAction { nullptr };
+    QLabel* m_performanceHudLabel { nullptr };
+    QAction* m_performanceHudLabelAction { nullptr };
+    QAction* m_performanceHudAction { nullptr };
+    QToolButton* m_performanceHudButton { nullptr };
+    QTimer* m_performanceHudTimer { nullptr };
 
     // --------------------------------------------------------------------------
     // Photo Editor window
@@ -0,0 +1,498 @@
+#include "photoloader.h"
+#include "colormanagement.h"
+#include "compositing.h"
+#include "exif.h"
+#include "profiler.h"
+#include "projectfile.h"
+#include "constants.h"
+#ifdef HAVE_LIBJPEG
+#include "jpegbandreader.h"
+#endif
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QTransform>
+
+namespace {
+
+// Applies the EXIF transformation to the band of stored rows starting at the top, returns it with the position
+// it lands at in the transformed photo. Mirrored and flipped first, then rotated clockwise, like QImageReader does.
+QImage orientedBand(const QImage& band, int top, const QSize& storedSize, QImageIOHandler::Transformations transformation,
+                    QPoint* position)
+{
+    const bool flip = transformation & QImageIOHandler::TransformationFlip;
+    const QImage mirroredBand = band.mirrored(transformation & QImageIOHandler::TransformationMirror, flip);
+    const int flippedTop = flip ? storedSize.height() - top - band.height() : top;
+    if (!(transformation & QImageIOHandler::TransformationRotate90)) {
+        *position = QPoint(0, flippedTop);
+        return mirroredBand;
+    }
+    *position = QPoint(storedSize.height() - flippedTop - band.height(), 0);
+    return mirroredBand.transformed(QTransform().rotate(90));
+}
+
+// Read-only file device which reports how far the decoder got and fails the reads once the load is canceled,
+// so the decoder stops in the middle of the file.
+class ProgressDevice : public QIODevice
+{
+public:
+    using Callback = std::function<bool(qint64 position, qint64 size)>;
+
+    ProgressDevice(const QString& filePath, const Callback& callback)
+        : m_file(filePath)
+        , m_callback(callback)
+    {}
+
+    bool open(OpenMode mode) override
+    {
+        if (!m_file.open(mode)) {
+            setErrorString(m_file.errorString());
+            return false;
+        }
+        return QIODevice::open(mode);
+    }
+
+    void close() override
+    {
+        m_file.close();
+        QIODevice::close();
+    }
+
+    qint64 size() const override { return m_file.size(); }
+
+    bool seek(qint64 position) override
+    {
+        return QIODevice::seek(position) && m_file.seek(position);
+    }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override
+    {
+        if (m_callback && !m_callback(m_file.pos(), m_file.size()))
+            return -1;
+        return m_file.read(data, maxSize);
+    }
+
+    qint64 writeData(const char*, qint64) override { return -1; }
+
+private:
+    QFile m_file;
+    Callback m_callback;
+};
+
+}
+
+PhotoLoader::PhotoLoader(QObject* parent)
+    : QObject(parent)
+{
+    m_threadPool.setMaxThreadCount(1);
+    m_prefetchThreadPool.setMaxThreadCount(Constants::PHOTO_PREFETCH_THREAD_COUNT);
+    m_cache.setMaxCost(Constants::PHOTO_CACHE_SIZE_MB * 1024);
+}
+
+PhotoLoader::~PhotoLoader()
+{
+    cancel();
+    for (const auto& job : qAsConst(m_prefetchJobs))
+        job->canceled = true;
+    m_threadPool.waitForDone();
+    m_prefetchThreadPool.waitForDone();
+}
+
+void PhotoLoader::load(const QString& filePath)
+{
+    cancel();
+    emit started(filePath);
+    emit progressChanged(0);
+
+    auto job = QSharedPointer<Job>::create();
+    job->filePath = filePath;
+    m_job = job;
+    if (isCached(filePath)) {
+        const CacheEntry* entry = m_cache.object(filePath);
+        const QImage photo = entry->photo;
+        const ImagePyramid pyramid = entry->pyramid;
+        QMetaObject::invokeMethod(this, [this, job, photo, pyramid]() {
+            if (job != m_job)
+                return;
+
+            m_job.reset();
+            emit progressChanged(100);
+            emit loaded(job->filePath, photo, pyramid);
+        }, Qt::QueuedConnection);
+        return;
+    }
+    m_cache.remove(filePath);
+
+    // The prefetch in flight becomes the load, its result is delivered once decoded.
+    const auto prefetchJob = m_prefetchJobs.constFind(filePath);
+    if (prefetchJob != m_prefetchJobs.constEnd()) {
+        m_job = *prefetchJob;
+        return;
+    }
+    start(job);
+}
+
+void PhotoLoader::cancel()
+{
+    if (m_job.isNull())
+        return;
+
+    // A prefetch the load was waiting for is left to prefetch(), the photo may still be wanted in the cache.
+    const QString filePath = m_job->filePath;
+    if (!m_job->prefetch)
+        m_job->canceled = true;
+    m_job.reset();
+    emit canceled(filePath);
+}
+
+void PhotoLoader::prefetch(const QStringList& filePaths)
+{
+    for (auto it = m_prefetchJobs.begin(); it != m_prefetchJobs.end();) {
+        if (!filePaths.contains(it.key()) && *it != m_job) {
+            (*it)->canceled = true;
+            it = m_prefetchJobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (const QString& filePath : filePaths) {
+        if (m_prefetchJobs.contains(filePath) || (m_job && m_job->filePath == filePath) || isCached(filePath))
+            continue;
+
+        auto job = QSharedPointer<Job>::create();
+        job->filePath = filePath;
+        job->prefetch = true;
+        m_prefetchJobs.insert(filePath, job);
+        m_prefetchThreadPool.start([this, job]() {
+            run(job);
+        });
+    }
+}
+
+bool PhotoLoader::isCached(const QString& filePath) const
+{
+    const CacheEntry* entry = m_cache.object(filePath);
+    if (!entry)
+        return false;
+
+    const QFileInfo fileInfo(filePath);
+    return fileInfo.lastModified() == entry->lastModified && fileInfo.size() == entry->fileSize;
+}
+
+void PhotoLoader::start(const QSharedPointer<Job>& job)
+{
+    m_threadPool.start([this, job]() {
+        run(job);
+    });
+}
+
+QImage PhotoLoader::readPhoto(const QString& filePath, QString* errorString, const ProgressCallback& progress)
+{
+    auto reportProgress = [&progress](int percent) {
+        return !progress || progress(percent);
+    };
+
+    // Decoding takes most of the time, the rest is split between the conversions.
+    ProgressDevice device(filePath, [&reportProgress](qint64 position, qint64 size) {
+        return reportProgress(size > 0 ? int(position * 80 / size) : 0);
+    });
+    if (!device.open(QIODevice::ReadOnly)) {
+        if (errorString)
+            *errorString = device.errorString();
+        return QImage();
+    }
+
+    QImageReader photoReader(&device, QFileInfo(filePath).suffix().toLatin1());
+    photoReader.setAutoTransform(true);
+    Profiler::ScopedTimer decodeTimer("decode", "load");
+    QImage photo = photoReader.read();
+    Profiler::recordDecode(decodeTimer.finish());
+    if (photo.isNull()) {
+        if (errorString)
+            *errorString = photoReader.errorString();
+        return QImage();
+    }
+
+    if (!reportProgress(80))
+        return QImage();
+    ColorManagement::convertToSRgb(photo);
+
+    if (!reportProgress(90))
+        return QImage();
+    photo = Compositing::toDestinationFormat(photo);
+    return photo;
+}
+
+bool PhotoLoader::needsTiledRead(const QString& filePath)
+{
+    QImageReader photoReader(filePath);
+    const QSize size = photoReader.size();
+    return size.isValid() && qint64(size.width()) * size.height() * 4 > qint64(Constants::OUT_OF_CORE_THRESHOLD_MB) * 1024 * 1024
+            && photoReader.supportsOption(QImageIOHandler::ClipRect);
+}
+
+ImagePyramid PhotoLoader::readTiledPhoto(const QString& filePath, QString* errorString, const ProgressCallback& progress)
+{
+    const qint64 startNs = Profiler::now();
+    QImageReader headerReader(filePath);
+    const QSize storedSize = headerReader.size();
+    if (!storedSize.isValid()) {
+        if (errorString)
+            *errorString = headerReader.errorString();
+        return ImagePyramid();
+    }
+    // The bands are decoded in the stored orientation and land transformed in the photo.
+    const QImageIOHandler::Transformations transformation = headerReader.transformation();
+    const bool transposed = transformation & QImageIOHandler::TransformationRotate90;
+    const QSize size = transposed ? storedSize.transposed() : storedSize;
+
+    // Levels bigger than the memory budget go to the out-of-core stores as well.
+    TiledPyramidBuilder builder(size);
+
+    // JPEG photos are decoded once from the top down. The other formats decode a clip rect per band with a new
+    // reader, as a reader decodes a single image.
+    QString bandErrorString;
+#ifdef HAVE_LIBJPEG
+    JpegBandReader jpegReader(filePath);
+    const bool sequentialRead = headerReader.format() == "jpeg" && jpegReader.open() && jpegReader.size() == storedSize;
+#endif
+    auto readBand = [&](int y, int height) {
+#ifdef HAVE_LIBJPEG
+        if (sequentialRead)
+            return jpegReader.readBand(height, &bandErrorString);
+#endif
+        QImageReader photoReader(filePath);
+        photoReader.setClipRect(QRect(0, y, storedSize.width(), height));
+        const QImage band = photoReader.read();
+        if (band.isNull())
+            bandErrorString = photoReader.errorString();
+        return band;
+    };
+
+    // The bands land on rows or columns divisible by the alignment of the builder. The stored rows run backwards
+    // through the photo when it is flipped, or rotated without being flipped, the bands are cut from the bottom then.
+    const int bandHeight = qMax(Constants::PHOTO_TILE_SIZE_PX * 4, builder.bandAlignment());
+    const bool reversed = bool(transformation & QImageIOHandler::TransformationFlip) != transposed;
+
+    int y = 0;
+    int height = reversed && storedSize.height() % bandHeight ? storedSize.height() % bandHeight
+                                                              : qMin(bandHeight, storedSize.height());
+    while (y < storedSize.height()) {
+        Profiler::ScopedTimer decodeTimer("decode band", "load");
+        QImage band = readBand(y, height);
+        decodeTimer.finish();
+        if (band.isNull()) {
+            if (errorString)
+                *errorString = bandErrorString;
+            return ImagePyramid();
+        }
+        ColorManagement::convertToSRgb(band);
+        band = Compositing::toDestinationFormat(band);
+        QPoint position;
+        band = orientedBand(band, y, storedSize, transformation, &position);
+        if (!builder.addBand(band, position, errorString))
+            return ImagePyramid();
+
+        y += height;
+        height = qMin(bandHeight, storedSize.height() - y);
+        if (progress && !progress(int(qint64(y) * 90 / storedSize.height())))
+            return ImagePyramid();
+    }
+
+    Profiler::recordDecode(Profiler::now() - startNs);
+    return builder.pyramid();
+}
+
+QStringList PhotoLoader::listPhotos(const QString& folderPath)
+{
+    static const QStringList nameFilters = []() {
+        QStringList filters;
+        const QList<QByteArray> formats = QImageReader::supportedImageFormats();
+        for (const QByteArray& format : formats)
+            filters.append("*." + QString::fromLatin1(format));
+        return filters;
+    }();
+
+    QStringList photos;
+    const QFileInfoList entries = QDir(folderPath).entryInfoList(nameFilters, QDir::Files | QDir::Readable,
+                                                                 QDir::Name | QDir::IgnoreCase | QDir::LocaleAware);
+    photos.reserve(entries.size());
+    for (const QFileInfo& entry : entries)
+        photos.append(entry.absoluteFilePath());
+    return photos;
+}
+
+QImage PhotoLoader::readScaledPhoto(const QString& filePath, const QSize& bound, QSize* photoSize)
+{
+    QImageReader photoReader(filePath);
+    photoReader.setAutoTransform(true);
+
+    // The size and the scaled size are in the stored orientation, before the EXIF transformation is applied.
+    const bool transposed = photoReader.transformation() & QImageIOHandler::TransformationRotate90;
+    const QSize storedSize = photoReader.size(),
+            storedBound = transposed ? bound.transposed() : bound;
+    if (photoSize)
+        *photoSize = transposed ? storedSize.transposed() : storedSize;
+
+    if (!storedSize.isValid() || !photoReader.supportsOption(QImageIOHandler::ScaledSize))
+        return QImage();
+    if (storedSize.width() <= storedBound.width() && storedSize.height() <= storedBound.height())
+        return QImage();
+
+    photoReader.setScaledSize(storedSize.scaled(storedBound, Qt::KeepAspectRatio));
+    const Profiler::ScopedTimer timer("decode preview", "load");
+    QImage preview = photoReader.read();
+    ColorManagement::convertToSRgb(preview);
+    return preview;
+}
+
+void PhotoLoader::run(const QSharedPointer<Job>& job)
+{
+    if (job->canceled)
+        return;
+
+    if (ProjectFile::isProject(job->filePath)) {
+        runProject(job);
+        return;
+    }
+
+    // Photos too big for memory would not fit into the cache, their prefetch leaves them to the load.
+    const bool tiledRead = needsTiledRead(job->filePath);
+    if (job->prefetch && tiledRead) {
+        QMetaObject::invokeMethod(this, [this, job]() {
+            if (m_prefetchJobs.value(job->filePath) == job)
+                m_prefetchJobs.remove(job->filePath);
+            if (job != m_job)
+                return;
+
+            auto loadJob = QSharedPointer<Job>::create();
+            loadJob->filePath = job->filePath;
+            m_job = loadJob;
+            start(loadJob);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    if (!job->prefetch)
+        runPreview(job);
+
+    int reportedPercent = 0;
+    auto reportProgress = [this, &job, &reportedPercent](int percent) {
+        if (percent != reportedPercent) {
+            reportedPercent = percent;
+            QMetaObject::invokeMethod(this, [this, job, percent]() {
+                if (job == m_job)
+                    emit progressChanged(percent);
+            }, Qt::QueuedConnection);
+        }
+        return !job->canceled;
+    };
+
+    const Profiler::ScopedTimer timer(job->prefetch ? "prefetch" : "load", "load");
+    // Read before decoding, a file written meanwhile makes the entry stale rather than passing for fresh.
+    const QFileInfo fileInfo(job->filePath);
+    const QDateTime lastModified = fileInfo.lastModified();
+    const qint64 fileSize = fileInfo.size();
+    QString errorString;
+    QImage photo;
+    ImagePyramid pyramid;
+    if (tiledRead) {
+        pyramid = readTiledPhoto(job->filePath, &errorString, reportProgress);
+    } else {
+        photo = readPhoto(job->filePath, &errorString, reportProgress);
+        if (!photo.isNull() && reportProgress(90)) {
+            const Profiler::ScopedTimer pyramidTimer("build pyramid", "load");
+            pyramid = ImagePyramid(photo);
+        }
+    }
+
+    QMetaObject::invokeMethod(this, [this, job, photo, pyramid, errorString, lastModified, fileSize]() {
+        if (m_prefetchJobs.value(job->filePath) == job)
+            m_prefetchJobs.remove(job->filePath);
+        // Out-of-core photos have no photo image, they are not cached.
+        if (!photo.isNull() && !pyramid.isNull()) {
+            m_cache.insert(job->filePath, new CacheEntry { photo, pyramid, lastModified, fileSize },
+                           int(qMax<qint64>(1, pyramid.memoryUsage() / 1024)));
+        }
+
+        // A canceled or superseded job is no longer the current one.
+        if (job != m_job)
+            return;
+
+        m_job.reset();
+        if (pyramid.isNull()) {
+            emit failed(job->filePath, errorString);
+        } else {
+            emit progressChanged(100);
+            emit loaded(job->filePath, photo, pyramid);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void PhotoLoader::runPreview(const QSharedPointer<Job>& job)
+{
+    QSize photoSize;
+    {
+        QFile file(job->filePath);
+        if (file.open(QIODevice::ReadOnly)) {
+            const QImage thumbnail = Exif::readThumbnail(&file);
+            if (!thumbnail.isNull()) {
+                file.seek(0);
+                QImageReader photoReader(&file, QFileInfo(job->filePath).suffix().toLatin1());
+                photoReader.setAutoTransform(true);
+                photoSize = photoReader.size();
+                if (photoReader.transformation() & QImageIOHandler::TransformationRotate90)
+                    photoSize.transpose();
+                if (photoSize.isValid())
+                    deliverPreview(job, thumbnail, photoSize);
+            }
+        }
+    }
+
+    // Small photos are decoded at full resolution fast enough.
+    const QSize bound(Constants::PHOTO_PREVIEW_SIZE_PX, Constants::PHOTO_PREVIEW_SIZE_PX);
+    if (job->canceled || (photoSize.isValid() && photoSize.width() <= bound.width() && photoSize.height() <= bound.height()))
+        return;
+
+    const QImage preview = readScaledPhoto(job->filePath, bound, &photoSize);
+    if (!preview.isNull())
+        deliverPreview(job, preview, photoSize);
+}
+
+void PhotoLoader::deliverPreview(const QSharedPointer<Job>& job, QImage preview, const QSize& photoSize)
+{
+    if (job->canceled)
+        return;
+    preview = Compositing::toDestinationFormat(preview);
+
+    QMetaObject::invokeMethod(this, [this, job, preview, photoSize]() {
+        if (job == m_job)
+            emit previewReady(job->filePath, preview, photoSize);
+    }, Qt::QueuedConnection);
+}
+
+void PhotoLoader::runProject(const QSharedPointer<Job>& job)
+{
+    QString errorString;
+    PhotoSaver::Document document;
+    const bool success = ProjectFile::read(job->filePath, &document, &errorString);
+
+    QMetaObject::invokeMethod(this, [this, job, success, document, errorString]() {
+        if (m_prefetchJobs.value(job->filePath) == job)
+            m_prefetchJobs.remove(job->filePath);
+        if (job != m_job)
+            return;
+
+        m_job.reset();
+        if (success) {
+            emit progressChanged(100);
+            emit projectLoaded(job->filePath, document);
+        } else {
+            emit failed(job->filePath, errorString);
+        }
+    }, Qt::QueuedConnection);
+}
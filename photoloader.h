@@ -0,0 +1,99 @@
+#ifndef PHOTOLOADER_H
+#define PHOTOLOADER_H
+
+#include "imagepyramid.h"
+#include "photosaver.h"
+
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+#include <atomic>
+#include <functional>
+
+// Decodes photos on a worker thread. Starting a new load cancels the one in flight;
+// the results of a canceled load are never delivered.
+// Before the full resolution decode, reduced previews are delivered: the EXIF thumbnail first, if any,
+// then a decode at the screen resolution for the formats which can scale while decoding, like JPEG.
+// Decoded photos are kept in an LRU cache bounded in bytes, so loading a photo seen recently or prefetched
+// delivers it without decoding. Prefetches run on their own threads and never deliver anything by themselves;
+// loading a photo whose prefetch is in flight waits for the prefetch instead of decoding it again.
+// Projects are mapped rather than decoded, they are delivered whole without previews and not cached.
+class PhotoLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Receives the progress in percent, returns false to cancel the load.
+    using ProgressCallback = std::function<bool(int percent)>;
+
+    PhotoLoader(QObject* parent = nullptr);
+    ~PhotoLoader();
+
+    void load(const QString& filePath);
+    void cancel();
+    bool isLoading() const { return !m_job.isNull(); }
+    // Decodes the photos into the cache in the background, the prefetches of photos not listed are canceled.
+    // Photos too big for memory are not prefetched.
+    void prefetch(const QStringList& filePaths);
+    bool isCached(const QString& filePath) const;
+
+    // Reads the photo, converts it to sRGB and to RGB32 or premultiplied ARGB32. Runs on the calling thread.
+    static QImage readPhoto(const QString& filePath, QString* errorString = nullptr,
+                            const ProgressCallback& progress = ProgressCallback());
+    // Reads a photo too big for memory band by band into out-of-core tile stores, only the coarse pyramid
+    // levels are kept in memory. JPEG photos are decoded in one pass when libjpeg is available, the other formats
+    // must support decoding a clip rect. The EXIF orientation is applied like readPhoto() does.
+    static ImagePyramid readTiledPhoto(const QString& filePath, QString* errorString = nullptr,
+                                       const ProgressCallback& progress = ProgressCallback());
+    // Returns true if the photo has to be read by readTiledPhoto().
+    static bool needsTiledRead(const QString& filePath);
+    // Returns the absolute paths of the photos of the folder the loader can read, in name order.
+    static QStringList listPhotos(const QString& folderPath);
+    // Reads the photo scaled down to fit the bound, using the decoder scaling when the format supports it.
+    static QImage readScaledPhoto(const QString& filePath, const QSize& bound, QSize* photoSize = nullptr);
+
+signals:
+    void started(const QString& filePath);
+    void progressChanged(int percent);
+    void previewReady(const QString& filePath, const QImage& preview, const QSize& photoSize);
+    // The photo is null if it is too big for memory, its pixels are only available from the pyramid then.
+    void loaded(const QString& filePath, const QImage& photo, const ImagePyramid& pyramid);
+    void projectLoaded(const QString& filePath, const PhotoSaver::Document& document);
+    void failed(const QString& filePath, const QString& errorString);
+    void canceled(const QString& filePath);
+
+private:
+    struct Job
+    {
+        QString filePath;
+        bool prefetch { false };
+        std::atomic<bool> canceled { false };
+    };
+
+    struct CacheEntry
+    {
+        QImage photo;
+        ImagePyramid pyramid;
+        // The entry is stale once the file changed.
+        QDateTime lastModified;
+        qint64 fileSize { 0 };
+    };
+
+    void start(const QSharedPointer<Job>& job);
+    void run(const QSharedPointer<Job>& job);
+    void runPreview(const QSharedPointer<Job>& job);
+    void runProject(const QSharedPointer<Job>& job);
+    void deliverPreview(const QSharedPointer<Job>& job, QImage preview, const QSize& photoSize);
+
+    QThreadPool m_threadPool;
+    QThreadPool m_prefetchThreadPool;
+    QSharedPointer<Job> m_job;
+    QHash<QString, QSharedPointer<Job>> m_prefetchJobs;
+    QCache<QString, CacheEntry> m_cache;
+};
+
+#endif // PHOTOLOADER_H
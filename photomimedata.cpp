@@ -0,0 +1,70 @@
+#include "photomimedata.h"
+
+#include <QBuffer>
+#include <QImageWriter>
+#include <QMimeDatabase>
+
+namespace {
+
+const QString IMAGE_MIME_TYPE { QStringLiteral("application/x-qt-image") };
+const QStringList ENCODED_MIME_TYPES { QStringLiteral("image/png"), QStringLiteral("image/bmp"),
+                                       QStringLiteral("image/jpeg"), QStringLiteral("image/tiff") };
+
+QStringList supportedEncodedMimeTypes()
+{
+    static const QStringList mimeTypes = []() {
+        const QByteArrayList writerMimeTypes = QImageWriter::supportedMimeTypes();
+        QStringList supported;
+        for (const QString& mimeType : ENCODED_MIME_TYPES) {
+            if (writerMimeTypes.contains(mimeType.toLatin1()))
+                supported.append(mimeType);
+        }
+        return supported;
+    }();
+    return mimeTypes;
+}
+
+}
+
+PhotoMimeData::PhotoMimeData(const QSharedPointer<Content>& content)
+    : m_content(content)
+{}
+
+bool PhotoMimeData::hasFormat(const QString& mimeType) const
+{
+    return mimeType == IMAGE_MIME_TYPE || supportedEncodedMimeTypes().contains(mimeType);
+}
+
+QStringList PhotoMimeData::formats() const
+{
+    return QStringList(IMAGE_MIME_TYPE) + supportedEncodedMimeTypes();
+}
+
+QVariant PhotoMimeData::retrieveData(const QString& mimeType, QVariant::Type preferredType) const
+{
+    if (mimeType == IMAGE_MIME_TYPE)
+        return image();
+    if (!supportedEncodedMimeTypes().contains(mimeType))
+        return QMimeData::retrieveData(mimeType, preferredType);
+
+    const auto encoding = m_content->encodings.constFind(mimeType);
+    if (encoding != m_content->encodings.constEnd())
+        return *encoding;
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    const QByteArray format = QMimeDatabase().mimeTypeForName(mimeType).preferredSuffix().toLatin1();
+    if (!QImageWriter(&buffer, format).write(image()))
+        return QVariant();
+
+    m_content->encodings.insert(mimeType, data);
+    return data;
+}
+
+QImage PhotoMimeData::image() const
+{
+    if (m_content->image.isNull())
+        m_content->image = PhotoSaver::flatten(m_content->document);
+    return m_content->image;
+}
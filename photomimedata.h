@@ -0,0 +1,39 @@
+#ifndef PHOTOMIMEDATA_H
+#define PHOTOMIMEDATA_H
+
+#include "photosaver.h"
+
+#include <QHash>
+#include <QMimeData>
+#include <QSharedPointer>
+
+// Clipboard data of the edited photo. Only a snapshot of the document is taken on copy; the photo is
+// flattened when a consumer first asks for it, and encoded only in the formats actually requested.
+class PhotoMimeData : public QMimeData
+{
+    Q_OBJECT
+
+public:
+    // Flattened photo and its encodings, shared by the copies of the same document state.
+    struct Content
+    {
+        PhotoSaver::Document document;
+        QImage image;
+        QHash<QString, QByteArray> encodings;
+    };
+
+    explicit PhotoMimeData(const QSharedPointer<Content>& content);
+
+    bool hasFormat(const QString& mimeType) const override;
+    QStringList formats() const override;
+
+protected:
+    QVariant retrieveData(const QString& mimeType, QVariant::Type preferredType) const override;
+
+private:
+    QImage image() const;
+
+    QSharedPointer<Content> m_content;
+};
+
+#endif // PHOTOMIMEDATA_H
@@ -0,0 +1,95 @@
+#include "photoprinter.h"
+#include "constants.h"
+
+#include <QPagedPaintDevice>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QtMath>
+
+namespace PhotoPrinter {
+
+void render(QPainter* painter, const QRectF& targetRect, const PhotoSaver::Document& document)
+{
+    if (document.pyramid.isNull() || targetRect.isEmpty())
+        return;
+
+    // Band edges are snapped to device pixels, so the neighbour bands meet without seams. Painters which rotate,
+    // shear or mirror have no pixel grid to snap to, the bands are drawn as they fall then.
+    const QTransform deviceTransform = painter->deviceTransform();
+    const bool snapped = deviceTransform.type() <= QTransform::TxScale && deviceTransform.m11() > 0.0
+            && deviceTransform.m22() > 0.0;
+    const QRectF bandsRect = snapped ? deviceTransform.mapRect(targetRect) : targetRect;
+
+    // The finest level needed for the device resolution, printing at 1200 dpi rarely needs the full photo.
+    const QSize photoSize = document.pyramid.size();
+    const ImagePyramid pyramid = FilterGraph(document.adjustments).apply(document.pyramid);
+    const int levelIndex = pyramid.levelForScale(bandsRect.width() / photoSize.width());
+    const TiledImage& level = pyramid.level(levelIndex);
+    const qreal levelScale = qreal(level.width()) / photoSize.width();
+
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+    if (snapped)
+        painter->resetTransform();
+    const qreal bandScale = bandsRect.height() / level.height();
+    const int left = qFloor(bandsRect.left()),
+            right = qFloor(bandsRect.right());
+    auto bandTargetRect = [&](const QRect& bandRect) {
+        if (!snapped) {
+            return QRectF(bandsRect.x(), bandsRect.y() + bandRect.top() * bandScale,
+                          bandsRect.width(), bandRect.height() * bandScale);
+        }
+        const int top = qFloor(bandsRect.top() + bandRect.top() * bandScale),
+                bottom = qFloor(bandsRect.top() + (bandRect.bottom() + 1) * bandScale);
+        return QRectF(left, top, right - left, bottom - top);
+    };
+
+    const int bandHeight = Constants::PRINT_BAND_HEIGHT_PX;
+    for (int top = 0; top < level.height(); top += bandHeight) {
+        const QRect bandRect(0, top, level.width(), qMin(bandHeight, level.height() - top));
+        const QRectF bandTarget = bandTargetRect(bandRect);
+        if (bandTarget.isEmpty())
+            continue;
+        QImage band = level.copy(bandRect);
+        document.annotations.composite(band, document.annotationOpacity, bandRect.topLeft(), levelScale);
+        painter->drawImage(bandTarget, band);
+    }
+    painter->restore();
+}
+
+bool print(QPagedPaintDevice* device, const PhotoSaver::Document& document, QString* errorString)
+{
+    if (document.pyramid.isNull()) {
+        if (errorString)
+            *errorString = QObject::tr("No photo");
+        return false;
+    }
+
+    QPainter painter;
+    if (!painter.begin(device)) {
+        if (errorString)
+            *errorString = QObject::tr("Cannot start printing");
+        return false;
+    }
+
+    // Fit the photo into the printable area, centered.
+    const QRect pageRect = painter.viewport();
+    const QSize targetSize = document.pyramid.size().scaled(pageRect.size(), Qt::KeepAspectRatio);
+    QRectF targetRect(QPointF(0.0, 0.0), targetSize);
+    targetRect.moveCenter(QRectF(pageRect).center());
+    render(&painter, targetRect, document);
+    return painter.end();
+}
+
+bool exportPdf(const PhotoSaver::Document& document, const QString& filePath, QString* errorString)
+{
+    QPdfWriter writer(filePath);
+    writer.setCreator(QStringLiteral("PhotoEditor"));
+    writer.setPageMargins(QMarginsF(0.0, 0.0, 0.0, 0.0));
+    const QSize photoSize = document.pyramid.size();
+    if (photoSize.width() > photoSize.height())
+        writer.setPageOrientation(QPageLayout::Landscape);
+    return print(&writer, document, errorString);
+}
+
+}
@@ -0,0 +1,23 @@
+#ifndef PHOTOPRINTER_H
+#define PHOTOPRINTER_H
+
+#include "photosaver.h"
+
+class QPagedPaintDevice;
+class QPainter;
+
+// Prints the document fitted into a page. The page is rendered in horizontal bands taken from the pyramid
+// level nearest to the print resolution, each band composited with the annotations on its own, so the
+// memory used depends on the band size rather than on the photo size.
+namespace PhotoPrinter {
+
+    // Renders the document into the target rect of the painter, in device coordinates.
+    void render(QPainter* painter, const QRectF& targetRect, const PhotoSaver::Document& document);
+
+    // Prints the document on a single page of the device, a QPrinter or a QPdfWriter.
+    bool print(QPagedPaintDevice* device, const PhotoSaver::Document& document, QString* errorString = nullptr);
+    bool exportPdf(const PhotoSaver::Document& document, const QString& filePath, QString* errorString = nullptr);
+
+}
+
+#endif // PHOTOPRINTER_H
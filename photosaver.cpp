@@ -0,0 +1,220 @@
+#include "photosaver.h"
+#include "compositing.h"
+#include "profiler.h"
+#include "projectfile.h"
+#include "constants.h"
+#ifdef HAVE_LIBJPEG
+#include "jpegbandwriter.h"
+#endif
+
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent>
+#include <QVector>
+
+#include <cstring>
+
+PhotoSaver::PhotoSaver(QObject* parent)
+    : QObject(parent)
+{
+    m_threadPool.setMaxThreadCount(1);
+}
+
+PhotoSaver::~PhotoSaver()
+{
+    // A save in flight is completed, the document would be lost otherwise.
+    m_threadPool.waitForDone();
+}
+
+void PhotoSaver::save(const Document& document, const QString& filePath, const QByteArray& format)
+{
+    ++m_pendingCount;
+    emit started(filePath);
+    emit progressChanged(0);
+
+    m_threadPool.start([this, document, filePath, format]() {
+        run(document, filePath, format);
+    });
+}
+
+QImage PhotoSaver::flatten(const Document& document, QString* errorString)
+{
+    if (document.pyramid.isNull())
+        return QImage();
+
+    const Profiler::ScopedTimer timer("flatten", "save");
+    const ImagePyramid pyramid = FilterGraph(document.adjustments).apply(document.pyramid);
+    const TiledImage& photoTiles = pyramid.level(0);
+    // The annotations blend onto RGB32 or premultiplied ARGB32 only, whatever format the tiles were stored in.
+    const QImage::Format format = Compositing::toDestinationFormat(photoTiles.tile(0, 0)).format();
+    QImage image(photoTiles.size(), format);
+    if (image.isNull()) {
+        if (errorString)
+            *errorString = QObject::tr("Not enough memory");
+        return QImage();
+    }
+
+    // Bands span whole tile rows, each one is assembled from its tiles, annotated and copied into the image.
+    const int bandHeight = Constants::PHOTO_TILE_SIZE_PX;
+    QVector<int> bandTops;
+    for (int y = 0; y < image.height(); y += bandHeight)
+        bandTops.append(y);
+
+    uchar* const bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    QtConcurrent::blockingMap(bandTops, [&](int bandTop) {
+        const QRect bandRect(0, bandTop, image.width(), qMin(bandHeight, image.height() - bandTop));
+        QImage band = photoTiles.copy(bandRect).convertToFormat(format);
+        document.annotations.composite(band, document.annotationOpacity, bandRect.topLeft());
+        const size_t lineBytes = size_t(band.width()) * 4;
+        for (int y = 0; y < band.height(); ++y)
+            std::memcpy(bits + (bandTop + y) * bytesPerLine, band.constScanLine(y), lineBytes);
+    });
+    return image;
+}
+
+bool PhotoSaver::write(const QImage& image, const QString& filePath, const QByteArray& format, QString* errorString)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    QImageWriter writer(&file, format.isEmpty() ? QFileInfo(filePath).suffix().toLatin1() : format);
+    const Profiler::ScopedTimer timer("encode", "save");
+    if (!writer.write(image)) {
+        if (errorString)
+            *errorString = writer.errorString();
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool PhotoSaver::writeBands(const Document& document, const QString& filePath, QString* errorString,
+                            const std::function<void(int percent)>& progress)
+{
+#ifdef HAVE_LIBJPEG
+    if (document.pyramid.isNull())
+        return false;
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    const Profiler::ScopedTimer timer("flatten and encode", "save");
+    const ImagePyramid pyramid = FilterGraph(document.adjustments).apply(document.pyramid);
+    const TiledImage& photoTiles = pyramid.level(0);
+    JpegBandWriter writer(&file);
+    if (!writer.open(photoTiles.size(), Constants::OUT_OF_CORE_JPEG_QUALITY, errorString)) {
+        file.cancelWriting();
+        return false;
+    }
+
+    // The encoder takes the lines in order, so the bands are flattened a batch at a time on all cores,
+    // then encoded one after the other. Only a batch of bands is ever in memory.
+    const int bandHeight = Constants::PHOTO_TILE_SIZE_PX;
+    const int batchSize = qMax(1, QThread::idealThreadCount());
+    for (int batchTop = 0; batchTop < photoTiles.height(); batchTop += bandHeight * batchSize) {
+        QVector<QRect> bandRects;
+        for (int y = batchTop; y < photoTiles.height() && bandRects.size() < batchSize; y += bandHeight)
+            bandRects.append(QRect(0, y, photoTiles.width(), qMin(bandHeight, photoTiles.height() - y)));
+
+        const QVector<QImage> bands = QtConcurrent::blockingMapped(bandRects, [&](const QRect& bandRect) {
+            QImage band = photoTiles.copy(bandRect);
+            document.annotations.composite(band, document.annotationOpacity, bandRect.topLeft());
+            return band;
+        });
+        for (const QImage& band : bands) {
+            if (!writer.writeBand(band, errorString)) {
+                file.cancelWriting();
+                return false;
+            }
+        }
+        if (progress)
+            progress(int(qint64(bandRects.last().bottom() + 1) * 100 / photoTiles.height()));
+    }
+
+    if (!writer.finish(errorString)) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(document)
+    Q_UNUSED(filePath)
+    Q_UNUSED(errorString)
+    Q_UNUSED(progress)
+    return false;
+#endif
+}
+
+void PhotoSaver::run(const Document& document, const QString& filePath, const QByteArray& format)
+{
+    const Profiler::ScopedTimer timer("save", "save");
+    QString errorString;
+    bool success = false;
+    int reportedPercent = 0;
+    auto reportProgress = [this, &reportedPercent](int percent) {
+        if (percent == reportedPercent)
+            return;
+        reportedPercent = percent;
+        QMetaObject::invokeMethod(this, [this, percent]() {
+            emit progressChanged(percent);
+        }, Qt::QueuedConnection);
+    };
+
+    if (ProjectFile::isProject(filePath)) {
+        success = ProjectFile::write(document, filePath, &errorString, reportProgress);
+    } else {
+        // Photos which only fit in memory out of core are not flattened whole when saved as JPEG, they are encoded
+        // band by band. The other formats need the whole image.
+        const QByteArray photoFormat = (format.isEmpty() ? QFileInfo(filePath).suffix().toLatin1() : format).toLower();
+        const bool outOfCore = !document.pyramid.isNull() && document.pyramid.level(0).isOutOfCore();
+        if (outOfCore && (photoFormat == "jpg" || photoFormat == "jpeg"))
+            success = writeBands(document, filePath, &errorString, reportProgress);
+
+        if (!success && errorString.isEmpty()) {
+            const QImage image = flatten(document, &errorString);
+            success = !image.isNull();
+            if (success) {
+                // The encoders report no progress.
+                QMetaObject::invokeMethod(this, [this]() {
+                    emit progressChanged(-1);
+                }, Qt::QueuedConnection);
+                success = write(image, filePath, format, &errorString);
+            } else if (outOfCore) {
+                errorString = tr("The photo is too big to be saved as %1, save it as JPEG or as a project")
+                        .arg(QString::fromLatin1(photoFormat.toUpper()));
+            }
+        }
+    }
+
+    QMetaObject::invokeMethod(this, [this, filePath, success, errorString]() {
+        --m_pendingCount;
+        if (success) {
+            emit progressChanged(100);
+            emit saved(filePath);
+        } else {
+            emit failed(filePath, errorString);
+        }
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,67 @@
+#ifndef PHOTOSAVER_H
+#define PHOTOSAVER_H
+
+#include "annotationscene.h"
+#include "edithistory.h"
+#include "filtergraph.h"
+#include "imagepyramid.h"
+
+#include <QObject>
+#include <QThreadPool>
+
+#include <functional>
+
+// Saves photos on a worker thread. A save works on a snapshot of the document: the pyramid and the
+// annotation scene are implicitly shared, taking one copies nothing, and the edits made while the save
+// is in flight detach from it. Saves run one after the other, in the order they were requested.
+// The file is written to a temporary file renamed over the target once complete, so an interrupted
+// save never leaves a truncated photo behind. Projects are saved as they are, without flattening.
+class PhotoSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Document
+    {
+        ImagePyramid pyramid;
+        AnnotationScene annotations;
+        int annotationOpacity { 255 };
+        // Applied over the pyramid when flattening and printing, projects keep them as they are.
+        QVector<FilterGraph::Node> adjustments;
+        // Only saved to projects, flattened photos have no history.
+        QVector<EditHistory::Record> history;
+        int historyIndex { 0 };
+    };
+
+    PhotoSaver(QObject* parent = nullptr);
+    ~PhotoSaver();
+
+    // The format is guessed from the file suffix if empty.
+    void save(const Document& document, const QString& filePath, const QByteArray& format = QByteArray());
+    bool isSaving() const { return m_pendingCount > 0; }
+
+    // Composites the edited tiles through the adjustments and the annotations over the photo, band by band on all cores.
+    static QImage flatten(const Document& document, QString* errorString = nullptr);
+    // Encodes the image to a temporary file and renames it to the file path. Runs on the calling thread.
+    static bool write(const QImage& image, const QString& filePath, const QByteArray& format = QByteArray(),
+                      QString* errorString = nullptr);
+    // Flattens the document band by band straight into a JPEG encoder, for the photos too big to flatten in memory.
+    // Returns false with no error string if libjpeg is not available. Runs on the calling thread.
+    static bool writeBands(const Document& document, const QString& filePath, QString* errorString = nullptr,
+                           const std::function<void(int percent)>& progress = std::function<void(int percent)>());
+
+signals:
+    void started(const QString& filePath);
+    // A negative percent means the progress is unknown, while the encoder runs.
+    void progressChanged(int percent);
+    void saved(const QString& filePath);
+    void failed(const QString& filePath, const QString& errorString);
+
+private:
+    void run(const Document& document, const QString& filePath, const QByteArray& format);
+
+    QThreadPool m_threadPool;
+    int m_pendingCount { 0 };
+};
+
+#endif // PHOTOSAVER_H
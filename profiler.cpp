@@ -0,0 +1,239 @@
+#include "profiler.h"
+#include "constants.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+struct Event
+{
+    const char* name { nullptr };
+    const char* category { nullptr };
+    qint64 startNs { 0 };
+    qint64 durationNs { 0 };
+    int threadId { 0 };
+};
+
+struct Frame
+{
+    qint64 endNs { 0 };
+    qint64 paintNs { 0 };
+    bool panning { false };
+};
+
+// Events and frames are recorded under the same lock, a few times per frame at most.
+struct State
+{
+    QMutex mutex;
+    QVector<Event> events;
+    int nextEvent { 0 };
+    QHash<int, QString> threadNames;
+    QVector<Frame> frames;
+
+    std::atomic<qint64> decodeNs { -1 };
+    std::atomic<int> tileCacheHits { 0 };
+    std::atomic<int> tileCacheMisses { 0 };
+};
+
+State& state()
+{
+    static State instance;
+    return instance;
+}
+
+const QElapsedTimer& clock()
+{
+    static const QElapsedTimer instance = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return instance;
+}
+
+// Small stable ids read better in the trace viewers than the native thread handles.
+int currentThreadId()
+{
+    static std::atomic<int> nextThreadId { 1 };
+    thread_local const int threadId = nextThreadId++;
+    return threadId;
+}
+
+QString currentThreadName()
+{
+    QThread* thread = QThread::currentThread();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+        return QStringLiteral("GUI thread");
+    return thread->objectName().isEmpty() ? QStringLiteral("Worker thread") : thread->objectName();
+}
+
+void record(const Event& event)
+{
+    State& profilerState = state();
+    QMutexLocker locker(&profilerState.mutex);
+    if (profilerState.events.size() < Constants::PROFILER_TRACE_EVENT_COUNT)
+        profilerState.events.append(event);
+    else
+        profilerState.events[profilerState.nextEvent] = event;
+    profilerState.nextEvent = (profilerState.nextEvent + 1) % Constants::PROFILER_TRACE_EVENT_COUNT;
+    if (!profilerState.threadNames.contains(event.threadId))
+        profilerState.threadNames.insert(event.threadId, currentThreadName());
+}
+
+}
+
+namespace Profiler {
+
+ScopedTimer::ScopedTimer(const char* name, const char* category)
+    : m_name(name)
+    , m_category(category)
+    , m_startNs(now())
+{}
+
+ScopedTimer::~ScopedTimer()
+{
+    finish();
+}
+
+qint64 ScopedTimer::finish()
+{
+    if (m_durationNs < 0) {
+        m_durationNs = now() - m_startNs;
+        record({ m_name, m_category, m_startNs, m_durationNs, currentThreadId() });
+    }
+    return m_durationNs;
+}
+
+qint64 now()
+{
+    return clock().nsecsElapsed();
+}
+
+QVector<Span> spans(const char* category)
+{
+    QVector<Span> categorySpans;
+    {
+        State& profilerState = state();
+        QMutexLocker locker(&profilerState.mutex);
+        for (const Event& event : qAsConst(profilerState.events)) {
+            if (std::strcmp(event.category, category) == 0)
+                categorySpans.append({ event.name, event.startNs, event.durationNs });
+        }
+    }
+    std::sort(categorySpans.begin(), categorySpans.end(), [](const Span& a, const Span& b) {
+        return a.startNs < b.startNs;
+    });
+    return categorySpans;
+}
+
+bool writeTrace(const QString& filePath, QString* errorString)
+{
+    QJsonArray traceEvents;
+    const qint64 processId = QCoreApplication::applicationPid();
+    {
+        State& profilerState = state();
+        QMutexLocker locker(&profilerState.mutex);
+        for (auto it = profilerState.threadNames.cbegin(); it != profilerState.threadNames.cend(); ++it) {
+            traceEvents.append(QJsonObject {
+                { "name", "thread_name" }, { "ph", "M" }, { "pid", processId }, { "tid", it.key() },
+                { "args", QJsonObject { { "name", it.value() } } }
+            });
+        }
+
+        // Once the buffer is full, the oldest event is the next one to be overwritten.
+        const int eventCount = profilerState.events.size();
+        const int firstEvent = eventCount < Constants::PROFILER_TRACE_EVENT_COUNT ? 0 : profilerState.nextEvent;
+        for (int i = 0; i < eventCount; ++i) {
+            const Event& event = profilerState.events.at((firstEvent + i) % eventCount);
+            traceEvents.append(QJsonObject {
+                { "name", QString::fromLatin1(event.name) }, { "cat", QString::fromLatin1(event.category) }, { "ph", "X" },
+                { "ts", event.startNs / 1000.0 }, { "dur", event.durationNs / 1000.0 }, { "pid", processId }, { "tid", event.threadId }
+            });
+        }
+    }
+
+    const QJsonObject trace { { "traceEvents", traceEvents }, { "displayTimeUnit", "ms" } };
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) < 0 || !file.commit()) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void recordDecode(qint64 durationNs)
+{
+    state().decodeNs = durationNs;
+}
+
+void recordFrame(qint64 paintNs, bool panning)
+{
+    State& profilerState = state();
+    const qint64 endNs = now();
+    QMutexLocker locker(&profilerState.mutex);
+    profilerState.frames.append({ endNs, paintNs, panning });
+    const qint64 windowStartNs = endNs - qint64(Constants::PROFILER_COUNTERS_WINDOW_MS) * 1000000;
+    int expiredFrames = 0;
+    while (expiredFrames < profilerState.frames.size() && profilerState.frames.at(expiredFrames).endNs < windowStartNs)
+        ++expiredFrames;
+    profilerState.frames.remove(0, expiredFrames);
+}
+
+void recordTileCacheLookup(bool hit)
+{
+    if (hit)
+        ++state().tileCacheHits;
+    else
+        ++state().tileCacheMisses;
+}
+
+Counters takeCounters()
+{
+    State& profilerState = state();
+    Counters counters;
+    counters.decodeNs = profilerState.decodeNs;
+
+    const int hits = profilerState.tileCacheHits.exchange(0),
+            misses = profilerState.tileCacheMisses.exchange(0);
+    if (hits + misses > 0)
+        counters.tileCacheHitRate = qreal(hits) / (hits + misses);
+
+    const qint64 windowStartNs = now() - qint64(Constants::PROFILER_COUNTERS_WINDOW_MS) * 1000000;
+    qint64 paintSumNs = 0, firstPanningFrameNs = -1, lastPanningFrameNs = -1;
+    int frameCount = 0, panningFrameCount = 0;
+    QMutexLocker locker(&profilerState.mutex);
+    for (const Frame& frame : qAsConst(profilerState.frames)) {
+        if (frame.endNs < windowStartNs)
+            continue;
+        paintSumNs += frame.paintNs;
+        ++frameCount;
+        if (frame.panning) {
+            if (firstPanningFrameNs < 0)
+                firstPanningFrameNs = frame.endNs;
+            lastPanningFrameNs = frame.endNs;
+            ++panningFrameCount;
+        }
+    }
+    if (frameCount > 0)
+        counters.paintNs = paintSumNs / frameCount;
+    if (panningFrameCount > 1 && lastPanningFrameNs > firstPanningFrameNs)
+        counters.panningFps = (panningFrameCount - 1) * 1e9 / (lastPanningFrameNs - firstPanningFrameNs);
+    return counters;
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+// Lightweight instrumentation of the load, conversion, paint and save paths. Scoped timers record their
+// scopes into a bounded ring buffer of trace events which is always on, so a trace of the last moments can be
+// exported for a bug report without an external profiler. The counters of the performance HUD are
+// recorded alongside.
+namespace Profiler {
+
+    // Measures the time from its construction to finish() or its destruction, whichever comes first, and
+    // records it as a trace event. The name and category must be string literals, only their address is kept.
+    class ScopedTimer
+    {
+        Q_DISABLE_COPY(ScopedTimer)
+
+    public:
+        explicit ScopedTimer(const char* name, const char* category = "photoeditor");
+        ~ScopedTimer();
+
+        // Records the event once, returns the measured time in nanoseconds.
+        qint64 finish();
+
+    private:
+        const char* m_name;
+        const char* m_category;
+        qint64 m_startNs;
+        qint64 m_durationNs { -1 };
+    };
+
+    struct Span
+    {
+        const char* name { nullptr };
+        qint64 startNs { 0 };
+        qint64 durationNs { 0 };
+    };
+
+    // Nanoseconds since the start of the profiling clock, started by its first use.
+    qint64 now();
+
+    // Returns the scopes of the category left in the ring buffer, in start order.
+    QVector<Span> spans(const char* category);
+
+    // Writes the events of the ring buffer in the Chrome trace_event JSON format,
+    // which chrome://tracing and Perfetto open.
+    bool writeTrace(const QString& filePath, QString* errorString = nullptr);
+
+    void recordDecode(qint64 durationNs);
+    // Panning frames are the ones painted after the view scrolled without zooming.
+    void recordFrame(qint64 paintNs, bool panning);
+    void recordTileCacheLookup(bool hit);
+
+    struct Counters
+    {
+        // Duration of the last decode, -1 if none.
+        qint64 decodeNs { -1 };
+        // Average paint time of the frames of the last second, -1 if none.
+        qint64 paintNs { -1 };
+        // Frame rate over the panning frames of the last second, 0 when not panning.
+        qreal panningFps { 0.0 };
+        // Ratio of the tile lookups served from the cache since the previous call, -1 if none.
+        qreal tileCacheHitRate { -1.0 };
+    };
+
+    // Returns the current counters and restarts the tile cache statistics.
+    Counters takeCounters();
+
+}
+
+#endif // PROFILER_H
@@ -0,0 +1,785 @@
+#include "projectfile.h"
+#include "profiler.h"
+#include "tiledimagestore.h"
+#include "constants.h"
+
+#include <QCache>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QMultiHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+// The line ending catches files mangled by text mode transfers, like in PNG.
+const char MAGIC[] = "PEPROJ\r\n";
+const int MAGIC_SIZE = 8;
+const quint32 VERSION = 1;
+// Magic, version, chunk count and directory offset.
+const int HEADER_SIZE = MAGIC_SIZE + 4 + 4 + 8;
+// Type, level, index, offset and size.
+const int DIRECTORY_ENTRY_SIZE = 4 + 4 + 4 + 8 + 8;
+const int TILE_COMPRESSION_LEVEL = 1;
+
+enum ChunkType : quint32 {
+    InfoChunk = 1,
+    TileChunk,
+    EditedTilesChunk,
+    AnnotationsChunk,
+    HistoryChunk,
+    // Added after the first version, projects without it have no adjustments.
+    AdjustmentsChunk
+};
+
+struct Chunk
+{
+    quint32 type { 0 };
+    quint32 level { 0 };
+    quint32 index { 0 };
+    quint64 offset { 0 };
+    quint64 size { 0 };
+};
+
+// The project file mapped into memory, shared by the tile stores of all the levels and by the history tiles
+// left in the file. Its users reach the chunks by the offsets they had when the project was opened: saving
+// the project over its own file swaps the mapping to the new file, where the chunks copied over are relocated.
+class Mapping : public EditHistory::TileFile
+{
+public:
+    ~Mapping() override
+    {
+        unmap();
+        QMutexLocker locker(&registryMutex());
+        auto& mappings = registry();
+        for (auto it = mappings.find(m_filePath); it != mappings.end() && it.key() == m_filePath;)
+            it = it->isNull() ? mappings.erase(it) : std::next(it);
+    }
+
+    // Maps the file, returns null on failure.
+    static QSharedPointer<Mapping> open(const QString& filePath, QString* errorString)
+    {
+        auto mapping = QSharedPointer<Mapping>::create();
+        mapping->m_filePath = QFileInfo(filePath).canonicalFilePath();
+        mapping->m_file.setFileName(filePath);
+        if (!mapping->map(errorString))
+            return QSharedPointer<Mapping>();
+
+        QMutexLocker locker(&registryMutex());
+        registry().insert(mapping->m_filePath, mapping);
+        return mapping;
+    }
+
+    // Returns the mappings of the file which are open, the ones a save over the file has to swap.
+    static QVector<QSharedPointer<Mapping>> mappings(const QString& filePath)
+    {
+        const QString canonicalFilePath = QFileInfo(filePath).canonicalFilePath();
+        QVector<QSharedPointer<Mapping>> mappings;
+        if (canonicalFilePath.isEmpty())
+            return mappings;
+
+        QMutexLocker locker(&registryMutex());
+        const QList<QWeakPointer<Mapping>> openMappings = registry().values(canonicalFilePath);
+        for (const QWeakPointer<Mapping>& openMapping : openMappings) {
+            if (const QSharedPointer<Mapping> mapping = openMapping.toStrongRef())
+                mappings.append(mapping);
+        }
+        return mappings;
+    }
+
+    // Held for reading while the bytes returned by address() are used, a swap waits for it.
+    QReadWriteLock& lock() const { return m_lock; }
+    // Size of the file mapped now.
+    qint64 size() const { return m_size; }
+
+    // Returns the bytes of the range at the offset it had when the project was opened, null if the range is not
+    // in the file mapped now. The lock must be held.
+    const uchar* address(qint64 offset, qint64 size) const
+    {
+        if (m_relocated) {
+            const auto relocatedOffset = m_relocation.constFind(offset);
+            if (relocatedOffset == m_relocation.constEnd())
+                return nullptr;
+            offset = *relocatedOffset;
+        }
+        if (!m_data || offset < 0 || size < 0 || offset > m_size || size > m_size - offset)
+            return nullptr;
+        return m_data + offset;
+    }
+
+    // Returns the bytes of a range of at most 2 GB, which fits in a byte array.
+    QByteArray bytes(qint64 offset, qint64 size) const
+    {
+        const uchar* data = size <= std::numeric_limits<int>::max() ? address(offset, size) : nullptr;
+        return data ? QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(size)) : QByteArray();
+    }
+
+    QByteArray read(qint64 offset, int size) override
+    {
+        QReadLocker locker(&m_lock);
+        const uchar* data = address(offset, size);
+        return data ? QByteArray(reinterpret_cast<const char*>(data), size) : QByteArray();
+    }
+
+    QString errorString() const override { return QObject::tr("The project file is damaged"); }
+
+    // Unmaps and closes the file, so it can be replaced even where files in use cannot be.
+    // The lock must be held for writing.
+    void unmap()
+    {
+        if (m_data)
+            m_file.unmap(m_data);
+        m_data = nullptr;
+        m_size = 0;
+        m_file.close();
+    }
+
+    // Maps the file again. If it was replaced, the ranges copied to it are reached through the relocation
+    // from the offsets they had when the project was opened, the others are gone. The lock must be held for writing.
+    bool remap(const QHash<qint64, qint64>* relocation, QString* errorString)
+    {
+        if (relocation) {
+            m_relocation = *relocation;
+            m_relocated = true;
+        }
+        return map(errorString);
+    }
+
+private:
+    bool map(QString* errorString)
+    {
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            if (errorString)
+                *errorString = m_file.errorString();
+            return false;
+        }
+        m_size = m_file.size();
+        m_data = m_size > 0 ? m_file.map(0, m_size) : nullptr;
+        if (!m_data) {
+            if (errorString)
+                *errorString = m_size > 0 ? m_file.errorString() : QObject::tr("Not a project file");
+            m_size = 0;
+            m_file.close();
+            return false;
+        }
+        return true;
+    }
+
+    static QMutex& registryMutex()
+    {
+        static QMutex mutex;
+        return mutex;
+    }
+
+    static QMultiHash<QString, QWeakPointer<Mapping>>& registry()
+    {
+        static QMultiHash<QString, QWeakPointer<Mapping>> mappings;
+        return mappings;
+    }
+
+    QString m_filePath;
+    QFile m_file;
+    uchar* m_data { nullptr };
+    qint64 m_size { 0 };
+    bool m_relocated { false };
+    QHash<qint64, qint64> m_relocation;
+    mutable QReadWriteLock m_lock;
+};
+
+// Offsets the chunks copied from the mappings of the file saved over had when the project was opened,
+// and their offsets in the new file.
+using Relocations = QHash<const EditHistory::TileFile*, QHash<qint64, qint64>>;
+
+void setUpStream(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+QByteArray compressPixels(const QImage& image)
+{
+    const int lineBytes = image.width() * image.depth() / 8;
+    QByteArray pixels;
+    pixels.reserve(lineBytes * image.height());
+    for (int y = 0; y < image.height(); ++y)
+        pixels.append(reinterpret_cast<const char*>(image.constScanLine(y)), lineBytes);
+    return qCompress(pixels, TILE_COMPRESSION_LEVEL);
+}
+
+QImage decompressPixels(const uchar* data, int size, const QSize& imageSize, QImage::Format format)
+{
+    const QByteArray pixels = data ? qUncompress(data, size) : QByteArray();
+    QImage image(imageSize, format);
+    const int lineBytes = imageSize.width() * image.depth() / 8;
+    if (pixels.size() != lineBytes * imageSize.height()) {
+        // A damaged tile shows as a hole rather than failing the whole project.
+        image.fill(0);
+        return image;
+    }
+
+    for (int y = 0; y < imageSize.height(); ++y)
+        std::memcpy(image.scanLine(y), pixels.constData() + y * lineBytes, size_t(lineBytes));
+    return image;
+}
+
+// Tile store of a pyramid level of a project, decompressing the tiles from the mapped file and keeping
+// the recently used ones. Tiles may be asked for from several threads at once, like when flattening.
+class ProjectTileStore : public TiledImageStore
+{
+public:
+    ProjectTileStore(const QSharedPointer<Mapping>& mapping, const QVector<Chunk>& tiles, const QSize& size,
+                     QImage::Format format, int tileSize)
+        : TiledImageStore(size, format, tileSize)
+        , m_mapping(mapping)
+        , m_tiles(tiles)
+    {
+        m_decodedTiles.setMaxCost(Constants::PROJECT_TILE_CACHE_SIZE_KB);
+    }
+
+    const QSharedPointer<Mapping>& mapping() const { return m_mapping; }
+
+    // Returns the compressed pixels of the original tile as they are in the file, with the offset they had
+    // when the project was opened. Empty if they are not in the file mapped now.
+    QByteArray compressedTile(int column, int row, qint64* offset) const
+    {
+        const Chunk& chunk = m_tiles.at(row * columns() + column);
+        *offset = qint64(chunk.offset);
+        return m_mapping->read(qint64(chunk.offset), int(chunk.size));
+    }
+
+    QImage tile(int column, int row) const override
+    {
+        const QRect rect = tileRect(column, row);
+        if (rect.isEmpty())
+            return QImage();
+
+        const int index = row * columns() + column;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (const QImage* tile = m_decodedTiles.object(index))
+                return *tile;
+        }
+
+        // Decompressed outside of the lock, so the tiles of a level decompress in parallel.
+        const Chunk& chunk = m_tiles.at(index);
+        QImage tile;
+        {
+            QReadLocker mappingLocker(&m_mapping->lock());
+            const uchar* data = m_mapping->address(qint64(chunk.offset), qint64(chunk.size));
+            tile = decompressPixels(data, int(chunk.size), rect.size(), format());
+        }
+        QMutexLocker locker(&m_mutex);
+        m_decodedTiles.insert(index, new QImage(tile), int(qMax<qint64>(1, tile.sizeInBytes() / 1024)));
+        return tile;
+    }
+
+private:
+    QSharedPointer<Mapping> m_mapping;
+    QVector<Chunk> m_tiles;
+    mutable QMutex m_mutex;
+    mutable QCache<int, QImage> m_decodedTiles;
+};
+
+void writeTiles(QDataStream& stream, const QVector<EditHistory::Tile>& tiles)
+{
+    stream << qint32(tiles.size());
+    for (const EditHistory::Tile& tile : tiles) {
+        stream << qint32(tile.column) << qint32(tile.row) << tile.image.size() << qint32(tile.image.format());
+        if (!tile.image.isNull())
+            stream << compressPixels(tile.image);
+    }
+}
+
+QVector<EditHistory::Tile> readTiles(QDataStream& stream)
+{
+    qint32 count = 0;
+    stream >> count;
+    QVector<EditHistory::Tile> tiles;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 column = 0, row = 0, format = QImage::Format_Invalid;
+        QSize size;
+        stream >> column >> row >> size >> format;
+        QImage image;
+        if (!size.isEmpty()) {
+            QByteArray compressed;
+            stream >> compressed;
+            image = decompressPixels(reinterpret_cast<const uchar*>(compressed.constData()), compressed.size(), size,
+                                     QImage::Format(format));
+        }
+        tiles.append({ column, row, image });
+    }
+    return tiles;
+}
+
+// Writes the tiles the way writeTiles() does, from the pixels as the history stored them. The tiles copied from
+// the mappings of the relocations are relocated. Fails if the pixels of a tile cannot be read back.
+bool writeStoredTiles(QDataStream& stream, const QVector<EditHistory::StoredTile>& tiles, Relocations* relocations)
+{
+    stream << qint32(tiles.size());
+    for (const EditHistory::StoredTile& tile : tiles) {
+        stream << qint32(tile.column) << qint32(tile.row) << tile.size << qint32(tile.format);
+        if (tile.isOriginal())
+            continue;
+        const QByteArray compressed = tile.compressedPixels();
+        if (compressed.isEmpty())
+            return false;
+
+        // Laid out like a byte array, its size then its bytes.
+        stream << quint32(compressed.size());
+        if (tile.compressed.isEmpty() && tile.block) {
+            const auto relocation = relocations->find(tile.block->file.data());
+            if (relocation != relocations->end())
+                relocation->insert(tile.block->offset, stream.device()->pos());
+        }
+        stream.writeRawData(compressed.constData(), compressed.size());
+    }
+    return true;
+}
+
+// Reads the tiles written by writeTiles() from the mapped file the stream reads, without decompressing them:
+// the stored tiles refer to their pixels in the file, up to the end of the chunk.
+QVector<EditHistory::StoredTile> readStoredTiles(QDataStream& stream, const QSharedPointer<Mapping>& mapping,
+                                                 qint64 chunkEnd)
+{
+    qint32 count = 0;
+    stream >> count;
+    QVector<EditHistory::StoredTile> tiles;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        EditHistory::StoredTile tile;
+        qint32 column = 0, row = 0, format = QImage::Format_Invalid;
+        stream >> column >> row >> tile.size >> format;
+        tile.column = column;
+        tile.row = row;
+        tile.format = QImage::Format(format);
+        if (!tile.isOriginal()) {
+            // Laid out like a byte array, its size then its bytes.
+            quint32 size = 0;
+            stream >> size;
+            const qint64 offset = stream.device()->pos();
+            if (size > quint32(std::numeric_limits<int>::max()) || qint64(size) > chunkEnd - offset
+                    || stream.skipRawData(int(size)) != int(size)) {
+                stream.setStatus(QDataStream::ReadCorruptData);
+                break;
+            }
+            tile.block = QSharedPointer<EditHistory::TileBlock>(new EditHistory::TileBlock { mapping, offset, int(size) });
+        }
+        tiles.append(tile);
+    }
+    return tiles;
+}
+
+void writeAnnotation(QDataStream& stream, const Annotation& annotation)
+{
+    stream << qint32(annotation.type());
+    if (!annotation.isNull())
+        stream << annotation.color() << double(annotation.penWidth()) << annotation.points();
+}
+
+Annotation readAnnotation(QDataStream& stream)
+{
+    qint32 type = Annotation::Invalid;
+    stream >> type;
+    if (type == Annotation::Invalid)
+        return Annotation();
+
+    QColor color;
+    double penWidth = 1.0;
+    QVector<QPointF> points;
+    stream >> color >> penWidth >> points;
+    Annotation annotation(Annotation::Type(type), color, penWidth);
+    for (const QPointF& point : qAsConst(points))
+        annotation.addPoint(point);
+    return annotation;
+}
+
+void writeAnnotationStates(QDataStream& stream, const QVector<EditHistory::AnnotationState>& states)
+{
+    stream << qint32(states.size());
+    for (const EditHistory::AnnotationState& state : states) {
+        stream << state.id;
+        writeAnnotation(stream, state.annotation);
+    }
+}
+
+QVector<EditHistory::AnnotationState> readAnnotationStates(QDataStream& stream)
+{
+    qint32 count = 0;
+    stream >> count;
+    QVector<EditHistory::AnnotationState> states;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        EditHistory::AnnotationState state;
+        stream >> state.id;
+        state.annotation = readAnnotation(stream);
+        states.append(state);
+    }
+    return states;
+}
+
+}
+
+bool ProjectFile::isProject(const QString& filePath)
+{
+    return QFileInfo(filePath).suffix().compare(Constants::PROJECT_FILE_SUFFIX, Qt::CaseInsensitive) == 0;
+}
+
+void ProjectFile::writeChange(QDataStream& stream, const EditHistory::Change& change)
+{
+    writeTiles(stream, change.tiles);
+    writeAnnotationStates(stream, change.annotations);
+}
+
+EditHistory::Change ProjectFile::readChange(QDataStream& stream)
+{
+    EditHistory::Change change;
+    change.tiles = readTiles(stream);
+    change.annotations = readAnnotationStates(stream);
+    return change;
+}
+
+bool ProjectFile::write(const PhotoSaver::Document& document, const QString& filePath, QString* errorString,
+                        const ProgressCallback& progress)
+{
+    if (document.pyramid.isNull())
+        return false;
+
+    const Profiler::ScopedTimer timer("write project", "save");
+    // The project is written to a sibling file which replaces it once complete. Saving over the project open
+    // swaps its mappings to the new file, the chunks copied from them are relocated.
+    const QVector<QSharedPointer<Mapping>> mappings = Mapping::mappings(filePath);
+    Relocations relocations;
+    for (const QSharedPointer<Mapping>& mapping : mappings)
+        relocations.insert(mapping.data(), QHash<qint64, qint64>());
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    auto fail = [&file, errorString](const QString& error) {
+        file.cancelWriting();
+        if (errorString)
+            *errorString = error;
+        return false;
+    };
+
+    // A failed write makes the commit fail, the chunks are not checked one by one.
+    QVector<Chunk> chunks;
+    auto writeChunk = [&](ChunkType type, int level, int index, const QByteArray& data) {
+        chunks.append({ type, quint32(level), quint32(index), quint64(file.pos()), quint64(data.size()) });
+        file.write(data);
+    };
+    file.write(QByteArray(HEADER_SIZE, '\0'));
+
+    const ImagePyramid& pyramid = document.pyramid;
+    QByteArray info;
+    QDataStream infoStream(&info, QIODevice::WriteOnly);
+    setUpStream(infoStream);
+    infoStream << qint32(pyramid.levelCount()) << qint32(pyramid.level(0).tileSize());
+    for (int level = 0; level < pyramid.levelCount(); ++level)
+        infoStream << pyramid.level(level).size() << qint32(pyramid.level(level).originalTile(0, 0).format());
+    infoStream << qint32(document.annotationOpacity);
+    writeChunk(InfoChunk, 0, 0, info);
+
+    // The original tiles of every level, the edits are saved apart on top of them.
+    int tileCount = 0, writtenTileCount = 0;
+    for (int level = 0; level < pyramid.levelCount(); ++level)
+        tileCount += pyramid.level(level).columns() * pyramid.level(level).rows();
+    for (int level = 0; level < pyramid.levelCount(); ++level) {
+        const TiledImage& levelTiles = pyramid.level(level);
+        // The levels of a project are copied compressed as they are in its file.
+        const auto* projectStore = dynamic_cast<const ProjectTileStore*>(levelTiles.store().data());
+        const auto relocation = projectStore ? relocations.find(projectStore->mapping().data()) : relocations.end();
+        QVector<int> columns(levelTiles.columns());
+        std::iota(columns.begin(), columns.end(), 0);
+        for (int row = 0; row < levelTiles.rows(); ++row) {
+            // The tiles of a row are compressed on all cores, then written in order.
+            QVector<QByteArray> compressedTiles(columns.size());
+            QVector<qint64> sourceOffsets(columns.size(), -1);
+            QtConcurrent::blockingMap(columns, [&](int column) {
+                if (projectStore)
+                    compressedTiles[column] = projectStore->compressedTile(column, row, &sourceOffsets[column]);
+                if (compressedTiles.at(column).isEmpty())
+                    compressedTiles[column] = compressPixels(levelTiles.originalTile(column, row));
+            });
+            for (int column = 0; column < columns.size(); ++column) {
+                if (relocation != relocations.end() && sourceOffsets.at(column) >= 0)
+                    relocation->insert(sourceOffsets.at(column), file.pos());
+                writeChunk(TileChunk, level, row * columns.size() + column, compressedTiles.at(column));
+            }
+
+            writtenTileCount += columns.size();
+            if (progress)
+                progress(writtenTileCount * 90 / tileCount);
+        }
+    }
+
+    const TiledImage& photoTiles = pyramid.level(0);
+    QVector<EditHistory::Tile> editedTiles;
+    for (int row = 0; row < photoTiles.rows(); ++row) {
+        for (int column = 0; column < photoTiles.columns(); ++column) {
+            if (photoTiles.isTileModified(column, row))
+                editedTiles.append({ column, row, photoTiles.tile(column, row) });
+        }
+    }
+    // Written straight to the file like the history, the edits of a huge photo may not fit in a byte array.
+    const quint64 editsOffset = quint64(file.pos());
+    QDataStream editsStream(&file);
+    setUpStream(editsStream);
+    writeTiles(editsStream, editedTiles);
+    chunks.append({ EditedTilesChunk, 0, 0, editsOffset, quint64(file.pos()) - editsOffset });
+
+    QByteArray annotations;
+    QDataStream annotationsStream(&annotations, QIODevice::WriteOnly);
+    setUpStream(annotationsStream);
+    const QVector<quint64> ids = document.annotations.ids();
+    annotationsStream << document.annotations.nextId() << qint32(ids.size());
+    for (const quint64 id : ids) {
+        annotationsStream << id;
+        writeAnnotation(annotationsStream, document.annotations.annotation(id));
+    }
+    writeChunk(AnnotationsChunk, 0, 0, annotations);
+
+    // The history is laid out like the changes of writeChange(), from the tiles as the history stored them:
+    // the compressed ones are written as they are, only the tiles still held as images are compressed here.
+    // It is written straight to the file, as it holds the pixels of every edit.
+    const quint64 historyOffset = quint64(file.pos());
+    QDataStream historyStream(&file);
+    setUpStream(historyStream);
+    historyStream << qint32(document.historyIndex) << qint32(document.history.size());
+    for (const EditHistory::Record& record : document.history) {
+        historyStream << record.text;
+        if (!writeStoredTiles(historyStream, record.tilesBefore, &relocations))
+            return fail(QObject::tr("Cannot read the undo history back"));
+        writeAnnotationStates(historyStream, record.annotationsBefore);
+        if (!writeStoredTiles(historyStream, record.tilesAfter, &relocations))
+            return fail(QObject::tr("Cannot read the undo history back"));
+        writeAnnotationStates(historyStream, record.annotationsAfter);
+    }
+    chunks.append({ HistoryChunk, 0, 0, historyOffset, quint64(file.pos()) - historyOffset });
+
+    QByteArray adjustments;
+    QDataStream adjustmentsStream(&adjustments, QIODevice::WriteOnly);
+    setUpStream(adjustmentsStream);
+    FilterGraph::writeNodes(adjustmentsStream, document.adjustments);
+    writeChunk(AdjustmentsChunk, 0, 0, adjustments);
+
+    const quint64 directoryOffset = quint64(file.pos());
+    QByteArray directory;
+    QDataStream directoryStream(&directory, QIODevice::WriteOnly);
+    setUpStream(directoryStream);
+    for (const Chunk& chunk : qAsConst(chunks))
+        directoryStream << chunk.type << chunk.level << chunk.index << chunk.offset << chunk.size;
+    file.write(directory);
+
+    // The header goes last, it points to the directory.
+    QByteArray header;
+    QDataStream headerStream(&header, QIODevice::WriteOnly);
+    setUpStream(headerStream);
+    headerStream.writeRawData(MAGIC, MAGIC_SIZE);
+    headerStream << VERSION << quint32(chunks.size()) << directoryOffset;
+    file.seek(0);
+    file.write(header);
+
+    // The old file is unmapped and closed before it is replaced, even where files in use cannot be replaced.
+    // The mappings are mapped again whether the new file replaced it or not.
+    for (const QSharedPointer<Mapping>& mapping : mappings) {
+        mapping->lock().lockForWrite();
+        mapping->unmap();
+    }
+    const bool committed = file.commit();
+    QString remapErrorString;
+    bool remapped = true;
+    for (const QSharedPointer<Mapping>& mapping : mappings) {
+        const QHash<qint64, qint64> relocation = relocations.value(mapping.data());
+        if (!mapping->remap(committed ? &relocation : nullptr, &remapErrorString))
+            remapped = false;
+        mapping->lock().unlock();
+    }
+
+    if (!committed) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    if (!remapped) {
+        if (errorString)
+            *errorString = QObject::tr("The project was saved but cannot be read back: %1").arg(remapErrorString);
+        return false;
+    }
+    return true;
+}
+
+bool ProjectFile::read(const QString& filePath, PhotoSaver::Document* document, QString* errorString)
+{
+    auto fail = [errorString](const QString& error) {
+        if (errorString)
+            *errorString = error;
+        return false;
+    };
+
+    const Profiler::ScopedTimer timer("read project", "load");
+    QString mappingErrorString;
+    const QSharedPointer<Mapping> mapping = Mapping::open(filePath, &mappingErrorString);
+    if (!mapping)
+        return fail(mappingErrorString);
+    // A save over the file waits until the project is read.
+    QReadLocker mappingLocker(&mapping->lock());
+    if (mapping->size() < HEADER_SIZE)
+        return fail(QObject::tr("Not a project file"));
+
+    QDataStream headerStream(mapping->bytes(0, HEADER_SIZE));
+    setUpStream(headerStream);
+    char magic[MAGIC_SIZE];
+    quint32 version = 0, chunkCount = 0;
+    quint64 directoryOffset = 0;
+    headerStream.readRawData(magic, MAGIC_SIZE);
+    headerStream >> version >> chunkCount >> directoryOffset;
+    if (std::memcmp(magic, MAGIC, MAGIC_SIZE) != 0)
+        return fail(QObject::tr("Not a project file"));
+    if (version > VERSION)
+        return fail(QObject::tr("The project was saved by a newer version"));
+    // The offsets and sizes of a damaged file may be anything, they are checked without overflowing.
+    const quint64 fileSize = quint64(mapping->size());
+    if (directoryOffset > fileSize || chunkCount > (fileSize - directoryOffset) / DIRECTORY_ENTRY_SIZE)
+        return fail(QObject::tr("The project file is damaged"));
+
+    // Only the directory is read here, the chunks are reached through it.
+    const qint64 directorySize = qint64(chunkCount) * DIRECTORY_ENTRY_SIZE;
+    const QByteArray directory = mapping->bytes(qint64(directoryOffset), directorySize);
+    if (directory.size() != directorySize)
+        return fail(QObject::tr("The project file is damaged"));
+    QDataStream directoryStream(directory);
+    setUpStream(directoryStream);
+    QVector<Chunk> chunks(int(chunkCount));
+    for (Chunk& chunk : chunks) {
+        directoryStream >> chunk.type >> chunk.level >> chunk.index >> chunk.offset >> chunk.size;
+        if (chunk.offset > fileSize || chunk.size > fileSize - chunk.offset)
+            return fail(QObject::tr("The project file is damaged"));
+        // Only the chunks holding the edited pixels may grow past what fits in a byte array.
+        if (chunk.type != EditedTilesChunk && chunk.type != HistoryChunk && chunk.size > quint64(std::numeric_limits<int>::max()))
+            return fail(QObject::tr("The project file is damaged"));
+    }
+    auto findChunk = [&chunks](ChunkType type) {
+        const auto chunk = std::find_if(chunks.cbegin(), chunks.cend(), [type](const Chunk& chunk) {
+            return chunk.type == type;
+        });
+        return chunk != chunks.cend() ? *chunk : Chunk();
+    };
+    auto chunkBytes = [&](ChunkType type) {
+        const Chunk chunk = findChunk(type);
+        return mapping->bytes(qint64(chunk.offset), qint64(chunk.size));
+    };
+
+    QDataStream infoStream(chunkBytes(InfoChunk));
+    setUpStream(infoStream);
+    qint32 levelCount = 0, tileSize = 0, annotationOpacity = 255;
+    infoStream >> levelCount >> tileSize;
+    QVector<QSize> levelSizes;
+    QVector<QImage::Format> levelFormats;
+    for (int level = 0; level < levelCount && infoStream.status() == QDataStream::Ok; ++level) {
+        QSize size;
+        qint32 format = QImage::Format_Invalid;
+        infoStream >> size >> format;
+        levelSizes.append(size);
+        levelFormats.append(QImage::Format(format));
+    }
+    infoStream >> annotationOpacity;
+    if (infoStream.status() != QDataStream::Ok || levelCount <= 0 || tileSize <= 0)
+        return fail(QObject::tr("The project file is damaged"));
+
+    QVector<QVector<Chunk>> levelTiles(levelCount);
+    for (int level = 0; level < levelCount; ++level) {
+        const QSize& size = levelSizes.at(level);
+        const QImage::Format format = levelFormats.at(level);
+        if (size.isEmpty() || format <= QImage::Format_Invalid || format >= QImage::NImageFormats)
+            return fail(QObject::tr("The project file is damaged"));
+        levelTiles[level].resize(((size.width() + tileSize - 1) / tileSize) * ((size.height() + tileSize - 1) / tileSize));
+    }
+    for (const Chunk& chunk : qAsConst(chunks)) {
+        if (chunk.type == TileChunk && int(chunk.level) < levelCount && int(chunk.index) < levelTiles.at(chunk.level).size())
+            levelTiles[chunk.level][chunk.index] = chunk;
+    }
+    QVector<TiledImage> levels;
+    for (int level = 0; level < levelCount; ++level) {
+        levels.append(TiledImage(QSharedPointer<TiledImageStore>(new ProjectTileStore(
+                mapping, levelTiles.at(level), levelSizes.at(level), levelFormats.at(level), tileSize))));
+    }
+    ImagePyramid pyramid(levels);
+
+    // The chunks holding the edited pixels are read from the file rather than the mapping, they may not fit
+    // in a byte array.
+    QFile chunkFile(filePath);
+    if (!chunkFile.open(QIODevice::ReadOnly))
+        return fail(chunkFile.errorString());
+    QDataStream chunkStream(&chunkFile);
+    setUpStream(chunkStream);
+    auto seekChunk = [&](const Chunk& chunk) {
+        chunkStream.resetStatus();
+        return chunk.size > 0 && chunkFile.seek(qint64(chunk.offset));
+    };
+
+    if (seekChunk(findChunk(EditedTilesChunk))) {
+        const QVector<EditHistory::Tile> editedTiles = readTiles(chunkStream);
+        for (const EditHistory::Tile& tile : editedTiles) {
+            if (tile.image.size() == pyramid.level(0).tileRect(tile.column, tile.row).size())
+                pyramid.setTile(tile.column, tile.row, tile.image);
+        }
+    }
+
+    AnnotationScene annotations;
+    QDataStream annotationsStream(chunkBytes(AnnotationsChunk));
+    setUpStream(annotationsStream);
+    quint64 nextId = 1;
+    qint32 annotationCount = 0;
+    annotationsStream >> nextId >> annotationCount;
+    for (int i = 0; i < annotationCount && annotationsStream.status() == QDataStream::Ok; ++i) {
+        quint64 id = 0;
+        annotationsStream >> id;
+        annotations.set(id, readAnnotation(annotationsStream));
+    }
+    annotations.reserveIds(nextId);
+
+    // The history tiles are left in the file, they are only decompressed once restored.
+    const Chunk historyChunk = findChunk(HistoryChunk);
+    qint32 historyIndex = 0, recordCount = 0;
+    QVector<EditHistory::Record> history;
+    if (seekChunk(historyChunk)) {
+        const qint64 historyEnd = qint64(historyChunk.offset + historyChunk.size);
+        chunkStream >> historyIndex >> recordCount;
+        for (int i = 0; i < recordCount && chunkStream.status() == QDataStream::Ok; ++i) {
+            EditHistory::Record record;
+            chunkStream >> record.text;
+            record.tilesBefore = readStoredTiles(chunkStream, mapping, historyEnd);
+            record.annotationsBefore = readAnnotationStates(chunkStream);
+            record.tilesAfter = readStoredTiles(chunkStream, mapping, historyEnd);
+            record.annotationsAfter = readAnnotationStates(chunkStream);
+            history.append(record);
+        }
+        // A damaged history is dropped, the document itself is still good.
+        if (chunkStream.status() != QDataStream::Ok || chunkFile.pos() > historyEnd)
+            history.clear();
+    }
+
+    QDataStream adjustmentsStream(chunkBytes(AdjustmentsChunk));
+    setUpStream(adjustmentsStream);
+    const QVector<FilterGraph::Node> adjustments = FilterGraph::readNodes(adjustmentsStream);
+
+    document->pyramid = pyramid;
+    document->annotations = annotations;
+    document->annotationOpacity = annotationOpacity;
+    document->adjustments = adjustments;
+    document->history = history;
+    document->historyIndex = historyIndex;
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef PROJECTFILE_H
+#define PROJECTFILE_H
+
+#include "photosaver.h"
+
+#include <functional>
+
+class QDataStream;
+
+// Native project format, saving the document as it is edited: the original photo, its pyramid of preview levels,
+// the edited tiles, the annotation scene, the adjustments and the undo history. The file is a header, the chunks, then a directory
+// of the chunks at the end. Every tile of every level is a chunk of its own, compressed separately, so opening
+// a project only maps the file and reads the directory and the small chunks; tiles are decompressed from the
+// mapping when first used, and only the ones in view ever are. The tiles of the undo history are left in the mapping
+// too, until an undo or a redo restores them.
+namespace ProjectFile {
+
+    // Receives the progress of a write in percent.
+    using ProgressCallback = std::function<void(int percent)>;
+
+    // Returns true if the file has the project suffix.
+    bool isProject(const QString& filePath);
+
+    // Writes the document with its history to a temporary file renamed to the file path. The mappings of a project
+    // saved over are swapped to the new file. Runs on the calling thread.
+    bool write(const PhotoSaver::Document& document, const QString& filePath, QString* errorString = nullptr,
+               const ProgressCallback& progress = ProgressCallback());
+    // Maps the project into the document. The pyramid levels read their tiles from the mapping, which stays
+    // open as long as they exist. Runs on the calling thread.
+    bool read(const QString& filePath, PhotoSaver::Document* document, QString* errorString = nullptr);
+
+    // Serializes the tiles and annotations of an edit the way the history is saved, the tiles compressed.
+    void writeChange(QDataStream& stream, const EditHistory::Change& change);
+    EditHistory::Change readChange(QDataStream& stream);
+
+}
+
+#endif // PROJECTFILE_H
@@ -0,0 +1,288 @@
+#include "recoveryjournal.h"
+#include "profiler.h"
+#include "projectfile.h"
+#include "constants.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include <QUuid>
+#include <QtEndian>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[] = "PEJRNL\r\n";
+const int MAGIC_SIZE = 8;
+// Every record is prefixed with the size of its payload, a record cut short by a crash is detected by it.
+const int RECORD_SIZE_BYTES = 4;
+
+QString journalDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + QStringLiteral("/recovery");
+}
+
+// A reused process id would take over the journal left by a crashed process with the same id, every session
+// journals to a file of its own.
+QString newJournalPath()
+{
+    return QStringLiteral("%1/%2.journal").arg(journalDirectory(), QUuid::createUuid().toString(QUuid::WithoutBraces));
+}
+
+QString lockFilePath(const QString& journalPath)
+{
+    return QFileInfo(journalPath).path() + QLatin1Char('/') + QFileInfo(journalPath).completeBaseName() + QStringLiteral(".lock");
+}
+
+void setUpStream(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+QByteArray encodeRecord(const RecoveryJournal::Operation& operation)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setUpStream(stream);
+    stream << qint32(operation.type);
+    if (operation.type == RecoveryJournal::Begin) {
+        const QFileInfo sourceInfo(operation.text);
+        stream << operation.text << sourceInfo.lastModified().toMSecsSinceEpoch() << sourceInfo.size();
+    } else if (operation.type == RecoveryJournal::Edit) {
+        stream << operation.text;
+        ProjectFile::writeChange(stream, operation.change);
+    } else if (operation.type == RecoveryJournal::Resize) {
+        stream << operation.size << qint32(operation.filter);
+    } else if (operation.type == RecoveryJournal::Adjust) {
+        FilterGraph::writeNodes(stream, operation.adjustments);
+    }
+
+    QByteArray record(RECORD_SIZE_BYTES, '\0');
+    qToLittleEndian<quint32>(quint32(payload.size()), record.data());
+    return record + payload;
+}
+
+// Flushes the file and waits until the system wrote it to the disk.
+void syncToDisk(QFile& file)
+{
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    ::fsync(file.handle());
+#endif
+}
+
+}
+
+bool RecoveryJournal::Session::isSourceUnchanged() const
+{
+    const QFileInfo sourceInfo(sourcePath);
+    return sourceInfo.exists() && sourceInfo.lastModified() == lastModified && sourceInfo.size() == sourceSize;
+}
+
+RecoveryJournal::RecoveryJournal(QObject* parent)
+    : QObject(parent)
+    , m_journalPath(newJournalPath())
+    , m_lockFile(lockFilePath(m_journalPath))
+{
+    QDir().mkpath(journalDirectory());
+    m_lockFile.tryLock(0);
+    m_file.setFileName(m_journalPath);
+    m_threadPool.setMaxThreadCount(1);
+}
+
+RecoveryJournal::~RecoveryJournal()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queue.clear();
+    }
+    m_threadPool.waitForDone();
+
+    // The session ends normally, there is nothing to recover.
+    m_file.close();
+    QFile::remove(m_journalPath);
+    m_lockFile.unlock();
+}
+
+void RecoveryJournal::begin(const QString& sourcePath)
+{
+    m_begun = true;
+    append({ Begin, sourcePath, EditHistory::Change() });
+}
+
+void RecoveryJournal::recordEdit(const QString& text, const EditHistory::Change& change)
+{
+    if (m_begun)
+        append({ Edit, text, change });
+}
+
+void RecoveryJournal::recordUndo()
+{
+    if (m_begun)
+        append({ Undo, QString(), EditHistory::Change() });
+}
+
+void RecoveryJournal::recordRedo()
+{
+    if (m_begun)
+        append({ Redo, QString(), EditHistory::Change() });
+}
+
+void RecoveryJournal::recordReset()
+{
+    if (m_begun)
+        append({ Reset, QString(), EditHistory::Change() });
+}
+
+void RecoveryJournal::recordResize(const QSize& size, int filter)
+{
+    if (!m_begun)
+        return;
+
+    Operation operation { Resize, QString(), EditHistory::Change() };
+    operation.size = size;
+    operation.filter = filter;
+    append(operation);
+}
+
+void RecoveryJournal::recordAdjustments(const QVector<FilterGraph::Node>& adjustments)
+{
+    if (!m_begun)
+        return;
+
+    Operation operation { Adjust, QString(), EditHistory::Change() };
+    operation.adjustments = adjustments;
+    append(operation);
+}
+
+QStringList RecoveryJournal::orphanedJournals()
+{
+    const QFileInfoList journals = QDir(journalDirectory()).entryInfoList({ QStringLiteral("*.journal") }, QDir::Files, QDir::Time);
+    QStringList orphaned;
+    for (const QFileInfo& journal : journals) {
+        // The lock of a process which is gone is stale and can be taken, the one of a running session cannot.
+        QLockFile lockFile(lockFilePath(journal.absoluteFilePath()));
+        if (lockFile.tryLock(0))
+            orphaned.append(journal.absoluteFilePath());
+    }
+    return orphaned;
+}
+
+bool RecoveryJournal::read(const QString& journalPath, Session* session, QString* errorString)
+{
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    if (!data.startsWith(QByteArray::fromRawData(MAGIC, MAGIC_SIZE))) {
+        if (errorString)
+            *errorString = QObject::tr("Not a recovery journal");
+        return false;
+    }
+
+    int position = MAGIC_SIZE;
+    while (position + RECORD_SIZE_BYTES <= data.size()) {
+        const quint32 size = qFromLittleEndian<quint32>(data.constData() + position);
+        if (size > quint32(data.size() - position - RECORD_SIZE_BYTES))
+            break;
+
+        QDataStream stream(QByteArray::fromRawData(data.constData() + position + RECORD_SIZE_BYTES, int(size)));
+        setUpStream(stream);
+        qint32 type = Edit;
+        stream >> type;
+        Operation operation;
+        operation.type = OperationType(type);
+        if (operation.type == Begin) {
+            qint64 lastModified = 0;
+            stream >> session->sourcePath >> lastModified >> session->sourceSize;
+            session->lastModified = QDateTime::fromMSecsSinceEpoch(lastModified);
+        } else if (operation.type == Edit) {
+            stream >> operation.text;
+            operation.change = ProjectFile::readChange(stream);
+        } else if (operation.type == Resize) {
+            qint32 filter = 0;
+            stream >> operation.size >> filter;
+            operation.filter = filter;
+        } else if (operation.type == Adjust) {
+            operation.adjustments = FilterGraph::readNodes(stream);
+        }
+        if (stream.status() != QDataStream::Ok)
+            break;
+
+        if (operation.type != Begin)
+            session->operations.append(operation);
+        position += RECORD_SIZE_BYTES + int(size);
+    }
+
+    if (session->sourcePath.isEmpty()) {
+        if (errorString)
+            *errorString = QObject::tr("The recovery journal is empty");
+        return false;
+    }
+    return true;
+}
+
+void RecoveryJournal::remove(const QString& journalPath)
+{
+    QFile::remove(journalPath);
+    QFile::remove(lockFilePath(journalPath));
+}
+
+void RecoveryJournal::append(const Operation& operation)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(operation);
+    if (m_writing)
+        return;
+
+    m_writing = true;
+    m_threadPool.start([this]() {
+        work();
+    });
+}
+
+void RecoveryJournal::work()
+{
+    forever {
+        QVector<Operation> batch;
+        {
+            QMutexLocker locker(&m_mutex);
+            batch.swap(m_queue);
+            if (batch.isEmpty()) {
+                m_writing = false;
+                return;
+            }
+        }
+
+        const Profiler::ScopedTimer timer("write journal", "journal");
+        for (const Operation& operation : qAsConst(batch)) {
+            if (operation.type == Begin) {
+                m_file.close();
+                if (m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                    m_file.write(MAGIC, MAGIC_SIZE);
+            }
+            if (m_file.isOpen())
+                m_file.write(encodeRecord(operation));
+        }
+        if (m_file.isOpen())
+            syncToDisk(m_file);
+
+        // The operations queued meanwhile are written and synced together with the next batch.
+        QThread::msleep(Constants::RECOVERY_JOURNAL_SYNC_INTERVAL_MS);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef RECOVERYJOURNAL_H
+#define RECOVERYJOURNAL_H
+
+#include "edithistory.h"
+#include "filtergraph.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QLockFile>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+
+// Append-only journal of the edits of the session, replayed over the photo to recover them after a crash.
+// The GUI thread only queues the operations, their tiles shared with the photo; a worker thread compresses
+// the tiles, appends the records and syncs the file to disk once per batch, batching the operations which
+// arrive within the sync interval. Undo and redo are journaled as such, replaying them rebuilds the history.
+// Each process holds a lock next to its journal; a journal without a live lock was left by a session which
+// crashed. The journal is removed when the session ends normally.
+class RecoveryJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum OperationType {
+        Begin,
+        Edit,
+        Undo,
+        Redo,
+        Reset,
+        Resize,
+        Adjust
+    };
+
+    struct Operation
+    {
+        OperationType type { Edit };
+        QString text;
+        EditHistory::Change change;
+        // Size and filter of a resize.
+        QSize size;
+        int filter { 0 };
+        // Adjustments set.
+        QVector<FilterGraph::Node> adjustments;
+    };
+
+    // The photo or project a journal was started on, and the operations made on it since.
+    struct Session
+    {
+        QString sourcePath;
+        QDateTime lastModified;
+        qint64 sourceSize { 0 };
+        QVector<Operation> operations;
+
+        // Returns false if the source was changed since, the operations no longer apply to it then.
+        bool isSourceUnchanged() const;
+    };
+
+    RecoveryJournal(QObject* parent = nullptr);
+    ~RecoveryJournal();
+
+    // Starts the journal over for the photo or project just loaded.
+    void begin(const QString& sourcePath);
+    void recordEdit(const QString& text, const EditHistory::Change& change);
+    void recordUndo();
+    void recordRedo();
+    void recordReset();
+    void recordResize(const QSize& size, int filter);
+    void recordAdjustments(const QVector<FilterGraph::Node>& adjustments);
+
+    // Returns the journals left by sessions which crashed, the most recent first.
+    static QStringList orphanedJournals();
+    // Reads the journal up to its last complete record, the records being written when the session crashed are dropped.
+    static bool read(const QString& journalPath, Session* session, QString* errorString = nullptr);
+    static void remove(const QString& journalPath);
+
+private:
+    void append(const Operation& operation);
+    void work();
+
+    QString m_journalPath;
+    QLockFile m_lockFile;
+    QThreadPool m_threadPool;
+    QMutex m_mutex;
+    QVector<Operation> m_queue;
+    bool m_writing { false };
+    bool m_begun { false };
+    // Only used by the worker.
+    QFile m_file;
+};
+
+#endif // RECOVERYJOURNAL_H
@@ -0,0 +1,240 @@
+#include "redaction.h"
+
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Rows blurred horizontally per parallel task, and columns per vertical stripe.
+const int BAND_HEIGHT = 64;
+const int STRIPE_WIDTH = 256;
+const quint32 ROUNDING = 1u << (Redaction::RECIPROCAL_BITS - 1);
+
+// Reciprocals of the window sizes up to 2 * radius + 1, the size of a window cut by an edge included.
+QVector<quint32> reciprocals(int radius)
+{
+    QVector<quint32> reciprocals(2 * radius + 2, 0);
+    for (int size = 1; size < reciprocals.size(); ++size)
+        reciprocals[size] = ((1u << Redaction::RECIPROCAL_BITS) + quint32(size) / 2) / quint32(size);
+    return reciprocals;
+}
+
+// Size of the window of the position, cut by the edges.
+inline int windowSize(int position, int count, int radius)
+{
+    return qMin(position + radius, count - 1) - qMax(position - radius, 0) + 1;
+}
+
+inline quint32 average(quint32 sum, quint32 reciprocal)
+{
+    return (sum * reciprocal + ROUNDING) >> Redaction::RECIPROCAL_BITS;
+}
+
+}
+
+namespace Redaction {
+
+HorizontalFunction horizontalFunction(Compositing::InstructionSet instructionSet)
+{
+    if (!Compositing::isSupported(instructionSet))
+        return horizontalScalar;
+
+    // The running sums along a row are serial, a pixel fills the four lanes of SSE and AVX2 has nothing to add.
+    switch (instructionSet) {
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    case Compositing::InstructionSet::Sse41:
+    case Compositing::InstructionSet::Avx2:
+        return horizontalSse41;
+#endif
+    default:
+        return horizontalScalar;
+    }
+}
+
+VerticalFunction verticalFunction(Compositing::InstructionSet instructionSet)
+{
+    if (!Compositing::isSupported(instructionSet))
+        return verticalScalar;
+
+    switch (instructionSet) {
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    case Compositing::InstructionSet::Sse41:
+        return verticalSse41;
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    case Compositing::InstructionSet::Avx2:
+        return verticalAvx2;
+#endif
+    default:
+        return verticalScalar;
+    }
+}
+
+QImage blurred(const QImage& image, int radius, Compositing::InstructionSet instructionSet)
+{
+    radius = qMin(radius, MAX_RADIUS);
+    if (image.isNull() || radius < 1)
+        return image;
+
+    QImage result = image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32_Premultiplied
+            ? image.copy() : image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    QImage buffer(result.size(), result.format());
+    if (result.isNull() || buffer.isNull())
+        return QImage();
+
+    const int width = result.width(), height = result.height();
+    const QVector<quint32> windowReciprocals = reciprocals(radius);
+    const HorizontalFunction horizontalPass = horizontalFunction(instructionSet);
+    const VerticalFunction verticalPass = verticalFunction(instructionSet);
+
+    // Detach once here, not concurrently from the bands.
+    uchar* const resultBits = result.bits();
+    uchar* const bufferBits = buffer.bits();
+    const qsizetype bytesPerLine = result.bytesPerLine();
+    auto line = [bytesPerLine](uchar* bits, int y) {
+        return reinterpret_cast<quint32*>(bits + y * bytesPerLine);
+    };
+
+    // The passes of a row go through two row buffers and back into the row.
+    auto blurBand = [&](int bandTop) {
+        QVector<quint32> first(width), second(width);
+        for (int y = bandTop; y < qMin(bandTop + BAND_HEIGHT, height); ++y) {
+            quint32* row = line(resultBits, y);
+            horizontalPass(first.data(), row, width, radius, windowReciprocals.constData());
+            horizontalPass(second.data(), first.constData(), width, radius, windowReciprocals.constData());
+            horizontalPass(row, second.constData(), width, radius, windowReciprocals.constData());
+        }
+    };
+
+    // The passes of a stripe go from the result to the buffer and back, the third one ends in the buffer.
+    auto blurStripe = [&](int stripeLeft) {
+        const int stripeWidth = qMin(STRIPE_WIDTH, width - stripeLeft);
+        const QVector<quint32> zeros(stripeWidth, 0);
+        QVector<quint32> sums(stripeWidth * 4);
+        for (int pass = 0; pass < BLUR_PASSES; ++pass) {
+            uchar* const sourceBits = pass % 2 ? bufferBits : resultBits;
+            uchar* const destinationBits = pass % 2 ? resultBits : bufferBits;
+            sums.fill(0);
+            for (int y = 0; y <= qMin(radius, height - 1); ++y) {
+                const uchar* bytes = reinterpret_cast<const uchar*>(line(sourceBits, y) + stripeLeft);
+                for (int i = 0; i < stripeWidth * 4; ++i)
+                    sums[i] += bytes[i];
+            }
+            for (int y = 0; y < height; ++y) {
+                const quint32* addedRow = y + radius + 1 < height ? line(sourceBits, y + radius + 1) + stripeLeft : zeros.constData();
+                const quint32* removedRow = y - radius >= 0 ? line(sourceBits, y - radius) + stripeLeft : zeros.constData();
+                verticalPass(line(destinationBits, y) + stripeLeft, sums.data(), addedRow, removedRow, stripeWidth,
+                             windowReciprocals.at(windowSize(y, height, radius)));
+            }
+        }
+    };
+
+    QVector<int> bandTops;
+    for (int y = 0; y < height; y += BAND_HEIGHT)
+        bandTops.append(y);
+    QVector<int> stripeLefts;
+    for (int x = 0; x < width; x += STRIPE_WIDTH)
+        stripeLefts.append(x);
+    // A single band or stripe, like a preview, runs on the calling thread.
+    if (bandTops.size() == 1)
+        blurBand(0);
+    else
+        QtConcurrent::blockingMap(bandTops, blurBand);
+    if (stripeLefts.size() == 1)
+        blurStripe(0);
+    else
+        QtConcurrent::blockingMap(stripeLefts, blurStripe);
+    return buffer;
+}
+
+QImage pixelated(const QImage& image, int cellSize)
+{
+    if (image.isNull() || cellSize < 2)
+        return image;
+
+    QImage result = image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32_Premultiplied
+            ? image.copy() : image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    if (result.isNull())
+        return QImage();
+
+    const int width = result.width(), height = result.height();
+    uchar* const bits = result.bits();
+    const qsizetype bytesPerLine = result.bytesPerLine();
+    auto pixelateCellRow = [&](int cellTop) {
+        const int cellBottom = qMin(cellTop + cellSize, height);
+        // The channels of every column summed over the rows of the cells, then summed over the columns of each cell.
+        QVector<quint32> columnSums(width * 4, 0);
+        for (int y = cellTop; y < cellBottom; ++y) {
+            const uchar* bytes = bits + y * bytesPerLine;
+            for (int i = 0; i < width * 4; ++i)
+                columnSums[i] += bytes[i];
+        }
+        for (int cellLeft = 0; cellLeft < width; cellLeft += cellSize) {
+            const int cellRight = qMin(cellLeft + cellSize, width);
+            const quint32 pixelCount = quint32((cellRight - cellLeft) * (cellBottom - cellTop));
+            quint32 sums[4] = {};
+            for (int x = cellLeft; x < cellRight; ++x) {
+                for (int channel = 0; channel < 4; ++channel)
+                    sums[channel] += columnSums.at(x * 4 + channel);
+            }
+            uchar pixel[4];
+            for (int channel = 0; channel < 4; ++channel)
+                pixel[channel] = uchar((sums[channel] + pixelCount / 2) / pixelCount);
+            quint32 value;
+            std::memcpy(&value, pixel, sizeof(value));
+            for (int y = cellTop; y < cellBottom; ++y) {
+                quint32* row = reinterpret_cast<quint32*>(bits + y * bytesPerLine);
+                std::fill(row + cellLeft, row + cellRight, value);
+            }
+        }
+    };
+
+    QVector<int> cellTops;
+    for (int y = 0; y < height; y += cellSize)
+        cellTops.append(y);
+    QtConcurrent::blockingMap(cellTops, pixelateCellRow);
+    return result;
+}
+
+QImage redacted(const QImage& image, Mode mode, int strength)
+{
+    return mode == Mode::Blur ? blurred(image, strength) : pixelated(image, strength);
+}
+
+void horizontalScalar(quint32* destination, const quint32* source, int count, int radius, const quint32* reciprocals)
+{
+    const uchar* bytes = reinterpret_cast<const uchar*>(source);
+    uchar* destinationBytes = reinterpret_cast<uchar*>(destination);
+    quint32 sums[4] = {};
+    for (int x = 0; x <= qMin(radius, count - 1); ++x) {
+        for (int channel = 0; channel < 4; ++channel)
+            sums[channel] += bytes[x * 4 + channel];
+    }
+    for (int x = 0; x < count; ++x) {
+        const quint32 reciprocal = reciprocals[windowSize(x, count, radius)];
+        for (int channel = 0; channel < 4; ++channel) {
+            destinationBytes[x * 4 + channel] = uchar(average(sums[channel], reciprocal));
+            if (x + radius + 1 < count)
+                sums[channel] += bytes[(x + radius + 1) * 4 + channel];
+            if (x - radius >= 0)
+                sums[channel] -= bytes[(x - radius) * 4 + channel];
+        }
+    }
+}
+
+void verticalScalar(quint32* destination, quint32* sums, const quint32* addedRow, const quint32* removedRow, int count,
+                    quint32 reciprocal)
+{
+    const uchar* added = reinterpret_cast<const uchar*>(addedRow);
+    const uchar* removed = reinterpret_cast<const uchar*>(removedRow);
+    uchar* destinationBytes = reinterpret_cast<uchar*>(destination);
+    for (int i = 0; i < count * 4; ++i) {
+        destinationBytes[i] = uchar(average(sums[i], reciprocal));
+        sums[i] += quint32(added[i]) - quint32(removed[i]);
+    }
+}
+
+}
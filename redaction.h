@@ -0,0 +1,60 @@
+#ifndef REDACTION_H
+#define REDACTION_H
+
+#include "compositing.h"
+
+#include <QImage>
+
+// Blurring and pixelating of 32-bit images, to hide parts of a photo. The blur is three box blurs with running
+// sums, which approximate a Gaussian of the radius as standard deviation at a cost per pixel that does not grow
+// with the radius: each pass adds the pixel entering the window and subtracts the one leaving it. The horizontal
+// passes run row by row, the vertical passes slide a row of sums down stripes of columns, both on all cores.
+// Averages are divided through fixed-point reciprocals and every kernel computes the same exact result, so the
+// SIMD kernels are bit-exact with the scalar ones. Windows cut by the image edges average the pixels inside only.
+namespace Redaction {
+
+    enum class Mode {
+        Blur,
+        Pixelate
+    };
+
+    const int BLUR_PASSES = 3;
+    // The sum of a window times the reciprocal of its size, shifted right by this, is the average within one.
+    const int RECIPROCAL_BITS = 24;
+    // Bound of the blur radius, which keeps the products of the sums and the reciprocals within 32 bits.
+    const int MAX_RADIUS = 4096;
+
+    // Box-averages count pixels of the source into the destination. reciprocals[n] is the reciprocal of a window of n.
+    using HorizontalFunction = void (*)(quint32* destination, const quint32* source, int count, int radius,
+                                        const quint32* reciprocals);
+    // Writes the averages of the channel sums of count pixels divided through the reciprocal, then slides the window
+    // down: the channels of the added row are added to the sums, the ones of the removed row subtracted.
+    using VerticalFunction = void (*)(quint32* destination, quint32* sums, const quint32* addedRow,
+                                      const quint32* removedRow, int count, quint32 reciprocal);
+
+    // Return the kernels of the instruction set, the scalar ones if the CPU does not support it.
+    HorizontalFunction horizontalFunction(Compositing::InstructionSet instructionSet);
+    VerticalFunction verticalFunction(Compositing::InstructionSet instructionSet);
+
+    QImage blurred(const QImage& image, int radius, Compositing::InstructionSet instructionSet = Compositing::bestInstructionSet());
+    // Fills every square cell of the size, from the top left corner, with its average. Cell rows run on all cores.
+    QImage pixelated(const QImage& image, int cellSize);
+    // Blurs with the strength as radius or pixelates with it as cell size.
+    QImage redacted(const QImage& image, Mode mode, int strength);
+
+    void horizontalScalar(quint32* destination, const quint32* source, int count, int radius, const quint32* reciprocals);
+    void verticalScalar(quint32* destination, quint32* sums, const quint32* addedRow, const quint32* removedRow, int count,
+                        quint32 reciprocal);
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    void horizontalSse41(quint32* destination, const quint32* source, int count, int radius, const quint32* reciprocals);
+    void verticalSse41(quint32* destination, quint32* sums, const quint32* addedRow, const quint32* removedRow, int count,
+                       quint32 reciprocal);
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    void verticalAvx2(quint32* destination, quint32* sums, const quint32* addedRow, const quint32* removedRow, int count,
+                      quint32 reciprocal);
+#endif
+
+}
+
+#endif // REDACTION_H
@@ -0,0 +1,59 @@
+#include "redaction.h"
+
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+
+#include <immintrin.h>
+
+namespace {
+
+// The sums are unsigned and can exceed 31 bits once multiplied, hence the logical shift.
+inline __m256i average(__m256i sums, __m256i reciprocal)
+{
+    return _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sums, reciprocal),
+                                              _mm256_set1_epi32(1 << (Redaction::RECIPROCAL_BITS - 1))),
+                             Redaction::RECIPROCAL_BITS);
+}
+
+inline __m256i slide(__m256i sums, __m128i added, __m128i removed)
+{
+    return _mm256_sub_epi32(_mm256_add_epi32(sums, _mm256_cvtepu8_epi32(added)), _mm256_cvtepu8_epi32(removed));
+}
+
+}
+
+namespace Redaction {
+
+void verticalAvx2(quint32* destination, quint32* sums, const quint32* addedRow, const quint32* removedRow, int count,
+                  quint32 reciprocal)
+{
+    const __m256i factor = _mm256_set1_epi32(int(reciprocal));
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Two pixels per register of sums: pixels 0 and 1, 2 and 3, 4 and 5, 6 and 7.
+        __m256i* pixelSums = reinterpret_cast<__m256i*>(sums + i * 4);
+        const __m256i first = _mm256_loadu_si256(pixelSums), second = _mm256_loadu_si256(pixelSums + 1),
+                third = _mm256_loadu_si256(pixelSums + 2), fourth = _mm256_loadu_si256(pixelSums + 3);
+
+        // Packing works within 128-bit lanes and leaves the pixels in the order 0 2 4 6 1 3 5 7.
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(average(first, factor), average(second, factor)),
+                                                   _mm256_packs_epi32(average(third, factor), average(fourth, factor)));
+        const __m256i pixels = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), pixels);
+
+        const __m128i addedLow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(addedRow + i)),
+                addedHigh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(addedRow + i + 4)),
+                removedLow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(removedRow + i)),
+                removedHigh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(removedRow + i + 4));
+        _mm256_storeu_si256(pixelSums, slide(first, addedLow, removedLow));
+        _mm256_storeu_si256(pixelSums + 1, slide(second, _mm_srli_si128(addedLow, 8), _mm_srli_si128(removedLow, 8)));
+        _mm256_storeu_si256(pixelSums + 2, slide(third, addedHigh, removedHigh));
+        _mm256_storeu_si256(pixelSums + 3, slide(fourth, _mm_srli_si128(addedHigh, 8), _mm_srli_si128(removedHigh, 8)));
+    }
+
+    if (i < count)
+        verticalScalar(destination + i, sums + i * 4, addedRow + i, removedRow + i, count - i, reciprocal);
+}
+
+}
+
+#endif // QT_COMPILER_SUPPORTS_AVX2
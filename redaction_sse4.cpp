@@ -0,0 +1,76 @@
+#include "redaction.h"
+
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+
+#include <smmintrin.h>
+
+namespace {
+
+inline __m128i widen(quint32 pixel)
+{
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(pixel)));
+}
+
+// The sums are unsigned and can exceed 31 bits once multiplied, hence the logical shift.
+inline __m128i average(__m128i sums, __m128i reciprocal)
+{
+    return _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(sums, reciprocal),
+                                        _mm_set1_epi32(1 << (Redaction::RECIPROCAL_BITS - 1))),
+                          Redaction::RECIPROCAL_BITS);
+}
+
+}
+
+namespace Redaction {
+
+void horizontalSse41(quint32* destination, const quint32* source, int count, int radius, const quint32* reciprocals)
+{
+    // The four channels of the window in the lanes.
+    __m128i sums = _mm_setzero_si128();
+    for (int x = 0; x <= qMin(radius, count - 1); ++x)
+        sums = _mm_add_epi32(sums, widen(source[x]));
+
+    for (int x = 0; x < count; ++x) {
+        const int size = qMin(x + radius, count - 1) - qMax(x - radius, 0) + 1;
+        const __m128i averages = average(sums, _mm_set1_epi32(int(reciprocals[size])));
+        destination[x] = quint32(_mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(averages, averages), averages)));
+        if (x + radius + 1 < count)
+            sums = _mm_add_epi32(sums, widen(source[x + radius + 1]));
+        if (x - radius >= 0)
+            sums = _mm_sub_epi32(sums, widen(source[x - radius]));
+    }
+}
+
+void verticalSse41(quint32* destination, quint32* sums, const quint32* addedRow, const quint32* removedRow, int count,
+                   quint32 reciprocal)
+{
+    const __m128i factor = _mm_set1_epi32(int(reciprocal));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // Four pixels, one per register of sums.
+        __m128i* pixelSums = reinterpret_cast<__m128i*>(sums + i * 4);
+        const __m128i first = _mm_loadu_si128(pixelSums), second = _mm_loadu_si128(pixelSums + 1),
+                third = _mm_loadu_si128(pixelSums + 2), fourth = _mm_loadu_si128(pixelSums + 3);
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(average(first, factor), average(second, factor)),
+                                                _mm_packs_epi32(average(third, factor), average(fourth, factor)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), packed);
+
+        const __m128i added = _mm_loadu_si128(reinterpret_cast<const __m128i*>(addedRow + i)),
+                removed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(removedRow + i));
+        _mm_storeu_si128(pixelSums, _mm_sub_epi32(_mm_add_epi32(first, _mm_cvtepu8_epi32(added)),
+                                                  _mm_cvtepu8_epi32(removed)));
+        _mm_storeu_si128(pixelSums + 1, _mm_sub_epi32(_mm_add_epi32(second, _mm_cvtepu8_epi32(_mm_srli_si128(added, 4))),
+                                                      _mm_cvtepu8_epi32(_mm_srli_si128(removed, 4))));
+        _mm_storeu_si128(pixelSums + 2, _mm_sub_epi32(_mm_add_epi32(third, _mm_cvtepu8_epi32(_mm_srli_si128(added, 8))),
+                                                      _mm_cvtepu8_epi32(_mm_srli_si128(removed, 8))));
+        _mm_storeu_si128(pixelSums + 3, _mm_sub_epi32(_mm_add_epi32(fourth, _mm_cvtepu8_epi32(_mm_srli_si128(added, 12))),
+                                                      _mm_cvtepu8_epi32(_mm_srli_si128(removed, 12))));
+    }
+
+    if (i < count)
+        verticalScalar(destination + i, sums + i * 4, addedRow + i, removedRow + i, count - i, reciprocal);
+}
+
+}
+
+#endif // QT_COMPILER_SUPPORTS_SSE4_1
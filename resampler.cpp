@@ -0,0 +1,276 @@
+#include "resampler.h"
+
+#include <QVarLengthArray>
+#include <QVector>
+#include <QtConcurrent>
+#include <QtMath>
+
+#include <cmath>
+
+namespace {
+
+// Destination rows resampled per parallel task, big enough to amortize the scheduling and the rows the
+// vertical taps of neighbour bands both need.
+const int BAND_HEIGHT = 64;
+const qint32 ROUNDING = 1 << (Resampler::WEIGHT_BITS - 1);
+
+// Fixed-point weights of the destination pixels along one axis. Every destination pixel has the same number
+// of taps, zero weights pad the windows cut by the source edges.
+struct Weights
+{
+    int taps { 0 };
+    QVector<int> starts;
+    QVector<qint32> weights;
+};
+
+double filterSupport(Resampler::Filter filter)
+{
+    switch (filter) {
+    case Resampler::Filter::Box:
+        return 0.5;
+    case Resampler::Filter::Bilinear:
+        return 1.0;
+    case Resampler::Filter::Lanczos3:
+        return 3.0;
+    }
+    return 1.0;
+}
+
+double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= M_PI;
+    return std::sin(x) / x;
+}
+
+double filterValue(Resampler::Filter filter, double x)
+{
+    switch (filter) {
+    case Resampler::Filter::Box:
+        return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+    case Resampler::Filter::Bilinear:
+        return qMax(0.0, 1.0 - std::abs(x));
+    case Resampler::Filter::Lanczos3:
+        return std::abs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+Weights computeWeights(Resampler::Filter filter, int sourceSize, double sourceOffset, double sourceLength, int size)
+{
+    const double scale = sourceLength / size;
+    // Shrinking stretches the filter over the source pixels each destination pixel covers.
+    const double filterScale = qMax(1.0, scale);
+    const double support = filterSupport(filter) * filterScale;
+
+    Weights weights;
+    weights.taps = qMin(sourceSize, int(std::ceil(support * 2.0)) + 2);
+    weights.starts.resize(size);
+    weights.weights.fill(0, size * weights.taps);
+    QVarLengthArray<double, 64> values(weights.taps);
+    for (int i = 0; i < size; ++i) {
+        const double center = sourceOffset + (i + 0.5) * scale;
+        const int first = qBound(0, int(std::floor(center - support)), sourceSize - 1),
+                last = qBound(first + 1, int(std::ceil(center + support)), qMin(sourceSize, first + weights.taps));
+        double total = 0.0;
+        for (int j = first; j < last; ++j) {
+            values[j - first] = filterValue(filter, (j + 0.5 - center) / filterScale);
+            total += values[j - first];
+        }
+
+        // The window is moved back inside the source, its weights shifted after the padding.
+        const int start = qMax(0, qMin(first, sourceSize - weights.taps));
+        weights.starts[i] = start;
+        qint32* pixelWeights = weights.weights.data() + i * weights.taps;
+        if (total == 0.0) {
+            pixelWeights[qBound(first, int(center), last - 1) - start] = 1 << Resampler::WEIGHT_BITS;
+            continue;
+        }
+
+        // The rounding error goes to the biggest weight, so the weights sum to exactly one.
+        qint32 sum = 0;
+        int biggest = first;
+        for (int j = first; j < last; ++j) {
+            pixelWeights[j - start] = qint32(std::lround(values[j - first] / total * (1 << Resampler::WEIGHT_BITS)));
+            sum += pixelWeights[j - start];
+            if (pixelWeights[j - start] > pixelWeights[biggest - start])
+                biggest = j;
+        }
+        pixelWeights[biggest - start] += (1 << Resampler::WEIGHT_BITS) - sum;
+    }
+    return weights;
+}
+
+// Rounds the sums to bytes and clamps the colors to the alpha.
+inline quint32 packPixel(qint32 blue, qint32 green, qint32 red, qint32 alpha)
+{
+    const qint32 a = qBound(0, (alpha + ROUNDING) >> Resampler::WEIGHT_BITS, 255);
+    auto channel = [a](qint32 sum) {
+        return quint32(qMin(qBound(0, (sum + ROUNDING) >> Resampler::WEIGHT_BITS, 255), a));
+    };
+    return quint32(a) << 24 | channel(red) << 16 | channel(green) << 8 | channel(blue);
+}
+
+}
+
+namespace Resampler {
+
+int reach(Filter filter, qreal scale)
+{
+    // The support is stretched when shrinking, and the windows start on the pixel before it.
+    return int(std::ceil(filterSupport(filter) * qMax(1.0, 1.0 / scale))) + 1;
+}
+
+HorizontalFunction horizontalFunction(Compositing::InstructionSet instructionSet)
+{
+    if (!Compositing::isSupported(instructionSet))
+        return horizontalScalar;
+
+    switch (instructionSet) {
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    case Compositing::InstructionSet::Sse41:
+        return horizontalSse41;
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    case Compositing::InstructionSet::Avx2:
+        return horizontalAvx2;
+#endif
+    default:
+        return horizontalScalar;
+    }
+}
+
+VerticalFunction verticalFunction(Compositing::InstructionSet instructionSet)
+{
+    if (!Compositing::isSupported(instructionSet))
+        return verticalScalar;
+
+    switch (instructionSet) {
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    case Compositing::InstructionSet::Sse41:
+        return verticalSse41;
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    case Compositing::InstructionSet::Avx2:
+        return verticalAvx2;
+#endif
+    default:
+        return verticalScalar;
+    }
+}
+
+QImage resample(const QImage& source, const QSize& size, Filter filter)
+{
+    return resample(source, QRectF(QPointF(0.0, 0.0), QSizeF(source.size())), size, filter);
+}
+
+QImage resample(const QImage& source, const QRectF& sourceRect, const QSize& size, Filter filter,
+                Compositing::InstructionSet instructionSet)
+{
+    if (source.isNull() || size.isEmpty() || sourceRect.isEmpty())
+        return QImage();
+
+    const QImage input = source.format() == QImage::Format_RGB32 || source.format() == QImage::Format_ARGB32_Premultiplied
+            ? source : source.convertToFormat(source.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    QImage image(size, input.format());
+    if (image.isNull())
+        return QImage();
+
+    const Weights horizontal = computeWeights(filter, input.width(), sourceRect.x(), sourceRect.width(), size.width());
+    const Weights vertical = computeWeights(filter, input.height(), sourceRect.y(), sourceRect.height(), size.height());
+    const HorizontalFunction horizontalPass = horizontalFunction(instructionSet);
+    const VerticalFunction verticalPass = verticalFunction(instructionSet);
+
+    // Detach once here, not concurrently from the bands.
+    uchar* const bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    auto resampleBand = [&](int bandTop) {
+        // Only the source rows the vertical taps of the band reach are resampled horizontally.
+        const int bandBottom = qMin(bandTop + BAND_HEIGHT, size.height());
+        const int firstRow = vertical.starts.at(bandTop),
+                lastRow = vertical.starts.at(bandBottom - 1) + vertical.taps;
+        QVector<quint32> rows((lastRow - firstRow) * size.width());
+        for (int y = firstRow; y < lastRow; ++y) {
+            horizontalPass(rows.data() + (y - firstRow) * size.width(), size.width(),
+                           reinterpret_cast<const quint32*>(input.constScanLine(y)), horizontal.starts.constData(),
+                           horizontal.weights.constData(), horizontal.taps);
+        }
+
+        QVarLengthArray<const quint32*, 64> rowPointers(vertical.taps);
+        for (int y = bandTop; y < bandBottom; ++y) {
+            for (int tap = 0; tap < vertical.taps; ++tap)
+                rowPointers[tap] = rows.constData() + (vertical.starts.at(y) + tap - firstRow) * size.width();
+            verticalPass(reinterpret_cast<quint32*>(bits + y * bytesPerLine), size.width(), rowPointers.constData(),
+                         vertical.weights.constData() + y * vertical.taps, vertical.taps);
+        }
+    };
+
+    QVector<int> bandTops;
+    for (int y = 0; y < size.height(); y += BAND_HEIGHT)
+        bandTops.append(y);
+    // A single band, like a tile, runs on the calling thread, which may already be one of the pool.
+    if (bandTops.size() == 1)
+        resampleBand(0);
+    else
+        QtConcurrent::blockingMap(bandTops, resampleBand);
+    return image;
+}
+
+bool resample(const TiledImage& source, const QSize& size, Filter filter, int bandHeight, const BandConsumer& consumer)
+{
+    if (source.isNull() || size.isEmpty() || bandHeight < 1)
+        return false;
+
+    const qreal scale = qreal(size.height()) / source.height();
+    const int margin = reach(filter, scale);
+    for (int top = 0; top < size.height(); top += bandHeight) {
+        const int height = qMin(bandHeight, size.height() - top);
+        const qreal sourceTop = top / scale,
+                sourceBottom = (top + height) / scale;
+        const int copyTop = qMax(0, qFloor(sourceTop) - margin),
+                copyBottom = qMin(source.height(), qCeil(sourceBottom) + margin);
+        const QImage band = resample(source.copy(QRect(0, copyTop, source.width(), copyBottom - copyTop)),
+                                     QRectF(0.0, sourceTop - copyTop, source.width(), sourceBottom - sourceTop),
+                                     QSize(size.width(), height), filter);
+        if (band.isNull() || !consumer(band, top))
+            return false;
+    }
+    return true;
+}
+
+void horizontalScalar(quint32* destination, int count, const quint32* source, const int* starts, const qint32* weights, int taps)
+{
+    for (int i = 0; i < count; ++i) {
+        const quint32* pixels = source + starts[i];
+        const qint32* pixelWeights = weights + i * taps;
+        qint32 blue = 0, green = 0, red = 0, alpha = 0;
+        for (int tap = 0; tap < taps; ++tap) {
+            const quint32 pixel = pixels[tap];
+            const qint32 weight = pixelWeights[tap];
+            blue += weight * qint32(pixel & 0xFF);
+            green += weight * qint32((pixel >> 8) & 0xFF);
+            red += weight * qint32((pixel >> 16) & 0xFF);
+            alpha += weight * qint32(pixel >> 24);
+        }
+        destination[i] = packPixel(blue, green, red, alpha);
+    }
+}
+
+void verticalScalar(quint32* destination, int count, const quint32* const* rows, const qint32* weights, int taps)
+{
+    for (int i = 0; i < count; ++i) {
+        qint32 blue = 0, green = 0, red = 0, alpha = 0;
+        for (int tap = 0; tap < taps; ++tap) {
+            const quint32 pixel = rows[tap][i];
+            const qint32 weight = weights[tap];
+            blue += weight * qint32(pixel & 0xFF);
+            green += weight * qint32((pixel >> 8) & 0xFF);
+            red += weight * qint32((pixel >> 16) & 0xFF);
+            alpha += weight * qint32(pixel >> 24);
+        }
+        destination[i] = packPixel(blue, green, red, alpha);
+    }
+}
+
+}
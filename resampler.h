@@ -0,0 +1,71 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "compositing.h"
+#include "tiledimage.h"
+
+#include <QImage>
+#include <QRectF>
+
+#include <functional>
+
+// Separable resampling of 32-bit images, a horizontal pass over the source rows then a vertical pass over the
+// resampled rows. The filter is stretched by the scale when shrinking, so every source pixel contributes and
+// nothing aliases. Weights are in fixed point and every kernel computes the same exact result, so the SIMD
+// kernels are bit-exact with the scalar one; the widest kernel supported by the CPU is selected at runtime.
+// Colors are clamped to the alpha, the overshoot of Lanczos never makes a premultiplied pixel invalid.
+namespace Resampler {
+
+    enum class Filter {
+        // Average of the source pixels covered, nearest neighbour when enlarging.
+        Box,
+        Bilinear,
+        Lanczos3
+    };
+
+    // The weights of a destination pixel sum to 1 << WEIGHT_BITS.
+    const int WEIGHT_BITS = 14;
+
+    // Destination pixel i is the sum of the taps source pixels from starts[i], weighted by weights[i * taps] onwards.
+    using HorizontalFunction = void (*)(quint32* destination, int count, const quint32* source, const int* starts,
+                                        const qint32* weights, int taps);
+    // Destination pixel i is the sum of the pixels i of the taps rows, weighted by the weights.
+    using VerticalFunction = void (*)(quint32* destination, int count, const quint32* const* rows, const qint32* weights,
+                                      int taps);
+
+    // Returns how far the filter reaches, in source pixels, past the source pixels covered by the destination
+    // ones when resampling by the scale, the destination size over the source size.
+    int reach(Filter filter, qreal scale);
+
+    // Return the kernels of the instruction set, the scalar ones if the CPU does not support it.
+    HorizontalFunction horizontalFunction(Compositing::InstructionSet instructionSet);
+    VerticalFunction verticalFunction(Compositing::InstructionSet instructionSet);
+
+    // Takes a band of the result with the row it starts at, returns false to stop.
+    using BandConsumer = std::function<bool(const QImage& band, int y)>;
+
+    // Resamples the image to the size. Bands of rows run on all cores.
+    QImage resample(const QImage& source, const QSize& size, Filter filter = Filter::Lanczos3);
+    // Resamples the part of the source inside the rect, in source pixels, to the size. The pixels of the source
+    // around the rect are used by the filter, so neighbour parts resampled separately meet without seams.
+    QImage resample(const QImage& source, const QRectF& sourceRect, const QSize& size, Filter filter = Filter::Lanczos3,
+                    Compositing::InstructionSet instructionSet = Compositing::bestInstructionSet());
+    // Resamples the tiled image to the size band by band, from the top down, for images too big for memory.
+    // Each band is resampled from a copy of the source rows its filter reaches only, so neither the source
+    // nor the result is ever whole in memory. Returns false if a band cannot be allocated or the consumer stops.
+    bool resample(const TiledImage& source, const QSize& size, Filter filter, int bandHeight, const BandConsumer& consumer);
+
+    void horizontalScalar(quint32* destination, int count, const quint32* source, const int* starts, const qint32* weights, int taps);
+    void verticalScalar(quint32* destination, int count, const quint32* const* rows, const qint32* weights, int taps);
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+    void horizontalSse41(quint32* destination, int count, const quint32* source, const int* starts, const qint32* weights, int taps);
+    void verticalSse41(quint32* destination, int count, const quint32* const* rows, const qint32* weights, int taps);
+#endif
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+    void horizontalAvx2(quint32* destination, int count, const quint32* source, const int* starts, const qint32* weights, int taps);
+    void verticalAvx2(quint32* destination, int count, const quint32* const* rows, const qint32* weights, int taps);
+#endif
+
+}
+
+#endif // RESAMPLER_H
@@ -0,0 +1,88 @@
+#include "resampler.h"
+
+#ifdef QT_COMPILER_SUPPORTS_AVX2
+
+#include <QVarLengthArray>
+
+#include <immintrin.h>
+
+namespace {
+
+inline __m256i roundSums(__m256i sum)
+{
+    return _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(1 << (Resampler::WEIGHT_BITS - 1))),
+                             Resampler::WEIGHT_BITS);
+}
+
+// Clamps the colors of the pixels to their alpha.
+inline __m256i clampToAlpha(__m256i pixels)
+{
+    const __m256i alphaShuffle = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+                                                  3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+    return _mm256_min_epu8(pixels, _mm256_shuffle_epi8(pixels, alphaShuffle));
+}
+
+}
+
+namespace Resampler {
+
+void horizontalAvx2(quint32* destination, int count, const quint32* source, const int* starts, const qint32* weights, int taps)
+{
+    for (int i = 0; i < count; ++i) {
+        const quint32* pixels = source + starts[i];
+        const qint32* pixelWeights = weights + i * taps;
+        // Two taps at a time, the channels of the first in the low 128-bit lane and of the second in the high one.
+        __m256i sum = _mm256_setzero_si256();
+        int tap = 0;
+        for (; tap + 2 <= taps; tap += 2) {
+            const __m256i widened = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels + tap)));
+            const __m256i weight = _mm256_set_m128i(_mm_set1_epi32(pixelWeights[tap + 1]), _mm_set1_epi32(pixelWeights[tap]));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(widened, weight));
+        }
+        __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        if (tap < taps) {
+            const __m128i widened = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(pixels[tap])));
+            total = _mm_add_epi32(total, _mm_mullo_epi32(widened, _mm_set1_epi32(pixelWeights[tap])));
+        }
+
+        const __m128i rounded = _mm_srai_epi32(_mm_add_epi32(total, _mm_set1_epi32(1 << (WEIGHT_BITS - 1))), WEIGHT_BITS);
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(rounded, rounded), _mm_setzero_si128());
+        const __m128i alpha = _mm_shuffle_epi8(packed, _mm_setr_epi8(3, 3, 3, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+        destination[i] = quint32(_mm_cvtsi128_si32(_mm_min_epu8(packed, alpha)));
+    }
+}
+
+void verticalAvx2(quint32* destination, int count, const quint32* const* rows, const qint32* weights, int taps)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Two pixels per register: pixels 0 and 1, 2 and 3, 4 and 5, 6 and 7.
+        __m256i first = _mm256_setzero_si256(), second = first, third = first, fourth = first;
+        for (int tap = 0; tap < taps; ++tap) {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[tap] + i)),
+                    high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[tap] + i + 4));
+            const __m256i weight = _mm256_set1_epi32(weights[tap]);
+            first = _mm256_add_epi32(first, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(low), weight));
+            second = _mm256_add_epi32(second, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)), weight));
+            third = _mm256_add_epi32(third, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(high), weight));
+            fourth = _mm256_add_epi32(fourth, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)), weight));
+        }
+
+        // Packing works within 128-bit lanes and leaves the pixels in the order 0 2 4 6 1 3 5 7.
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(roundSums(first), roundSums(second)),
+                                                   _mm256_packs_epi32(roundSums(third), roundSums(fourth)));
+        const __m256i pixels = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), clampToAlpha(pixels));
+    }
+
+    if (i < count) {
+        QVarLengthArray<const quint32*, 64> tailRows(taps);
+        for (int tap = 0; tap < taps; ++tap)
+            tailRows[tap] = rows[tap] + i;
+        verticalScalar(destination + i, count - i, tailRows.constData(), weights, taps);
+    }
+}
+
+}
+
+#endif // QT_COMPILER_SUPPORTS_AVX2
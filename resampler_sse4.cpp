@@ -0,0 +1,72 @@
+#include "resampler.h"
+
+#ifdef QT_COMPILER_SUPPORTS_SSE4_1
+
+#include <QVarLengthArray>
+
+#include <smmintrin.h>
+
+namespace {
+
+// Rounds the sums of four pixels, one 32-bit lane per channel, to bytes and clamps the colors to the alpha.
+inline __m128i packPixels(__m128i first, __m128i second, __m128i third, __m128i fourth)
+{
+    const __m128i rounding = _mm_set1_epi32(1 << (Resampler::WEIGHT_BITS - 1));
+    auto roundSums = [rounding](__m128i sum) {
+        return _mm_srai_epi32(_mm_add_epi32(sum, rounding), Resampler::WEIGHT_BITS);
+    };
+    const __m128i pixels = _mm_packus_epi16(_mm_packs_epi32(roundSums(first), roundSums(second)),
+                                            _mm_packs_epi32(roundSums(third), roundSums(fourth)));
+    const __m128i alpha = _mm_shuffle_epi8(pixels, _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15));
+    return _mm_min_epu8(pixels, alpha);
+}
+
+inline __m128i widenPixel(quint32 pixel)
+{
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(pixel)));
+}
+
+}
+
+namespace Resampler {
+
+void horizontalSse41(quint32* destination, int count, const quint32* source, const int* starts, const qint32* weights, int taps)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < count; ++i) {
+        const quint32* pixels = source + starts[i];
+        const qint32* pixelWeights = weights + i * taps;
+        __m128i sum = zero;
+        for (int tap = 0; tap < taps; ++tap)
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(widenPixel(pixels[tap]), _mm_set1_epi32(pixelWeights[tap])));
+        destination[i] = quint32(_mm_cvtsi128_si32(packPixels(sum, zero, zero, zero)));
+    }
+}
+
+void verticalSse41(quint32* destination, int count, const quint32* const* rows, const qint32* weights, int taps)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i first = _mm_setzero_si128(), second = first, third = first, fourth = first;
+        for (int tap = 0; tap < taps; ++tap) {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[tap] + i));
+            const __m128i weight = _mm_set1_epi32(weights[tap]);
+            first = _mm_add_epi32(first, _mm_mullo_epi32(_mm_cvtepu8_epi32(pixels), weight));
+            second = _mm_add_epi32(second, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(pixels, 4)), weight));
+            third = _mm_add_epi32(third, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(pixels, 8)), weight));
+            fourth = _mm_add_epi32(fourth, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(pixels, 12)), weight));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), packPixels(first, second, third, fourth));
+    }
+
+    if (i < count) {
+        QVarLengthArray<const quint32*, 64> tailRows(taps);
+        for (int tap = 0; tap < taps; ++tap)
+            tailRows[tap] = rows[tap] + i;
+        verticalScalar(destination + i, count - i, tailRows.constData(), weights, taps);
+    }
+}
+
+}
+
+#endif // QT_COMPILER_SUPPORTS_SSE4_1
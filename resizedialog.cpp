@@ -0,0 +1,80 @@
+#include "resizedialog.h"
+#include "constants.h"
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QSignalBlocker>
+#include <QSpinBox>
+
+ResizeDialog::ResizeDialog(const QSize& size, QWidget* parent)
+    : QDialog(parent)
+    , m_originalSize(size)
+{
+    setWindowTitle(tr("Resize Image"));
+
+    m_widthSpinBox = new QSpinBox(this);
+    m_widthSpinBox->setRange(1, Constants::RESIZE_MAX_SIZE_PX);
+    m_widthSpinBox->setSuffix(tr(" px"));
+    m_widthSpinBox->setValue(size.width());
+    m_heightSpinBox = new QSpinBox(this);
+    m_heightSpinBox->setRange(1, Constants::RESIZE_MAX_SIZE_PX);
+    m_heightSpinBox->setSuffix(tr(" px"));
+    m_heightSpinBox->setValue(size.height());
+    m_keepAspectRatioCheckBox = new QCheckBox(tr("Keep aspect ratio"), this);
+    m_keepAspectRatioCheckBox->setChecked(true);
+
+    // The items follow the order of Resampler::Filter.
+    m_filterComboBox = new QComboBox(this);
+    m_filterComboBox->addItem(tr("Box (area average)"));
+    m_filterComboBox->addItem(tr("Bilinear"));
+    m_filterComboBox->addItem(tr("Lanczos"));
+    m_filterComboBox->setCurrentIndex(int(Resampler::Filter::Lanczos3));
+
+    auto* buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+
+    auto* layout = new QFormLayout(this);
+    layout->addRow(tr("Width:"), m_widthSpinBox);
+    layout->addRow(tr("Height:"), m_heightSpinBox);
+    layout->addRow(QString(), m_keepAspectRatioCheckBox);
+    layout->addRow(tr("Filter:"), m_filterComboBox);
+    layout->addRow(buttonBox);
+
+    connect(m_widthSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &ResizeDialog::onWidthChanged);
+    connect(m_heightSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &ResizeDialog::onHeightChanged);
+    connect(m_keepAspectRatioCheckBox, &QCheckBox::toggled, [&](bool checked) {
+        if (checked)
+            onWidthChanged(m_widthSpinBox->value());
+    });
+    connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+QSize ResizeDialog::imageSize() const
+{
+    return QSize(m_widthSpinBox->value(), m_heightSpinBox->value());
+}
+
+Resampler::Filter ResizeDialog::filter() const
+{
+    return Resampler::Filter(m_filterComboBox->currentIndex());
+}
+
+void ResizeDialog::onWidthChanged(int width)
+{
+    if (!m_keepAspectRatioCheckBox->isChecked())
+        return;
+
+    QSignalBlocker blocker(m_heightSpinBox);
+    m_heightSpinBox->setValue(qMax(1, qRound(qreal(width) * m_originalSize.height() / m_originalSize.width())));
+}
+
+void ResizeDialog::onHeightChanged(int height)
+{
+    if (!m_keepAspectRatioCheckBox->isChecked())
+        return;
+
+    QSignalBlocker blocker(m_widthSpinBox);
+    m_widthSpinBox->setValue(qMax(1, qRound(qreal(height) * m_originalSize.width() / m_originalSize.height())));
+}
@@ -0,0 +1,36 @@
+#ifndef RESIZEDIALOG_H
+#define RESIZEDIALOG_H
+
+#include "resampler.h"
+
+#include <QDialog>
+
+class QCheckBox;
+class QComboBox;
+class QSpinBox;
+
+// Asks for the new size of the photo and the filter it is resampled with. Keeping the aspect ratio couples
+// the width and the height to the proportions of the original size.
+class ResizeDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    ResizeDialog(const QSize& size, QWidget* parent = nullptr);
+    ~ResizeDialog() = default;
+
+    QSize imageSize() const;
+    Resampler::Filter filter() const;
+
+private:
+    void onWidthChanged(int width);
+    void onHeightChanged(int height);
+
+    QSize m_originalSize;
+    QSpinBox* m_widthSpinBox { nullptr };
+    QSpinBox* m_heightSpinBox { nullptr };
+    QCheckBox* m_keepAspectRatioCheckBox { nullptr };
+    QComboBox* m_filterComboBox { nullptr };
+};
+
+#endif // RESIZEDIALOG_H
@@ -0,0 +1,95 @@
+#include "summedareatable.h"
+#include "profiler.h"
+
+SummedAreaTable::SummedAreaTable(int cacheSizeKb)
+{
+    m_tables.setMaxCost(cacheSizeKb);
+}
+
+void SummedAreaTable::setImage(const TiledImage& image)
+{
+    m_tables.clear();
+    m_image = image;
+}
+
+void SummedAreaTable::updateImage(const TiledImage& image, const QRect& dirtyRect)
+{
+    m_image = image;
+    const QRect range = m_image.tileRange(dirtyRect);
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column)
+            m_tables.remove(row * m_image.columns() + column);
+    }
+}
+
+QColor SummedAreaTable::average(const QRect& rect)
+{
+    const QRect clipped = rect.intersected(QRect(QPoint(0, 0), m_image.size()));
+    if (clipped.isEmpty())
+        return QColor();
+
+    quint64 sums[4] = {};
+    const QRect range = m_image.tileRange(clipped);
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column) {
+            const Table* tileTable = table(column, row);
+            const QRect tileRect = m_image.tileRect(column, row);
+            const QRect local = clipped.intersected(tileRect).translated(-tileRect.topLeft());
+            const int stride = (tileTable->width + 1) * 4;
+            const quint32* top = tileTable->sums.constData() + local.top() * stride;
+            const quint32* bottom = tileTable->sums.constData() + (local.bottom() + 1) * stride;
+            const int left = local.left() * 4, right = (local.right() + 1) * 4;
+            for (int channel = 0; channel < 4; ++channel) {
+                sums[channel] += bottom[right + channel] - bottom[left + channel]
+                        - top[right + channel] + top[left + channel];
+            }
+        }
+    }
+
+    // Channels are red, green, blue and alpha, the color ones premultiplied.
+    const quint64 alphaSum = sums[3];
+    if (alphaSum == 0)
+        return QColor(0, 0, 0, 0);
+    const quint64 pixelCount = quint64(clipped.width()) * clipped.height();
+    return QColor(int((sums[0] * 255 + alphaSum / 2) / alphaSum), int((sums[1] * 255 + alphaSum / 2) / alphaSum),
+                  int((sums[2] * 255 + alphaSum / 2) / alphaSum), int((alphaSum + pixelCount / 2) / pixelCount));
+}
+
+const SummedAreaTable::Table* SummedAreaTable::table(int column, int row)
+{
+    const int key = row * m_image.columns() + column;
+    if (const Table* cachedTable = m_tables.object(key))
+        return cachedTable;
+
+    const Profiler::ScopedTimer timer("build summed-area table");
+    QImage tile = m_image.tile(column, row);
+    // RGB32 pixels are opaque premultiplied ones already.
+    if (tile.format() != QImage::Format_RGB32 && tile.format() != QImage::Format_ARGB32_Premultiplied)
+        tile = tile.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    auto* tileTable = new Table;
+    tileTable->width = tile.width();
+    const int stride = (tile.width() + 1) * 4;
+    tileTable->sums.fill(0, stride * (tile.height() + 1));
+    quint32* sums = tileTable->sums.data();
+    for (int y = 0; y < tile.height(); ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(tile.constScanLine(y));
+        const quint32* above = sums + y * stride + 4;
+        quint32* current = sums + (y + 1) * stride + 4;
+        quint32 red = 0, green = 0, blue = 0, alpha = 0;
+        for (int x = 0; x < tile.width(); ++x) {
+            red += qRed(line[x]);
+            green += qGreen(line[x]);
+            blue += qBlue(line[x]);
+            alpha += qAlpha(line[x]);
+            current[x * 4] = above[x * 4] + red;
+            current[x * 4 + 1] = above[x * 4 + 1] + green;
+            current[x * 4 + 2] = above[x * 4 + 2] + blue;
+            current[x * 4 + 3] = above[x * 4 + 3] + alpha;
+        }
+    }
+
+    const Table* result = tileTable;
+    m_tables.insert(key, tileTable, qMax(1, int(tileTable->sums.size() * sizeof(quint32) / 1024)));
+    return result;
+}
@@ -0,0 +1,42 @@
+#ifndef SUMMEDAREATABLE_H
+#define SUMMEDAREATABLE_H
+
+#include "tiledimage.h"
+#include "constants.h"
+
+#include <QCache>
+#include <QColor>
+#include <QVector>
+
+// Averages the pixels of any rect of a tiled 32-bit image in constant time per tile the rect touches.
+// Every tile gets its own table of running sums, built on the first average reading it and cached, so
+// only the tiles under the pointer are ever scanned and an edit only drops the tables of its tiles.
+// The sums are kept per premultiplied channel, so transparent pixels do not darken the average.
+class SummedAreaTable
+{
+public:
+    explicit SummedAreaTable(int cacheSizeKb = Constants::PIPETTE_TABLE_CACHE_SIZE_KB);
+
+    void setImage(const TiledImage& image);
+    // Takes an edited version of the current image, only the tables of the tiles of the dirty rect are dropped.
+    void updateImage(const TiledImage& image, const QRect& dirtyRect);
+
+    // Returns the average color of the pixels of the rect clipped to the image, an invalid color if none.
+    QColor average(const QRect& rect);
+
+private:
+    // Sums of the pixels above and left of each position of a tile, one more row and column than the tile,
+    // four channels per position. 32 bits hold the sums of tiles up to 4096 pixels wide.
+    struct Table
+    {
+        int width { 0 };
+        QVector<quint32> sums;
+    };
+
+    const Table* table(int column, int row);
+
+    TiledImage m_image;
+    QCache<int, Table> m_tables;
+};
+
+#endif // SUMMEDAREATABLE_H
@@ -0,0 +1,428 @@
+#include "annotationscene.h"
+#include "batchprocessor.h"
+#include "colormanagement.h"
+#include "compositing.h"
+#include "histogram.h"
+#include "photoloader.h"
+#include "redaction.h"
+#include "resampler.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QVector>
+#include <QtTest>
+
+#include <cstring>
+
+// Checks the SIMD kernels against the scalar ones they must be bit-exact with. The kernels the CPU or the compiler
+// does not support are skipped. The pixelation, which has no SIMD kernels, is checked against direct cell averages.
+class Tests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sourceOver_data();
+    void sourceOver();
+    void compositeStraightAlpha();
+    void batchStraightAlpha();
+    void batchOutputCollisions();
+    void resample_data();
+    void resample();
+    void resampleBands();
+    void luma_data();
+    void luma();
+    void blur_data();
+    void blur();
+    void pixelated();
+    void convertToSRgb_data();
+    void convertToSRgb();
+};
+
+namespace {
+
+// Pixels compared past the end of the blended ones, a kernel must leave them untouched.
+const int GUARD_PIXELS = 8;
+
+enum class Run {
+    Random,
+    Transparent,
+    Opaque
+};
+
+QVector<quint32> premultipliedPixels(int count, Run run, QRandomGenerator& random)
+{
+    QVector<quint32> pixels(count);
+    for (quint32& pixel : pixels) {
+        const int alpha = run == Run::Transparent ? 0 : run == Run::Opaque ? 255 : int(random.bounded(256u));
+        // The channels of a premultiplied pixel never exceed its alpha.
+        pixel = qRgba(int(random.bounded(quint32(alpha) + 1)), int(random.bounded(quint32(alpha) + 1)),
+                      int(random.bounded(quint32(alpha) + 1)), alpha);
+    }
+    return pixels;
+}
+
+void addInstructionSetRows()
+{
+    QTest::addColumn<int>("instructionSet");
+    QTest::newRow("sse4.1") << int(Compositing::InstructionSet::Sse41);
+    QTest::newRow("avx2") << int(Compositing::InstructionSet::Avx2);
+}
+
+}
+
+void Tests::sourceOver_data()
+{
+    addInstructionSetRows();
+}
+
+void Tests::sourceOver()
+{
+    QFETCH(int, instructionSet);
+    if (!Compositing::isSupported(Compositing::InstructionSet(instructionSet)))
+        QSKIP("Not supported by this CPU or build");
+    const Compositing::SourceOverFunction sourceOver = Compositing::sourceOverFunction(Compositing::InstructionSet(instructionSet));
+
+    // Up to 17 pixels covers every tail of the 4 and 8 pixel loops, the offset of one pixel misaligns the rows.
+    QRandomGenerator random(instructionSet);
+    for (const Run run : { Run::Random, Run::Transparent, Run::Opaque }) {
+        for (const int opacity : { 0, 1, 128, 254, 255 }) {
+            for (int count = 0; count <= 17; ++count) {
+                for (const int offset : { 0, 1 }) {
+                    const QVector<quint32> source = premultipliedPixels(offset + count + GUARD_PIXELS, run, random);
+                    const QVector<quint32> destination = premultipliedPixels(offset + count + GUARD_PIXELS, Run::Random, random);
+                    QVector<quint32> expected = destination, actual = destination;
+                    Compositing::sourceOverScalar(expected.data() + offset, source.constData() + offset, count, opacity);
+                    sourceOver(actual.data() + offset, source.constData() + offset, count, opacity);
+                    QVERIFY2(actual == expected, qPrintable(QStringLiteral("%1 pixels at offset %2, opacity %3, %4 source")
+                                                            .arg(count).arg(offset).arg(opacity)
+                                                            .arg(run == Run::Random ? "random" : run == Run::Transparent ? "transparent" : "opaque")));
+                }
+            }
+        }
+    }
+}
+
+void Tests::compositeStraightAlpha()
+{
+    // A straight alpha photo, like a decoded RGBA PNG, gets the same pixels as its premultiplied conversion.
+    QRandomGenerator random(1);
+    QImage image(37, 29, QImage::Format_ARGB32);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+            line[x] = random.generate();
+    }
+    AnnotationScene scene;
+    Annotation box(Annotation::Box, QColor(255, 0, 0, 160), 6.0);
+    box.addPoint(QPointF(3.0, 4.0));
+    box.setEndPoint(QPointF(30.0, 25.0));
+    scene.add(box);
+
+    QImage expected = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QImage unblended = expected;
+    scene.composite(expected, 200);
+    QImage actual = image;
+    scene.composite(actual, 200);
+    QCOMPARE(actual.format(), QImage::Format_ARGB32_Premultiplied);
+    QVERIFY(expected != unblended);
+    QVERIFY(actual == expected);
+}
+
+void Tests::batchStraightAlpha()
+{
+    // An RGBA PNG decodes to straight alpha, the batch output must match the premultiplied compositing of the editor.
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QRandomGenerator random(1);
+    QImage image(37, 29, QImage::Format_ARGB32);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+            line[x] = random.generate();
+    }
+    const QString inputPath = directory.filePath("photo.png");
+    QVERIFY(image.save(inputPath));
+
+    BatchProcessor::Script script;
+    Annotation box(Annotation::Box, QColor(255, 0, 0, 160), 6.0);
+    box.addPoint(QPointF(3.0, 4.0));
+    box.setEndPoint(QPointF(30.0, 25.0));
+    script.annotations.append(box);
+    script.opacity = 200;
+    const QString outputDirectory = directory.filePath("output");
+    QVERIFY(QDir().mkpath(outputDirectory));
+    BatchProcessor processor(script, outputDirectory);
+    QCOMPARE(processor.run({ inputPath }, QThread::idealThreadCount()), 0);
+
+    AnnotationScene scene;
+    scene.add(box);
+    QImage expected = PhotoLoader::readPhoto(inputPath);
+    QCOMPARE(expected.format(), QImage::Format_ARGB32_Premultiplied);
+    scene.composite(expected, script.opacity);
+    const QImage actual(QDir(outputDirectory).filePath("photo.png"));
+    QVERIFY(!actual.isNull());
+    QVERIFY(actual.convertToFormat(QImage::Format_ARGB32) == expected.convertToFormat(QImage::Format_ARGB32));
+}
+
+void Tests::batchOutputCollisions()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    QImage image(8, 8, QImage::Format_RGB32);
+    image.fill(Qt::gray);
+    const QString pngPath = directory.filePath("photo.png"), bmpPath = directory.filePath("photo.bmp");
+    QVERIFY(image.save(pngPath));
+    QVERIFY(image.save(bmpPath));
+
+    // Both inputs would be saved as photo.png, only the first one is processed.
+    BatchProcessor::Script script;
+    script.format = "png";
+    const QString outputDirectory = directory.filePath("output");
+    QVERIFY(QDir().mkpath(outputDirectory));
+    BatchProcessor processor(script, outputDirectory);
+    QCOMPARE(processor.run({ pngPath, bmpPath }, QThread::idealThreadCount()), 1);
+    QVERIFY(QFileInfo::exists(QDir(outputDirectory).filePath("photo.png")));
+    QVERIFY(!QFileInfo::exists(QDir(outputDirectory).filePath("photo.bmp")));
+
+    // The output would replace the input in its own directory.
+    QFile input(pngPath);
+    QVERIFY(input.open(QIODevice::ReadOnly));
+    const QByteArray inputBytes = input.readAll();
+    input.close();
+    script.annotations.append(Annotation(Annotation::Box, Qt::red, 2.0));
+    script.annotations.last().addPoint(QPointF(1.0, 1.0));
+    script.annotations.last().setEndPoint(QPointF(6.0, 6.0));
+    BatchProcessor inPlaceProcessor(script, directory.path());
+    QCOMPARE(inPlaceProcessor.run({ pngPath }, QThread::idealThreadCount()), 1);
+    QVERIFY(input.open(QIODevice::ReadOnly));
+    QCOMPARE(input.readAll(), inputBytes);
+}
+
+void Tests::resample_data()
+{
+    addInstructionSetRows();
+}
+
+void Tests::resample()
+{
+    QFETCH(int, instructionSet);
+    if (!Compositing::isSupported(Compositing::InstructionSet(instructionSet)))
+        QSKIP("Not supported by this CPU or build");
+
+    // Odd widths leave tails to the 4 and 8 pixel loops, the fractional rect offsets every filter window.
+    QRandomGenerator random(instructionSet);
+    const QSize sourceSize(61, 37);
+    const QVector<quint32> pixels = premultipliedPixels(sourceSize.width() * sourceSize.height(), Run::Random, random);
+    const QImage source(reinterpret_cast<const uchar*>(pixels.constData()), sourceSize.width(), sourceSize.height(),
+                        QImage::Format_ARGB32_Premultiplied);
+    for (const Resampler::Filter filter : { Resampler::Filter::Box, Resampler::Filter::Bilinear, Resampler::Filter::Lanczos3 }) {
+        for (const QSize& size : { QSize(1, 1), QSize(7, 5), QSize(29, 19), QSize(61, 37), QSize(133, 81) }) {
+            for (const QRectF& sourceRect : { QRectF(QPointF(0.0, 0.0), QSizeF(sourceSize)), QRectF(3.25, 2.5, 41.5, 27.75) }) {
+                const QImage expected = Resampler::resample(source, sourceRect, size, filter, Compositing::InstructionSet::Scalar);
+                const QImage actual = Resampler::resample(source, sourceRect, size, filter,
+                                                          Compositing::InstructionSet(instructionSet));
+                QVERIFY2(actual == expected, qPrintable(QStringLiteral("%1x%2 from %3,%4 %5x%6, filter %7")
+                                                        .arg(size.width()).arg(size.height())
+                                                        .arg(sourceRect.x()).arg(sourceRect.y())
+                                                        .arg(sourceRect.width()).arg(sourceRect.height())
+                                                        .arg(int(filter))));
+            }
+        }
+    }
+}
+
+void Tests::resampleBands()
+{
+    // Resampling a photo too big for memory band by band from its tiles meets without seams, the bands only differ
+    // from the whole result by the rounding of the weights of their offset windows.
+    QRandomGenerator random(1);
+    const QSize sourceSize(300, 530);
+    const QVector<quint32> pixels = premultipliedPixels(sourceSize.width() * sourceSize.height(), Run::Random, random);
+    const QImage source = QImage(reinterpret_cast<const uchar*>(pixels.constData()), sourceSize.width(), sourceSize.height(),
+                                 QImage::Format_ARGB32_Premultiplied).copy();
+    const TiledImage tiles(source, 64);
+    for (const Resampler::Filter filter : { Resampler::Filter::Box, Resampler::Filter::Bilinear, Resampler::Filter::Lanczos3 }) {
+        for (const QSize& size : { QSize(97, 171), QSize(300, 530), QSize(641, 1009) }) {
+            const QImage expected = Resampler::resample(source, size, filter);
+            QImage actual(size, expected.format());
+            const bool resampled = Resampler::resample(tiles, size, filter, 37, [&](const QImage& band, int y) {
+                for (int row = 0; row < band.height(); ++row)
+                    std::memcpy(actual.scanLine(y + row), band.constScanLine(row), size_t(band.width()) * 4);
+                return true;
+            });
+            QVERIFY(resampled);
+
+            int maxDifference = 0;
+            for (int y = 0; y < size.height(); ++y) {
+                const QRgb* actualLine = reinterpret_cast<const QRgb*>(actual.constScanLine(y));
+                const QRgb* expectedLine = reinterpret_cast<const QRgb*>(expected.constScanLine(y));
+                for (int x = 0; x < size.width(); ++x) {
+                    const QRgb a = actualLine[x], e = expectedLine[x];
+                    maxDifference = qMax(maxDifference, qMax(qMax(qAbs(qRed(a) - qRed(e)), qAbs(qGreen(a) - qGreen(e))),
+                                                             qMax(qAbs(qBlue(a) - qBlue(e)), qAbs(qAlpha(a) - qAlpha(e)))));
+                }
+            }
+            QVERIFY2(maxDifference <= 1, qPrintable(QStringLiteral("%1x%2, filter %3, difference %4")
+                                                    .arg(size.width()).arg(size.height()).arg(int(filter)).arg(maxDifference)));
+        }
+    }
+}
+
+void Tests::luma_data()
+{
+    addInstructionSetRows();
+}
+
+void Tests::luma()
+{
+    QFETCH(int, instructionSet);
+    if (!Compositing::isSupported(Compositing::InstructionSet(instructionSet)))
+        QSKIP("Not supported by this CPU or build");
+    const Histogram::LumaFunction luma = Histogram::lumaFunction(Compositing::InstructionSet(instructionSet));
+
+    // Up to 17 pixels covers every tail of the 4 and 8 pixel loops, the bytes past the end must stay untouched.
+    QRandomGenerator random(instructionSet);
+    for (const Run run : { Run::Random, Run::Transparent, Run::Opaque }) {
+        for (int count = 0; count <= 17; ++count) {
+            for (const int offset : { 0, 1 }) {
+                const QVector<quint32> pixels = premultipliedPixels(offset + count, run, random);
+                QVector<uchar> expected(offset + count + GUARD_PIXELS, 0xA5), actual = expected;
+                Histogram::lumaScalar(expected.data() + offset, pixels.constData() + offset, count);
+                luma(actual.data() + offset, pixels.constData() + offset, count);
+                QVERIFY2(actual == expected, qPrintable(QStringLiteral("%1 pixels at offset %2, %3 source")
+                                                        .arg(count).arg(offset)
+                                                        .arg(run == Run::Random ? "random" : run == Run::Transparent ? "transparent" : "opaque")));
+            }
+        }
+    }
+
+    // Pure white and pure black hit the ends of the fixed-point range.
+    const QVector<quint32> extremes { 0xFFFFFFFF, 0xFF000000, 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFFFF, 0xFF000000,
+                                      0xFFFF0000, 0xFF00FF00 };
+    QVector<uchar> expected(extremes.size()), actual(extremes.size());
+    Histogram::lumaScalar(expected.data(), extremes.constData(), extremes.size());
+    luma(actual.data(), extremes.constData(), extremes.size());
+    QCOMPARE(actual, expected);
+}
+
+void Tests::blur_data()
+{
+    addInstructionSetRows();
+}
+
+void Tests::blur()
+{
+    QFETCH(int, instructionSet);
+    if (!Compositing::isSupported(Compositing::InstructionSet(instructionSet)))
+        QSKIP("Not supported by this CPU or build");
+
+    // Widths off the multiples of 4 and 8 leave tails to the kernels, 300 columns span two vertical stripes and
+    // 70 rows two horizontal bands. The radii go from the smallest to windows past the image and the bound.
+    QRandomGenerator random(instructionSet);
+    for (const QSize& size : { QSize(1, 1), QSize(7, 5), QSize(13, 1), QSize(1, 13), QSize(61, 37), QSize(300, 70) }) {
+        const QVector<quint32> pixels = premultipliedPixels(size.width() * size.height(), Run::Random, random);
+        for (const QImage::Format format : { QImage::Format_ARGB32_Premultiplied, QImage::Format_RGB32 }) {
+            const QImage image = QImage(reinterpret_cast<const uchar*>(pixels.constData()), size.width(), size.height(),
+                                        QImage::Format_ARGB32_Premultiplied).convertToFormat(format);
+            for (const int radius : { 1, 2, 5, 40, Redaction::MAX_RADIUS, Redaction::MAX_RADIUS + 1 }) {
+                const QImage expected = Redaction::blurred(image, radius, Compositing::InstructionSet::Scalar);
+                const QImage actual = Redaction::blurred(image, radius, Compositing::InstructionSet(instructionSet));
+                QVERIFY2(actual == expected, qPrintable(QStringLiteral("%1x%2, radius %3, format %4")
+                                                        .arg(size.width()).arg(size.height()).arg(radius).arg(int(format))));
+            }
+        }
+    }
+}
+
+void Tests::pixelated()
+{
+    // 23x17 pixels in cells of 5 leave partial cells along the right and bottom edges, averaged over their pixels only.
+    QRandomGenerator random(1);
+    const QSize size(23, 17);
+    const int cellSize = 5;
+    const QVector<quint32> pixels = premultipliedPixels(size.width() * size.height(), Run::Random, random);
+    const QImage image(reinterpret_cast<const uchar*>(pixels.constData()), size.width(), size.height(),
+                       QImage::Format_ARGB32_Premultiplied);
+    const QImage actual = Redaction::pixelated(image, cellSize);
+    QCOMPARE(actual.size(), size);
+
+    for (int cellTop = 0; cellTop < size.height(); cellTop += cellSize) {
+        for (int cellLeft = 0; cellLeft < size.width(); cellLeft += cellSize) {
+            const QRect cell = QRect(cellLeft, cellTop, cellSize, cellSize) & image.rect();
+            const quint32 pixelCount = quint32(cell.width() * cell.height());
+            quint32 sums[4] = {};
+            for (int y = cell.top(); y <= cell.bottom(); ++y) {
+                for (int x = cell.left(); x <= cell.right(); ++x) {
+                    const QRgb pixel = reinterpret_cast<const QRgb*>(image.constScanLine(y))[x];
+                    sums[0] += quint32(qRed(pixel));
+                    sums[1] += quint32(qGreen(pixel));
+                    sums[2] += quint32(qBlue(pixel));
+                    sums[3] += quint32(qAlpha(pixel));
+                }
+            }
+            const QRgb expected = qRgba(int((sums[0] + pixelCount / 2) / pixelCount), int((sums[1] + pixelCount / 2) / pixelCount),
+                                        int((sums[2] + pixelCount / 2) / pixelCount), int((sums[3] + pixelCount / 2) / pixelCount));
+            for (int y = cell.top(); y <= cell.bottom(); ++y) {
+                for (int x = cell.left(); x <= cell.right(); ++x) {
+                    QVERIFY2(reinterpret_cast<const QRgb*>(actual.constScanLine(y))[x] == expected, qPrintable(QStringLiteral("pixel %1,%2 of the cell at %3,%4")
+                                                                        .arg(x).arg(y).arg(cellLeft).arg(cellTop)));
+                }
+            }
+        }
+    }
+}
+
+void Tests::convertToSRgb_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("colorSpace");
+    for (const QImage::Format format : { QImage::Format_RGB32, QImage::Format_ARGB32 }) {
+        for (const QColorSpace::NamedColorSpace colorSpace : { QColorSpace::DisplayP3, QColorSpace::AdobeRgb }) {
+            QTest::newRow(qPrintable(QStringLiteral("%1 %2").arg(format == QImage::Format_RGB32 ? "rgb32" : "argb32")
+                                     .arg(colorSpace == QColorSpace::DisplayP3 ? "display-p3" : "adobe-rgb")))
+                    << int(format) << int(colorSpace);
+        }
+    }
+}
+
+void Tests::convertToSRgb()
+{
+    QFETCH(int, format);
+    QFETCH(int, colorSpace);
+
+    // Taller than two bands, so the photo is converted band by band on all cores, with a last partial band.
+    QRandomGenerator random(format + colorSpace);
+    QImage image(67, 301, QImage::Format(format));
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+            line[x] = format == QImage::Format_RGB32 ? (random.generate() | 0xFF000000) : random.generate();
+    }
+    image.setColorSpace(QColorSpace::NamedColorSpace(colorSpace));
+
+    const QImage expected = image.convertedToColorSpace(QColorSpace::SRgb);
+    QImage actual = image;
+    ColorManagement::convertToSRgb(actual);
+    QCOMPARE(actual.format(), expected.format());
+    QCOMPARE(actual.colorSpace(), QColorSpace(QColorSpace::SRgb));
+
+    for (int y = 0; y < actual.height(); ++y) {
+        const QRgb* actualLine = reinterpret_cast<const QRgb*>(actual.constScanLine(y));
+        const QRgb* expectedLine = reinterpret_cast<const QRgb*>(expected.constScanLine(y));
+        for (int x = 0; x < actual.width(); ++x) {
+            const QRgb a = actualLine[x], e = expectedLine[x];
+            const int difference = qMax(qMax(qAbs(qRed(a) - qRed(e)), qAbs(qGreen(a) - qGreen(e))),
+                                        qMax(qAbs(qBlue(a) - qBlue(e)), qAbs(qAlpha(a) - qAlpha(e))));
+            QVERIFY2(difference <= 1, qPrintable(QStringLiteral("pixel %1,%2 is %3, QImage::convertToColorSpace gives %4")
+                                                 .arg(x).arg(y).arg(a, 8, 16, QLatin1Char('0')).arg(e, 8, 16, QLatin1Char('0'))));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(Tests)
+
+#include "tests.moc"
@@ -0,0 +1,11 @@
+QT += testlib
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tests
+
+include(../PhotoEditorCore.pri)
+
+SOURCES += \
+    tests.cpp
@@ -0,0 +1,141 @@
+#include "thumbnailloader.h"
+#include "colormanagement.h"
+#include "exif.h"
+#include "photoloader.h"
+#include "profiler.h"
+#include "constants.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+
+namespace {
+
+QString cacheFilePath(const QFileInfo& fileInfo)
+{
+    static const QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/thumbnails");
+
+    // Any change of the file gives another key, stale thumbnails are never looked up again.
+    const QByteArray key = fileInfo.absoluteFilePath().toUtf8() + '\n' + QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch())
+            + '\n' + QByteArray::number(fileInfo.size());
+    const QString hash = QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+    // Spread over subfolders, so no folder of the cache gets thousands of entries.
+    return QStringLiteral("%1/%2/%3").arg(directory, hash.left(2), hash);
+}
+
+QImage makeThumbnail(const QString& filePath, const QSize& bound)
+{
+    QImage thumbnail;
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly))
+        thumbnail = Exif::readThumbnail(&file);
+    file.close();
+
+    if (thumbnail.isNull())
+        thumbnail = PhotoLoader::readScaledPhoto(filePath, bound);
+    // Photos smaller than the bound and formats which cannot scale while decoding are decoded in full.
+    if (thumbnail.isNull()) {
+        QImageReader photoReader(filePath);
+        photoReader.setAutoTransform(true);
+        thumbnail = photoReader.read();
+        ColorManagement::convertToSRgb(thumbnail);
+    }
+    if (thumbnail.isNull())
+        return QImage();
+
+    if (thumbnail.width() > bound.width() || thumbnail.height() > bound.height())
+        thumbnail = thumbnail.scaled(bound, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    if (thumbnail.depth() != 32)
+        thumbnail = thumbnail.convertToFormat(thumbnail.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    return thumbnail;
+}
+
+}
+
+ThumbnailLoader::ThumbnailLoader(QObject* parent)
+    : QObject(parent)
+{
+    m_threadPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), Constants::THUMBNAIL_THREAD_COUNT));
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queue.clear();
+    }
+    m_threadPool.waitForDone();
+}
+
+void ThumbnailLoader::request(const QStringList& filePaths)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    for (const QString& filePath : filePaths) {
+        if (!m_running.contains(filePath))
+            m_queue.append(filePath);
+    }
+
+    // Workers take the photos from the queue until it is empty, more are started up to the pool size.
+    while (m_workerCount < qMin(m_queue.size(), m_threadPool.maxThreadCount())) {
+        ++m_workerCount;
+        m_threadPool.start([this]() {
+            work();
+        });
+    }
+}
+
+QImage ThumbnailLoader::readThumbnail(const QString& filePath)
+{
+    const QFileInfo fileInfo(filePath);
+    const QString cachePath = cacheFilePath(fileInfo);
+    if (QFileInfo::exists(cachePath)) {
+        QImage thumbnail = QImageReader(cachePath).read();
+        if (!thumbnail.isNull())
+            return thumbnail;
+    }
+
+    const Profiler::ScopedTimer timer("make thumbnail", "thumbnails");
+    const QImage thumbnail = makeThumbnail(filePath, QSize(Constants::THUMBNAIL_SIZE_PX, Constants::THUMBNAIL_SIZE_PX));
+    if (thumbnail.isNull())
+        return thumbnail;
+
+    // Written aside and renamed, a thumbnail is never read half-written by another thread or instance.
+    QDir().mkpath(QFileInfo(cachePath).path());
+    QSaveFile file(cachePath);
+    if (file.open(QIODevice::WriteOnly) && thumbnail.save(&file, thumbnail.hasAlphaChannel() ? "png" : "jpg"))
+        file.commit();
+    return thumbnail;
+}
+
+void ThumbnailLoader::work()
+{
+    forever {
+        QString filePath;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_queue.isEmpty()) {
+                --m_workerCount;
+                return;
+            }
+            filePath = m_queue.takeFirst();
+            m_running.insert(filePath);
+        }
+
+        const QImage thumbnail = readThumbnail(filePath);
+        {
+            QMutexLocker locker(&m_mutex);
+            m_running.remove(filePath);
+        }
+        QMetaObject::invokeMethod(this, [this, filePath, thumbnail]() {
+            emit thumbnailReady(filePath, thumbnail);
+        }, Qt::QueuedConnection);
+    }
+}
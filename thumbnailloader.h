@@ -0,0 +1,45 @@
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+
+// Makes the thumbnails of photos on a bounded pool of threads. A thumbnail is the EXIF thumbnail when the
+// photo has one, otherwise a decode scaled down by the decoder itself, like JPEG does in the DCT.
+// Thumbnails are kept in an on-disk cache under a hash of the path, the modification time and the size of
+// the file, so a photo is never decoded for its thumbnail twice, across sessions too.
+// A request replaces the queue of the photos not started yet, so the photos in view always go first.
+class ThumbnailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    ThumbnailLoader(QObject* parent = nullptr);
+    ~ThumbnailLoader();
+
+    // Queues the photos in the given order instead of the queued ones, the photos in progress are not queued again.
+    void request(const QStringList& filePaths);
+
+    // Returns the cached thumbnail of the photo, making and caching it first if needed. The thumbnail fits
+    // into the thumbnail size. Runs on the calling thread.
+    static QImage readThumbnail(const QString& filePath);
+
+signals:
+    // The thumbnail is null if the photo cannot be read.
+    void thumbnailReady(const QString& filePath, const QImage& thumbnail);
+
+private:
+    void work();
+
+    QThreadPool m_threadPool;
+    QMutex m_mutex;
+    QStringList m_queue;
+    QSet<QString> m_running;
+    int m_workerCount { 0 };
+};
+
+#endif // THUMBNAILLOADER_H
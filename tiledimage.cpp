@@ -0,0 +1,109 @@
+#include "tiledimage.h"
+#include "tiledimagestore.h"
+
+#include <QPainter>
+
+TiledImage::TiledImage(const QImage& image, int tileSize)
+    : m_image(image)
+    , m_size(image.size())
+    , m_tileSize(qMax(1, tileSize))
+{}
+
+TiledImage::TiledImage(const QSharedPointer<TiledImageStore>& store)
+    : m_store(store)
+    , m_size(store ? store->size() : QSize())
+    , m_tileSize(store ? store->tileSize() : Constants::PHOTO_TILE_SIZE_PX)
+{}
+
+QImage::Format TiledImage::format() const
+{
+    return m_store ? m_store->format() : m_image.format();
+}
+
+int TiledImage::columns() const
+{
+    return (width() + m_tileSize - 1) / m_tileSize;
+}
+
+int TiledImage::rows() const
+{
+    return (height() + m_tileSize - 1) / m_tileSize;
+}
+
+QRect TiledImage::tileRect(int column, int row) const
+{
+    return QRect(column * m_tileSize, row * m_tileSize, m_tileSize, m_tileSize).intersected(QRect(QPoint(0, 0), m_size));
+}
+
+QRect TiledImage::tileRange(const QRect& rect) const
+{
+    const QRect clipped = rect.intersected(QRect(QPoint(0, 0), m_size));
+    if (clipped.isEmpty())
+        return QRect();
+
+    const int firstColumn = clipped.left() / m_tileSize,
+            firstRow = clipped.top() / m_tileSize,
+            lastColumn = clipped.right() / m_tileSize,
+            lastRow = clipped.bottom() / m_tileSize;
+    return QRect(firstColumn, firstRow, lastColumn - firstColumn + 1, lastRow - firstRow + 1);
+}
+
+QImage TiledImage::tile(int column, int row) const
+{
+    const auto tileIt = m_tiles.constFind(tileIndex(column, row));
+    return tileIt != m_tiles.constEnd() ? *tileIt : originalTile(column, row);
+}
+
+QImage TiledImage::originalTile(int column, int row) const
+{
+    if (m_store)
+        return m_store->tile(column, row);
+
+    const QRect rect = tileRect(column, row);
+    if (rect.isEmpty())
+        return QImage();
+
+    // Wrap the pixels of the source image instead of copying them.
+    const int bytesPerPixel = m_image.depth() / 8;
+    const uchar* bits = m_image.constScanLine(rect.y()) + rect.x() * bytesPerPixel;
+    return QImage(bits, rect.width(), rect.height(), m_image.bytesPerLine(), m_image.format());
+}
+
+void TiledImage::setTile(int column, int row, const QImage& tile)
+{
+    Q_ASSERT(tile.isNull() || tile.size() == tileRect(column, row).size());
+
+    if (tile.isNull())
+        m_tiles.remove(tileIndex(column, row));
+    else
+        m_tiles.insert(tileIndex(column, row), tile);
+}
+
+qint64 TiledImage::memoryUsage() const
+{
+    qint64 usage = m_image.sizeInBytes();
+    for (const QImage& tile : m_tiles)
+        usage += tile.sizeInBytes();
+    return usage;
+}
+
+QImage TiledImage::copy(const QRect& rect) const
+{
+    const QRect sourceRect = rect.intersected(QRect(QPoint(0, 0), m_size));
+    QImage image = m_store ? m_store->read(sourceRect) : m_image.copy(sourceRect);
+    if (m_tiles.isEmpty() || image.isNull())
+        return image;
+
+    // Put the edited tiles over the original pixels.
+    const QRect range = tileRange(sourceRect);
+    QPainter painter(&image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (int row = range.top(); row <= range.bottom(); ++row) {
+        for (int column = range.left(); column <= range.right(); ++column) {
+            const auto tileIt = m_tiles.constFind(tileIndex(column, row));
+            if (tileIt != m_tiles.constEnd())
+                painter.drawImage(tileRect(column, row).topLeft() - sourceRect.topLeft(), *tileIt);
+        }
+    }
+    return image;
+}
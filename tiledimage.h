@@ -0,0 +1,68 @@
+#ifndef TILEDIMAGE_H
+#define TILEDIMAGE_H
+
+#include "constants.h"
+
+#include <QImage>
+#include <QRect>
+#include <QHash>
+#include <QSharedPointer>
+
+class TiledImageStore;
+
+// Splits an image into fixed-size square tiles. The last column and row may be narrower.
+// The pixels are either held by an image in memory or by an out-of-core store.
+// Tiles share the pixels of their source, so the TiledImage must outlive the tiles it returns.
+// Edited tiles are kept as separate images on top of the source, which itself is never modified;
+// copies of a TiledImage share both the source and the edited tiles.
+class TiledImage
+{
+public:
+    TiledImage() = default;
+    explicit TiledImage(const QImage& image, int tileSize = Constants::PHOTO_TILE_SIZE_PX);
+    explicit TiledImage(const QSharedPointer<TiledImageStore>& store);
+
+    bool isNull() const { return m_size.isEmpty(); }
+    bool isOutOfCore() const { return !m_store.isNull(); }
+    QSize size() const { return m_size; }
+    int width() const { return m_size.width(); }
+    int height() const { return m_size.height(); }
+    int tileSize() const { return m_tileSize; }
+    // Format of the original pixels, the edited tiles have it too.
+    QImage::Format format() const;
+    int columns() const;
+    int rows() const;
+
+    QRect tileRect(int column, int row) const;
+    // Returns the columns (x, width) and rows (y, height) of the tiles intersecting the rect.
+    QRect tileRange(const QRect& rect) const;
+    QImage tile(int column, int row) const;
+    QImage originalTile(int column, int row) const;
+    // Replaces the tile with an image of the same size and format, a null image restores the original tile.
+    void setTile(int column, int row, const QImage& tile);
+    bool isTileModified(int column, int row) const { return m_tiles.contains(tileIndex(column, row)); }
+    bool isModified() const { return !m_tiles.isEmpty(); }
+    void resetTiles() { m_tiles.clear(); }
+
+    // Returns a copy of the pixels inside the rect.
+    QImage copy(const QRect& rect) const;
+
+    // Returns the original pixels, a null image for out-of-core ones.
+    const QImage& image() const { return m_image; }
+    // Returns the store of the out-of-core original pixels, null for the ones in memory.
+    const QSharedPointer<TiledImageStore>& store() const { return m_store; }
+    // Returns the bytes of the original and edited pixels held in memory. Out-of-core pixels are paged
+    // in and out by the system and not counted.
+    qint64 memoryUsage() const;
+
+private:
+    int tileIndex(int column, int row) const { return row * columns() + column; }
+
+    QImage m_image;
+    QSharedPointer<TiledImageStore> m_store;
+    QHash<int, QImage> m_tiles;
+    QSize m_size;
+    int m_tileSize { Constants::PHOTO_TILE_SIZE_PX };
+};
+
+#endif // TILEDIMAGE_H
@@ -0,0 +1,123 @@
+#include "tiledimagestore.h"
+
+#include <QDir>
+
+#include <cstring>
+
+namespace {
+
+const int BYTES_PER_PIXEL = 4;
+
+}
+
+TiledImageStore::TiledImageStore(const QSize& size, QImage::Format format, int tileSize)
+    : m_size(size)
+    , m_format(format)
+    , m_tileSize(qMax(1, tileSize))
+    , m_file(QDir::tempPath() + QStringLiteral("/PhotoEditor-XXXXXX.tiles"))
+{}
+
+TiledImageStore::~TiledImageStore()
+{
+    if (m_data)
+        m_file.unmap(m_data);
+}
+
+bool TiledImageStore::open(QString* errorString)
+{
+    const qint64 fileSize = qint64(columns()) * rows() * tileBytes();
+    if (!m_file.open() || !m_file.resize(fileSize)) {
+        if (errorString)
+            *errorString = m_file.errorString();
+        return false;
+    }
+
+    m_data = m_file.map(0, fileSize);
+    if (!m_data && errorString)
+        *errorString = m_file.errorString();
+    return m_data != nullptr;
+}
+
+int TiledImageStore::columns() const
+{
+    return (m_size.width() + m_tileSize - 1) / m_tileSize;
+}
+
+int TiledImageStore::rows() const
+{
+    return (m_size.height() + m_tileSize - 1) / m_tileSize;
+}
+
+QRect TiledImageStore::tileRect(int column, int row) const
+{
+    return QRect(column * m_tileSize, row * m_tileSize, m_tileSize, m_tileSize).intersected(QRect(QPoint(0, 0), m_size));
+}
+
+QImage TiledImageStore::tile(int column, int row) const
+{
+    const QRect rect = tileRect(column, row);
+    if (!m_data || rect.isEmpty())
+        return QImage();
+
+    const uchar* data = tileData(column, row);
+    return QImage(data, rect.width(), rect.height(), m_tileSize * BYTES_PER_PIXEL, m_format);
+}
+
+void TiledImageStore::write(const QImage& image, const QPoint& position)
+{
+    Q_ASSERT(image.format() == m_format);
+
+    const QRect targetRect = QRect(position, image.size()).intersected(QRect(QPoint(0, 0), m_size));
+    if (!m_data || targetRect.isEmpty())
+        return;
+
+    const int firstColumn = targetRect.left() / m_tileSize, lastColumn = targetRect.right() / m_tileSize,
+            firstRow = targetRect.top() / m_tileSize, lastRow = targetRect.bottom() / m_tileSize;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const QRect tileRect = this->tileRect(column, row), rect = tileRect.intersected(targetRect);
+            uchar* data = tileData(column, row);
+            for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                std::memcpy(data + qint64(y - tileRect.top()) * m_tileSize * BYTES_PER_PIXEL + (rect.left() - tileRect.left()) * BYTES_PER_PIXEL,
+                            image.constScanLine(y - position.y()) + (rect.left() - position.x()) * BYTES_PER_PIXEL,
+                            size_t(rect.width()) * BYTES_PER_PIXEL);
+            }
+        }
+    }
+}
+
+QImage TiledImageStore::read(const QRect& rect) const
+{
+    const QRect sourceRect = rect.intersected(QRect(QPoint(0, 0), m_size));
+    if (sourceRect.isEmpty())
+        return QImage();
+
+    QImage image(sourceRect.size(), m_format);
+    const int firstColumn = sourceRect.left() / m_tileSize, lastColumn = sourceRect.right() / m_tileSize,
+            firstRow = sourceRect.top() / m_tileSize, lastRow = sourceRect.bottom() / m_tileSize;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const QImage tile = this->tile(column, row);
+            if (tile.isNull())
+                return QImage();
+
+            const QRect tileRect = this->tileRect(column, row), copyRect = tileRect.intersected(sourceRect);
+            for (int y = copyRect.top(); y <= copyRect.bottom(); ++y) {
+                std::memcpy(image.scanLine(y - sourceRect.top()) + (copyRect.left() - sourceRect.left()) * BYTES_PER_PIXEL,
+                            tile.constScanLine(y - tileRect.top()) + (copyRect.left() - tileRect.left()) * BYTES_PER_PIXEL,
+                            size_t(copyRect.width()) * BYTES_PER_PIXEL);
+            }
+        }
+    }
+    return image;
+}
+
+qint64 TiledImageStore::tileBytes() const
+{
+    return qint64(m_tileSize) * m_tileSize * BYTES_PER_PIXEL;
+}
+
+uchar* TiledImageStore::tileData(int column, int row) const
+{
+    return m_data + (qint64(row) * columns() + column) * tileBytes();
+}
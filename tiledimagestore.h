@@ -0,0 +1,49 @@
+#ifndef TILEDIMAGESTORE_H
+#define TILEDIMAGESTORE_H
+
+#include "constants.h"
+
+#include <QImage>
+#include <QTemporaryFile>
+
+// Out-of-core storage of a 32-bit image, laid out tile by tile in a memory mapped scratch file.
+// Tiles are paged in by the system when they are touched, so the resident set stays bounded
+// by the tiles in use rather than by the image size.
+// Subclasses may serve the tiles from another storage by overriding tile(), read() is built on it.
+class TiledImageStore
+{
+    Q_DISABLE_COPY(TiledImageStore)
+
+public:
+    TiledImageStore(const QSize& size, QImage::Format format, int tileSize = Constants::PHOTO_TILE_SIZE_PX);
+    virtual ~TiledImageStore();
+
+    // Creates and maps the scratch file.
+    bool open(QString* errorString = nullptr);
+    bool isOpen() const { return m_data != nullptr; }
+
+    QSize size() const { return m_size; }
+    QImage::Format format() const { return m_format; }
+    int tileSize() const { return m_tileSize; }
+    int columns() const;
+    int rows() const;
+    QRect tileRect(int column, int row) const;
+
+    // Returns the tile wrapping the mapped pixels, valid as long as the store exists.
+    virtual QImage tile(int column, int row) const;
+    // Copies the image into the tiles at the position. The image must have the format of the store.
+    void write(const QImage& image, const QPoint& position);
+    QImage read(const QRect& rect) const;
+
+private:
+    qint64 tileBytes() const;
+    uchar* tileData(int column, int row) const;
+
+    QSize m_size;
+    QImage::Format m_format;
+    int m_tileSize;
+    QTemporaryFile m_file;
+    uchar* m_data { nullptr };
+};
+
+#endif // TILEDIMAGESTORE_H